@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+
+// Engine analysis of the position a UI shows, on a thread of its own so that the UI never waits for it.
+// The UI hands over a copy of every new position with analyze_position. The copies are triple buffered: the UI fills
+// its back buffer and swaps it with the middle one, the thread swaps the middle one with its front buffer when it's
+// marked fresh. Either side only ever does an atomic exchange, newer positions replace older ones that weren't taken
+// yet, and a search of an old position is stopped through stop_requested. Positions are numbered, a stop that comes
+// after the thread took the position it was meant for doesn't end the analysis of the latest one.
+// Results of every finished iteration go back through a single producer single consumer ring, poll_analysis takes the
+// latest without waiting. A full ring drops the new result, so poll often or wake up with result_ready
+
+#define ANALYSIS_FRESH 4        // in middle, the buffer holds a position the thread hasn't taken
+
+static void *analysis_thread(void *argument);
+static void publish_result(struct SearchResult *search_result, void *argument);
+
+// Starts the thread, it searches every position handed over with options. result_ready is called on the thread after
+// every result, e.g. to wake the UI, NULL for none. false if there's no memory or no thread
+bool initialize_analysis(struct Analysis *analysis, struct Rules *rules, struct SearchOptions *options,
+                         void (*result_ready)(void *argument), void *result_ready_argument) {
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->rules = *rules;
+    analysis->options = *options;
+    analysis->result_ready = result_ready;
+    analysis->result_ready_argument = result_ready_argument;
+    analysis->board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        analysis->board_length *= rules->board_shape[dim];
+    }
+    bool ok = true;
+    analysis->game_state.board = calloc(analysis->board_length, sizeof(struct Square));    // empty until the first position
+    ok = ok && analysis->game_state.board != NULL;
+    for (int i = 0; i < 3; ++i) {
+        analysis->snapshots[i].board = malloc(sizeof(struct Square) * analysis->board_length);
+        ok = ok && analysis->snapshots[i].board != NULL;
+    }
+    if (!ok || !initialize_search_context(&analysis->search_context, &analysis->game_state, &analysis->rules)) {
+        printf("Tragedy: no memory for analysis\n");
+        for (int i = 0; i < 3; ++i) {
+            free(analysis->snapshots[i].board);
+        }
+        free(analysis->game_state.board);
+        return false;
+    }
+    analysis->search_context.iteration_done = publish_result;
+    analysis->search_context.iteration_done_argument = analysis;
+    analysis->back = 0;
+    analysis->middle = 1;
+    analysis->front = 2;
+
+    if (sem_init(&analysis->wake, 0, 0) != 0 || pthread_create(&analysis->thread, NULL, analysis_thread, analysis) != 0) {
+        printf("Havoc: can't start the analysis thread\n");
+        terminate_search_context(&analysis->search_context);
+        for (int i = 0; i < 3; ++i) {
+            free(analysis->snapshots[i].board);
+        }
+        free(analysis->game_state.board);
+        return false;
+    }
+    return true;
+}
+
+// Stops the search and waits for the thread to end
+void terminate_analysis(struct Analysis *analysis) {
+    __atomic_store_n(&analysis->quit, true, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&analysis->search_context.stop_requested, true, __ATOMIC_SEQ_CST);
+    sem_post(&analysis->wake);
+    pthread_join(analysis->thread, NULL);
+    sem_destroy(&analysis->wake);
+    terminate_search_context(&analysis->search_context);
+    for (int i = 0; i < 3; ++i) {
+        free(analysis->snapshots[i].board);
+    }
+    free(analysis->game_state.board);
+}
+
+// Analysis of the position from now on, hash tells its results apart from those of older positions. Never waits
+void analyze_position(struct Analysis *analysis, struct GameState *game_state, unsigned long long hash) {
+    struct GameState *snapshot = &analysis->snapshots[analysis->back];
+    struct Square *board = snapshot->board;
+    *snapshot = *game_state;
+    snapshot->board = board;
+    memcpy(board, game_state->board, sizeof(struct Square) * analysis->board_length);
+    analysis->snapshot_hashes[analysis->back] = hash;
+    unsigned int number = analysis->positions_handed_over + 1;
+    analysis->snapshot_numbers[analysis->back] = number;
+    __atomic_store_n(&analysis->positions_handed_over, number, __ATOMIC_SEQ_CST);
+    analysis->back = __atomic_exchange_n(&analysis->middle, analysis->back | ANALYSIS_FRESH, __ATOMIC_ACQ_REL) &
+                     ~ANALYSIS_FRESH;
+    __atomic_store_n(&analysis->search_context.stop_requested, true, __ATOMIC_SEQ_CST);
+    sem_post(&analysis->wake);
+}
+
+// Latest result not polled before, older ones are skipped. false if there's none. Never waits
+bool poll_analysis(struct Analysis *analysis, struct AnalysisResult *result) {
+    unsigned int read = analysis->results_read;
+    unsigned int written = __atomic_load_n(&analysis->results_written, __ATOMIC_ACQUIRE);
+    if (read == written) {
+        return false;
+    }
+    *result = analysis->results[(written - 1) % ANALYSIS_RESULT_SLOTS];
+    __atomic_store_n(&analysis->results_read, written, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void *analysis_thread(void *argument) {
+    struct Analysis *analysis = argument;
+    while (true) {
+        sem_wait(&analysis->wake);
+        if (analysis->quit) {
+            break;
+        }
+        // Cleared before the position is taken, so that a position handed over after this stops the search below
+        __atomic_store_n(&analysis->search_context.stop_requested, false, __ATOMIC_SEQ_CST);
+        if (!(__atomic_load_n(&analysis->middle, __ATOMIC_ACQUIRE) & ANALYSIS_FRESH)) {
+            continue;
+        }
+        analysis->front = __atomic_exchange_n(&analysis->middle, analysis->front, __ATOMIC_ACQ_REL) & ~ANALYSIS_FRESH;
+        struct GameState *snapshot = &analysis->snapshots[analysis->front];
+        struct Square *board = analysis->game_state.board;
+        analysis->game_state = *snapshot;
+        analysis->game_state.board = board;
+        memcpy(board, snapshot->board, sizeof(struct Square) * analysis->board_length);
+        analysis->searched_hash = analysis->snapshot_hashes[analysis->front];
+        unsigned int number = analysis->snapshot_numbers[analysis->front];
+        search_position(&analysis->search_context, &analysis->options);
+        // The UI requests the stop after the exchange, so the thread can take a position and then get the stop that was
+        // meant for the one before it. Searched again as long as no newer position was handed over
+        while (analysis->search_context.stop_requested) {
+            __atomic_store_n(&analysis->search_context.stop_requested, false, __ATOMIC_SEQ_CST);
+            if (    __atomic_load_n(&analysis->quit, __ATOMIC_SEQ_CST) ||
+                    __atomic_load_n(&analysis->positions_handed_over, __ATOMIC_SEQ_CST) != number) {
+                break;
+            }
+            search_position(&analysis->search_context, &analysis->options);
+        }
+    }
+    return NULL;
+}
+
+// Called by search_position after every finished iteration
+static void publish_result(struct SearchResult *search_result, void *argument) {
+    struct Analysis *analysis = argument;
+    unsigned int written = analysis->results_written;
+    if (written - __atomic_load_n(&analysis->results_read, __ATOMIC_ACQUIRE) == ANALYSIS_RESULT_SLOTS) {
+        ++analysis->dropped_results;
+        return;
+    }
+    struct AnalysisResult *result = &analysis->results[written % ANALYSIS_RESULT_SLOTS];
+    result->hash = analysis->searched_hash;
+    result->side_to_move = analysis->game_state.whos_turn;
+    result->best_move = search_result->best_move;
+    result->score = search_result->score;
+    result->depth = search_result->depth_reached;
+    result->nodes = search_result->nodes;
+    result->seconds = search_result->seconds;
+    __atomic_store_n(&analysis->results_written, written + 1, __ATOMIC_RELEASE);
+    if (analysis->result_ready != NULL) {
+        analysis->result_ready(analysis->result_ready_argument);
+    }
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include "chess.h"
+#include "engine.h"
+
+// Fixed position search bench. Every selective search feature is measured alone and all together against plain
+// alpha-beta: nodes needed for a fixed depth and depth reached within a fixed node budget
+
+#define BENCH_DEPTH 4
+#define BENCH_NODE_BUDGET 200000
+#define BENCH_OPENING_PLIES 8
+
+struct BenchPosition {
+    enum Variant variant;
+    const char *name;
+};
+
+struct BenchConfiguration {
+    const char *name;
+    bool null_move_pruning;
+    bool late_move_reductions;
+    bool futility_pruning;
+    bool razoring;
+};
+
+static const struct BenchPosition bench_positions[] = {
+    {STANDARD_CHESS,            "standard"},
+    {STANDARD_10X10_CHESS,      "standard 10x10"},
+    {THREE_D_5X5X5_CHESS,       "3D 5x5x5"},
+    {FOUR_D_3X3X3X3_V2_CHESS,   "4D 3x3x3x3 v2"},
+    {FOUR_D_4X4X4X4_V1_CHESS,   "4D 4x4x4x4 v1"},
+};
+
+static const struct BenchConfiguration bench_configurations[] = {
+    {"alpha-beta",  false, false, false, false},
+    {"null move",   true,  false, false, false},
+    {"lmr",         false, true,  false, false},
+    {"futility",    false, false, true,  false},
+    {"razoring",    false, false, false, true},
+    {"all",         true,  true,  true,  true},
+};
+
+#define NBR_OF_BENCH_POSITIONS (int)(sizeof(bench_positions) / sizeof(bench_positions[0]))
+#define NBR_OF_BENCH_CONFIGURATIONS (int)(sizeof(bench_configurations) / sizeof(bench_configurations[0]))
+
+// Same opening moves every run so that positions are comparable between builds
+static void play_bench_opening(struct GameState *game_state, struct Rules *rules) {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    for (int ply = 0; ply < BENCH_OPENING_PLIES; ++ply) {
+        int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, game_state, rules);
+        if (nbr_moves == 0) {
+            return;
+        }
+        make_move(moves[(ply * 7 + 3) % nbr_moves], QUEEN, game_state, rules);
+    }
+}
+
+int main() {
+    long long total_nodes[NBR_OF_BENCH_CONFIGURATIONS] = {0};
+    int total_depth[NBR_OF_BENCH_CONFIGURATIONS] = {0};
+    double total_seconds[NBR_OF_BENCH_CONFIGURATIONS] = {0};
+
+    printf("depth %i, node budget %i\n", BENCH_DEPTH, BENCH_NODE_BUDGET);
+    printf("%-16s %-12s %12s %10s %8s %12s\n", "position", "search", "nodes", "change", "depth", "seconds");
+    for (int p = 0; p < NBR_OF_BENCH_POSITIONS; ++p) {
+        struct Rules rules;
+        struct GameState game_state;
+        if (!initialize_rules_and_game_state(&rules, &game_state, bench_positions[p].variant)) {
+            return 1;
+        }
+        play_bench_opening(&game_state, &rules);
+        struct SearchContext search_context;
+        if (!initialize_search_context(&search_context, &game_state, &rules)) {
+            return 1;
+        }
+
+        long long baseline_nodes = 0;
+        for (int c = 0; c < NBR_OF_BENCH_CONFIGURATIONS; ++c) {
+            struct SearchOptions options;
+            default_search_options(&options);
+            options.null_move_pruning = bench_configurations[c].null_move_pruning;
+            options.late_move_reductions = bench_configurations[c].late_move_reductions;
+            options.futility_pruning = bench_configurations[c].futility_pruning;
+            options.razoring = bench_configurations[c].razoring;
+
+            // Fresh history for every run, otherwise later configurations profit from earlier ones
+            terminate_move_ordering(&search_context.move_ordering);
+            initialize_move_ordering(&search_context.move_ordering, &rules);
+            options.max_depth = BENCH_DEPTH;
+            struct SearchResult fixed_depth = search_position(&search_context, &options);
+
+            terminate_move_ordering(&search_context.move_ordering);
+            initialize_move_ordering(&search_context.move_ordering, &rules);
+            options.max_depth = MAX_SEARCH_PLY;
+            options.max_nodes = BENCH_NODE_BUDGET;
+            struct SearchResult fixed_nodes = search_position(&search_context, &options);
+
+            if (c == 0) {
+                baseline_nodes = fixed_depth.nodes;
+            }
+            double change = baseline_nodes > 0 ? 100.0 * (double)(fixed_depth.nodes - baseline_nodes) / (double)baseline_nodes : 0;
+            printf("%-16s %-12s %12lli %+9.1f%% %8i %12.3f\n", bench_positions[p].name, bench_configurations[c].name,
+                   fixed_depth.nodes, change, fixed_nodes.depth_reached, fixed_depth.seconds);
+            total_nodes[c] += fixed_depth.nodes;
+            total_depth[c] += fixed_nodes.depth_reached;
+            total_seconds[c] += fixed_depth.seconds;
+        }
+        terminate_search_context(&search_context);
+        terminate_game_state(&game_state);
+    }
+
+    printf("\n%-16s %-12s %12s %10s %8s %12s\n", "total", "search", "nodes", "change", "depth", "seconds");
+    for (int c = 0; c < NBR_OF_BENCH_CONFIGURATIONS; ++c) {
+        double change = 100.0 * (double)(total_nodes[c] - total_nodes[0]) / (double)total_nodes[0];
+        printf("%-16s %-12s %12lli %+9.1f%% %8.1f %12.3f\n", "", bench_configurations[c].name, total_nodes[c], change,
+               (double)total_depth[c] / NBR_OF_BENCH_POSITIONS, total_seconds[c]);
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include "board_layout.h"
+#include "chess.h"
+
+// Number of squares of the board, the length of graphics_board below
+int board_layout_length(int dimensions, int board_shape[]) {
+    int length = 1;
+    for (int dim = 0; dim < dimensions; ++dim) {
+        length *= board_shape[dim];
+    }
+    return length;
+}
+
+// Square size and the top left corner of every square for the board to fill as much of width x height as possible,
+// centered. Pure, graphics_board has board_layout_length squares
+void compute_board_layout(struct BoardLayout *layout, struct GraphicsSquare graphics_board[], int width, int height,
+                          int dimensions, int board_shape[]) {
+    layout->width = width;
+    layout->height = height;
+
+    // Compute square_width for board to fill as much of screen as possible
+    float separation_width_for_dim[MAX_DIMENSIONS] = {0.0, 0.0, 0.5, 0.5, 1.0, 1.0, 1.5, 1.5, 2.0, 2.0, 2.5, 2.5, 3.0, 3.0};    // change this hardcoding if MAX_DIMENSIONS changes
+    float board_width_in_squares = 1.0;
+    float board_height_in_squares = 1.0;
+    for (int dim = 0; dim < dimensions; ++dim) {
+        float this_dim = 0.0;
+        if (dim % 2 == 0) {
+            for (int i = 0; i < board_shape[dim]; ++i) {
+                this_dim += board_width_in_squares;
+                this_dim += separation_width_for_dim[dim];
+            }
+            board_width_in_squares = this_dim - separation_width_for_dim[dim];
+        } else {
+            for (int i = 0; i < board_shape[dim]; ++i) {
+                this_dim += board_height_in_squares;
+                this_dim += separation_width_for_dim[dim];
+            }
+            board_height_in_squares = this_dim - separation_width_for_dim[dim];
+        }
+    }
+
+    int width_ratio = (int)(width / board_width_in_squares);
+    int height_ratio = (int)(height / board_height_in_squares);
+    int square_width = width_ratio < height_ratio ? width_ratio : height_ratio;
+    layout->square_width = square_width;
+
+    for (int i = 2; i < MAX_DIMENSIONS; ++i) {
+        separation_width_for_dim[i] *= square_width;
+    }
+
+    // Computing coordinates for all the dimensions by themselves
+    // 0, 0 is bottom left  (or top left)
+    int x_coord = square_width;
+    int y_coord = square_width;
+    int coordinates_for_dim[MAX_DIMENSIONS][MAX_SIDE_LENGTH];
+    for (int dim = 0; dim < dimensions; ++dim) {
+        int dim_coord = 0;
+        coordinates_for_dim[dim][0] = dim_coord;
+        if (dim % 2 == 0) {
+            x_coord += separation_width_for_dim[dim];
+            for (int i = 1; i < board_shape[dim] + 1; ++i) {
+                dim_coord += x_coord;
+                coordinates_for_dim[dim][i] = dim_coord;
+            }
+            x_coord = dim_coord - separation_width_for_dim[dim];
+        } else {
+            y_coord += separation_width_for_dim[dim];
+            for (int i = 1; i < board_shape[dim] + 1; ++i) {
+                dim_coord += y_coord;
+                coordinates_for_dim[dim][i] = dim_coord;
+            }
+            y_coord = dim_coord - separation_width_for_dim[dim];
+        }
+    }
+    int board_total_width = x_coord;
+    int board_total_height = y_coord;
+
+    layout->board_total_width = board_total_width;
+    layout->board_total_height = board_total_height;
+
+    // Computing exact coordinates for all squares
+    // coordinates 0, 0 is top left of window
+    // no rotation: 0 right, 1000 down
+    // 90° rotation: 1000 down, 0 right
+    int x_offset = (width - board_total_width) / 2;
+    int y_offset = (height - board_total_height) / 2;
+    int length = board_layout_length(dimensions, board_shape);
+    int square[dimensions];
+    for (int index = 0; index < length; ++index) {
+        square_index_to_square(index, square, dimensions, board_shape);
+        //printf("%d %d\n", square[0], square[1]);
+        int x = 0;
+        int y = board_total_height - square_width;  // top left corner of bottom left square
+        int light_square_dark_square = 0;
+        for (int dim = dimensions-1; dim >= 0; --dim) {
+            light_square_dark_square += square[dim];
+            if (dim % 2 == 0) {
+                x += coordinates_for_dim[dim][square[dim]];
+            } else {
+                y -= coordinates_for_dim[dim][square[dim]];
+            }
+        }
+        //printf("%d\n", x);
+        graphics_board[index].x = x + x_offset;
+        graphics_board[index].y = y + y_offset;
+        graphics_board[index].light_squares = (light_square_dark_square % 2 == 1);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef BOARD_LAYOUT_H
+#define BOARD_LAYOUT_H
+
+#include <stdbool.h>
+
+// Where the squares of an n-D board go in a window or image, shared by the SDL window and the software renderer.
+// Nothing in here depends on SDL
+
+#define LIGHT_SQUARES_RGB 237, 214, 176
+#define DARK_SQUARES_RGB 184, 134, 98      // standard dark squares color
+#define BACKGROUND_RGB 33, 37, 41
+
+struct GraphicsSquare {
+    int x;
+    int y;
+    bool light_squares;
+};
+
+struct BoardLayout {
+    int width;                          // of the window or image
+    int height;
+    int square_width;
+    int board_total_width;
+    int board_total_height;
+};
+
+int  board_layout_length(int dimensions, int board_shape[]);
+void compute_board_layout(struct BoardLayout *layout, struct GraphicsSquare graphics_board[], int width, int height,
+                          int dimensions, int board_shape[]);
+
+#endif // BOARD_LAYOUT_H
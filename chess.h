@@ -9,6 +9,7 @@
 #define MAX_NBR_OF_WIN_CONDITIONS 10
 #define MAX_MOVES_SINGLE_PIECE 200
 #define MAX_MOVES_PER_TURN 10
+#define MAX_SQUARES_CHANGED_BY_MOVE 256   // gravity can move every piece
 
 enum PieceType {
     NULL_PIECE_TYPE = 0, PAWN, ROOK, KNIGHT, BISHOP, KING, QUEEN,
@@ -61,6 +62,20 @@ struct GameState {
     struct Move last_moves_by_piece_color[PIECE_COLOR_COUNT][MAX_MOVES_PER_TURN];   // defines legal en passant captures
 };
 
+struct SquareChange {
+    int square_index;
+    struct Square square;   // content before the change
+};
+
+// Everything make_move_with_undo changed. Lets search take moves back instead of copying the board
+struct MoveUndo {
+    enum PieceColor whos_turn;
+    int moves_made_this_turn;
+    struct Move overwritten_last_move;
+    int nbr_square_changes;
+    struct SquareChange square_changes[MAX_SQUARES_CHANGED_BY_MOVE];
+};
+
 enum WinCondition {
     NULL_WIN_CONDITION,
     CHECKMATE,
@@ -75,6 +90,25 @@ enum WinCondition {
     NBR_OF_WIN_CONDITIONS,
 };
 
+// Neighbours of every square, compiled once per board by compile_board_topology so that move generation follows
+// edges instead of stepping coordinates. Directions are numbered in the order pieces walk them: 2 horizontal per
+// dimension (-1 then +1), 4 diagonal per pair dim1 < dim2 ({1,1},{1,-1},{-1,1},{-1,-1}) and 4 knight jumps per pair
+// dim1 != dim2 (two steps in dim1). Edges that leave the board or end on a square that isn't part of it are -1,
+// wrapping dimensions are edges like any other. Shared by every copy of the rules and never freed
+struct BoardTopology {
+    int  dimensions;
+    int  board_shape[MAX_DIMENSIONS];
+    bool dimension_wrapping[MAX_DIMENSIONS];
+    bool *part_of_board;                // per square, the board the topology was compiled from
+    int  board_length;
+    int  nbr_directions;
+    int  first_diagonal_direction;
+    int  first_knight_direction;
+    int  diagonal_directions[MAX_DIMENSIONS][MAX_DIMENSIONS];  // first of the 4 directions of dim1 < dim2
+    int  *successors;                   // [square_index * nbr_directions + direction]
+    struct BoardTopology *next;
+};
+
 struct Rules {
     int  dimensions;
     int  board_shape[MAX_DIMENSIONS];
@@ -94,6 +128,7 @@ struct Rules {
     int  gravity_direction;      // -1 or 1
     bool can_move_anywhere_unoccupied;
     //bool pieces_two_lives;    // is this fun?
+    const struct BoardTopology *topology;   // set by initialize_rules_and_game_state from the starting board
 };
 
 enum Variant {
@@ -152,6 +187,7 @@ enum Variant {
     KNIGHT_KING_CHESS,
     PAWN_PROMOTION_CHESS,
     PIECES_TWO_LIVES_CHESS,
+    NBR_OF_VARIANTS,                // not a variant
 
     // some variant(s) where only one side allowed to be on specific part of board
     // some variant(s) where only one side allow to capture on specific part of board
@@ -161,16 +197,31 @@ enum Variant {
 // chess_initialize.c
 bool initialize_rules_and_game_state (struct Rules *rules, struct GameState *GameState, enum Variant variant);
 void terminate_game_state   (struct GameState *game_state);
+const char *variant_name    (enum Variant variant);
+bool variant_from_name      (const char *name, enum Variant *variant);
 
 // chess_logic.c
 void get_moves              (struct Move moves[MAX_MOVES_SINGLE_PIECE], struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE], 
                              int square_index, struct GameState *game_state, struct Rules *rules);
+void get_capture_moves      (struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, struct GameState *game_state, 
+                             struct Rules *rules);
 struct Move validate_selected_move (int origin_square, int destination_square, struct Move possible_moves[], 
                              struct GameState *game_state, struct Rules *rules);
 bool evaluate_promotion     (int square_index_from, int square_index_moving_to, struct GameState *game_state, struct Rules *rules);
 void make_move              (struct Move move, enum PieceType promotion_piece_type, struct GameState *game_state, 
                              struct Rules *rules);
+void make_move_with_undo    (struct Move move, enum PieceType promotion_piece_type, struct GameState *game_state, 
+                             struct Rules *rules, struct MoveUndo *undo);
+void unmake_move            (struct MoveUndo *undo, struct GameState *game_state);
+void make_null_move         (struct GameState *game_state, struct MoveUndo *undo);
 bool evaluate_win_conditions(struct Move last_move, struct GameState *game_state, struct Rules *rules);
+enum PieceColor get_winner  (struct Move last_move, struct GameState *game_state, struct Rules *rules);
+bool move_is_capture        (struct Move move, struct GameState *game_state);
+int  get_attackers          (int attackers[], int max_attackers, int square_index, enum PieceColor attacking_piece_color, 
+                             struct GameState *game_state, struct Rules *rules);
+void count_attacks          (int *attack_counts[PIECE_COLOR_COUNT], struct GameState *game_state, struct Rules *rules);
+const struct BoardTopology *compile_board_topology(struct Rules *rules, const struct Square board[]);
+bool update_board_topology  (struct Rules *rules, const struct Square board[]);
 
 // chess_utils.c
 int  square_to_square_index (int square[], int dimensions, int board_shape[]);
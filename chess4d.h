@@ -0,0 +1,260 @@
+#ifndef CHESS4D_H
+#define CHESS4D_H
+
+// Public header of libchess4d: rules, search and headless games. Nothing in here depends on SDL
+
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "chess.h"
+#include "engine.h"
+
+#define DEFAULT_MAX_GAME_LENGTH 500     // moves, the game is a draw after this many
+#define MAX_SQUARE_TEXT_LENGTH (MAX_DIMENSIONS * 4)                 // "99." per dimension, the last dot is the terminator
+#define MAX_MOVE_TEXT_LENGTH (2 * MAX_SQUARE_TEXT_LENGTH + 2)       // origin, dash, destination, promotion letter
+#define POSITION_STREAM_KEYFRAME_INTERVAL 64
+#define POSITION_UPDATE_KEYFRAME 0      // first byte of a position stream message
+#define POSITION_UPDATE_DELTA 1
+#define GAME_RECORD_VERSION 2           // bumped whenever the order of get_moves changes
+#define GAME_DATABASE_FIRST_GAME 5      // offset of the first game in a game database, after the header
+#define GAME_DATABASE_PLY_BITS 16       // low bits of GameDatabaseEntry location
+#define GAME_DATABASE_MAX_PLY ((1 << GAME_DATABASE_PLY_BITS) - 1)      // later positions aren't indexed
+#define ANALYSIS_RESULT_SLOTS 16        // results the UI hasn't polled yet, a power of two
+#define MOVE_CACHE_POOL_LENGTH (2 * MAX_MOVES_IN_POSITION)             // moves and diagonal pawn moves of one position
+
+enum MoveChooserType {
+    MOVE_CHOOSER_RANDOM,                // uniformly among the moves of the side to move
+    MOVE_CHOOSER_SEARCH,                // best move of search_position
+};
+
+// How one side picks its moves
+struct MoveChooser {
+    enum MoveChooserType type;
+    struct SearchOptions search_options;    // MOVE_CHOOSER_SEARCH only. Node and time limits are per move
+};
+
+// Writes a binary message per move for clients following a game, see position_stream.c
+struct PositionStreamEncoder {
+    int board_length;
+    unsigned int sequence;              // of the next message
+    int keyframe_interval;              // messages from one keyframe to the next
+    int updates_since_keyframe;
+};
+
+struct PositionStreamDecoder {
+    struct Rules *rules;                // its topology follows the holes of the keyframes
+    int board_length;
+    unsigned int next_sequence;
+    bool synchronized;                  // false until a keyframe arrives and after a missed message
+};
+
+// Appends games to a game record file, see game_record.c
+struct GameRecordWriter {
+    FILE *file;                         // NULL to write to buffer instead
+    unsigned char *buffer;
+    int buffer_length;
+    int buffer_capacity;
+    bool game_open;
+    struct Rules rules;
+    struct GameState game_state;        // position of the open game
+    long long nbr_moves;
+    long long bytes_written;
+};
+
+struct GameRecordReader {
+    FILE *file;                         // NULL to read from data instead
+    const unsigned char *data;          // next byte
+    const unsigned char *data_end;
+    bool game_open;
+    bool variant_loaded;                // starting_position and game_state are allocated
+    enum Variant variant;               // of the open game
+    struct Rules rules;
+    struct GameState starting_position; // of variant
+    int board_length;
+    struct GameState game_state;        // after the last move read
+    struct MoveUndo undo;               // of the last move read
+    enum PieceColor winner;             // recorded result, set at the end of the game
+    bool error;                         // the record is broken
+    long long nbr_games;
+    long long nbr_moves;
+};
+
+// Position hash index entry of a game database, see game_database.c
+struct GameDatabaseEntry {
+    unsigned long long hash;
+    unsigned long long location;        // offset of the game << GAME_DATABASE_PLY_BITS | ply the position is reached at
+};
+
+// Memory mapped game database and its index
+struct GameDatabase {
+    const unsigned char *data;
+    size_t length;
+    const unsigned char *index_data;    // NULL without index
+    size_t index_length;
+    const struct GameDatabaseEntry *entries;    // sorted by hash, in index_data
+    long long nbr_entries;
+    long long indexed_length;           // the index covers the games before this offset
+};
+
+// Moves of one square in a MoveCache
+struct MoveCacheEntry {
+    unsigned int generation;            // valid if the generation of the cache
+    int first_move;                     // in pool, the moves then the diagonal pawn moves
+    int nbr_moves;
+    int nbr_diagonal_pawn_moves;
+};
+
+// Moves of every piece of the side to move, generated in the background for the UI, see move_cache.c
+struct MoveCache {
+    struct Rules rules;
+    int board_length;
+    pthread_t thread;
+    bool thread_started;
+    bool synchronization_initialized;
+    pthread_mutex_t mutex;              // guards everything below
+    pthread_cond_t condition;           // new position or quit
+    bool quit;
+    struct GameState position;          // latest position, own board
+    unsigned long long hash;            // of position
+    unsigned int generation;            // of position, counts the positions handed over
+    unsigned int completed_generation;  // the background thread is done with this position
+    struct MoveCacheEntry *entries;     // [board_length]
+    struct Move *pool;                  // [MOVE_CACHE_POOL_LENGTH]
+    int pool_length;
+    long long hits;
+    long long misses;
+};
+
+// One finished search iteration of the analysis thread
+struct AnalysisResult {
+    unsigned long long hash;            // of the analyzed position
+    enum PieceColor side_to_move;       // in the analyzed position
+    struct Move best_move;
+    int  score;                         // from the point of view of side_to_move
+    int  depth;
+    long long nodes;
+    double seconds;                     // since the search of the position started
+};
+
+// Background engine analysis of the latest position handed over, see analysis.c
+struct Analysis {
+    struct Rules rules;
+    int board_length;
+    struct SearchOptions options;
+    struct SearchContext search_context;    // stop_requested is set by the UI when a new position arrives
+    struct GameState game_state;        // searched by the thread
+    unsigned long long searched_hash;   // of game_state
+    pthread_t thread;
+    sem_t wake;
+    volatile bool quit;
+    // Triple buffered positions handed over to the thread
+    struct GameState snapshots[3];      // own boards
+    unsigned long long snapshot_hashes[3];
+    unsigned int snapshot_numbers[3];   // positions_handed_over when the snapshot was handed over
+    unsigned int positions_handed_over; // counts up, stored by the UI before the exchange
+    int back;                           // written by the UI only
+    int front;                          // read by the thread only
+    int middle;                         // exchanged atomically, with ANALYSIS_FRESH set when the UI put a new position there
+    // Single producer single consumer ring of results
+    struct AnalysisResult results[ANALYSIS_RESULT_SLOTS];
+    unsigned int results_written;       // counts up, stored by the thread
+    unsigned int results_read;          // stored by the UI
+    long long dropped_results;          // ring was full
+    void (*result_ready)(void *argument);   // called on the thread after every result, NULL for none
+    void *result_ready_argument;
+};
+
+struct GameSettings {
+    enum Variant variant;
+    struct MoveChooser move_choosers[PIECE_COLOR_COUNT];
+    int  max_game_length;
+    int  random_opening_moves;          // played at random by both sides before the move choosers take over
+    unsigned long long random_seed;     // same seed, same game
+    bool verbose;
+    struct GameRecordWriter *record;    // NULL or where the game is appended
+};
+
+struct GameResult {
+    enum PieceColor winner;             // NULL_PIECE_COLOR for a draw
+    int  nbr_moves;
+    long long nodes;                    // searched by both sides
+    double seconds;                     // spent searching
+};
+
+// game.c
+void default_game_settings      (struct GameSettings *settings, enum Variant variant);
+bool play_game                  (struct GameResult *result, struct GameSettings *settings);
+unsigned long long next_random  (unsigned long long *random_state);
+
+// notation.c
+void square_to_text             (int square_index, char text[MAX_SQUARE_TEXT_LENGTH], struct Rules *rules);
+int  text_to_square             (const char *text, const char **end, struct Rules *rules);
+void move_to_text               (struct Move move, enum PieceType promotion_piece_type, char text[MAX_MOVE_TEXT_LENGTH],
+                                 struct Rules *rules);
+bool text_to_move               (const char *text, struct Move *move, enum PieceType *promotion_piece_type,
+                                 struct GameState *game_state, struct Rules *rules);
+int  position_text_max_length   (struct Rules *rules);
+int  position_to_text           (struct GameState *game_state, struct Rules *rules, char text[]);
+bool text_to_position           (const char *text, struct GameState *game_state, struct Rules *rules);
+
+// position_stream.c
+void initialize_position_encoder(struct PositionStreamEncoder *encoder, int keyframe_interval, struct Rules *rules);
+void initialize_position_decoder(struct PositionStreamDecoder *decoder, struct Rules *rules);
+int  position_update_max_bytes  (struct Rules *rules);
+int  encode_position_keyframe   (struct PositionStreamEncoder *encoder, struct GameState *game_state, unsigned char buffer[]);
+int  encode_position_update     (struct PositionStreamEncoder *encoder, struct MoveUndo *undo, struct GameState *game_state,
+                                 unsigned char buffer[]);
+bool decode_position_update     (struct PositionStreamDecoder *decoder, const unsigned char buffer[], int length,
+                                 struct GameState *game_state);
+
+// game_record.c
+void initialize_game_record_writer(struct GameRecordWriter *writer, FILE *file);
+void terminate_game_record_writer(struct GameRecordWriter *writer);
+bool begin_game_record          (struct GameRecordWriter *writer, enum Variant variant);
+bool write_game_record_move     (struct GameRecordWriter *writer, struct Move move, enum PieceType promotion_piece_type);
+void end_game_record            (struct GameRecordWriter *writer, enum PieceColor winner);
+bool initialize_game_record_reader(struct GameRecordReader *reader, FILE *file);
+void initialize_game_record_reader_from_memory(struct GameRecordReader *reader, const unsigned char *data, size_t length);
+void set_game_record_reader_memory(struct GameRecordReader *reader, const unsigned char *data, size_t length);
+void terminate_game_record_reader(struct GameRecordReader *reader);
+bool next_game_record           (struct GameRecordReader *reader);
+bool read_game_record_move      (struct GameRecordReader *reader, struct Move *move, enum PieceType *promotion_piece_type);
+bool verify_game_records        (struct GameRecordReader *reader);
+
+// game_database.c
+unsigned long long position_hash(struct GameState *game_state, struct Rules *rules, enum Variant variant);
+unsigned long long update_position_hash(unsigned long long hash, struct MoveUndo *undo, struct GameState *game_state);
+FILE *open_game_database_for_append(const char *path);
+bool append_game_to_database    (FILE *database_file, struct GameRecordWriter *writer);
+bool open_game_database         (struct GameDatabase *database, const char *path);
+void close_game_database        (struct GameDatabase *database);
+bool database_game              (struct GameDatabase *database, long long offset, const unsigned char **game, size_t *length,
+                                 long long *next_offset);
+long long find_database_position(struct GameDatabase *database, unsigned long long hash,
+                                 const struct GameDatabaseEntry **first);
+bool build_game_database_index  (const char *path, int nbr_threads, size_t memory_budget, long long *nbr_entries);
+
+// starting_position_cache.c
+bool write_starting_position_cache  (const char *path, int *nbr_variants);
+bool load_starting_position_cache   (const char *path);
+void unload_starting_position_cache (void);
+bool start_game                     (struct Rules *rules, struct GameState *game_state, enum Variant variant);
+
+// move_cache.c
+bool initialize_move_cache          (struct MoveCache *cache, struct GameState *game_state, struct Rules *rules,
+                                     unsigned long long hash);
+void terminate_move_cache           (struct MoveCache *cache);
+void set_move_cache_position        (struct MoveCache *cache, struct GameState *game_state, unsigned long long hash);
+void get_cached_moves               (struct MoveCache *cache, struct Move moves[MAX_MOVES_SINGLE_PIECE],
+                                     struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE], int square_index,
+                                     struct GameState *game_state, unsigned long long hash);
+bool move_cache_complete            (struct MoveCache *cache);
+
+// analysis.c
+bool initialize_analysis            (struct Analysis *analysis, struct Rules *rules, struct SearchOptions *options,
+                                     void (*result_ready)(void *argument), void *result_ready_argument);
+void terminate_analysis             (struct Analysis *analysis);
+void analyze_position               (struct Analysis *analysis, struct GameState *game_state, unsigned long long hash);
+bool poll_analysis                  (struct Analysis *analysis, struct AnalysisResult *result);
+
+#endif // CHESS4D_H
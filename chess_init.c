@@ -7,6 +7,61 @@
 
 static struct Square *parse_board_from_textfile(char *text_file_name, int dimensions, int *board_shape);
 
+// Names used on the command line and in files. Lower case enum name without _CHESS
+static const char *variant_names[NBR_OF_VARIANTS] = {
+    [STANDARD_CHESS]                            = "standard",
+    [CAPTURE_THE_FLAG_CHESS]                    = "capture_the_flag",
+    [LONG_RANGE_CHESS]                          = "long_range",
+    [KING_MARCH_CHESS]                          = "king_march",
+    [STANDARD_10X10_CHESS]                      = "standard_10x10",
+    [STANDARD_24X24_CHESS]                      = "standard_24x24",
+    [STANDARD_DIAMOND_CHESS]                    = "standard_diamond",
+    [SPARSE_CHESS]                              = "sparse",
+    [SWAP2_CHESS]                               = "swap2",
+    [TWO_MOVES_CHESS]                           = "two_moves",
+    [TEN_MOVES_CHESS]                           = "ten_moves",
+    [TWO_PLUS_ONE_MOVE_CHESS]                   = "two_plus_one_move",
+    [RANDOM_STARTING_POSITION_CHESS]            = "random_starting_position",
+    [RANDOM_SYMETRICAL_STARTING_POSITION_CHESS] = "random_symetrical_starting_position",
+    [MORE_PAWNS_CHESS]                          = "more_pawns",
+    [GRAVITY_CHESS]                             = "gravity",
+    [MORE_PAWNS_GRAVITY_CHESS]                  = "more_pawns_gravity",
+    [NO_RETREATING_MOVES_CHESS]                 = "no_retreating_moves",
+    [START_AS_OPPONENT_CHESS]                   = "start_as_opponent",
+    [ANYTHING_CAN_PROMOTE_CHESS]                = "anything_can_promote",
+    [MOVE_TO_ANY_SQUARE_CHESS]                  = "move_to_any_square",
+    [CONTROL_OPPONENTS_KING_CHESS]              = "control_opponents_king",
+    [THREE_D_5X5X5_CHESS]                       = "three_d_5x5x5",
+    [THREE_D_8X8X8_CHESS]                       = "three_d_8x8x8",
+    [FOUR_D_3X3X3X3_V1_CHESS]                   = "four_d_3x3x3x3_v1",
+    [FOUR_D_3X3X3X3_V2_CHESS]                   = "four_d_3x3x3x3_v2",
+    [FOUR_D_3X3X3X3_V3_CHESS]                   = "four_d_3x3x3x3_v3",
+    [FOUR_D_3X3X3X3_V4_CHESS]                   = "four_d_3x3x3x3_v4",
+    [FOUR_D_4X4X4X4_V1_CHESS]                   = "four_d_4x4x4x4_v1",
+    [FOUR_D_4X4X4X4_V2_CHESS]                   = "four_d_4x4x4x4_v2",
+    [FOUR_D_8X8X8X8_V1_CHESS]                   = "four_d_8x8x8x8_v1",
+    [FOUR_D_8X8X8X8_V2_CHESS]                   = "four_d_8x8x8x8_v2",
+    [FIVE_D_3X3X3X3X3_CHESS]                    = "five_d_3x3x3x3x3",
+    [SIX_D_2X2X2X2X2X2_CHESS]                   = "six_d_2x2x2x2x2x2",
+    [SIX_D_3X3X3X3X3X3_CHESS]                   = "six_d_3x3x3x3x3x3",
+    [WRAPPING_10X10_CHESS]                      = "wrapping_10x10",
+    [WRAPPING_12X12_CHESS]                      = "wrapping_12x12",
+    [WRAPPING_8X14_CHESS]                       = "wrapping_8x14",
+    [THREE_D_SPHERE_CHESS]                      = "three_d_sphere",
+    [FOUR_D_SPHERE_CHESS]                       = "four_d_sphere",
+    [HOLLOW_CUBE_CHESS]                         = "hollow_cube",
+    [DONUT_CHESS]                               = "donut",
+    [SIMULTANEOUS_CHESS]                        = "simultaneous",
+    [TOWER_DEFENSE_CHESS]                       = "tower_defense",
+    [MONSTER_CHESS]                             = "monster",
+    [CAPTURE_ALL_PAWNS_CHESS]                   = "capture_all_pawns",
+    [CONNECT_SIX_DIAGONALLY_CHESS]              = "connect_six_diagonally",
+    [RANK_SEVEN_AND_EIGHT_CHESS]                = "rank_seven_and_eight",
+    [KNIGHT_KING_CHESS]                         = "knight_king",
+    [PAWN_PROMOTION_CHESS]                      = "pawn_promotion",
+    [PIECES_TWO_LIVES_CHESS]                    = "pieces_two_lives",
+};
+
 bool initialize_rules_and_game_state(struct Rules *rules, struct GameState *game_state, enum Variant variant) {
     rules->dimensions = 2;
     rules->board_shape[0] = 8;
@@ -43,6 +98,7 @@ bool initialize_rules_and_game_state(struct Rules *rules, struct GameState *game
     for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
         for (int i = 0; i < MAX_MOVES_PER_TURN; ++i) {
             game_state->last_moves_by_piece_color[piece_color][i].destination_square = -1;
+            game_state->last_moves_by_piece_color[piece_color][i].pawn_moved_past_square = -1;
         }
     }
 
@@ -280,6 +336,13 @@ bool initialize_rules_and_game_state(struct Rules *rules, struct GameState *game
     if (game_state->board == NULL) {
         return false;
     }
+    rules->topology = compile_board_topology(rules, game_state->board);
+    if (rules->topology == NULL) {
+        printf("Tragedy: no memory for the board topology\n");
+        free(game_state->board);
+        game_state->board = NULL;
+        return false;
+    }
     return true;
 }
 
@@ -312,6 +375,7 @@ bool initialize_rules(struct Rules *rules, enum Variant variant) {
     rules->gravity_dimension = -1;  // no gravity
     rules->gravity_direction = 0;   // no gravity
     rules->can_move_anywhere_unoccupied = false;
+    rules->topology = NULL;     // compile_board_topology once there is a board
 
     switch (variant) {
         case STANDARD_CHESS:
@@ -486,6 +550,7 @@ bool initialize_game_state(struct GameState *state, enum Variant variant, int di
     for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
         for (int i = 0; i < MAX_MOVES_PER_TURN; ++i) {
             state->last_moves_by_piece_color[piece_color][i].destination_square = -1;
+            state->last_moves_by_piece_color[piece_color][i].pawn_moved_past_square = -1;
         }
     }
 
@@ -602,6 +667,7 @@ static struct Square *parse_board_from_textfile(char *text_file_name, int dimens
     FILE *file = fopen(text_file_path, "r");
     if (file == NULL) {
         printf("Debacle: failed to open starting position file\n");
+        free(board);
         return NULL;
     }
 
@@ -632,17 +698,23 @@ static struct Square *parse_board_from_textfile(char *text_file_name, int dimens
 
         if (square[dim_change_order[dimensions-1]] < 0) {   //last dim to change less than 0
             printf("Trouble: to many chars in starting position text file compared to board shape.\n");
+            fclose(file);
+            free(board);
             return NULL;
         }
 
         if (c != 'w' & c != 'b' & c != 'x' & c != '.') {
             printf("Shock and horror: char: %c in starting position text file not valid.\n", c);
+            fclose(file);
+            free(board);
             return NULL;
         }
 
         c2 = fgetc(file);
         if (c2 != 'p' & c2 != 'R' & c2 != 'N' & c2 != 'B' & c2 != 'Q' & c2 != 'K' & c2 != 'F' & c2 != 'x' & c2 != '.') {
             printf("Blunder: char: %c in starting position text file not valid.\n", c2);
+            fclose(file);
+            free(board);
             return NULL;
         }
 
@@ -678,10 +750,16 @@ static struct Square *parse_board_from_textfile(char *text_file_name, int dimens
                 } else if (c == 'b') {
                     board[index].black_flag = true;
                 }
-            case 'x': board[index].part_of_board = false; break;
+                break;
+            case 'x':
+                board[index].part_of_board = false;
+                board[index].piece.piece_type = NULL_PIECE_TYPE;
+                break;
             case '.': board[index].piece.piece_type = NULL_PIECE_TYPE; break;
             default: 
                 printf("Square content in starting positions file not valid. Index %d\n", index);
+                fclose(file);
+                free(board);
                 return NULL;
         }
         switch(c3) {
@@ -715,6 +793,7 @@ static struct Square *parse_board_from_textfile(char *text_file_name, int dimens
             }
         }
     }
+    fclose(file);
     return board;
 }
 
@@ -722,3 +801,21 @@ void terminate_game_state(struct GameState *game_state) {
     free(game_state->board);
 }
 
+
+const char *variant_name(enum Variant variant) {
+    if (variant < 0 || variant >= NBR_OF_VARIANTS) {
+        return "unknown";
+    }
+    return variant_names[variant];
+}
+
+bool variant_from_name(const char *name, enum Variant *variant) {
+    for (int i = 0; i < NBR_OF_VARIANTS; ++i) {
+        if (strcmp(name, variant_names[i]) == 0) {
+            *variant = i;
+            return true;
+        }
+    }
+    printf("Blunder: no variant named %s\n", name);
+    return false;
+}
@@ -1,8 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "chess.h"
 
+static pthread_mutex_t topologies_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct BoardTopology *topologies = NULL;     // every board compiled so far
+
 static bool increment_dim_of_square_if_legal(int square[], int dim, int incr, bool dimension_wrapping, int board_shape_dim);
+static bool topology_matches(const struct BoardTopology *topology, struct Rules *rules, const struct Square board[]);
+static struct BoardTopology *build_board_topology(struct Rules *rules, const struct Square board[]);
+static int  square_after_steps(int square_index, int steps[][2], int nbr_steps, const struct Square board[],
+                              struct Rules *rules);
+static int  diagonal_direction(const struct BoardTopology *topology, int dim1, int incr1, int dim2, int incr2);
 static void get_pawn_moves  (struct Move moves[], struct Move diagonal_pawn_moves[], int square_index, struct Square board[], 
                              struct Move last_moves_by_piece_color[PIECE_COLOR_COUNT][MAX_MOVES_PER_TURN], struct Rules *rules);
 //static void get_direct_pawn_captures (struct Move moves[], int square_index, struct Square board[], struct Rules *rules);
@@ -18,6 +27,12 @@ static int  get_castling_moves (struct Move moves[], int king_square_index, stru
 static void get_queen_moves (struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, struct Square board[], 
                              struct Rules *rules);
 static void get_all_moves_to_unoccupied (struct Move moves[], int square_index, struct Square board[], struct Rules *rules);
+static void get_slider_captures(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, bool horizontal, bool diagonal,
+                             struct Square board[], struct Rules *rules);
+static int  get_moves_on_ray(struct Move moves[], int square_index, int direction, struct Square board[], 
+                             const struct BoardTopology *topology);
+static int  get_first_capture_on_ray(struct Move *move, int square_index, int direction, struct Square board[], 
+                             const struct BoardTopology *topology);
 
 //static bool piece_color_in_check(enum PieceColor piece_color, int king_square, struct Square *board, struct Rules *rules);
 //static bool move_puts_own_king_in_check(struct Move move, struct Square *board, struct Rules *rules);
@@ -25,7 +40,23 @@ static bool square_is_attacked(int square_index, enum PieceColor attacked_piece_
 static bool player_is_checkmated(enum PieceColor piece_color, struct GameState *game_state, struct Rules *rules);
 static bool piece_color_king_captured(bool piece_color, struct GameState *game_state, struct Rules *rules);
 
-static void evaluate_gravity(struct Square board[], struct Rules *rules);
+static void evaluate_gravity(struct Square board[], struct Rules *rules, struct MoveUndo *undo);
+
+// Square one step in direction from square_index, -1 if there is none
+static inline int next_square(const struct BoardTopology *topology, int square_index, int direction) {
+    return topology->successors[square_index * topology->nbr_directions + direction];
+}
+
+// 2*dim for -1, 2*dim+1 for +1
+static inline int horizontal_direction(int dim, int incr) {
+    return 2 * dim + (incr > 0 ? 1 : 0);
+}
+
+// Order in which get_attackers lists attackers, least valuable first
+static const int attacker_rank[] = {
+    [NULL_PIECE_TYPE] = 0, [PAWN] = 1, [KNIGHT] = 2, [BISHOP] = 3, [ROOK] = 4, [QUEEN] = 5, [KING] = 6,
+};
+static void record_square_change(struct MoveUndo *undo, int square_index, struct Square board[]);
 
 void get_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE], 
                int square_index, struct GameState *game_state, struct Rules *rules) {
@@ -90,6 +121,49 @@ void get_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], struct Move diagonal_p
     }
 }
 
+// Same captures as get_moves would return, without generating the non-capturing moves of sliders
+void get_capture_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, struct GameState *game_state, 
+                       struct Rules *rules) {
+    struct Square *board = game_state->board;
+    struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    switch (board[square_index].piece.piece_type) {
+        case NULL_PIECE_TYPE:
+            moves[0].destination_square = -1;
+            return;
+        case PAWN:
+            get_pawn_moves(moves, diagonal_pawn_moves, square_index, board, game_state->last_moves_by_piece_color, rules);
+            break;
+        case ROOK:
+            get_slider_captures(moves, square_index, true, false, board, rules);
+            break;
+        case KNIGHT:
+            get_knight_moves(moves, square_index, board, rules);
+            break;
+        case BISHOP:
+            get_slider_captures(moves, square_index, false, true, board, rules);
+            break;
+        case KING:
+            get_king_moves(moves, square_index, true, board, rules);    // castling never captures
+            break;
+        case QUEEN:
+            get_slider_captures(moves, square_index, true, true, board, rules);
+            break;
+    }
+
+    // Keep captures only. King invincible: remove moves that capture opponents king, like get_moves
+    int counter = 0;
+    for (int i = 0; moves[i].destination_square != -1; ++i) {
+        if (!move_is_capture(moves[i], game_state)) {
+            continue;
+        }
+        if (rules->king_invincible && board[moves[i].destination_square].piece.piece_type == KING) {
+            continue;
+        }
+        moves[counter++] = moves[i];
+    }
+    moves[counter].destination_square = -1;
+}
+
 struct Move validate_selected_move(int origin_square, int destination_square, struct Move moves[], struct GameState *game_state, 
                                    struct Rules *rules) {
     struct Move move;
@@ -127,15 +201,29 @@ struct Move validate_selected_move(int origin_square, int destination_square, st
 }
 
 void make_move(struct Move move, enum PieceType promotion_piece_type, struct GameState *game_state, struct Rules *rules) {
+    make_move_with_undo(move, promotion_piece_type, game_state, rules, NULL);
+}
+
+// make_move that also records everything it changes in undo, so that unmake_move can take the move back. undo can be NULL
+void make_move_with_undo(struct Move move, enum PieceType promotion_piece_type, struct GameState *game_state, 
+                         struct Rules *rules, struct MoveUndo *undo) {
     enum PieceType piece_type = game_state->board[move.origin_square].piece.piece_type;
+    if (undo != NULL) {
+        undo->whos_turn = game_state->whos_turn;
+        undo->moves_made_this_turn = game_state->moves_made_this_turn;
+        undo->overwritten_last_move = game_state->last_moves_by_piece_color[game_state->whos_turn][game_state->moves_made_this_turn];
+        undo->nbr_square_changes = 0;
+    }
 
     // Make the move
+    record_square_change(undo, move.destination_square, game_state->board);
+    record_square_change(undo, move.origin_square, game_state->board);
     game_state->board[move.destination_square].piece = game_state->board[move.origin_square].piece;
     game_state->board[move.origin_square].piece.piece_type = NULL_PIECE_TYPE;
 
     // Gravity if gravity
     if (rules->gravity_dimension != -1) {
-        evaluate_gravity(game_state->board, rules);
+        evaluate_gravity(game_state->board, rules, undo);
     }
 
     // En passant: Remove captured pawn
@@ -149,6 +237,7 @@ void make_move(struct Move move, enum PieceType promotion_piece_type, struct Gam
                 if (    game_state->last_moves_by_piece_color[opponent_piece_color][i].pawn_moved_past_square == 
                         move.destination_square) {
                     int square = game_state->last_moves_by_piece_color[opponent_piece_color][i].destination_square;
+                    record_square_change(undo, square, game_state->board);
                     game_state->board[square].piece.piece_type = NULL_PIECE_TYPE;
                 }
             }
@@ -157,6 +246,8 @@ void make_move(struct Move move, enum PieceType promotion_piece_type, struct Gam
 
     // Deal with castling king move
     if (piece_type == KING && move.castling_with_rook_on_square != -1) {
+        record_square_change(undo, move.castling_rook_destination_square, game_state->board);
+        record_square_change(undo, move.castling_with_rook_on_square, game_state->board);
         game_state->board[move.castling_rook_destination_square].piece = game_state->board[move.castling_with_rook_on_square].piece;
         game_state->board[move.castling_with_rook_on_square].piece.piece_type = NULL_PIECE_TYPE;
     }
@@ -164,6 +255,7 @@ void make_move(struct Move move, enum PieceType promotion_piece_type, struct Gam
     // Move the flag if it was on the square
 
     // Carry out promotion
+    record_square_change(undo, move.destination_square, game_state->board);     // gravity may have changed it
     if (promotion_piece_type != NULL_PIECE_TYPE) {
         game_state->board[move.destination_square].piece.piece_type = promotion_piece_type;
     }
@@ -171,8 +263,12 @@ void make_move(struct Move move, enum PieceType promotion_piece_type, struct Gam
     // The piece has now moved
     game_state->board[move.destination_square].piece.has_moved = true;
 
-    // Add move to list of last moves by piece color
+    // Add move to list of last moves by piece color. pawn_moved_past_square is undefined for other pieces but en passant
+    // reads it
     game_state->last_moves_by_piece_color[game_state->whos_turn][game_state->moves_made_this_turn] = move;
+    if (piece_type != PAWN) {
+        game_state->last_moves_by_piece_color[game_state->whos_turn][game_state->moves_made_this_turn].pawn_moved_past_square = -1;
+    }
 
     ++game_state->moves_made_this_turn;
     if (game_state->moves_made_this_turn >= rules->moves_per_turn_by_color[game_state->whos_turn]) {
@@ -185,11 +281,60 @@ void make_move(struct Move move, enum PieceType promotion_piece_type, struct Gam
     }
 }
 
-// TODO: should also check if the square is part of the board
-// and if that piece color is allowed on that square
-// TODO make increment_dim_of_square_if_legal deal with one dimension wrapping and non-rectangle board shapes. It should increment both dims simultaneously and then move if wrapping
+// Restores the board and turn state to what it was before the move recorded in undo
+void unmake_move(struct MoveUndo *undo, struct GameState *game_state) {
+    for (int i = undo->nbr_square_changes - 1; i >= 0; --i) {
+        game_state->board[undo->square_changes[i].square_index] = undo->square_changes[i].square;
+    }
+    game_state->whos_turn = undo->whos_turn;
+    game_state->moves_made_this_turn = undo->moves_made_this_turn;
+    game_state->last_moves_by_piece_color[undo->whos_turn][undo->moves_made_this_turn] = undo->overwritten_last_move;
+}
+
+// Passes the turn without moving, for null move search. Only meaningful when the side to move has one move per turn.
+// Taken back with unmake_move
+void make_null_move(struct GameState *game_state, struct MoveUndo *undo) {
+    undo->whos_turn = game_state->whos_turn;
+    undo->moves_made_this_turn = game_state->moves_made_this_turn;
+    undo->overwritten_last_move = game_state->last_moves_by_piece_color[game_state->whos_turn][game_state->moves_made_this_turn];
+    undo->nbr_square_changes = 0;
+
+    // No move means no en passant for the opponent
+    struct Move *last_move = &game_state->last_moves_by_piece_color[game_state->whos_turn][game_state->moves_made_this_turn];
+    last_move->destination_square = -1;
+    last_move->pawn_moved_past_square = -1;
+
+    game_state->whos_turn = (game_state->whos_turn == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+    game_state->moves_made_this_turn = 0;
+}
+
+// Saves the square as it is before it is changed. Restoring in reverse order makes recording the same square twice harmless
+static void record_square_change(struct MoveUndo *undo, int square_index, struct Square board[]) {
+    if (undo == NULL) {
+        return;
+    }
+    if (undo->nbr_square_changes >= MAX_SQUARES_CHANGED_BY_MOVE) {
+        printf("bug, record_square_change: more than MAX_SQUARES_CHANGED_BY_MOVE squares changed\n");
+        return;
+    }
+    undo->square_changes[undo->nbr_square_changes].square_index = square_index;
+    undo->square_changes[undo->nbr_square_changes].square = board[square_index];
+    ++undo->nbr_square_changes;
+}
+
+// True if the move removes an opponents piece. Only pawn moves have en_passant_capture set
+bool move_is_capture(struct Move move, struct GameState *game_state) {
+    struct Piece moving_piece = game_state->board[move.origin_square].piece;
+    struct Piece captured_piece = game_state->board[move.destination_square].piece;
+    if (captured_piece.piece_type != NULL_PIECE_TYPE && captured_piece.piece_color != moving_piece.piece_color) {
+        return true;
+    }
+    return moving_piece.piece_type == PAWN && move.en_passant_capture;
+}
+
+// Only build_board_topology steps coordinates, squares that aren't part of the board are left out there.
+// TODO: check if that piece color is allowed on that square
 static bool increment_dim_of_square_if_legal(int square[], int dim, int incr, bool dimension_wrapping, int board_shape_dim) {
-    // todo: non-rectangle shaped boards
     square[dim] += incr;
     if (square[dim] >= 0 && square[dim] < board_shape_dim) {
         return true;
@@ -205,20 +350,160 @@ static bool increment_dim_of_square_if_legal(int square[], int dim, int incr, bo
     }
 }
 
+// The topology of the rules and board, compiled the first time this board shape, wrapping and set of squares that are
+// part of the board is seen and shared after that. NULL if there's no memory
+const struct BoardTopology *compile_board_topology(struct Rules *rules, const struct Square board[]) {
+    pthread_mutex_lock(&topologies_mutex);
+    struct BoardTopology *topology = topologies;
+    while (topology != NULL && !topology_matches(topology, rules, board)) {
+        topology = topology->next;
+    }
+    if (topology == NULL) {
+        topology = build_board_topology(rules, board);
+        if (topology != NULL) {
+            topology->next = topologies;
+            topologies = topology;
+        }
+    }
+    pthread_mutex_unlock(&topologies_mutex);
+    return topology;
+}
+
+// rules->topology compiled again if the squares that are part of board aren't the ones it was compiled from, for boards
+// read from outside the game. false if there's no memory
+bool update_board_topology(struct Rules *rules, const struct Square board[]) {
+    if (rules->topology != NULL && topology_matches(rules->topology, rules, board)) {
+        return true;
+    }
+    rules->topology = compile_board_topology(rules, board);
+    if (rules->topology == NULL) {
+        printf("Tragedy: no memory for the board topology\n");
+        return false;
+    }
+    return true;
+}
+
+static bool topology_matches(const struct BoardTopology *topology, struct Rules *rules, const struct Square board[]) {
+    if (topology->dimensions != rules->dimensions) {
+        return false;
+    }
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        if (    topology->board_shape[dim] != rules->board_shape[dim] ||
+                topology->dimension_wrapping[dim] != rules->dimension_wrapping[dim]) {
+            return false;
+        }
+    }
+    for (int square_index = 0; square_index < topology->board_length; ++square_index) {
+        if (topology->part_of_board[square_index] != board[square_index].part_of_board) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every edge is found once the way pieces used to step: increment_dim_of_square_if_legal for each step in turn
+static struct BoardTopology *build_board_topology(struct Rules *rules, const struct Square board[]) {
+    int dimensions = rules->dimensions;
+    struct BoardTopology *topology = malloc(sizeof(*topology));
+    if (topology == NULL) {
+        return NULL;
+    }
+    topology->dimensions = dimensions;
+    topology->board_length = 1;
+    for (int dim = 0; dim < dimensions; ++dim) {
+        topology->board_shape[dim] = rules->board_shape[dim];
+        topology->dimension_wrapping[dim] = rules->dimension_wrapping[dim];
+        topology->board_length *= rules->board_shape[dim];
+    }
+    int direction = 2 * dimensions;
+    topology->first_diagonal_direction = direction;
+    for (int dim1 = 0; dim1 < dimensions; ++dim1) {
+        for (int dim2 = dim1 + 1; dim2 < dimensions; ++dim2) {
+            topology->diagonal_directions[dim1][dim2] = direction;
+            direction += 4;
+        }
+    }
+    topology->first_knight_direction = direction;
+    topology->nbr_directions = direction + 4 * dimensions * (dimensions - 1);
+    topology->part_of_board = malloc(sizeof(bool) * topology->board_length);
+    topology->successors = malloc(sizeof(int) * topology->board_length * topology->nbr_directions);
+    if (topology->part_of_board == NULL || topology->successors == NULL) {
+        free(topology->part_of_board);
+        free(topology->successors);
+        free(topology);
+        return NULL;
+    }
+
+    int increments[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
+    for (int square_index = 0; square_index < topology->board_length; ++square_index) {
+        topology->part_of_board[square_index] = board[square_index].part_of_board;
+        int *successors = &topology->successors[square_index * topology->nbr_directions];
+        direction = 0;
+        for (int dim = 0; dim < dimensions; ++dim) {
+            for (int incr = -1; incr <= 1; incr += 2) {
+                int steps[1][2] = {{dim, incr}};
+                successors[direction++] = square_after_steps(square_index, steps, 1, board, rules);
+            }
+        }
+        for (int dim1 = 0; dim1 < dimensions; ++dim1) {
+            for (int dim2 = dim1 + 1; dim2 < dimensions; ++dim2) {
+                for (int i = 0; i < 4; ++i) {
+                    int steps[2][2] = {{dim1, increments[i][0]}, {dim2, increments[i][1]}};
+                    successors[direction++] = square_after_steps(square_index, steps, 2, board, rules);
+                }
+            }
+        }
+        for (int dim1 = 0; dim1 < dimensions; ++dim1) {
+            for (int dim2 = 0; dim2 < dimensions; ++dim2) {
+                if (dim1 == dim2) {
+                    continue;
+                }
+                for (int i = 0; i < 4; ++i) {
+                    int steps[3][2] = {{dim1, increments[i][0]}, {dim1, increments[i][0]}, {dim2, increments[i][1]}};
+                    successors[direction++] = square_after_steps(square_index, steps, 3, board, rules);
+                }
+            }
+        }
+    }
+    return topology;
+}
+
+// steps are {dim, incr}. -1 if a step leaves the board or either end isn't part of it
+static int square_after_steps(int square_index, int steps[][2], int nbr_steps, const struct Square board[],
+                              struct Rules *rules) {
+    if (!board[square_index].part_of_board) {
+        return -1;
+    }
+    int square[rules->dimensions];
+    square_index_to_square(square_index, square, rules->dimensions, rules->board_shape);
+    for (int i = 0; i < nbr_steps; ++i) {
+        int dim = steps[i][0];
+        if (!increment_dim_of_square_if_legal(square, dim, steps[i][1], rules->dimension_wrapping[dim], rules->board_shape[dim])) {
+            return -1;
+        }
+    }
+    int destination_square_index = square_to_square_index(square, rules->dimensions, rules->board_shape);
+    return board[destination_square_index].part_of_board ? destination_square_index : -1;
+}
+
+// The one diagonal direction that steps incr1 in dim1 and incr2 in dim2, in either order of the dimensions
+static int diagonal_direction(const struct BoardTopology *topology, int dim1, int incr1, int dim2, int incr2) {
+    if (dim1 > dim2) {
+        return diagonal_direction(topology, dim2, incr2, dim1, incr1);
+    }
+    return topology->diagonal_directions[dim1][dim2] + (incr1 < 0 ? 2 : 0) + (incr2 < 0 ? 1 : 0);
+}
+
 // assumes there is a pawn at the square
 static void get_pawn_moves(struct Move moves[], struct Move diagonal_pawn_moves[], int square_index, struct Square board[], 
                            struct Move last_moves_by_piece_color[PIECE_COLOR_COUNT][MAX_MOVES_PER_TURN], struct Rules *rules) {
+    const struct BoardTopology *topology = rules->topology;
     enum PieceColor piece_color = board[square_index].piece.piece_color;
     int dimensions = rules->dimensions;
-    int origin_square[dimensions];
-    square_index_to_square(square_index, origin_square, dimensions, rules->board_shape);
-    int destination_square[dimensions];
 
     int counter = 0;
     int counter_diag = 0;
     for (int dim = 0; dim < dimensions; ++dim) {
-        copy_int_array(origin_square, destination_square, dimensions);
-
         // Figure out direction for this pawn of this piece color in this dimension.
         enum Direction piece_direction = board[square_index].piece.direction;
         bool dim_is_forward_dimension = rules->is_forward_dimension[dim];
@@ -238,14 +523,9 @@ static void get_pawn_moves(struct Move moves[], struct Move diagonal_pawn_moves[
             incr *= -1;
         }
 
-        bool increment_legal = increment_dim_of_square_if_legal(destination_square, dim, incr, rules->dimension_wrapping[dim], 
-                                                                rules->board_shape[dim]);
-        if (!increment_legal) {
-            continue;
-        }
-
-        int destination_square_index = square_to_square_index(destination_square, dimensions, rules->board_shape);
-        if (board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
+        int forward_direction = horizontal_direction(dim, incr);
+        int destination_square_index = next_square(topology, square_index, forward_direction);
+        if (destination_square_index != -1 && board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
             moves[counter].origin_square = square_index;
             moves[counter].destination_square = destination_square_index;
             moves[counter].pawn_moved_past_square = -1;
@@ -253,13 +533,9 @@ static void get_pawn_moves(struct Move moves[], struct Move diagonal_pawn_moves[
             ++counter;
 
             if (!board[square_index].piece.has_moved) {
-                int two_squares_destination_square[dimensions];
-                copy_int_array(destination_square, two_squares_destination_square, dimensions);
-                increment_legal = increment_dim_of_square_if_legal(two_squares_destination_square, dim, incr, 
-                                                                   rules->dimension_wrapping[dim], rules->board_shape[dim]);
-                int two_squares_destination_square_index = square_to_square_index(two_squares_destination_square, dimensions, 
-                                                                                  rules->board_shape);
-                if (increment_legal && board[two_squares_destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
+                int two_squares_destination_square_index = next_square(topology, destination_square_index, forward_direction);
+                if (    two_squares_destination_square_index != -1 &&
+                        board[two_squares_destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
                     moves[counter].origin_square = square_index;
                     moves[counter].destination_square = two_squares_destination_square_index;
                     moves[counter].pawn_moved_past_square = destination_square_index;
@@ -278,16 +554,13 @@ static void get_pawn_moves(struct Move moves[], struct Move diagonal_pawn_moves[
             if ((piece_direction == RIGHT || piece_direction == LEFT) && !rules->is_forward_dimension[dim2]) {
                 continue;
             }
-            for (incr = -1; incr <= 1; incr += 2) {
-                int destination_square_diag[dimensions];
-                copy_int_array(destination_square, destination_square_diag, dimensions);
-                bool increment_legal = increment_dim_of_square_if_legal(destination_square_diag, dim2, incr, 
-                                                                        rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                if (!increment_legal) {
+            for (int incr2 = -1; incr2 <= 1; incr2 += 2) {
+                destination_square_index = next_square(topology, square_index, 
+                                                       diagonal_direction(topology, dim, incr, dim2, incr2));
+                if (destination_square_index == -1) {
                     continue;
                 }
 
-                destination_square_index = square_to_square_index(destination_square_diag, dimensions, rules->board_shape);
                 diagonal_pawn_moves[counter_diag].origin_square = square_index;
                 diagonal_pawn_moves[counter_diag].destination_square = destination_square_index;
                 diagonal_pawn_moves[counter_diag].pawn_moved_past_square = -1;
@@ -400,122 +673,61 @@ static void get_pawn_moves(struct Move moves[], struct Move diagonal_pawn_moves[
 //}
 
 static void get_rook_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, struct Square board[], struct Rules *rules) {
-    // Variables
-    enum PieceColor piece_color = board[square_index].piece.piece_color;
-    int dimensions = rules->dimensions;
-    int square[dimensions];
-    square_index_to_square(square_index, square, dimensions, rules->board_shape);
-    int destination_square[dimensions];
-
     int counter = 0;
-    for (int dim = 0; dim < dimensions; ++dim) {
-        for (int direction = -1; direction <= 1; direction += 2) {
-            copy_int_array(square, destination_square, dimensions);
-            bool stop = false;
-            while (!stop) {
-                bool increment_legal = increment_dim_of_square_if_legal(destination_square, dim, direction, rules->dimension_wrapping[dim], rules->board_shape[dim]);
-                if (!increment_legal) {
-                    stop = true;
-                    continue;
-                }
-                int destination_square_index = square_to_square_index(destination_square, dimensions, rules->board_shape);
-
-                if (destination_square_index == square_index) {
-                    break;
-                } else if (board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
-                    moves[counter].origin_square = square_index;
-                    moves[counter].destination_square = destination_square_index;
-                    ++counter;
-                } else if (board[destination_square_index].piece.piece_color != piece_color) {
-                    moves[counter].origin_square = square_index;
-                    moves[counter].destination_square = destination_square_index;
-                    ++counter;
-                    break;
-                } else {
-                    break;
-                }
-            }
-        }
+    for (int direction = 0; direction < rules->topology->first_diagonal_direction; ++direction) {
+        counter += get_moves_on_ray(moves + counter, square_index, direction, board, rules->topology);
     }
     moves[counter].destination_square = -1;
 }
 
 static void get_bishop_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, struct Square board[], struct Rules *rules) {
-    // Variables
-    enum PieceColor piece_color = board[square_index].piece.piece_color;
-    int dimensions = rules->dimensions;
-    int square[dimensions];
-    square_index_to_square(square_index, square, dimensions, rules->board_shape);
-    int destination_square[dimensions];
-
+    const struct BoardTopology *topology = rules->topology;
     int counter = 0;
-    for (int dim1 = 0; dim1 < dimensions; ++dim1) {
-        for (int dim2 = dim1 + 1; dim2 < dimensions; ++dim2) {
-            int increments[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
-            for (int i = 0; i < 4; ++i) {
-                copy_int_array(square, destination_square, dimensions);
-                bool stop = false;
-                while (!stop) {
-                    bool increment1_legal = increment_dim_of_square_if_legal(destination_square, dim1, increments[i][0], 
-                                                                    rules->dimension_wrapping[dim1], rules->board_shape[dim1]);
-                    bool increment2_legal = increment_dim_of_square_if_legal(destination_square, dim2, increments[i][1], 
-                                                                    rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                    if (!increment1_legal || !increment2_legal) {
-                        stop = true;
-                        continue;
-                    }
-                    int destination_square_index = square_to_square_index(destination_square, dimensions, rules->board_shape);
+    for (int direction = topology->first_diagonal_direction; direction < topology->first_knight_direction; ++direction) {
+        counter += get_moves_on_ray(moves + counter, square_index, direction, board, topology);
+    }
+    moves[counter].destination_square = -1;
+}
 
-                    if (destination_square_index == square_index) {
-                        break;
-                    } else if (board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
-                        moves[counter].origin_square = square_index;
-                        moves[counter].destination_square = destination_square_index;
-                        ++counter;
-                    } else if (board[destination_square_index].piece.piece_color != piece_color) {
-                        moves[counter].origin_square = square_index;
-                        moves[counter].destination_square = destination_square_index;
-                        ++counter;
-                        break;
-                    } else {
-                        break;
-                    }
-                }
-            }
+// Empty squares along the ray and the opponents piece that blocks it. Returns the number of moves
+static int get_moves_on_ray(struct Move moves[], int square_index, int direction, struct Square board[], 
+                            const struct BoardTopology *topology) {
+    enum PieceColor piece_color = board[square_index].piece.piece_color;
+    int counter = 0;
+    int destination_square_index = next_square(topology, square_index, direction);
+    // A ray along wrapping dimensions can come back to the original square
+    while (destination_square_index != -1 && destination_square_index != square_index) {
+        if (board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
+            moves[counter].origin_square = square_index;
+            moves[counter].destination_square = destination_square_index;
+            ++counter;
+        } else if (board[destination_square_index].piece.piece_color != piece_color) {
+            moves[counter].origin_square = square_index;
+            moves[counter].destination_square = destination_square_index;
+            ++counter;
+            break;
+        } else {
+            break;
         }
+        destination_square_index = next_square(topology, destination_square_index, direction);
     }
-    moves[counter].destination_square = -1;
+    return counter;
 }
 
 static void get_knight_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, struct Square board[], struct Rules *rules) {
+    const struct BoardTopology *topology = rules->topology;
     enum PieceColor piece_color = board[square_index].piece.piece_color;
-    int dimensions = rules->dimensions;
-    int square[dimensions];
-    square_index_to_square(square_index, square, dimensions, rules->board_shape);
-    int destination_square[dimensions];
     int counter = 0;
-    for (int dim1 = 0; dim1 < dimensions; ++dim1) {
-        for (int dim2 = 0; dim2 < dimensions; ++dim2) {
-            if (dim1 == dim2) {
-                continue;
-            }
-            int increments[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
-            for (int i = 0; i < 4; ++i) {
-                copy_int_array(square, destination_square, dimensions);
-                bool increment1_legal = increment_dim_of_square_if_legal(destination_square, dim1, increments[i][0], rules->dimension_wrapping[dim1], rules->board_shape[dim1]); // TODO make increment_dim_of_square_if_legal deal with one dimension wrapping and non-rectangle board shapes. It should increment both dims simultaneously and then move if wrapping
-                bool increment2_legal = increment_dim_of_square_if_legal(destination_square, dim1, increments[i][0], rules->dimension_wrapping[dim1], rules->board_shape[dim1]); // TODO make increment_dim_of_square_if_legal deal with one dimension wrapping and non-rectangle board shapes. It should increment both dims simultaneously and then move if wrapping
-                bool increment3_legal = increment_dim_of_square_if_legal(destination_square, dim2, increments[i][1], rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                if (!increment1_legal || !increment2_legal || !increment3_legal) {
-                    continue;
-                }
-                int destination_square_index = square_to_square_index(destination_square, dimensions, rules->board_shape);
-                if (    board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE ||
-                        board[destination_square_index].piece.piece_color != piece_color) {
-                    moves[counter].origin_square = square_index;
-                    moves[counter].destination_square = destination_square_index;
-                    ++counter;
-                }
-            }
+    for (int direction = topology->first_knight_direction; direction < topology->nbr_directions; ++direction) {
+        int destination_square_index = next_square(topology, square_index, direction);
+        if (destination_square_index == -1) {
+            continue;
+        }
+        if (    board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE ||
+                board[destination_square_index].piece.piece_color != piece_color) {
+            moves[counter].origin_square = square_index;
+            moves[counter].destination_square = destination_square_index;
+            ++counter;
         }
     }
     moves[counter].destination_square = -1;
@@ -529,46 +741,29 @@ static void get_queen_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int squar
 }
 
 static void get_king_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, bool in_check, struct Square board[], struct Rules *rules) {
-    // Variables
+    const struct BoardTopology *topology = rules->topology;
     enum PieceColor piece_color = board[square_index].piece.piece_color;
     int dimensions = rules->dimensions;
-    int square[dimensions];
-    square_index_to_square(square_index, square, dimensions, rules->board_shape);
-    int destination_square[dimensions];
 
     int counter = 0;
     for (int dim1 = 0; dim1 < dimensions; ++dim1) {
         for (int dim2 = dim1 + 1; dim2 < dimensions; ++dim2) {
-            if (dim1 == dim2) {
-                continue;
-            }
-            int j;
-            int increments[8][2];
+            // One step along either dimension of the pair, and diagonally only in two dimensions
+            int directions[8] = {
+                horizontal_direction(dim1, 1), horizontal_direction(dim1, -1),
+                horizontal_direction(dim2, 1), horizontal_direction(dim2, -1),
+            };
+            int j = 4;
             if (dimensions == 2) {
-                j = 8;
-                increments[0][0] = 1;   increments[0][1] = 0;
-                increments[1][0] = -1;  increments[1][1] = 0;
-                increments[2][0] = 0;   increments[2][1] = 1;
-                increments[3][0] = 0;   increments[3][1] = -1;
-                increments[4][0] = 1;   increments[4][1] = 1;
-                increments[5][0] = 1;   increments[5][1] = -1;
-                increments[6][0] = -1;  increments[6][1] = 1;
-                increments[7][0] = -1;  increments[7][1] = -1;
-            } else {
-                j = 4;
-                increments[0][0] = 1;   increments[0][1] = 0;
-                increments[1][0] = -1;  increments[1][1] = 0;
-                increments[2][0] = 0;   increments[2][1] = 1;
-                increments[3][0] = 0;   increments[3][1] = -1;
+                for (int i = 0; i < 4; ++i) {
+                    directions[j++] = topology->diagonal_directions[dim1][dim2] + i;
+                }
             }
             for (int i = 0; i < j; ++i) {
-                copy_int_array(square, destination_square, dimensions);
-                bool increment1_legal = increment_dim_of_square_if_legal(destination_square, dim1, increments[i][0], rules->dimension_wrapping[dim1], rules->board_shape[dim1]); // TODO make increment_dim_of_square_if_legal deal with one dimension wrapping and non-rectangle board shapes. It should increment both dims simultaneously and then move if wrapping
-                bool increment2_legal = increment_dim_of_square_if_legal(destination_square, dim2, increments[i][1], rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                if (!increment1_legal || !increment2_legal) {
+                int destination_square_index = next_square(topology, square_index, directions[i]);
+                if (destination_square_index == -1) {
                     continue;
                 }
-                int destination_square_index = square_to_square_index(destination_square, dimensions, rules->board_shape);
 
                 if (board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
                     moves[counter].origin_square = square_index;
@@ -596,61 +791,94 @@ static void get_king_moves(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square
 
 static int get_castling_moves(struct Move moves[], int king_square_index, struct Square board[], struct Rules *rules) {
     enum PieceColor piece_color = board[king_square_index].piece.piece_color;
-    int king_square[rules->dimensions];
-    square_index_to_square(king_square_index, king_square, rules->dimensions, rules->board_shape);
-    int destination_square[rules->dimensions];
 
     int counter = 0;
     // TODO both positive and negative direction
-    for (int dim = 0; dim < rules->dimensions; ++dim) {
-        for (int increment = -1; increment <= 1; increment += 2) {
-            copy_int_array(king_square, destination_square, rules->dimensions);
-            // go forward until edge of board, if own rook that hasn't moved after three or more squares -> compute castling move
-            int distance = 1;
-            int squares_passed[20];
-            int counter2 = 0;
-            while (true) {
-                bool increment_legal = increment_dim_of_square_if_legal(destination_square, dim, increment, 
-                                                                        rules->dimension_wrapping[dim], rules->board_shape[dim]);
-                if (!increment_legal) {
-                    break;
-                }
-                
-                int destination_square_index = square_to_square_index(destination_square, rules->dimensions, rules->board_shape);
-                squares_passed[counter2++] = destination_square_index;
-                if (    board[destination_square_index].piece.piece_type == ROOK &&
-                        board[destination_square_index].piece.piece_color == piece_color &&
-                        distance >= 3) {
-                    int gap1;
-                    int gap2;
-                    int gap3;
-                    int gaps_sum = distance - 3;
-                    gap3 = (gaps_sum + 2) / 3;          // division with 3 and rounding up
-                    gap1 = (gaps_sum - gap3 + 1) / 2;   // division with 2 and rounding up
-                    gap2 = gaps_sum - gap3 - gap1;
-
-                    // TODO: check that squares the king has to pass through is not attacked
-                    for (int i = 0; i < (gap1+1+gap2+1); ++i) {
-                        // check that square not attacked
-                    }
-
-                    moves[counter].origin_square = king_square_index;
-                    moves[counter].castling_rook_destination_square = squares_passed[gap1 + 1 - 1];
-                    moves[counter].destination_square = squares_passed[gap1 + 1 + gap2 + 1 - 1];
-                    moves[counter].castling_with_rook_on_square = destination_square_index;
-                    ++counter;
-                    break;
-                } else if (board[destination_square_index].piece.piece_type != NULL_PIECE_TYPE) {
-                    break;
+    for (int direction = 0; direction < rules->topology->first_diagonal_direction; ++direction) {
+        // go forward until edge of board, if own rook that hasn't moved after three or more squares -> compute castling move
+        int distance = 1;
+        int squares_passed[20];
+        int counter2 = 0;
+        int destination_square_index = king_square_index;
+        while (true) {
+            destination_square_index = next_square(rules->topology, destination_square_index, direction);
+            if (destination_square_index == -1) {
+                break;
+            }
+            
+            squares_passed[counter2++] = destination_square_index;
+            if (    board[destination_square_index].piece.piece_type == ROOK &&
+                    board[destination_square_index].piece.piece_color == piece_color &&
+                    distance >= 3) {
+                int gap1;
+                int gap2;
+                int gap3;
+                int gaps_sum = distance - 3;
+                gap3 = (gaps_sum + 2) / 3;          // division with 3 and rounding up
+                gap1 = (gaps_sum - gap3 + 1) / 2;   // division with 2 and rounding up
+                gap2 = gaps_sum - gap3 - gap1;
+
+                // TODO: check that squares the king has to pass through is not attacked
+                for (int i = 0; i < (gap1+1+gap2+1); ++i) {
+                    // check that square not attacked
                 }
 
-                ++distance;
+                moves[counter].origin_square = king_square_index;
+                moves[counter].castling_rook_destination_square = squares_passed[gap1 + 1 - 1];
+                moves[counter].destination_square = squares_passed[gap1 + 1 + gap2 + 1 - 1];
+                moves[counter].castling_with_rook_on_square = destination_square_index;
+                ++counter;
+                break;
+            } else if (board[destination_square_index].piece.piece_type != NULL_PIECE_TYPE) {
+                break;
             }
+
+            ++distance;
         }
     }
     return counter;
 }
 
+// Walks the same rays as get_rook_moves and get_bishop_moves but only adds the opponents piece blocking each ray
+static void get_slider_captures(struct Move moves[MAX_MOVES_SINGLE_PIECE], int square_index, bool horizontal, bool diagonal,
+                                struct Square board[], struct Rules *rules) {
+    const struct BoardTopology *topology = rules->topology;
+    int first_direction = horizontal ? 0 : topology->first_diagonal_direction;
+    int end_direction = diagonal ? topology->first_knight_direction : topology->first_diagonal_direction;
+    int counter = 0;
+    for (int direction = first_direction; direction < end_direction; ++direction) {
+        counter += get_first_capture_on_ray(moves + counter, square_index, direction, board, topology);
+    }
+    moves[counter].destination_square = -1;
+}
+
+// Returns 1 if a capture was written to move
+static int get_first_capture_on_ray(struct Move *move, int square_index, int direction, struct Square board[], 
+                                    const struct BoardTopology *topology) {
+    int destination_square_index = square_index;
+    while (true) {
+        destination_square_index = next_square(topology, destination_square_index, direction);
+        if (destination_square_index == -1) {
+            return 0;   // edge of board
+        }
+        if (destination_square_index == square_index) {
+            return 0;   // we are back to original square
+        }
+        if (board[destination_square_index].piece.piece_type == NULL_PIECE_TYPE) {
+            continue;
+        }
+        if (board[destination_square_index].piece.piece_color == board[square_index].piece.piece_color) {
+            return 0;
+        }
+        move->origin_square = square_index;
+        move->destination_square = destination_square_index;
+        move->pawn_moved_past_square = -1;
+        move->en_passant_capture = false;
+        move->castling_with_rook_on_square = -1;
+        return 1;
+    }
+}
+
 static void get_all_moves_to_unoccupied(struct Move moves[], int origin_square, struct Square board[], struct Rules *rules) {
     int board_length = 1;
     for (int i = 0; i < rules->dimensions; ++i) {
@@ -665,7 +893,7 @@ static void get_all_moves_to_unoccupied(struct Move moves[], int origin_square,
     bool already_among_moves = false;
 
     for (int square = 0; square < board_length; ++square) {
-        if (board[square].piece.piece_type == NULL_PIECE_TYPE && square != origin_square) {
+        if (board[square].part_of_board && board[square].piece.piece_type == NULL_PIECE_TYPE && square != origin_square) {
             for (int i = 0; i < nbr_moves_before; ++i) {
                 if (moves[i].destination_square == square) {
                     already_among_moves = true;
@@ -676,6 +904,9 @@ static void get_all_moves_to_unoccupied(struct Move moves[], int origin_square,
             if (!already_among_moves) {
                 moves[counter].origin_square = origin_square;
                 moves[counter].destination_square = square;
+                moves[counter].pawn_moved_past_square = -1;
+                moves[counter].en_passant_capture = false;
+                moves[counter].castling_with_rook_on_square = -1;
                 ++counter;
             }
             already_among_moves = false;
@@ -941,189 +1172,180 @@ static void get_all_moves_to_unoccupied(struct Move moves[], int origin_square,
     //return true;    // checkmate
 //}
 
+// Board only version of get_attackers, en passant doesn't matter for attacks on a square
 static bool square_is_attacked(int square_index, enum PieceColor attacked_piece_color, struct Square *board, struct Rules *rules) {
-    // Variables
+    struct GameState game_state;
+    game_state.board = board;
+    game_state.whos_turn = attacked_piece_color;
+    game_state.moves_made_this_turn = 0;
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        for (int i = 0; i < MAX_MOVES_PER_TURN; ++i) {
+            game_state.last_moves_by_piece_color[piece_color][i].destination_square = -1;
+            game_state.last_moves_by_piece_color[piece_color][i].pawn_moved_past_square = -1;
+        }
+    }
+    enum PieceColor attacking_piece_color = (attacked_piece_color == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+    int attackers[1];
+    return get_attackers(attackers, 1, square_index, attacking_piece_color, &game_state, rules) > 0;
+}
+
+// Squares of the pieces of attacking_piece_color that could capture on square_index, least valuable piece first.
+// Walks the same rays outwards from the square as square_is_attacked. Returns the number of attackers
+int get_attackers(int attackers[], int max_attackers, int square_index, enum PieceColor attacking_piece_color, 
+                  struct GameState *game_state, struct Rules *rules) {
+    const struct BoardTopology *topology = rules->topology;
+    struct Square *board = game_state->board;
     int dimensions = rules->dimensions;
-    int square_backup[dimensions];
-    square_index_to_square(square_index, square_backup, dimensions, rules->board_shape);
-    int square[dimensions];
+    int counter = 0;
 
-    // Diagonal captures. One step - king or pawn with correct orientation
+    // Horizontal and diagonal rays. dim2 == dim1 means horizontal ray along dim1
     for (int dim1 = 0; dim1 < dimensions; ++dim1) {
-        for (int dim2 = dim1 + 1; dim2 < dimensions; ++dim2) {
-            int increments[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
+        for (int dim2 = dim1; dim2 < dimensions; ++dim2) {
+            bool horizontal = dim1 == dim2;
             for (int i = 0; i < 4; ++i) {
-                copy_int_array(square_backup, square, dimensions);
-                
-                // One step - kings, bishops, queens, pawns with right orientation
-                bool increment1_legal = increment_dim_of_square_if_legal(square, dim1, increments[i][0], 
-                                                                    rules->dimension_wrapping[dim1], rules->board_shape[dim1]);
-                bool increment2_legal = increment_dim_of_square_if_legal(square, dim2, increments[i][1], 
-                                                                    rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                if (!increment1_legal || !increment2_legal) {
-                    continue;
-                }
-
-                int destination_square_index = square_to_square_index(square, dimensions, rules->board_shape);
-                enum PieceType piece_type = board[destination_square_index].piece.piece_type;
-                enum PieceColor piece_color = board[destination_square_index].piece.piece_color;
-
-                // todo: change this for team chess
-                if (piece_type != NULL_PIECE_TYPE && piece_color == attacked_piece_color) { 
-                    continue;   // piece of own piece_color, continue
-                }
-
-                if (piece_type == BISHOP || piece_type == QUEEN || (piece_type == KING && rules->dimensions > 2)) {
-                    return true;    // square is attacked
-                } else if (piece_type == PAWN) {
-                    bool dim1_forward_dim = rules->is_forward_dimension[dim1];
-                    bool dim2_forward_dim = rules->is_forward_dimension[dim2];
-                    enum Direction piece_direction = board[destination_square_index].piece.direction;
-                    if (dim1_forward_dim) {
-                        if (    (increments[dim1][0] ==  1 && piece_direction == BACKWARDS && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim1][0] ==  1 && piece_direction == FORWARDS  && piece_color == PIECE_COLOR_BLACK) ||
-                                (increments[dim1][0] == -1 && piece_direction == FORWARDS  && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim1][0] == -1 && piece_direction == BACKWARDS && piece_color == PIECE_COLOR_BLACK)) {
-                            return true;
-                        }
-                    } else {
-                        if (    (increments[dim1][0] ==  1 && piece_direction == LEFT  && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim1][0] ==  1 && piece_direction == RIGHT && piece_color == PIECE_COLOR_BLACK) ||
-                                (increments[dim1][0] == -1 && piece_direction == RIGHT && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim1][0] == -1 && piece_direction == LEFT  && piece_color == PIECE_COLOR_BLACK)) {
-                            return true;
-                        }
-                    }
-                    if (dim2_forward_dim) {
-                        if (    (increments[dim2][1] ==  1 && piece_direction == BACKWARDS && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim2][1] ==  1 && piece_direction == FORWARDS  && piece_color == PIECE_COLOR_BLACK) ||
-                                (increments[dim2][1] == -1 && piece_direction == FORWARDS  && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim2][1] == -1 && piece_direction == BACKWARDS && piece_color == PIECE_COLOR_BLACK)) {
-                            return true;
-                        }
-                    } else {
-                        if (    (increments[dim2][1] ==  1 && piece_direction == LEFT  && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim2][1] ==  1 && piece_direction == RIGHT && piece_color == PIECE_COLOR_BLACK) ||
-                                (increments[dim2][1] == -1 && piece_direction == RIGHT && piece_color == PIECE_COLOR_WHITE) ||
-                                (increments[dim2][1] == -1 && piece_direction == LEFT  && piece_color == PIECE_COLOR_BLACK)) {
-                            return true;
-                        }
-                    }
+                int direction;
+                if (horizontal && i % 2 == 1) {
+                    continue;   // {1,1} and {-1,1} are the two horizontal directions
+                } else if (horizontal) {
+                    direction = horizontal_direction(dim1, i == 0 ? 1 : -1);
+                } else {
+                    direction = topology->diagonal_directions[dim1][dim2] + i;
                 }
-
-                // Steps beyond first step - only bishops and queens
-                while (true) {
-                    bool increment1_legal = increment_dim_of_square_if_legal(square, dim1, increments[i][0], 
-                                                                    rules->dimension_wrapping[dim1], rules->board_shape[dim1]);
-                    bool increment2_legal = increment_dim_of_square_if_legal(square, dim2, increments[i][1], 
-                                                                    rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                    if (!increment1_legal || !increment2_legal) {
+                int attacker_square_index = square_index;
+                for (int distance = 1; counter < max_attackers; ++distance) {
+                    attacker_square_index = next_square(topology, attacker_square_index, direction);
+                    if (attacker_square_index == -1) {
                         break;  // edge of board
                     }
-
-                    int destination_square_index = square_to_square_index(square, dimensions, rules->board_shape);
-                    enum PieceType piece_type = board[destination_square_index].piece.piece_type;
-                    enum PieceColor piece_color = board[destination_square_index].piece.piece_color;
-
-                    if (destination_square_index == square_index) {
-                        break;      // we are back to original square
+                    if (attacker_square_index == square_index) {
+                        break;  // we are back to original square
                     }
-                    if (piece_type == NULL_PIECE_TYPE) {
-                        continue;   // square empty, continue
+                    struct Piece piece = board[attacker_square_index].piece;
+                    if (piece.piece_type == NULL_PIECE_TYPE) {
+                        continue;
                     }
-                    if (piece_color == attacked_piece_color) {
-                        break;      // piece of own piece_color
+                    if (piece.piece_color != attacking_piece_color) {
+                        break;
                     }
-                    if (piece_type == BISHOP || piece_type == QUEEN) {
-                        return true;    // square is attacked
+
+                    bool attacks = false;
+                    if (horizontal) {
+                        attacks = piece.piece_type == ROOK || piece.piece_type == QUEEN || 
+                                  (piece.piece_type == KING && distance == 1 && rules->king_allowed_to_capture);
+                    } else {
+                        attacks = piece.piece_type == BISHOP || piece.piece_type == QUEEN || 
+                                  (piece.piece_type == KING && distance == 1 && dimensions == 2 && rules->king_allowed_to_capture);
+                        if (piece.piece_type == PAWN && distance == 1) {
+                            struct Move pawn_moves[MAX_MOVES_SINGLE_PIECE];
+                            struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+                            get_pawn_moves(pawn_moves, diagonal_pawn_moves, attacker_square_index, board, 
+                                           game_state->last_moves_by_piece_color, rules);
+                            for (int j = 0; diagonal_pawn_moves[j].destination_square != -1 && !attacks; ++j) {
+                                attacks = diagonal_pawn_moves[j].destination_square == square_index;
+                            }
+                        }
+                    }
+                    if (attacks) {
+                        attackers[counter++] = attacker_square_index;
                     }
-                    break;      // opponents piece but not bishop or queen
+                    break;
                 }
             }
         }
     }
 
-    // Horizontal captures. One step - king
-    for (int dim = 0; dim < dimensions; ++dim) {
-        for (int direction = -1; direction <= 1; direction += 2) {
-            copy_int_array(square_backup, square, dimensions);
-                
-            // One step - kings
-            bool increment_legal = increment_dim_of_square_if_legal(square, dim, direction, 
-                                                                    rules->dimension_wrapping[dim], rules->board_shape[dim]);
-            if (!increment_legal) {
-                continue;
-            }
-            int destination_square_index = square_to_square_index(square, dimensions, rules->board_shape);
-            enum PieceType piece_type = board[destination_square_index].piece.piece_type;
-            enum PieceColor piece_color = board[destination_square_index].piece.piece_color;
+    // Knights
+    for (int direction = topology->first_knight_direction; direction < topology->nbr_directions && counter < max_attackers; 
+            ++direction) {
+        int attacker_square_index = next_square(topology, square_index, direction);
+        if (attacker_square_index == -1) {
+            continue;
+        }
+        struct Piece piece = board[attacker_square_index].piece;
+        if (piece.piece_type == KNIGHT && piece.piece_color == attacking_piece_color) {
+            attackers[counter++] = attacker_square_index;
+        }
+    }
 
-            if (piece_type != NULL_PIECE_TYPE && piece_color == attacked_piece_color) { 
-                continue;   // piece of own piece_color, continue
-            }
-            if (piece_type == ROOK || piece_type == QUEEN || piece_type == KING) {
-                return true;    // square is attacked
-            }
+    // Least valuable attacker first. Few attackers, insertion sort
+    for (int i = 1; i < counter; ++i) {
+        int attacker = attackers[i];
+        int rank = attacker_rank[board[attacker].piece.piece_type];
+        int j = i - 1;
+        for (; j >= 0 && attacker_rank[board[attackers[j]].piece.piece_type] > rank; --j) {
+            attackers[j+1] = attackers[j];
+        }
+        attackers[j+1] = attacker;
+    }
+    return counter;
+}
 
-            while (true) {
-                bool increment_legal = increment_dim_of_square_if_legal(square, dim, direction, 
-                                                                    rules->dimension_wrapping[dim], rules->board_shape[dim]);
-                if (!increment_legal) {
-                    break;
-                }
-                int destination_square_index = square_to_square_index(square, dimensions, rules->board_shape);
-                enum PieceType piece_type = board[destination_square_index].piece.piece_type;
-                enum PieceColor piece_color = board[destination_square_index].piece.piece_color;
-
-                if (destination_square_index == square_index) {
-                    break;      // we are back to original square
-                } 
-                if (piece_type == NULL_PIECE_TYPE) {
-                    continue;   // square empty, continue
-                } 
-                if (piece_color == attacked_piece_color) {
-                    break;      // piece of own piece color
-                } 
-                if (piece_type == BISHOP || piece_type == QUEEN) {
-                    return true;    // square is attacked
-                }
-                break;      // opponents piece but not bishop or queen
-            }
+// How many pieces of each color attack every square, counted the way get_attackers finds attackers but generated
+// forwards: one pass over the board walks the rays of every piece instead of walking rays back from every square.
+// attack_counts[color] needs one counter per square, they are overwritten
+void count_attacks(int *attack_counts[PIECE_COLOR_COUNT], struct GameState *game_state, struct Rules *rules) {
+    const struct BoardTopology *topology = rules->topology;
+    struct Square *board = game_state->board;
+    int board_length = topology->board_length;
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        for (int square_index = 0; square_index < board_length; ++square_index) {
+            attack_counts[piece_color][square_index] = 0;
         }
     }
 
-    // Knight captures
-    for (int dim1 = 0; dim1 < dimensions; ++dim1) {
-        for (int dim2 = 0; dim2 < dimensions; ++dim2) {
-            if (dim1 == dim2) {
-                continue;
+    for (int origin_index = 0; origin_index < board_length; ++origin_index) {
+        struct Piece piece = board[origin_index].piece;
+        if (piece.piece_type == NULL_PIECE_TYPE || piece.piece_color < 0 || piece.piece_color >= PIECE_COLOR_COUNT) {
+            continue;
+        }
+        int *counts = attack_counts[piece.piece_color];
+        if (piece.piece_type == PAWN) {
+            struct Move pawn_moves[MAX_MOVES_SINGLE_PIECE];
+            struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+            get_pawn_moves(pawn_moves, diagonal_pawn_moves, origin_index, board, game_state->last_moves_by_piece_color, 
+                           rules);
+            for (int j = 0; diagonal_pawn_moves[j].destination_square != -1; ++j) {
+                ++counts[diagonal_pawn_moves[j].destination_square];
             }
-            int increments[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
-            for (int i = 0; i < 4; ++i) {
-                copy_int_array(square_backup, square, dimensions);
-                
-                // One step - kings, bishops, queens, pawns with right orientation
-                bool increment1_legal = increment_dim_of_square_if_legal(square, dim1, increments[i][0], 
-                                                                    rules->dimension_wrapping[dim1], rules->board_shape[dim1]);
-                bool increment2_legal = increment_dim_of_square_if_legal(square, dim1, increments[i][0], 
-                                                                    rules->dimension_wrapping[dim1], rules->board_shape[dim1]);
-                bool increment3_legal = increment_dim_of_square_if_legal(square, dim2, increments[i][1], 
-                                                                    rules->dimension_wrapping[dim2], rules->board_shape[dim2]);
-                if (!increment1_legal || !increment2_legal || !increment3_legal) {
-                    continue;
-                }
+            continue;
+        }
 
-                int destination_square_index = square_to_square_index(square, dimensions, rules->board_shape);
-                enum PieceType piece_type = board[destination_square_index].piece.piece_type;
-                enum PieceColor piece_color = board[destination_square_index].piece.piece_color;
+        if (piece.piece_type == KNIGHT) {
+            for (int direction = topology->first_knight_direction; direction < topology->nbr_directions; ++direction) {
+                int square_index = next_square(topology, origin_index, direction);
+                if (square_index != -1) {
+                    ++counts[square_index];
+                }
+            }
+            continue;
+        }
 
-                if (piece_type == KNIGHT && piece_color != attacked_piece_color) {
-                    return true;
+        bool king = piece.piece_type == KING;
+        if (king && !rules->king_allowed_to_capture) {
+            continue;
+        }
+        bool horizontal_rays = piece.piece_type == ROOK || piece.piece_type == QUEEN || king;
+        bool diagonal_rays = piece.piece_type == BISHOP || piece.piece_type == QUEEN || (king && rules->dimensions == 2);
+        // Same rays as get_attackers
+        int first_direction = horizontal_rays ? 0 : topology->first_diagonal_direction;
+        int end_direction = diagonal_rays ? topology->first_knight_direction : topology->first_diagonal_direction;
+        for (int direction = first_direction; direction < end_direction; ++direction) {
+            int square_index = origin_index;
+            for (int distance = 1; !king || distance == 1; ++distance) {
+                square_index = next_square(topology, square_index, direction);
+                if (square_index == -1) {
+                    break;  // edge of board
+                }
+                if (square_index == origin_index) {
+                    break;  // we are back to original square
+                }
+                ++counts[square_index];
+                if (board[square_index].piece.piece_type != NULL_PIECE_TYPE) {
+                    break;
                 }
             }
         }
     }
-    return false;
 }
 
 //TODO
@@ -1154,13 +1376,34 @@ static bool player_is_checkmated(enum PieceColor piece_color, struct GameState *
         return false;
     }
 
-    // Check if all squares king can move to attacked
-    struct Move king_moves[MAX_MOVES_SINGLE_PIECE];
-    get_king_moves(king_moves, own_king_square, true, board, rules);
-
-    for (int i = 0; king_moves[i].destination_square != -1; ++i) {
-        if(!square_is_attacked(king_moves[i].destination_square, piece_color, board, rules)) {
-            return false;
+    // Check if any move gets the king out of check. Moving, capturing the checking piece and blocking all count
+    struct MoveUndo undo;
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        if (    !board[square_index].part_of_board || board[square_index].piece.piece_type == NULL_PIECE_TYPE ||
+                board[square_index].piece.piece_color != piece_color) {
+            continue;
+        }
+        struct Move moves[MAX_MOVES_SINGLE_PIECE];
+        struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+        get_moves(moves, diagonal_pawn_moves, square_index, game_state, rules);
+        for (int i = 0; moves[i].destination_square != -1; ++i) {
+            if (square_index == own_king_square && moves[i].castling_with_rook_on_square != -1) {
+                continue;   // no castling out of check. get_moves doesn't know about the check
+            }
+            make_move_with_undo(moves[i], NULL_PIECE_TYPE, game_state, rules, &undo);
+            int king_square = (square_index == own_king_square) ? moves[i].destination_square : own_king_square;
+            if (rules->gravity_dimension != -1) {
+                for (king_square = 0; king_square < board_length; ++king_square) {
+                    if (board[king_square].piece.piece_type == KING && board[king_square].piece.piece_color == piece_color) {
+                        break;
+                    }
+                }
+            }
+            bool still_in_check = king_square < board_length && square_is_attacked(king_square, piece_color, board, rules);
+            unmake_move(&undo, game_state);
+            if (!still_in_check) {
+                return false;
+            }
         }
     }
     return true;
@@ -1190,7 +1433,7 @@ static bool piece_color_king_captured(bool piece_color, struct GameState *game_s
 static bool piece_color_king_arrived(bool piece_color, struct GameState *game_state, struct Rules *rules) {
     int goal_square = rules->goal_square_by_piece_color[piece_color];
     enum PieceType piece_type_goal_square = game_state->board[goal_square].piece.piece_type;
-    enum PieceType piece_color_goal_square = game_state->board[goal_square].piece.piece_color;
+    enum PieceColor piece_color_goal_square = game_state->board[goal_square].piece.piece_color;
     if (piece_type_goal_square == KING && piece_color_goal_square == piece_color) {
         return true;
     }
@@ -1200,6 +1443,22 @@ static bool piece_color_king_arrived(bool piece_color, struct GameState *game_st
 // If any one win condition is satisfied, the game is over
 // returns true if game over. Whoever made the last move won
 bool evaluate_win_conditions(struct Move last_move, struct GameState *game_state, struct Rules *rules) {
+    enum PieceColor winner = get_winner(last_move, game_state, rules);
+    if (winner == NULL_PIECE_COLOR) {
+        return false;
+    }
+
+    if (winner == PIECE_COLOR_WHITE) {
+        printf("Game over, white won\n");
+    } else {
+        printf("Game over, black won\n");
+    }
+    return true;
+}
+
+// evaluate_win_conditions without printing. Returns the piece color that made the last move if it won, NULL_PIECE_COLOR if
+// the game goes on
+enum PieceColor get_winner(struct Move last_move, struct GameState *game_state, struct Rules *rules) {
     enum PieceColor piece_color_last_move = game_state->board[last_move.destination_square].piece.piece_color;
     bool win_condition_satisfied = false;
     for (int i = 0; rules->win_conditions[i] != NULL_WIN_CONDITION && !win_condition_satisfied; ++i) {
@@ -1249,15 +1508,9 @@ bool evaluate_win_conditions(struct Move last_move, struct GameState *game_state
         }
     }
     if (!win_condition_satisfied) {
-        return false;
-    }
-
-    if (piece_color_last_move == PIECE_COLOR_WHITE) {
-        printf("Game over, white won\n");
-    } else {
-        printf("Game over, black won\n");
+        return NULL_PIECE_COLOR;
     }
-    return true;
+    return piece_color_last_move;
 }
 
 // returns true if the piece moving from that square should promote
@@ -1326,7 +1579,7 @@ bool evaluate_promotion(int square_index_from, int square_index_moving_to, struc
     return false;
 }
 
-static void evaluate_gravity(struct Square board[], struct Rules *rules) {
+static void evaluate_gravity(struct Square board[], struct Rules *rules, struct MoveUndo *undo) {
     int square[rules->dimensions];
     int square_copy[rules->dimensions];
     int gravity_dimension = rules->gravity_dimension;
@@ -1347,6 +1600,9 @@ static void evaluate_gravity(struct Square board[], struct Rules *rules) {
                     continue;
                 }
 
+                if (square[gravity_dimension] == (rules->board_shape[gravity_dimension] - 1)) {
+                    continue;   // already on the floor
+                }
                 copy_int_array(square, square_copy, rules->dimensions);
                 int square_index_prev = square_to_square_index(square_copy, rules->dimensions, rules->board_shape);
                 
@@ -1359,10 +1615,14 @@ static void evaluate_gravity(struct Square board[], struct Rules *rules) {
                 for (; square_copy[gravity_dimension] < rules->board_shape[gravity_dimension]; ++square_copy[gravity_dimension]) {
                     square_index_this = square_to_square_index(square_copy, rules->dimensions, rules->board_shape);
                     if (board[square_index_this].piece.piece_type != NULL_PIECE_TYPE) {
+                        record_square_change(undo, square_index_prev, board);
+                        record_square_change(undo, square_index2, board);
                         board[square_index_prev].piece = board[square_index2].piece;
                         board[square_index2].piece.piece_type = NULL_PIECE_TYPE;
                         break;
                     } else if (square_copy[gravity_dimension] == (rules->board_shape[gravity_dimension] - 1)) {
+                        record_square_change(undo, square_index_this, board);
+                        record_square_change(undo, square_index2, board);
                         board[square_index_this].piece = board[square_index2].piece;
                         board[square_index2].piece.piece_type = NULL_PIECE_TYPE;
                         break;
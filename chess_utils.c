@@ -32,9 +32,8 @@ int square_to_square_index(int square[], int dimensions, int board_shape[]) {
 void square_index_to_square(int index, int square[], int dimensions, int board_shape[]) {
     int factors[dimensions];
     factors[0] = 1;
-    factors[1] = board_shape[0];
-    for (int dim = 2; dim < dimensions; ++dim) {
-        factors[dim] = factors[dim-1] * board_shape[dim];
+    for (int dim = 1; dim < dimensions; ++dim) {
+        factors[dim] = factors[dim-1] * board_shape[dim-1];
     }
     for (int dim = dimensions-1; dim >= 0; --dim) {
         int pos = index / factors[dim];
@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 199309L     // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chess4d.h"
+
+// Compiles the starting positions of every variant into one file for load_starting_position_cache, then checks that
+// games start in the same position from it and prints how long starting a game takes from the text files and from the
+// compiled file. Run from the directory with starting_positions/, e.g.
+//   ./compile_positions -o starting_positions.c4sp && ./game_server -positions starting_positions.c4sp
+
+#define DEFAULT_COMPILED_POSITIONS_PATH "starting_positions.c4sp"
+#define DEFAULT_TIMING_RUNS 200
+
+static bool same_position(struct GameState *game_state1, struct GameState *game_state2, struct Rules *rules);
+static int  compare_doubles(const void *a, const void *b);
+static double seconds_now(void);
+
+int main(int argc, char *argv[]) {
+    const char *path = DEFAULT_COMPILED_POSITIONS_PATH;
+    int nbr_runs = DEFAULT_TIMING_RUNS;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) {
+            nbr_runs = atoi(argv[++i]);
+        } else {
+            printf("usage: compile_positions [-o file] [-runs n]\n");
+            return 1;
+        }
+    }
+    if (nbr_runs < 1) {
+        nbr_runs = 1;
+    }
+
+    int nbr_variants;
+    if (!write_starting_position_cache(path, &nbr_variants)) {
+        return 1;
+    }
+    double start_time = seconds_now();
+    if (!load_starting_position_cache(path)) {
+        return 1;
+    }
+    double load_seconds = seconds_now() - start_time;
+    printf("\n%s: %i variants, loaded in %.1f us\n\n", path, nbr_variants, 1e6 * load_seconds);
+
+    double *text_latencies = malloc(nbr_runs * sizeof(double));
+    double *cache_latencies = malloc(nbr_runs * sizeof(double));
+    if (text_latencies == NULL || cache_latencies == NULL) {
+        return 1;
+    }
+    printf("%-36s %7s %12s %12s %12s %12s %8s\n", "variant", "squares", "text p50 us", "text p99 us", "cache p50 us",
+           "cache p99 us", "speedup");
+    bool all_same = true;
+    for (int variant = 0; variant < NBR_OF_VARIANTS; ++variant) {
+        struct Rules rules, cached_rules;
+        struct GameState game_state, cached_game_state;
+        // start_game falls back to the text files for variants that aren't in the file, unload to see the text files
+        unload_starting_position_cache();
+        if (!initialize_rules_and_game_state(&rules, &game_state, variant)) {
+            continue;
+        }
+        load_starting_position_cache(path);
+        if (!start_game(&cached_rules, &cached_game_state, variant)) {
+            return 1;
+        }
+        all_same = all_same && same_position(&game_state, &cached_game_state, &rules) &&
+                   cached_rules.dimensions == rules.dimensions &&
+                   memcmp(cached_rules.board_shape, rules.board_shape, rules.dimensions * sizeof(int)) == 0;
+        terminate_game_state(&game_state);
+        terminate_game_state(&cached_game_state);
+
+        unload_starting_position_cache();
+        for (int run = 0; run < nbr_runs; ++run) {
+            start_time = seconds_now();
+            initialize_rules_and_game_state(&rules, &game_state, variant);
+            terminate_game_state(&game_state);
+            text_latencies[run] = seconds_now() - start_time;
+        }
+        load_starting_position_cache(path);
+        for (int run = 0; run < nbr_runs; ++run) {
+            start_time = seconds_now();
+            start_game(&rules, &game_state, variant);
+            terminate_game_state(&game_state);
+            cache_latencies[run] = seconds_now() - start_time;
+        }
+        qsort(text_latencies, nbr_runs, sizeof(double), compare_doubles);
+        qsort(cache_latencies, nbr_runs, sizeof(double), compare_doubles);
+        int board_length = 1;
+        for (int dim = 0; dim < rules.dimensions; ++dim) {
+            board_length *= rules.board_shape[dim];
+        }
+        int p99 = (nbr_runs - 1) * 99 / 100;
+        printf("%-36s %7i %12.2f %12.2f %12.2f %12.2f %7.0fx\n", variant_name(variant), board_length,
+               1e6 * text_latencies[nbr_runs / 2], 1e6 * text_latencies[p99], 1e6 * cache_latencies[nbr_runs / 2],
+               1e6 * cache_latencies[p99], text_latencies[nbr_runs / 2] / cache_latencies[nbr_runs / 2]);
+    }
+    printf("\nlatency of starting and terminating a game, %i runs per variant\n", nbr_runs);
+    free(text_latencies);
+    free(cache_latencies);
+    unload_starting_position_cache();
+    if (!all_same) {
+        printf("bug, a game starts in another position from %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+// Squares that aren't part of the board are left half set by the text files, only part_of_board counts for them
+static bool same_position(struct GameState *game_state1, struct GameState *game_state2, struct Rules *rules) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        board_length *= rules->board_shape[dim];
+    }
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        struct Square square1 = game_state1->board[square_index];
+        struct Square square2 = game_state2->board[square_index];
+        if (    square1.part_of_board != square2.part_of_board || (square1.part_of_board &&
+                (square1.piece.piece_type != square2.piece.piece_type || square1.piece.piece_color != square2.piece.piece_color ||
+                 square1.piece.direction != square2.piece.direction || square1.piece.has_moved != square2.piece.has_moved ||
+                 square1.white_flag != square2.white_flag || square1.black_flag != square2.black_flag))) {
+            return false;
+        }
+    }
+    return game_state1->whos_turn == game_state2->whos_turn &&
+           game_state1->moves_made_this_turn == game_state2->moves_made_this_turn;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
@@ -0,0 +1,136 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include "chess.h"
+
+#define NBR_OF_PIECE_TYPES (QUEEN + 1)      // indexed by enum PieceType, NULL_PIECE_TYPE included
+#define MAX_SEARCH_PLY 64
+#define NBR_OF_KILLER_MOVES 2
+#define HISTORY_MAX 16384                   // history scores are kept in [-HISTORY_MAX, HISTORY_MAX]
+#define MAX_MOVES_IN_POSITION 8192
+#define MAX_ATTACKERS 256
+#define MATE_SCORE 1000000                  // score for winning now. MATE_SCORE - ply for winning ply plies from the root
+#define INFINITE_SCORE 2000000
+
+enum GenerationStage {
+    GENERATION_STAGE_CAPTURES,
+    GENERATION_STAGE_QUIETS,
+    GENERATION_STAGE_DONE,
+};
+
+// Iterates over the moves of the side to move, captures of all pieces before any quiet move. Moves of a piece are only
+// generated when the caller asks for a move and the previous piece has run out
+struct MoveGenerator {
+    struct GameState *game_state;
+    struct Rules *rules;
+    enum GenerationStage stage;
+    bool captures_only;
+    int board_length;
+    int next_square_index;                          // next square whose piece has not been generated in this stage
+    struct Move piece_moves[MAX_MOVES_SINGLE_PIECE + 1];
+    int piece_move_index;                           // next move in piece_moves to hand out
+};
+
+// Tables used to try good moves first. Allocated once per board in initialize_move_ordering, never during search
+struct MoveOrdering {
+    int board_length;
+    int *history;                   // [PIECE_COLOR_COUNT * NBR_OF_PIECE_TYPES][board_length]. Piece moving, destination square
+    struct Move *countermoves;      // same indexing as history, by piece and destination square of the previous move
+    struct Move killers[MAX_SEARCH_PLY][NBR_OF_KILLER_MOVES];
+    // instrumentation
+    long long cutoffs;              // beta cutoffs recorded
+    long long first_move_cutoffs;   // beta cutoffs produced by the first move tried
+};
+
+// Selective search features can be switched off one by one to measure what each of them is worth
+struct SearchOptions {
+    int  max_depth;
+    long long max_nodes;                    // 0 means no limit
+    double max_seconds;                     // 0 means no limit
+    bool null_move_pruning;
+    bool late_move_reductions;
+    bool futility_pruning;
+    bool razoring;
+};
+
+struct SearchResult {
+    struct Move best_move;                  // destination_square -1 if there is no move
+    int  score;                             // from the point of view of the side to move
+    int  depth_reached;                     // last fully searched depth
+    long long nodes;
+    double seconds;
+};
+
+// One entry per ply of the current search line
+struct SearchPly {
+    struct MoveUndo undo;
+    int material[PIECE_COLOR_COUNT];        // material before the move made at this ply
+};
+
+// Search state for one GameState. Everything search needs is allocated in initialize_search_context
+struct SearchContext {
+    struct GameState *game_state;
+    struct Rules *rules;
+    struct MoveOrdering move_ordering;
+    struct Move *move_stack;                // [MAX_SEARCH_PLY][MAX_MOVES_IN_POSITION]
+    int *score_stack;                       // move ordering scores, same layout as move_stack
+    struct SearchPly *plies;                // [MAX_SEARCH_PLY]
+    int material[PIECE_COLOR_COUNT];        // kept up to date while searching, kings included
+    struct SearchOptions options;
+    double start_time;
+    bool stopped;                           // limit reached, unwind and discard the unfinished iteration
+    // Written by another thread while search_position runs, read every node. Cleared by the caller before searching
+    volatile bool stop_requested;           // stop as soon as possible
+    volatile bool pondering;                // node and time limits don't count until this is cleared
+    bool limits_started;                    // node and time limits count from limits_start_*
+    double limits_start_time;
+    long long limits_start_nodes;
+    struct Move root_best_move;             // best move of the iteration being searched
+    struct Move previous_root_best_move;    // best move of the last finished iteration, tried first
+    // Called on the searching thread after every finished iteration of search_position, NULL for none
+    void (*iteration_done)(struct SearchResult *result, void *argument);
+    void *iteration_done_argument;
+    // instrumentation
+    long long nodes;
+    long long quiescence_nodes;
+    long long see_pruned_captures;
+    long long null_move_cutoffs;
+    long long reduced_moves;
+    long long futility_pruned_moves;
+    long long razored_nodes;
+};
+
+// move_ordering.c
+extern const int piece_values[NBR_OF_PIECE_TYPES];
+bool initialize_move_ordering   (struct MoveOrdering *move_ordering, struct Rules *rules);
+void terminate_move_ordering    (struct MoveOrdering *move_ordering);
+void clear_move_ordering        (struct MoveOrdering *move_ordering);
+void score_moves                (int scores[], struct Move moves[], int nbr_moves, int ply, struct Move previous_move,
+                                 struct GameState *game_state, struct MoveOrdering *move_ordering);
+void pick_next_move             (struct Move moves[], int scores[], int nbr_moves, int index);
+void update_move_ordering_on_cutoff(struct Move move, int move_number, struct Move quiets_tried[], int nbr_quiets_tried,
+                                 struct Move previous_move, int ply, int depth, struct GameState *game_state,
+                                 struct MoveOrdering *move_ordering);
+double first_move_cutoff_rate   (struct MoveOrdering *move_ordering);
+
+// move_generation.c
+void initialize_move_generator  (struct MoveGenerator *move_generator, bool captures_only, struct GameState *game_state,
+                                 struct Rules *rules);
+bool next_move                  (struct MoveGenerator *move_generator, struct Move *move);
+int  generate_stage_moves       (struct MoveGenerator *move_generator, struct Move moves[], int max_moves);
+int  generate_moves             (struct Move moves[], int max_moves, bool captures_only, struct GameState *game_state,
+                                 struct Rules *rules);
+bool piece_can_move_this_turn   (int square_index, struct GameState *game_state, struct Rules *rules);
+
+// search.c
+bool initialize_search_context  (struct SearchContext *search_context, struct GameState *game_state, struct Rules *rules);
+void terminate_search_context   (struct SearchContext *search_context);
+void reset_search_material      (struct SearchContext *search_context);
+int  evaluate_position          (struct SearchContext *search_context);
+int  static_exchange_evaluation (struct Move move, struct GameState *game_state, struct Rules *rules);
+int  quiescence_search          (struct SearchContext *search_context, int alpha, int beta, int ply);
+void default_search_options     (struct SearchOptions *options);
+struct SearchResult search_position(struct SearchContext *search_context, struct SearchOptions *options);
+
+#endif // ENGINE_H
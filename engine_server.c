@@ -0,0 +1,277 @@
+#define _POSIX_C_SOURCE 200809L     // getline
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "chess4d.h"
+
+// Engine speaking a line based text protocol on stdin/stdout, so that other programs can play against it:
+//   chess4d                                     -> id name ..., chess4dok
+//   isready                                     -> readyok, also while searching
+//   variant <variant>                           sets up the starting position of variant
+//   position <variant>|startpos [moves <move> ..] sets up the starting position and plays the moves
+//   moves <move> <move> ..                      plays the moves in the current position
+//   go [depth n] [nodes n] [movetime ms] [ponder] [infinite]
+//                                               -> info ..., bestmove <move> or bestmove none
+//   stop                                        ends the search, bestmove is sent right away
+//   ponderhit                                   the pondered move was played, limits start counting now
+//   quit
+// Search runs on its own thread so that stop, ponderhit and isready are answered while searching. With ponder or
+// infinite the bestmove is held back until stop or ponderhit even if the search finishes. Moves are written as in
+// notation.c. Command line options switch off selective search: -no-null-move -no-lmr -no-futility -no-razoring
+
+#define ENGINE_NAME "chess4d"
+
+struct EngineServer {
+    bool position_set;
+    enum Variant variant;
+    struct Rules rules;
+    struct GameState game_state;                // only touched by the search thread while searching
+    struct SearchContext search_context;
+    struct SearchOptions search_options;        // defaults for go
+
+    // search thread
+    bool searching;                             // search thread started and not joined
+    pthread_t search_thread;
+    struct SearchOptions go_options;
+    pthread_mutex_t mutex;                      // guards the waiting for stop or ponderhit below
+    pthread_cond_t condition;
+    bool infinite;                              // hold bestmove back until stop
+};
+
+static void handle_position(struct EngineServer *engine_server, char *arguments);
+static void handle_moves(struct EngineServer *engine_server, char *moves);
+static void handle_go(struct EngineServer *engine_server, char *arguments);
+static void *search_thread(void *argument);
+static void stop_search(struct EngineServer *engine_server);
+static void ponderhit(struct EngineServer *engine_server);
+static bool set_up_variant(struct EngineServer *engine_server, enum Variant variant);
+
+int main(int argc, char *argv[]) {
+    struct EngineServer engine_server;
+    engine_server.position_set = false;
+    engine_server.searching = false;
+    default_search_options(&engine_server.search_options);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-no-null-move") == 0) {
+            engine_server.search_options.null_move_pruning = false;
+        } else if (strcmp(argv[i], "-no-lmr") == 0) {
+            engine_server.search_options.late_move_reductions = false;
+        } else if (strcmp(argv[i], "-no-futility") == 0) {
+            engine_server.search_options.futility_pruning = false;
+        } else if (strcmp(argv[i], "-no-razoring") == 0) {
+            engine_server.search_options.razoring = false;
+        } else {
+            printf("usage: engine_server [-no-null-move] [-no-lmr] [-no-futility] [-no-razoring]\n");
+            return 1;
+        }
+    }
+    pthread_mutex_init(&engine_server.mutex, NULL);
+    pthread_cond_init(&engine_server.condition, NULL);
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    while (getline(&line, &line_capacity, stdin) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *arguments = line + strcspn(line, " ");
+        if (*arguments != '\0') {
+            *arguments++ = '\0';
+        }
+
+        // Commands that don't touch the game state are answered while searching, the others end the search first
+        if (strcmp(line, "chess4d") == 0) {
+            printf("id name " ENGINE_NAME "\nchess4dok\n");
+        } else if (strcmp(line, "isready") == 0) {
+            printf("readyok\n");
+        } else if (strcmp(line, "stop") == 0) {
+            stop_search(&engine_server);
+        } else if (strcmp(line, "ponderhit") == 0) {
+            ponderhit(&engine_server);
+        } else if (strcmp(line, "variant") == 0) {
+            stop_search(&engine_server);
+            enum Variant variant;
+            if (!variant_from_name(arguments, &variant) || !set_up_variant(&engine_server, variant)) {
+                printf("info string Calamity: no variant %s\n", arguments);
+            }
+        } else if (strcmp(line, "position") == 0) {
+            stop_search(&engine_server);
+            handle_position(&engine_server, arguments);
+        } else if (strcmp(line, "moves") == 0) {
+            stop_search(&engine_server);
+            handle_moves(&engine_server, arguments);
+        } else if (strcmp(line, "go") == 0) {
+            stop_search(&engine_server);
+            handle_go(&engine_server, arguments);
+        } else if (strcmp(line, "quit") == 0) {
+            break;
+        } else if (line[0] != '\0') {
+            printf("info string Calamity: unknown command %s\n", line);
+        }
+        fflush(stdout);
+    }
+    stop_search(&engine_server);
+    free(line);
+    if (engine_server.position_set) {
+        terminate_search_context(&engine_server.search_context);
+        terminate_game_state(&engine_server.game_state);
+    }
+    pthread_cond_destroy(&engine_server.condition);
+    pthread_mutex_destroy(&engine_server.mutex);
+    return 0;
+}
+
+static void handle_position(struct EngineServer *engine_server, char *arguments) {
+    char *variant_text = strtok(arguments, " ");
+    enum Variant variant = engine_server->variant;
+    if (variant_text == NULL || (strcmp(variant_text, "startpos") == 0 && !engine_server->position_set) ||
+            (strcmp(variant_text, "startpos") != 0 && !variant_from_name(variant_text, &variant)) ||
+            !set_up_variant(engine_server, variant)) {
+        printf("info string Calamity: no position\n");
+        return;
+    }
+    char *token = strtok(NULL, " ");
+    if (token == NULL) {
+        return;
+    }
+    if (strcmp(token, "moves") != 0) {
+        printf("info string Calamity: expected moves, got %s\n", token);
+        return;
+    }
+    char *moves = strtok(NULL, "");
+    if (moves != NULL) {
+        handle_moves(engine_server, moves);
+    }
+}
+
+static void handle_moves(struct EngineServer *engine_server, char *moves) {
+    if (!engine_server->position_set) {
+        printf("info string Calamity: moves without position\n");
+        return;
+    }
+    for (char *token = strtok(moves, " "); token != NULL; token = strtok(NULL, " ")) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        if (!text_to_move(token, &move, &promotion_piece_type, &engine_server->game_state, &engine_server->rules)) {
+            printf("info string Calamity: illegal move %s\n", token);
+            return;
+        }
+        make_move(move, promotion_piece_type, &engine_server->game_state, &engine_server->rules);
+    }
+}
+
+// Starting position of variant. The search context is only set up again when the board changes size
+static bool set_up_variant(struct EngineServer *engine_server, enum Variant variant) {
+    bool same_variant = engine_server->position_set && engine_server->variant == variant;
+    if (engine_server->position_set) {
+        terminate_game_state(&engine_server->game_state);
+        if (!same_variant) {
+            terminate_search_context(&engine_server->search_context);
+        }
+    }
+    engine_server->position_set = false;
+    if (!initialize_rules_and_game_state(&engine_server->rules, &engine_server->game_state, variant)) {
+        return false;
+    }
+    if (!same_variant && !initialize_search_context(&engine_server->search_context, &engine_server->game_state,
+                                                    &engine_server->rules)) {
+        terminate_game_state(&engine_server->game_state);
+        return false;
+    }
+    engine_server->variant = variant;
+    engine_server->position_set = true;
+    return true;
+}
+
+static void handle_go(struct EngineServer *engine_server, char *arguments) {
+    if (!engine_server->position_set) {
+        printf("info string Calamity: go without position\nbestmove none\n");
+        return;
+    }
+    struct SearchOptions *options = &engine_server->go_options;
+    *options = engine_server->search_options;
+    bool ponder = false;
+    engine_server->infinite = false;
+    for (char *token = strtok(arguments, " "); token != NULL; token = strtok(NULL, " ")) {
+        if (strcmp(token, "ponder") == 0) {
+            ponder = true;
+            continue;
+        }
+        if (strcmp(token, "infinite") == 0) {
+            engine_server->infinite = true;
+            options->max_depth = MAX_SEARCH_PLY;
+            continue;
+        }
+        char *value = strtok(NULL, " ");
+        if (value == NULL) {
+            break;
+        }
+        if (strcmp(token, "depth") == 0) {
+            options->max_depth = atoi(value);
+        } else if (strcmp(token, "nodes") == 0) {
+            options->max_nodes = atoll(value);
+        } else if (strcmp(token, "movetime") == 0) {
+            options->max_seconds = atof(value) / 1000.0;
+        }
+    }
+    if (engine_server->infinite) {
+        options->max_nodes = 0;
+        options->max_seconds = 0;
+    }
+
+    engine_server->search_context.stop_requested = false;
+    engine_server->search_context.pondering = ponder;
+    if (pthread_create(&engine_server->search_thread, NULL, search_thread, engine_server) != 0) {
+        printf("info string Calamity: failed to start search\nbestmove none\n");
+        return;
+    }
+    engine_server->searching = true;
+}
+
+static void *search_thread(void *argument) {
+    struct EngineServer *engine_server = argument;
+    struct SearchContext *search_context = &engine_server->search_context;
+    struct SearchResult result = search_position(search_context, &engine_server->go_options);
+
+    pthread_mutex_lock(&engine_server->mutex);
+    while ((search_context->pondering || engine_server->infinite) && !search_context->stop_requested) {
+        pthread_cond_wait(&engine_server->condition, &engine_server->mutex);
+    }
+    pthread_mutex_unlock(&engine_server->mutex);
+
+    char move_text[MAX_MOVE_TEXT_LENGTH] = "none";
+    if (result.best_move.destination_square != -1) {
+        enum PieceType promotion_piece_type = NULL_PIECE_TYPE;
+        if (evaluate_promotion(result.best_move.origin_square, result.best_move.destination_square,
+                               &engine_server->game_state, &engine_server->rules)) {
+            promotion_piece_type = QUEEN;
+        }
+        move_to_text(result.best_move, promotion_piece_type, move_text, &engine_server->rules);
+    }
+    printf("info depth %i score %i nodes %lli time %.0f\nbestmove %s\n", result.depth_reached, result.score,
+           result.nodes, result.seconds * 1000.0, move_text);
+    fflush(stdout);
+    return NULL;
+}
+
+// Returns when the search thread has sent its bestmove
+static void stop_search(struct EngineServer *engine_server) {
+    if (!engine_server->searching) {
+        return;
+    }
+    pthread_mutex_lock(&engine_server->mutex);
+    engine_server->search_context.stop_requested = true;
+    pthread_cond_signal(&engine_server->condition);
+    pthread_mutex_unlock(&engine_server->mutex);
+    pthread_join(engine_server->search_thread, NULL);
+    engine_server->searching = false;
+}
+
+static void ponderhit(struct EngineServer *engine_server) {
+    if (!engine_server->searching) {
+        return;
+    }
+    pthread_mutex_lock(&engine_server->mutex);
+    engine_server->search_context.pondering = false;
+    pthread_cond_signal(&engine_server->condition);
+    pthread_mutex_unlock(&engine_server->mutex);
+}
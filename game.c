@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include "chess4d.h"
+
+static struct Move choose_move(struct MoveChooser *move_chooser, bool random_move, struct SearchContext *search_context,
+                               unsigned long long *random_state, struct GameResult *result);
+
+// Search at depth 3 for both sides, no random opening
+void default_game_settings(struct GameSettings *settings, enum Variant variant) {
+    settings->variant = variant;
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        settings->move_choosers[piece_color].type = MOVE_CHOOSER_SEARCH;
+        default_search_options(&settings->move_choosers[piece_color].search_options);
+        settings->move_choosers[piece_color].search_options.max_depth = 3;
+    }
+    settings->max_game_length = DEFAULT_MAX_GAME_LENGTH;
+    settings->random_opening_moves = 0;
+    settings->random_seed = 1;
+    settings->verbose = false;
+    settings->record = NULL;
+}
+
+// Plays one game from the starting position of the variant. Everything the game needs is owned by this call, so games
+// can be played on several threads at once. Both sides promote to queen. A side without moves draws the game, as does
+// reaching max_game_length moves
+bool play_game(struct GameResult *result, struct GameSettings *settings) {
+    struct Rules rules;
+    struct GameState game_state;
+    if (!start_game(&rules, &game_state, settings->variant)) {
+        return false;
+    }
+    struct SearchContext search_context;
+    if (!initialize_search_context(&search_context, &game_state, &rules)) {
+        terminate_game_state(&game_state);
+        return false;
+    }
+    unsigned long long random_state = settings->random_seed != 0 ? settings->random_seed : 1;   // xorshift state can't be 0
+    if (settings->record != NULL && !begin_game_record(settings->record, settings->variant)) {
+        terminate_search_context(&search_context);
+        terminate_game_state(&game_state);
+        return false;
+    }
+
+    result->winner = NULL_PIECE_COLOR;
+    result->nbr_moves = 0;
+    result->nodes = 0;
+    result->seconds = 0;
+    while (result->nbr_moves < settings->max_game_length) {
+        enum PieceColor piece_color = game_state.whos_turn;
+        bool random_move = result->nbr_moves < settings->random_opening_moves;
+        struct Move move = choose_move(&settings->move_choosers[piece_color], random_move, &search_context, &random_state,
+                                       result);
+        if (move.destination_square == -1) {
+            break;
+        }
+
+        enum PieceType promotion_piece_type = NULL_PIECE_TYPE;
+        if (evaluate_promotion(move.origin_square, move.destination_square, &game_state, &rules)) {
+            promotion_piece_type = QUEEN;
+        }
+        if (settings->record != NULL) {
+            write_game_record_move(settings->record, move, promotion_piece_type);
+        }
+        make_move(move, promotion_piece_type, &game_state, &rules);
+        ++result->nbr_moves;
+        if (settings->verbose) {
+            printf("%i. %s %i-%i\n", result->nbr_moves, piece_color == PIECE_COLOR_WHITE ? "white" : "black",
+                   move.origin_square, move.destination_square);
+        }
+
+        result->winner = get_winner(move, &game_state, &rules);
+        if (result->winner != NULL_PIECE_COLOR) {
+            break;
+        }
+    }
+
+    if (settings->record != NULL) {
+        end_game_record(settings->record, result->winner);
+    }
+    terminate_search_context(&search_context);
+    terminate_game_state(&game_state);
+    return true;
+}
+
+// xorshift64*. The state belongs to the caller, one per thread or game
+unsigned long long next_random(unsigned long long *random_state) {
+    *random_state ^= *random_state >> 12;
+    *random_state ^= *random_state << 25;
+    *random_state ^= *random_state >> 27;
+    return *random_state * 2685821657736338717ULL;
+}
+
+// destination_square -1 if the side to move has no moves
+static struct Move choose_move(struct MoveChooser *move_chooser, bool random_move, struct SearchContext *search_context,
+                               unsigned long long *random_state, struct GameResult *result) {
+    struct Move move;
+    move.destination_square = -1;
+    if (random_move || move_chooser->type == MOVE_CHOOSER_RANDOM) {
+        // The search move stack is free between searches
+        struct Move *moves = search_context->move_stack;
+        int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, search_context->game_state, search_context->rules);
+        if (nbr_moves > 0) {
+            move = moves[next_random(random_state) % (unsigned long long)nbr_moves];
+        }
+        return move;
+    }
+
+    struct SearchResult search_result = search_position(search_context, &move_chooser->search_options);
+    result->nodes += search_result.nodes;
+    result->seconds += search_result.seconds;
+    return search_result.best_move;
+}
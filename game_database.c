@@ -0,0 +1,624 @@
+#define _POSIX_C_SOURCE 200809L     // mmap
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "chess4d.h"
+
+// Game database: an append-only file of games and an index from position hashes to the games that reached them.
+// Database file:
+//   "C4DB", byte GAME_RECORD_VERSION
+//   per game varint length, then the game as game_record.c writes it without a file header
+// Index file, path of the database + ".index", rebuilt from scratch by build_game_database_index:
+//   struct GameDatabaseIndexHeader, then struct GameDatabaseEntry sorted by hash, then location
+// The build holds at most a memory budget of entries, beyond it sorted runs are spilled to files next to the database and
+// merged from there, so the index can be larger than memory
+// Both files are memory mapped, games are decoded straight from the mapping and a lookup is a binary search over the
+// mapped entries. Games appended after the index was built are not in it until it is built again.
+// Position hashes are Zobrist hashes without tables, the key of a piece on a square is mixed from the square index and the
+// piece since boards go up to MAX_TOTAL_NBR_OF_SQUARES squares. The variant and the side to move are hashed as well
+
+#define GAME_DATABASE_MAGIC "C4DB"
+#define GAME_DATABASE_INDEX_MAGIC "C4DI"
+#define GAME_DATABASE_INDEX_VERSION 1
+#define INDEX_MERGE_BUFFER_ENTRIES 4096
+
+struct GameDatabaseIndexHeader {
+    char magic[4];
+    unsigned int version;
+    long long nbr_entries;
+    long long database_length;          // bytes of the database file the index covers
+};
+
+// A sorted run in the spill file of a build thread
+struct SpilledRun {
+    long long offset;                   // in bytes
+    long long nbr_entries;
+};
+
+// Entries of one build thread, sorted by the thread. Every time max_entries are in memory they are sorted and appended
+// to the spill file as one more spilled run
+struct IndexRun {
+    struct GameDatabase *database;
+    long long *game_offsets;
+    long long first_game, end_game;
+    struct GameDatabaseEntry *entries;
+    long long nbr_entries;              // in memory
+    long long capacity;
+    long long max_entries;
+    char spill_path[FILENAME_MAX];
+    FILE *spill_file;                   // NULL until the first spill, removed from the directory as soon as it's open
+    struct SpilledRun *spilled_runs;
+    int  nbr_spilled_runs;
+    long long total_entries;            // in memory and spilled
+    bool ok;
+};
+
+// Where a sorted run is in the merge, entries straight from memory or a block at a time from a spill file
+struct MergeSource {
+    const struct GameDatabaseEntry *entries;
+    long long next, end;
+    int  fd;                            // -1 for a run in memory
+    long long file_offset;              // of the next block
+    long long entries_in_file;          // not read yet
+    struct GameDatabaseEntry *buffer;   // of the blocks
+};
+
+static unsigned long long mix_hash(unsigned long long x);
+static unsigned long long square_hash(int square_index, struct Square square);
+static unsigned long long turn_hash(enum PieceColor whos_turn, int moves_made_this_turn);
+static bool map_file(const char *path, const unsigned char **data, size_t *length);
+static bool map_database(struct GameDatabase *database, const char *path);
+static bool read_game_length(const unsigned char *data, size_t length, long long *offset, size_t *game_length);
+static void *index_games(void *argument);
+static bool add_index_entry(struct IndexRun *run, unsigned long long hash, long long game_offset, int ply);
+static bool spill_run       (struct IndexRun *run);
+static int  compare_entries(const void *a, const void *b);
+static bool next_merge_block(struct MergeSource *source);
+static void sift_down       (struct MergeSource sources[], int heap[], int heap_size, int position);
+static bool write_index(const char *path, struct IndexRun runs[], int nbr_runs, long long database_length);
+
+unsigned long long position_hash(struct GameState *game_state, struct Rules *rules, enum Variant variant) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        board_length *= rules->board_shape[dim];
+    }
+    unsigned long long hash = mix_hash(0x56415249414E54ULL + variant);
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        hash ^= square_hash(square_index, game_state->board[square_index]);
+    }
+    return hash ^ turn_hash(game_state->whos_turn, game_state->moves_made_this_turn);
+}
+
+// Hash after the move undo was made for, from the hash before it. Only the squares the move changed are looked at
+unsigned long long update_position_hash(unsigned long long hash, struct MoveUndo *undo, struct GameState *game_state) {
+    hash ^= turn_hash(undo->whos_turn, undo->moves_made_this_turn);
+    hash ^= turn_hash(game_state->whos_turn, game_state->moves_made_this_turn);
+    for (int i = 0; i < undo->nbr_square_changes; ++i) {
+        // A square can be recorded more than once, the first change has what was there before the move
+        int square_index = undo->square_changes[i].square_index;
+        bool recorded_before = false;
+        for (int j = 0; j < i && !recorded_before; ++j) {
+            recorded_before = undo->square_changes[j].square_index == square_index;
+        }
+        if (!recorded_before) {
+            hash ^= square_hash(square_index, undo->square_changes[i].square);
+            hash ^= square_hash(square_index, game_state->board[square_index]);
+        }
+    }
+    return hash;
+}
+
+// Opens the database for appending games, a new one is created with its header. NULL on failure
+FILE *open_game_database_for_append(const char *path) {
+    FILE *file = fopen(path, "ab");
+    if (file == NULL) {
+        printf("Tragedy: can't open game database %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        fwrite(GAME_DATABASE_MAGIC, 1, strlen(GAME_DATABASE_MAGIC), file);
+        fputc(GAME_RECORD_VERSION, file);
+    }
+    return file;
+}
+
+// Moves the games in the buffer of writer, which writes to memory, to the end of the database
+bool append_game_to_database(FILE *database_file, struct GameRecordWriter *writer) {
+    if (writer->file != NULL || writer->game_open) {
+        printf("bug, append_game_to_database needs a finished game in memory\n");
+        return false;
+    }
+    unsigned int length = writer->buffer_length;
+    while (length >= 0x80) {
+        fputc((length & 0x7F) | 0x80, database_file);
+        length >>= 7;
+    }
+    fputc(length, database_file);
+    bool written = fwrite(writer->buffer, 1, writer->buffer_length, database_file) == (size_t)writer->buffer_length;
+    writer->buffer_length = 0;
+    return written;
+}
+
+// The index is optional, without it nbr_entries is 0
+bool open_game_database(struct GameDatabase *database, const char *path) {
+    if (!map_database(database, path)) {
+        return false;
+    }
+
+    char index_path[FILENAME_MAX];
+    snprintf(index_path, sizeof(index_path), "%s.index", path);
+    if (access(index_path, R_OK) != 0 || !map_file(index_path, &database->index_data, &database->index_length)) {
+        return true;
+    }
+    const struct GameDatabaseIndexHeader *header = (const struct GameDatabaseIndexHeader *)database->index_data;
+    if (    database->index_length < sizeof(*header) || memcmp(header->magic, GAME_DATABASE_INDEX_MAGIC, 4) != 0 ||
+            header->version != GAME_DATABASE_INDEX_VERSION || header->database_length > (long long)database->length ||
+            database->index_length != sizeof(*header) + header->nbr_entries * sizeof(struct GameDatabaseEntry)) {
+        printf("Fiasco: %s is broken, build it again\n", index_path);
+        close_game_database(database);
+        return false;
+    }
+    // A lookup touches a few scattered pages, reading ahead around them only pushes the rest of the index out of memory
+    posix_madvise((void *)database->index_data, database->index_length, POSIX_MADV_RANDOM);
+    database->entries = (const struct GameDatabaseEntry *)(database->index_data + sizeof(*header));
+    database->nbr_entries = header->nbr_entries;
+    database->indexed_length = header->database_length;
+    return true;
+}
+
+void close_game_database(struct GameDatabase *database) {
+    if (database->data != NULL) {
+        munmap((void *)database->data, database->length);
+        database->data = NULL;
+    }
+    if (database->index_data != NULL) {
+        munmap((void *)database->index_data, database->index_length);
+        database->index_data = NULL;
+    }
+    database->entries = NULL;
+    database->nbr_entries = 0;
+}
+
+// The game at offset, straight from the mapping. Start at GAME_DATABASE_FIRST_GAME and continue at next_offset. false at
+// the end of the database or when the game doesn't fit in it
+bool database_game(struct GameDatabase *database, long long offset, const unsigned char **game, size_t *length,
+                   long long *next_offset) {
+    if (offset >= (long long)database->length || !read_game_length(database->data, database->length, &offset, length)) {
+        return false;
+    }
+    *game = database->data + offset;
+    *next_offset = offset + *length;
+    return true;
+}
+
+// Entries with the hash, *first points at the first one. Two binary searches over the mapped index, for the first entry
+// with the hash and the first one after them
+long long find_database_position(struct GameDatabase *database, unsigned long long hash,
+                                 const struct GameDatabaseEntry **first) {
+    long long low = 0, high = database->nbr_entries;
+    while (low < high) {
+        long long middle = low + (high - low) / 2;
+        if (database->entries[middle].hash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *first = database->entries + low;
+    long long end = low;
+    high = database->nbr_entries;
+    while (end < high) {
+        long long middle = end + (high - end) / 2;
+        if (database->entries[middle].hash <= hash) {
+            end = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return end - low;
+}
+
+// Replays every game on nbr_threads threads, each sorts the positions of its games and the sorted runs are merged into
+// the index file. Written next to it first and renamed, so readers see the old index or the new one. Together the
+// threads keep about memory_budget bytes of entries in memory, more are spilled to disk
+bool build_game_database_index(const char *path, int nbr_threads, size_t memory_budget, long long *nbr_entries) {
+    struct GameDatabase database;
+    if (!map_database(&database, path)) {
+        return false;
+    }
+    // Game lengths are in front of the games, finding where they start doesn't need them decoded
+    long long nbr_games = 0, capacity = 1024;
+    long long *game_offsets = malloc(sizeof(*game_offsets) * capacity);
+    long long offset = GAME_DATABASE_FIRST_GAME, next_offset;
+    const unsigned char *game;
+    size_t length;
+    while (game_offsets != NULL && database_game(&database, offset, &game, &length, &next_offset)) {
+        if (nbr_games == capacity) {
+            capacity *= 2;
+            long long *offsets = realloc(game_offsets, sizeof(*game_offsets) * capacity);
+            if (offsets == NULL) {
+                free(game_offsets);
+                game_offsets = NULL;
+                break;
+            }
+            game_offsets = offsets;
+        }
+        game_offsets[nbr_games++] = offset;
+        offset = next_offset;
+    }
+    if (nbr_threads < 1) {
+        nbr_threads = 1;
+    }
+    // Half of it for the entries, qsort sorts through a copy of them
+    long long max_entries = memory_budget / sizeof(struct GameDatabaseEntry) / nbr_threads / 2;
+    if (max_entries < INDEX_MERGE_BUFFER_ENTRIES) {
+        max_entries = INDEX_MERGE_BUFFER_ENTRIES;
+    }
+    struct IndexRun *runs = calloc(nbr_threads, sizeof(*runs));
+    pthread_t *threads = malloc(sizeof(*threads) * nbr_threads);
+    if (game_offsets == NULL || runs == NULL || threads == NULL) {
+        printf("Catastrophe: out of memory for the index\n");
+        free(game_offsets);
+        free(runs);
+        free(threads);
+        close_game_database(&database);
+        return false;
+    }
+
+    bool ok = true;
+    int nbr_started = 0;
+    for (; nbr_started < nbr_threads; ++nbr_started) {
+        struct IndexRun *run = &runs[nbr_started];
+        run->database = &database;
+        run->game_offsets = game_offsets;
+        run->first_game = nbr_games * nbr_started / nbr_threads;
+        run->end_game = nbr_games * (nbr_started + 1) / nbr_threads;
+        run->max_entries = max_entries;
+        snprintf(run->spill_path, sizeof(run->spill_path), "%s.index.spill%i", path, nbr_started);
+        if (pthread_create(&threads[nbr_started], NULL, index_games, run) != 0) {
+            printf("Havoc: can't start index thread\n");
+            ok = false;
+            break;
+        }
+    }
+    *nbr_entries = 0;
+    for (int i = 0; i < nbr_started; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && runs[i].ok;
+        *nbr_entries += runs[i].total_entries;
+    }
+    ok = ok && write_index(path, runs, nbr_started, offset);     // offset is past the last game
+
+    for (int i = 0; i < nbr_started; ++i) {
+        free(runs[i].entries);
+        free(runs[i].spilled_runs);
+        if (runs[i].spill_file != NULL) {
+            fclose(runs[i].spill_file);
+        }
+    }
+    free(runs);
+    free(threads);
+    free(game_offsets);
+    close_game_database(&database);
+    return ok;
+}
+
+static void *index_games(void *argument) {
+    struct IndexRun *run = argument;
+    struct GameRecordReader reader;
+    initialize_game_record_reader_from_memory(&reader, NULL, 0);
+    run->ok = true;
+    enum Variant hashed_variant = NBR_OF_VARIANTS;
+    unsigned long long starting_hash = 0;
+    for (long long game_number = run->first_game; game_number < run->end_game && run->ok; ++game_number) {
+        long long next_offset;
+        const unsigned char *game;
+        size_t length;
+        long long offset = run->game_offsets[game_number];
+        database_game(run->database, offset, &game, &length, &next_offset);
+        set_game_record_reader_memory(&reader, game, length);
+        if (!next_game_record(&reader)) {
+            run->ok = false;
+            break;
+        }
+        if (reader.variant != hashed_variant) {
+            starting_hash = position_hash(&reader.game_state, &reader.rules, reader.variant);
+            hashed_variant = reader.variant;
+        }
+        unsigned long long hash = starting_hash;
+        run->ok = add_index_entry(run, hash, offset, 0);
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        for (int ply = 1; run->ok && ply <= GAME_DATABASE_MAX_PLY &&
+                read_game_record_move(&reader, &move, &promotion_piece_type); ++ply) {
+            hash = update_position_hash(hash, &reader.undo, &reader.game_state);
+            run->ok = add_index_entry(run, hash, offset, ply);
+        }
+        run->ok = run->ok && !reader.error;
+    }
+    terminate_game_record_reader(&reader);
+    if (run->ok) {
+        qsort(run->entries, run->nbr_entries, sizeof(*run->entries), compare_entries);
+    }
+    if (run->ok && run->spill_file != NULL && fflush(run->spill_file) != 0) {
+        printf("Tragedy: can't write %s\n", run->spill_path);
+        run->ok = false;
+    }
+    return NULL;
+}
+
+static bool add_index_entry(struct IndexRun *run, unsigned long long hash, long long game_offset, int ply) {
+    if (run->nbr_entries == run->max_entries && !spill_run(run)) {
+        return false;
+    }
+    if (run->nbr_entries == run->capacity) {
+        long long capacity = run->capacity > 0 ? 2 * run->capacity : 65536;
+        capacity = capacity < run->max_entries ? capacity : run->max_entries;
+        struct GameDatabaseEntry *entries = realloc(run->entries, sizeof(*entries) * capacity);
+        if (entries == NULL) {
+            printf("Catastrophe: out of memory for the index\n");
+            return false;
+        }
+        run->entries = entries;
+        run->capacity = capacity;
+    }
+    run->entries[run->nbr_entries].hash = hash;
+    run->entries[run->nbr_entries].location = (unsigned long long)game_offset << GAME_DATABASE_PLY_BITS | ply;
+    ++run->nbr_entries;
+    ++run->total_entries;
+    return true;
+}
+
+// Sorts the entries in memory and appends them to the spill file, which is created the first time
+static bool spill_run(struct IndexRun *run) {
+    if (run->spill_file == NULL) {
+        run->spill_file = fopen(run->spill_path, "w+b");
+        if (run->spill_file == NULL) {
+            printf("Tragedy: can't write %s\n", run->spill_path);
+            return false;
+        }
+        remove(run->spill_path);        // open until the build is done, nothing is left behind after a crash
+    }
+    struct SpilledRun *spilled_runs = realloc(run->spilled_runs, sizeof(*spilled_runs) * (run->nbr_spilled_runs + 1));
+    if (spilled_runs == NULL) {
+        printf("Catastrophe: out of memory for the index\n");
+        return false;
+    }
+    run->spilled_runs = spilled_runs;
+    struct SpilledRun *spilled_run = &spilled_runs[run->nbr_spilled_runs];
+    spilled_run->offset = (run->total_entries - run->nbr_entries) * (long long)sizeof(*run->entries);
+    spilled_run->nbr_entries = run->nbr_entries;
+    qsort(run->entries, run->nbr_entries, sizeof(*run->entries), compare_entries);
+    if (fwrite(run->entries, sizeof(*run->entries), run->nbr_entries, run->spill_file) != (size_t)run->nbr_entries) {
+        printf("Tragedy: can't write %s\n", run->spill_path);
+        return false;
+    }
+    ++run->nbr_spilled_runs;
+    run->nbr_entries = 0;
+    return true;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const struct GameDatabaseEntry *entry1 = a, *entry2 = b;
+    if (entry1->hash != entry2->hash) {
+        return entry1->hash < entry2->hash ? -1 : 1;
+    }
+    return (entry1->location > entry2->location) - (entry1->location < entry2->location);
+}
+
+// Merges the sorted runs of every thread, spilled and in memory. The run with the smallest next entry is on top of a heap
+static bool write_index(const char *path, struct IndexRun runs[], int nbr_runs, long long database_length) {
+    char index_path[FILENAME_MAX], temporary_path[FILENAME_MAX];
+    snprintf(index_path, sizeof(index_path), "%s.index", path);
+    snprintf(temporary_path, sizeof(temporary_path), "%s.index.new", path);
+    int nbr_sources = 0;
+    for (int i = 0; i < nbr_runs; ++i) {
+        nbr_sources += runs[i].nbr_spilled_runs + 1;
+    }
+    struct MergeSource *sources = calloc(nbr_sources, sizeof(*sources));
+    int *heap = malloc(sizeof(*heap) * nbr_sources);
+    bool ok = sources != NULL && heap != NULL;
+    int nbr_opened = 0;
+    for (int i = 0; i < nbr_runs && ok; ++i) {
+        for (int j = 0; j < runs[i].nbr_spilled_runs && ok; ++j) {
+            struct MergeSource *source = &sources[nbr_opened++];
+            source->fd = fileno(runs[i].spill_file);
+            source->file_offset = runs[i].spilled_runs[j].offset;
+            source->entries_in_file = runs[i].spilled_runs[j].nbr_entries;
+            source->buffer = malloc(sizeof(*source->buffer) * INDEX_MERGE_BUFFER_ENTRIES);
+            source->entries = source->buffer;
+            ok = source->buffer != NULL;
+        }
+        struct MergeSource *source = &sources[nbr_opened++];
+        source->fd = -1;
+        source->entries = runs[i].entries;
+        source->end = runs[i].nbr_entries;
+    }
+    if (!ok) {
+        printf("Catastrophe: out of memory for the index\n");
+    }
+    FILE *file = ok ? fopen(temporary_path, "wb") : NULL;
+    if (ok && file == NULL) {
+        printf("Tragedy: can't write %s\n", temporary_path);
+        ok = false;
+    }
+
+    if (ok) {
+        struct GameDatabaseIndexHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, GAME_DATABASE_INDEX_MAGIC, 4);
+        header.version = GAME_DATABASE_INDEX_VERSION;
+        header.database_length = database_length;
+        for (int i = 0; i < nbr_runs; ++i) {
+            header.nbr_entries += runs[i].total_entries;
+        }
+        fwrite(&header, sizeof(header), 1, file);
+
+        // A source that can't give its first entry is left out of the heap, an unreadable one ends the merge
+        int heap_size = 0;
+        for (int i = 0; i < nbr_sources && ok; ++i) {
+            if (next_merge_block(&sources[i])) {
+                heap[heap_size++] = i;
+            }
+            ok = sources[i].entries_in_file == 0 || sources[i].next < sources[i].end;
+        }
+        for (int position = heap_size / 2 - 1; position >= 0; --position) {
+            sift_down(sources, heap, heap_size, position);
+        }
+        static struct GameDatabaseEntry buffer[INDEX_MERGE_BUFFER_ENTRIES];
+        int nbr_buffered = 0;
+        long long nbr_written = 0;
+        while (ok && heap_size > 0) {
+            struct MergeSource *source = &sources[heap[0]];
+            buffer[nbr_buffered++] = source->entries[source->next++];
+            if (nbr_buffered == INDEX_MERGE_BUFFER_ENTRIES) {
+                fwrite(buffer, sizeof(*buffer), nbr_buffered, file);
+                nbr_written += nbr_buffered;
+                nbr_buffered = 0;
+            }
+            if (!next_merge_block(source)) {
+                ok = source->entries_in_file == 0;
+                heap[0] = heap[--heap_size];
+            }
+            sift_down(sources, heap, heap_size, 0);
+        }
+        fwrite(buffer, sizeof(*buffer), nbr_buffered, file);
+        nbr_written += nbr_buffered;
+        ok = ok && nbr_written == header.nbr_entries && !ferror(file);
+        if (fclose(file) != 0 || !ok || rename(temporary_path, index_path) != 0) {
+            printf("Tragedy: can't write %s\n", index_path);
+            remove(temporary_path);
+            ok = false;
+        }
+    }
+
+    for (int i = 0; i < nbr_opened; ++i) {
+        free(sources[i].buffer);
+    }
+    free(sources);
+    free(heap);
+    return ok;
+}
+
+// The next block of a spilled run is read once the one before is used up. false when the run is done or can't be read,
+// entries_in_file tells them apart
+static bool next_merge_block(struct MergeSource *source) {
+    if (source->next < source->end) {
+        return true;
+    }
+    if (source->fd == -1 || source->entries_in_file == 0) {
+        return false;
+    }
+    long long nbr_read = source->entries_in_file < INDEX_MERGE_BUFFER_ENTRIES ? source->entries_in_file :
+                         INDEX_MERGE_BUFFER_ENTRIES;
+    size_t length = sizeof(*source->buffer) * nbr_read;
+    if (pread(source->fd, source->buffer, length, source->file_offset) != (ssize_t)length) {
+        printf("Tragedy: can't read back a spilled index run\n");
+        return false;
+    }
+    source->file_offset += length;
+    source->entries_in_file -= nbr_read;
+    source->next = 0;
+    source->end = nbr_read;
+    return true;
+}
+
+static void sift_down(struct MergeSource sources[], int heap[], int heap_size, int position) {
+    while (true) {
+        int smallest = position;
+        for (int child = 2 * position + 1; child <= 2 * position + 2 && child < heap_size; ++child) {
+            struct MergeSource *source = &sources[heap[child]], *smallest_source = &sources[heap[smallest]];
+            if (compare_entries(&source->entries[source->next], &smallest_source->entries[smallest_source->next]) < 0) {
+                smallest = child;
+            }
+        }
+        if (smallest == position) {
+            return;
+        }
+        int swap = heap[position];
+        heap[position] = heap[smallest];
+        heap[smallest] = swap;
+        position = smallest;
+    }
+}
+
+static bool read_game_length(const unsigned char *data, size_t length, long long *offset, size_t *game_length) {
+    *game_length = 0;
+    for (int shift = 0; shift < 35 && *offset < (long long)length; shift += 7) {
+        unsigned char byte = data[(*offset)++];
+        *game_length |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return *game_length <= length - *offset;
+        }
+    }
+    return false;
+}
+
+// Without the index
+static bool map_database(struct GameDatabase *database, const char *path) {
+    database->entries = NULL;
+    database->nbr_entries = 0;
+    database->indexed_length = 0;
+    database->index_data = NULL;
+    database->index_length = 0;
+    if (!map_file(path, &database->data, &database->length)) {
+        return false;
+    }
+    if (    database->length < GAME_DATABASE_FIRST_GAME ||
+            memcmp(database->data, GAME_DATABASE_MAGIC, strlen(GAME_DATABASE_MAGIC)) != 0 ||
+            database->data[strlen(GAME_DATABASE_MAGIC)] != GAME_RECORD_VERSION) {
+        printf("Fiasco: %s isn't a game database of version %i\n", path, GAME_RECORD_VERSION);
+        close_game_database(database);
+        return false;
+    }
+    return true;
+}
+
+static bool map_file(const char *path, const unsigned char **data, size_t *length) {
+    *data = NULL;
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd == -1 || fstat(fd, &status) == -1) {
+        printf("Tragedy: can't open %s\n", path);
+        if (fd != -1) {
+            close(fd);
+        }
+        return false;
+    }
+    *length = status.st_size;
+    void *mapping = *length > 0 ? mmap(NULL, *length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("Tragedy: can't map %s\n", path);
+        return false;
+    }
+    *data = mapping;
+    return true;
+}
+
+// splitmix64 finalizer
+static unsigned long long mix_hash(unsigned long long x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static unsigned long long square_hash(int square_index, struct Square square) {
+    if (square.piece.piece_type == NULL_PIECE_TYPE) {
+        return 0;
+    }
+    unsigned long long piece = (unsigned long long)(square.piece.piece_color + 1) * NBR_OF_PIECE_TYPES + square.piece.piece_type;
+    return mix_hash((unsigned long long)square_index << 8 | piece);
+}
+
+static unsigned long long turn_hash(enum PieceColor whos_turn, int moves_made_this_turn) {
+    return mix_hash(0x7475524E00000000ULL | (unsigned long long)whos_turn << 16 | (unsigned long long)moves_made_this_turn);
+}
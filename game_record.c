@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+
+// Binary game records, many games after each other in one file:
+//   "C4DR", byte GAME_RECORD_VERSION                                  once per file
+//   varint  variant                                                   per game
+//   varint  move + 1, byte promotion piece type                       per move, the byte only when the move promotes
+//   varint  0, byte winner + 1                                         end of the game, 0 for a draw
+// A move is an index into the moves of the position, in a deterministic order: the pieces that can move this turn in
+// square order, and the moves get_moves returns for the piece. With n such pieces it is stored as
+// move index * n + piece index, one byte in most positions of standard chess. Decoding only generates the moves of the
+// piece that moved instead of the whole position. The starting position comes from the variant, variants that set up
+// their board at random can't be recorded. Anything that changes the order of get_moves has to bump
+// GAME_RECORD_VERSION, older records would replay into different games.
+// Without a file the writer keeps the games in a buffer and the reader reads them from memory, without the file header,
+// which is how game_database.c stores them
+
+#define GAME_RECORD_MAGIC "C4DR"
+#define GAME_RECORD_END_OF_GAME 0
+#define GAME_RECORD_PIECES_PER_SCAN 256
+
+static void write_byte(struct GameRecordWriter *writer, int byte);
+static void write_varint(struct GameRecordWriter *writer, unsigned int value);
+static int  read_byte(struct GameRecordReader *reader);
+static bool read_varint(struct GameRecordReader *reader, unsigned int *value);
+static bool can_move(int square_index, struct GameState *game_state, struct Rules *rules);
+static int  move_index(struct Move move, struct GameState *game_state, struct Rules *rules);
+static bool nth_move(unsigned int index, struct Move *move, struct GameState *game_state, struct Rules *rules);
+
+// The file must be open for writing, the header is written right away. file NULL writes to writer->buffer
+void initialize_game_record_writer(struct GameRecordWriter *writer, FILE *file) {
+    writer->file = file;
+    writer->buffer = NULL;
+    writer->buffer_length = 0;
+    writer->buffer_capacity = 0;
+    writer->game_open = false;
+    writer->nbr_moves = 0;
+    writer->bytes_written = 0;
+    if (file != NULL) {
+        for (const char *magic = GAME_RECORD_MAGIC; *magic != '\0'; ++magic) {
+            write_byte(writer, *magic);
+        }
+        write_byte(writer, GAME_RECORD_VERSION);
+    }
+}
+
+// Ends an unfinished game as a draw. The file stays open
+void terminate_game_record_writer(struct GameRecordWriter *writer) {
+    if (writer->game_open) {
+        end_game_record(writer, NULL_PIECE_COLOR);
+    }
+    if (writer->file != NULL) {
+        fflush(writer->file);
+    }
+    free(writer->buffer);
+    writer->buffer = NULL;
+}
+
+bool begin_game_record(struct GameRecordWriter *writer, enum Variant variant) {
+    if (writer->game_open) {
+        end_game_record(writer, NULL_PIECE_COLOR);
+    }
+    if (!initialize_rules_and_game_state(&writer->rules, &writer->game_state, variant)) {
+        return false;
+    }
+    write_varint(writer, variant);
+    writer->game_open = true;
+    return true;
+}
+
+// The move must be one of get_moves for a piece that can move in the position of the record, which the writer follows on
+// its own board. promotion_piece_type is only looked at when the move promotes
+bool write_game_record_move(struct GameRecordWriter *writer, struct Move move, enum PieceType promotion_piece_type) {
+    if (!writer->game_open) {
+        printf("bug, move written to a game record before begin_game_record\n");
+        return false;
+    }
+    int index = move_index(move, &writer->game_state, &writer->rules);
+    if (index == -1) {
+        printf("Blunder: move %i-%i isn't legal in the recorded game\n", move.origin_square, move.destination_square);
+        return false;
+    }
+    write_varint(writer, index + 1);
+    if (evaluate_promotion(move.origin_square, move.destination_square, &writer->game_state, &writer->rules)) {
+        write_byte(writer, promotion_piece_type);
+    } else {
+        promotion_piece_type = NULL_PIECE_TYPE;     // make_move would turn the piece into it regardless
+    }
+    make_move(move, promotion_piece_type, &writer->game_state, &writer->rules);
+    ++writer->nbr_moves;
+    return true;
+}
+
+void end_game_record(struct GameRecordWriter *writer, enum PieceColor winner) {
+    if (!writer->game_open) {
+        return;
+    }
+    write_varint(writer, GAME_RECORD_END_OF_GAME);
+    write_byte(writer, winner + 1);
+    terminate_game_state(&writer->game_state);
+    writer->game_open = false;
+}
+
+// false if the file isn't a game record of this version
+bool initialize_game_record_reader(struct GameRecordReader *reader, FILE *file) {
+    initialize_game_record_reader_from_memory(reader, NULL, 0);
+    reader->file = file;
+    char magic[sizeof(GAME_RECORD_MAGIC)] = {0};
+    if (fread(magic, 1, strlen(GAME_RECORD_MAGIC), file) != strlen(GAME_RECORD_MAGIC) ||
+            strcmp(magic, GAME_RECORD_MAGIC) != 0) {
+        printf("Fiasco: not a game record\n");
+        return false;
+    }
+    int version = fgetc(file);
+    if (version != GAME_RECORD_VERSION) {
+        printf("Fiasco: game record version %i, this build reads version %i\n", version, GAME_RECORD_VERSION);
+        return false;
+    }
+    return true;
+}
+
+// Games back to back in data, without the file header. Nothing is copied, data must outlive the reader
+void initialize_game_record_reader_from_memory(struct GameRecordReader *reader, const unsigned char *data, size_t length) {
+    reader->file = NULL;
+    reader->data = data;
+    reader->data_end = data + length;
+    reader->game_open = false;
+    reader->variant_loaded = false;
+    reader->nbr_games = 0;
+    reader->nbr_moves = 0;
+}
+
+// Keeps the starting position of the variant loaded
+void set_game_record_reader_memory(struct GameRecordReader *reader, const unsigned char *data, size_t length) {
+    reader->data = data;
+    reader->data_end = data + length;
+    reader->game_open = false;
+}
+
+void terminate_game_record_reader(struct GameRecordReader *reader) {
+    if (reader->variant_loaded) {
+        terminate_game_state(&reader->starting_position);
+        terminate_game_state(&reader->game_state);
+        reader->variant_loaded = false;
+    }
+    reader->game_open = false;
+}
+
+// Sets up the starting position of the next game. false at the end of the file or for a broken record. Games of the
+// variant of the game before start from a copy of its starting position instead of the variant files
+bool next_game_record(struct GameRecordReader *reader) {
+    reader->game_open = false;
+    unsigned int variant;
+    if (reader->file != NULL) {
+        int c = fgetc(reader->file);
+        if (c == EOF) {
+            return false;
+        }
+        ungetc(c, reader->file);
+    } else if (reader->data == reader->data_end) {
+        return false;
+    }
+    if (!read_varint(reader, &variant) || variant >= NBR_OF_VARIANTS) {
+        printf("Fiasco: game %lli of the record has no variant\n", reader->nbr_games + 1);
+        return false;
+    }
+    if (!reader->variant_loaded || reader->variant != (enum Variant)variant) {
+        terminate_game_record_reader(reader);
+        if (!initialize_rules_and_game_state(&reader->rules, &reader->starting_position, (enum Variant)variant)) {
+            return false;
+        }
+        reader->board_length = 1;
+        for (int dim = 0; dim < reader->rules.dimensions; ++dim) {
+            reader->board_length *= reader->rules.board_shape[dim];
+        }
+        reader->game_state.board = malloc(sizeof(*reader->game_state.board) * reader->board_length);
+        if (reader->game_state.board == NULL) {
+            printf("Catastrophe: out of memory for the board\n");
+            terminate_game_state(&reader->starting_position);
+            return false;
+        }
+        reader->variant = (enum Variant)variant;
+        reader->variant_loaded = true;
+    }
+    struct Square *board = reader->game_state.board;
+    reader->game_state = reader->starting_position;
+    reader->game_state.board = board;
+    memcpy(board, reader->starting_position.board, sizeof(*board) * reader->board_length);
+    reader->winner = NULL_PIECE_COLOR;
+    reader->error = false;
+    reader->game_open = true;
+    ++reader->nbr_games;
+    return true;
+}
+
+// Reads the next move and plays it on reader->game_state. false at the end of the game, when reader->winner is the
+// recorded result, or when the record is broken, when reader->error is set as well
+bool read_game_record_move(struct GameRecordReader *reader, struct Move *move, enum PieceType *promotion_piece_type) {
+    if (!reader->game_open) {
+        return false;
+    }
+    unsigned int value;
+    if (!read_varint(reader, &value)) {
+        printf("Fiasco: game %lli of the record ends in the middle\n", reader->nbr_games);
+        reader->error = true;
+        return false;
+    }
+    if (value == GAME_RECORD_END_OF_GAME) {
+        int winner = read_byte(reader);
+        if (winner < NULL_PIECE_COLOR + 1 || winner > PIECE_COLOR_COUNT) {
+            printf("Fiasco: game %lli of the record has no result\n", reader->nbr_games);
+            reader->error = true;
+            return false;
+        }
+        reader->winner = (enum PieceColor)(winner - 1);
+        reader->game_open = false;
+        return false;
+    }
+    if (!nth_move(value - 1, move, &reader->game_state, &reader->rules)) {
+        printf("Fiasco: game %lli of the record has move %u, the position has no such move\n", reader->nbr_games, value);
+        reader->error = true;
+        return false;
+    }
+    *promotion_piece_type = NULL_PIECE_TYPE;
+    if (evaluate_promotion(move->origin_square, move->destination_square, &reader->game_state, &reader->rules)) {
+        int piece_type = read_byte(reader);
+        if (piece_type <= NULL_PIECE_TYPE || piece_type >= NBR_OF_PIECE_TYPES || piece_type == KING) {
+            printf("Fiasco: game %lli of the record promotes to piece type %i\n", reader->nbr_games, piece_type);
+            reader->error = true;
+            return false;
+        }
+        *promotion_piece_type = (enum PieceType)piece_type;
+    }
+    make_move_with_undo(*move, *promotion_piece_type, &reader->game_state, &reader->rules, &reader->undo);
+    ++reader->nbr_moves;
+    return true;
+}
+
+// Replays every game left in the reader and checks it against the rules: every move exists and the recorded winner is
+// the one get_winner finds after the last move, no earlier move ends the game
+bool verify_game_records(struct GameRecordReader *reader) {
+    while (next_game_record(reader)) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        enum PieceColor winner = NULL_PIECE_COLOR;
+        int nbr_moves = 0;
+        while (read_game_record_move(reader, &move, &promotion_piece_type)) {
+            if (winner != NULL_PIECE_COLOR) {
+                printf("Fiasco: game %lli of the record goes on after move %i won it\n", reader->nbr_games, nbr_moves);
+                return false;
+            }
+            winner = get_winner(move, &reader->game_state, &reader->rules);
+            ++nbr_moves;
+        }
+        if (reader->error) {
+            return false;
+        }
+        if (reader->winner != winner) {
+            printf("Fiasco: game %lli of the record has result %i, the moves give %i\n", reader->nbr_games,
+                   reader->winner, winner);
+            return false;
+        }
+    }
+    return reader->file == NULL || !ferror(reader->file);
+}
+
+static void write_byte(struct GameRecordWriter *writer, int byte) {
+    ++writer->bytes_written;
+    if (writer->file != NULL) {
+        fputc(byte, writer->file);
+        return;
+    }
+    if (writer->buffer_length == writer->buffer_capacity) {
+        int capacity = writer->buffer_capacity > 0 ? 2 * writer->buffer_capacity : 256;
+        unsigned char *buffer = realloc(writer->buffer, capacity);
+        if (buffer == NULL) {
+            printf("Catastrophe: out of memory for the game record\n");
+            return;
+        }
+        writer->buffer = buffer;
+        writer->buffer_capacity = capacity;
+    }
+    writer->buffer[writer->buffer_length++] = byte;
+}
+
+static void write_varint(struct GameRecordWriter *writer, unsigned int value) {
+    while (value >= 0x80) {
+        write_byte(writer, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    write_byte(writer, value);
+}
+
+// EOF at the end of the file or of the memory
+static int read_byte(struct GameRecordReader *reader) {
+    if (reader->file != NULL) {
+        return getc(reader->file);
+    }
+    return reader->data < reader->data_end ? *reader->data++ : EOF;
+}
+
+static bool read_varint(struct GameRecordReader *reader, unsigned int *value) {
+    *value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        int c = read_byte(reader);
+        if (c == EOF) {
+            return false;
+        }
+        *value |= (unsigned int)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// piece_can_move_this_turn, the board is scanned on every move and most squares are empty
+static bool can_move(int square_index, struct GameState *game_state, struct Rules *rules) {
+    return game_state->board[square_index].piece.piece_color == game_state->whos_turn &&
+           piece_can_move_this_turn(square_index, game_state, rules);
+}
+
+// -1 if the move isn't one of get_moves for a piece that can move this turn
+static int move_index(struct Move move, struct GameState *game_state, struct Rules *rules) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        board_length *= rules->board_shape[dim];
+    }
+    if (move.origin_square < 0 || move.origin_square >= board_length || !can_move(move.origin_square, game_state, rules)) {
+        return -1;
+    }
+    int piece_index = 0, nbr_pieces = 0;
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        if (can_move(square_index, game_state, rules)) {
+            piece_index += square_index < move.origin_square;
+            ++nbr_pieces;
+        }
+    }
+    struct Move piece_moves[MAX_MOVES_SINGLE_PIECE];
+    struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    get_moves(piece_moves, diagonal_pawn_moves, move.origin_square, game_state, rules);
+    for (int i = 0; piece_moves[i].destination_square != -1; ++i) {
+        if (piece_moves[i].destination_square == move.destination_square) {
+            return i * nbr_pieces + piece_index;
+        }
+    }
+    return -1;
+}
+
+static bool nth_move(unsigned int index, struct Move *move, struct GameState *game_state, struct Rules *rules) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        board_length *= rules->board_shape[dim];
+    }
+    // One pass over the board while the pieces fit in squares, a second one to find the piece otherwise
+    int squares[GAME_RECORD_PIECES_PER_SCAN];
+    unsigned int nbr_pieces = 0;
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        if (can_move(square_index, game_state, rules)) {
+            if (nbr_pieces < GAME_RECORD_PIECES_PER_SCAN) {
+                squares[nbr_pieces] = square_index;
+            }
+            ++nbr_pieces;
+        }
+    }
+    if (nbr_pieces == 0) {
+        return false;
+    }
+    unsigned int piece_index = index % nbr_pieces, move_number = index / nbr_pieces;
+    int origin_square = 0;
+    if (piece_index < GAME_RECORD_PIECES_PER_SCAN) {
+        origin_square = squares[piece_index];
+    } else {
+        for (unsigned int pieces_before = 0; ; ++origin_square) {
+            if (can_move(origin_square, game_state, rules) && pieces_before++ == piece_index) {
+                break;
+            }
+        }
+    }
+    struct Move piece_moves[MAX_MOVES_SINGLE_PIECE];
+    struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    get_moves(piece_moves, diagonal_pawn_moves, origin_square, game_state, rules);
+    for (unsigned int i = 0; piece_moves[i].destination_square != -1; ++i) {
+        if (i == move_number) {
+            *move = piece_moves[i];
+            return true;
+        }
+    }
+    return false;
+}
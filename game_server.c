@@ -0,0 +1,622 @@
+#define _POSIX_C_SOURCE 200809L     // clock_gettime, sigaction
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "chess4d.h"
+
+// Many games in one process. One thread runs an epoll loop over all connections, every game owns its Rules and GameState
+// and every move is checked with validate_selected_move (through text_to_move) before it is made. Line based protocol,
+// one game per connection:
+//   new <variant>       -> game <id> white               create a game and wait for an opponent
+//   join <id>           -> game <id> black, start to both
+//   move <move>         -> moved <move> <square>=<piece> .. to both players, the squares the move changed
+//                          winner white|black after the move that ends the game
+//   board               -> board <side to move> <piece per square>
+//   stats               -> stats connections .. games .. moves .. validate_avg_us .. validate_max_us ..
+//   quit
+// Pieces are PRNBKQ for white, lower case for black, . for an empty square and # for a square not on the board. Errors
+// are answered with "error Calamity: ...". Listens on 127.0.0.1:7474 unless -port or -unix says otherwise
+
+#define DEFAULT_PORT 7474
+#define MAX_LINE_LENGTH 256
+#define MAX_EVENTS 256
+#define LISTEN_BACKLOG 4096
+
+struct Game {
+    int id;
+    enum Variant variant;
+    struct Rules rules;
+    struct GameState game_state;
+    int players[PIECE_COLOR_COUNT];     // connection file descriptors, -1 for an empty seat
+    bool over;
+};
+
+struct Connection {
+    int fd;
+    struct Game *game;
+    enum PieceColor piece_color;
+    char input[MAX_LINE_LENGTH];
+    int input_length;
+    char *output;                       // not yet sent, sent as soon as the socket takes it
+    size_t output_length;
+    size_t output_capacity;
+    bool waiting_for_writable;
+};
+
+// Starting position of a variant, loaded from file once and copied into every new game
+struct VariantTemplate {
+    bool loaded;
+    struct Rules rules;
+    struct GameState game_state;
+    int board_length;
+};
+
+struct GameServer {
+    int epoll_fd;
+    int listen_fd;
+    struct Connection **connections;    // indexed by file descriptor
+    int connections_capacity;
+    int nbr_connections;
+    struct Game **games;                // indexed by game id, NULL when the game is gone
+    int games_capacity;
+    int next_game_id;
+    int nbr_games;
+    struct VariantTemplate variant_templates[NBR_OF_VARIANTS];
+    // instrumentation
+    long long moves;
+    double validation_seconds;          // reading, validating and making moves, summed
+    double max_validation_seconds;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static bool open_listen_socket(struct GameServer *server, int port, const char *unix_path);
+static void accept_connections(struct GameServer *server);
+static void read_connection(struct GameServer *server, struct Connection *connection);
+static void handle_line(struct GameServer *server, struct Connection *connection, char *line);
+static void handle_new(struct GameServer *server, struct Connection *connection, char *arguments);
+static void handle_join(struct GameServer *server, struct Connection *connection, char *arguments);
+static void handle_move(struct GameServer *server, struct Connection *connection, char *arguments);
+static void handle_board(struct GameServer *server, struct Connection *connection);
+static void send_line(struct GameServer *server, struct Connection *connection, const char *format, ...);
+static void flush_connection(struct GameServer *server, struct Connection *connection);
+static void close_connection(struct GameServer *server, struct Connection *connection);
+static bool new_game_state(struct GameServer *server, enum Variant variant, struct Rules *rules,
+                           struct GameState *game_state);
+static char piece_letter(struct Square square);
+static bool set_non_blocking(int fd);
+static double seconds_now(void);
+static void handle_signal(int signal_number);
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    const char *unix_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-unix") == 0 && i + 1 < argc) {
+            unix_path = argv[++i];
+        } else if (strcmp(argv[i], "-positions") == 0 && i + 1 < argc) {
+            if (!load_starting_position_cache(argv[++i])) {
+                return 1;
+            }
+        } else {
+            printf("usage: game_server [-port n] [-unix path] [-positions file]\n");
+            return 1;
+        }
+    }
+
+    // One file descriptor per player, ask for as many as allowed
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct GameServer server;
+    memset(&server, 0, sizeof(server));
+    server.epoll_fd = epoll_create1(0);
+    if (server.epoll_fd == -1 || !open_listen_socket(&server, port, unix_path)) {
+        return 1;
+    }
+    if (unix_path != NULL) {
+        printf("listening on %s\n", unix_path);
+    } else {
+        printf("listening on 127.0.0.1:%i\n", port);
+    }
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (running) {
+        int nbr_events = epoll_wait(server.epoll_fd, events, MAX_EVENTS, -1);
+        if (nbr_events == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("Catastrophe: epoll_wait failed\n");
+            break;
+        }
+        for (int i = 0; i < nbr_events; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == server.listen_fd) {
+                accept_connections(&server);
+                continue;
+            }
+            struct Connection *connection = server.connections[fd];
+            if (connection == NULL) {
+                continue;       // closed by an earlier event in this batch
+            }
+            if (events[i].events & EPOLLOUT) {
+                flush_connection(&server, connection);
+            }
+            if (server.connections[fd] != NULL && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                read_connection(&server, connection);
+            }
+        }
+    }
+
+    for (int fd = 0; fd < server.connections_capacity; ++fd) {
+        if (server.connections[fd] != NULL) {
+            close_connection(&server, server.connections[fd]);
+        }
+    }
+    for (int v = 0; v < NBR_OF_VARIANTS; ++v) {
+        if (server.variant_templates[v].loaded) {
+            terminate_game_state(&server.variant_templates[v].game_state);
+        }
+    }
+    free(server.connections);
+    free(server.games);
+    close(server.listen_fd);
+    close(server.epoll_fd);
+    if (unix_path != NULL) {
+        unlink(unix_path);
+    }
+    printf("%lli moves in %i games\n", server.moves, server.next_game_id);
+    return 0;
+}
+
+static bool open_listen_socket(struct GameServer *server, int port, const char *unix_path) {
+    if (unix_path != NULL) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(unix_path) >= sizeof(address.sun_path)) {
+            printf("Catastrophe: socket path too long\n");
+            return false;
+        }
+        strcpy(address.sun_path, unix_path);
+        unlink(unix_path);
+        server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server->listen_fd == -1 || bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+            printf("Catastrophe: can't listen on %s\n", unix_path);
+            return false;
+        }
+    } else {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (server->listen_fd != -1) {
+            setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (server->listen_fd == -1 || bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+            printf("Catastrophe: can't listen on port %i\n", port);
+            return false;
+        }
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = server->listen_fd;
+    if (listen(server->listen_fd, LISTEN_BACKLOG) == -1 || !set_non_blocking(server->listen_fd) ||
+            epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) == -1) {
+        printf("Catastrophe: can't listen\n");
+        return false;
+    }
+    return true;
+}
+
+static void accept_connections(struct GameServer *server) {
+    while (true) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                printf("Havoc: accept failed, %s\n", strerror(errno));
+            }
+            return;
+        }
+        if (fd >= server->connections_capacity) {
+            int capacity = 2 * fd + 64;
+            struct Connection **connections = realloc(server->connections, sizeof(*connections) * capacity);
+            if (connections == NULL) {
+                close(fd);
+                continue;
+            }
+            memset(connections + server->connections_capacity, 0,
+                   sizeof(*connections) * (capacity - server->connections_capacity));
+            server->connections = connections;
+            server->connections_capacity = capacity;
+        }
+        struct Connection *connection = calloc(1, sizeof(*connection));
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (connection == NULL || !set_non_blocking(fd) || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));     // fails harmlessly on unix sockets
+        connection->fd = fd;
+        connection->piece_color = NULL_PIECE_COLOR;
+        server->connections[fd] = connection;
+        ++server->nbr_connections;
+    }
+}
+
+// Reads what is available and handles every complete line
+static void read_connection(struct GameServer *server, struct Connection *connection) {
+    int fd = connection->fd;
+    while (true) {
+        ssize_t nbr_read = read(fd, connection->input + connection->input_length,
+                                MAX_LINE_LENGTH - connection->input_length);
+        if (nbr_read == 0 || (nbr_read == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_connection(server, connection);
+            return;
+        }
+        if (nbr_read == -1) {
+            return;
+        }
+        connection->input_length += nbr_read;
+
+        char *line = connection->input;
+        char *newline;
+        while ((newline = memchr(line, '\n', connection->input_length - (line - connection->input))) != NULL) {
+            *newline = '\0';
+            if (newline > line && newline[-1] == '\r') {
+                newline[-1] = '\0';
+            }
+            handle_line(server, connection, line);
+            if (server->connections[fd] == NULL) {
+                return;     // quit
+            }
+            line = newline + 1;
+        }
+        connection->input_length -= line - connection->input;
+        memmove(connection->input, line, connection->input_length);
+        if (connection->input_length == MAX_LINE_LENGTH) {
+            send_line(server, connection, "error Calamity: line too long");
+            close_connection(server, connection);
+            return;
+        }
+    }
+}
+
+static void handle_line(struct GameServer *server, struct Connection *connection, char *line) {
+    char *arguments = line + strcspn(line, " ");
+    if (*arguments != '\0') {
+        *arguments++ = '\0';
+    }
+    if (strcmp(line, "move") == 0) {
+        handle_move(server, connection, arguments);
+    } else if (strcmp(line, "new") == 0) {
+        handle_new(server, connection, arguments);
+    } else if (strcmp(line, "join") == 0) {
+        handle_join(server, connection, arguments);
+    } else if (strcmp(line, "board") == 0) {
+        handle_board(server, connection);
+    } else if (strcmp(line, "stats") == 0) {
+        send_line(server, connection, "stats connections %i games %i moves %lli validate_avg_us %.2f validate_max_us %.2f",
+                  server->nbr_connections, server->nbr_games, server->moves,
+                  server->moves > 0 ? 1e6 * server->validation_seconds / server->moves : 0.0,
+                  1e6 * server->max_validation_seconds);
+    } else if (strcmp(line, "quit") == 0) {
+        flush_connection(server, connection);
+        close_connection(server, connection);
+    } else if (line[0] != '\0') {
+        send_line(server, connection, "error Calamity: unknown command %s", line);
+    }
+}
+
+static void handle_new(struct GameServer *server, struct Connection *connection, char *arguments) {
+    enum Variant variant;
+    if (connection->game != NULL) {
+        send_line(server, connection, "error Calamity: already in game %i", connection->game->id);
+        return;
+    }
+    if (!variant_from_name(arguments, &variant)) {
+        send_line(server, connection, "error Calamity: no variant %s", arguments);
+        return;
+    }
+    int id = server->next_game_id;     // ids are never reused, the table only grows
+    if (id >= server->games_capacity) {
+        int capacity = 2 * server->games_capacity + 64;
+        struct Game **games = realloc(server->games, sizeof(*games) * capacity);
+        if (games == NULL) {
+            send_line(server, connection, "error Calamity: out of memory");
+            return;
+        }
+        memset(games + server->games_capacity, 0, sizeof(*games) * (capacity - server->games_capacity));
+        server->games = games;
+        server->games_capacity = capacity;
+    }
+    struct Game *game = malloc(sizeof(*game));
+    if (game == NULL || !new_game_state(server, variant, &game->rules, &game->game_state)) {
+        free(game);
+        send_line(server, connection, "error Calamity: can't start %s", arguments);
+        return;
+    }
+    game->id = id;
+    game->variant = variant;
+    game->players[PIECE_COLOR_WHITE] = connection->fd;
+    game->players[PIECE_COLOR_BLACK] = -1;
+    game->over = false;
+    server->games[id] = game;
+    ++server->next_game_id;
+    ++server->nbr_games;
+    connection->game = game;
+    connection->piece_color = PIECE_COLOR_WHITE;
+    send_line(server, connection, "game %i white", id);
+}
+
+static void handle_join(struct GameServer *server, struct Connection *connection, char *arguments) {
+    char *end;
+    long id = strtol(arguments, &end, 10);
+    if (connection->game != NULL) {
+        send_line(server, connection, "error Calamity: already in game %i", connection->game->id);
+        return;
+    }
+    if (end == arguments || id < 0 || id >= server->games_capacity || server->games[id] == NULL ||
+            server->games[id]->players[PIECE_COLOR_BLACK] != -1) {
+        send_line(server, connection, "error Calamity: no open game %s", arguments);
+        return;
+    }
+    struct Game *game = server->games[id];
+    game->players[PIECE_COLOR_BLACK] = connection->fd;
+    connection->game = game;
+    connection->piece_color = PIECE_COLOR_BLACK;
+    send_line(server, connection, "game %li black", id);
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        send_line(server, server->connections[game->players[piece_color]], "start %s", variant_name(game->variant));
+    }
+}
+
+// Validates and makes the move, then sends both players the squares it changed
+static void handle_move(struct GameServer *server, struct Connection *connection, char *arguments) {
+    struct Game *game = connection->game;
+    if (game == NULL || game->players[PIECE_COLOR_WHITE] == -1 || game->players[PIECE_COLOR_BLACK] == -1) {
+        send_line(server, connection, "error Calamity: no opponent");
+        return;
+    }
+    if (game->over || game->game_state.whos_turn != connection->piece_color) {
+        send_line(server, connection, "error Calamity: not your turn");
+        return;
+    }
+
+    double start_time = seconds_now();
+    struct Move move;
+    enum PieceType promotion_piece_type;
+    if (!text_to_move(arguments, &move, &promotion_piece_type, &game->game_state, &game->rules)) {
+        send_line(server, connection, "error Calamity: illegal move %s", arguments);
+        return;
+    }
+    static struct MoveUndo undo;    // only used to find the changed squares, one move at a time
+    make_move_with_undo(move, promotion_piece_type, &game->game_state, &game->rules, &undo);
+    enum PieceColor winner = get_winner(move, &game->game_state, &game->rules);
+    double seconds = seconds_now() - start_time;
+    ++server->moves;
+    server->validation_seconds += seconds;
+    if (seconds > server->max_validation_seconds) {
+        server->max_validation_seconds = seconds;
+    }
+
+    // moved <move> <square>=<piece> .., every changed square once
+    char delta[MAX_MOVE_TEXT_LENGTH + MAX_SQUARES_CHANGED_BY_MOVE * (MAX_SQUARE_TEXT_LENGTH + 3) + 1];
+    move_to_text(move, promotion_piece_type, delta, &game->rules);
+    size_t length = strlen(delta);
+    for (int i = 0; i < undo.nbr_square_changes; ++i) {
+        int square_index = undo.square_changes[i].square_index;
+        bool seen = false;
+        for (int j = 0; j < i && !seen; ++j) {
+            seen = undo.square_changes[j].square_index == square_index;
+        }
+        if (seen) {
+            continue;
+        }
+        delta[length++] = ' ';
+        square_to_text(square_index, delta + length, &game->rules);
+        length += strlen(delta + length);
+        delta[length++] = '=';
+        delta[length++] = piece_letter(game->game_state.board[square_index]);
+        delta[length] = '\0';
+    }
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        struct Connection *player = server->connections[game->players[piece_color]];
+        send_line(server, player, "moved %s", delta);
+        if (winner != NULL_PIECE_COLOR) {
+            send_line(server, player, "winner %s", winner == PIECE_COLOR_WHITE ? "white" : "black");
+        }
+    }
+    game->over = winner != NULL_PIECE_COLOR;
+}
+
+static void handle_board(struct GameServer *server, struct Connection *connection) {
+    struct Game *game = connection->game;
+    if (game == NULL) {
+        send_line(server, connection, "error Calamity: not in a game");
+        return;
+    }
+    int board_length = server->variant_templates[game->variant].board_length;
+    char *pieces = malloc(board_length + 1);
+    if (pieces == NULL) {
+        send_line(server, connection, "error Calamity: out of memory");
+        return;
+    }
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        pieces[square_index] = piece_letter(game->game_state.board[square_index]);
+    }
+    pieces[board_length] = '\0';
+    send_line(server, connection, "board %s %s", game->game_state.whos_turn == PIECE_COLOR_WHITE ? "white" : "black",
+              pieces);
+    free(pieces);
+}
+
+// Queues a line and sends what the socket takes right away
+static void send_line(struct GameServer *server, struct Connection *connection, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(NULL, 0, format, arguments);
+    va_end(arguments);
+    if (connection->output_length + length + 2 > connection->output_capacity) {
+        size_t capacity = 2 * connection->output_capacity + length + 2;
+        char *output = realloc(connection->output, capacity);
+        if (output == NULL) {
+            return;
+        }
+        connection->output = output;
+        connection->output_capacity = capacity;
+    }
+    va_start(arguments, format);
+    vsnprintf(connection->output + connection->output_length, length + 1, format, arguments);
+    va_end(arguments);
+    connection->output_length += length;
+    connection->output[connection->output_length++] = '\n';
+    flush_connection(server, connection);
+}
+
+// Writes queued output. Waits for the socket to become writable if it doesn't take everything
+static void flush_connection(struct GameServer *server, struct Connection *connection) {
+    size_t sent = 0;
+    while (sent < connection->output_length) {
+        ssize_t nbr_written = send(connection->fd, connection->output + sent, connection->output_length - sent,
+                                   MSG_NOSIGNAL);
+        if (nbr_written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;      // full, or gone, which the next read notices
+        }
+        sent += nbr_written;
+    }
+    connection->output_length -= sent;
+    memmove(connection->output, connection->output + sent, connection->output_length);
+
+    bool wait_for_writable = connection->output_length > 0;
+    if (wait_for_writable != connection->waiting_for_writable) {
+        struct epoll_event event;
+        event.events = wait_for_writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = connection->fd;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->waiting_for_writable = wait_for_writable;
+    }
+}
+
+// The opponent is told, the game is freed when its last player is gone
+static void close_connection(struct GameServer *server, struct Connection *connection) {
+    struct Game *game = connection->game;
+    if (game != NULL) {
+        game->players[connection->piece_color] = -1;
+        int opponent_fd = game->players[1 - connection->piece_color];
+        if (opponent_fd != -1) {
+            send_line(server, server->connections[opponent_fd], "opponent left");
+        } else {
+            server->games[game->id] = NULL;
+            terminate_game_state(&game->game_state);
+            free(game);
+            --server->nbr_games;
+        }
+    }
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    server->connections[connection->fd] = NULL;
+    --server->nbr_connections;
+    free(connection->output);
+    free(connection);
+}
+
+// Copies the starting position of variant. Random starting positions are set up from scratch every time
+static bool new_game_state(struct GameServer *server, enum Variant variant, struct Rules *rules,
+                           struct GameState *game_state) {
+    if (variant == RANDOM_STARTING_POSITION_CHESS || variant == RANDOM_SYMETRICAL_STARTING_POSITION_CHESS) {
+        if (!initialize_rules_and_game_state(rules, game_state, variant)) {
+            return false;
+        }
+        server->variant_templates[variant].board_length = 1;
+        for (int dim = 0; dim < rules->dimensions; ++dim) {
+            server->variant_templates[variant].board_length *= rules->board_shape[dim];
+        }
+        return true;
+    }
+    struct VariantTemplate *variant_template = &server->variant_templates[variant];
+    if (!variant_template->loaded) {
+        if (!start_game(&variant_template->rules, &variant_template->game_state, variant)) {
+            return false;
+        }
+        variant_template->board_length = 1;
+        for (int dim = 0; dim < variant_template->rules.dimensions; ++dim) {
+            variant_template->board_length *= variant_template->rules.board_shape[dim];
+        }
+        variant_template->loaded = true;
+    }
+    *rules = variant_template->rules;
+    *game_state = variant_template->game_state;
+    game_state->board = malloc(sizeof(*game_state->board) * variant_template->board_length);
+    if (game_state->board == NULL) {
+        return false;
+    }
+    memcpy(game_state->board, variant_template->game_state.board, sizeof(*game_state->board) * variant_template->board_length);
+    return true;
+}
+
+static char piece_letter(struct Square square) {
+    static const char white_letters[NBR_OF_PIECE_TYPES] = {
+        [NULL_PIECE_TYPE] = '.', [PAWN] = 'P', [ROOK] = 'R', [KNIGHT] = 'N', [BISHOP] = 'B', [KING] = 'K', [QUEEN] = 'Q',
+    };
+    if (!square.part_of_board) {
+        return '#';
+    }
+    char letter = white_letters[square.piece.piece_type];
+    if (square.piece.piece_type != NULL_PIECE_TYPE && square.piece.piece_color == PIECE_COLOR_BLACK) {
+        letter += 'a' - 'A';
+    }
+    return letter;
+}
+
+static bool set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+static void handle_signal(int signal_number) {
+    (void)signal_number;
+    running = 0;
+}
@@ -0,0 +1,341 @@
+#define _POSIX_C_SOURCE 200809L     // sysconf, clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "chess4d.h"
+
+// Builds, indexes and queries a game database, see game_database.c. Whatever is asked for is done in this order:
+//   -generate n     appends n random games of -variant, at most -length moves each
+//   -import file    appends the games of a game record file, e.g. from selfplay -record
+//   -index          builds the position index on -threads threads, in -memory megabytes and on disk beyond that
+//   -query n        looks up n positions from random games of the database and n positions that are in no game
+//   -find "moves"   games that reached the position after the moves, from the starting position of -variant
+// e.g.
+//   ./gamedb -db games.c4db -generate 100000 -index -query 10000
+
+#define MAX_FOUND_GAMES_PRINTED 10
+
+struct Options {
+    const char *path;
+    long long nbr_generate;
+    const char *import_path;
+    bool index;
+    int  nbr_queries;
+    const char *find_moves;
+    enum Variant variant;
+    int  max_game_length;
+    long nbr_threads;
+    long long memory_megabytes;
+    unsigned long long random_seed;
+};
+
+static bool generate_games(struct Options *options);
+static bool import_games(struct Options *options);
+static bool query_positions(struct Options *options);
+static bool find_position(struct Options *options);
+static int  compare_doubles(const void *a, const void *b);
+static double seconds_now(void);
+
+static void print_usage(void) {
+    printf("usage: gamedb -db file [-generate n] [-import file] [-index] [-query n] [-find \"moves\"] [-variant name]\n"
+           "              [-length n] [-threads n] [-memory megabytes] [-seed n]\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct Options options = {.path = NULL, .nbr_generate = 0, .import_path = NULL, .index = false, .nbr_queries = 0,
+                              .find_moves = NULL, .variant = STANDARD_CHESS, .max_game_length = 100,
+                              .nbr_threads = sysconf(_SC_NPROCESSORS_ONLN), .memory_megabytes = 1024,
+                              .random_seed = 1};
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-index") == 0) {
+            options.index = true;
+        } else if (strcmp(argv[i], "-db") == 0 && has_value) {
+            options.path = argv[++i];
+        } else if (strcmp(argv[i], "-generate") == 0 && has_value) {
+            options.nbr_generate = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-import") == 0 && has_value) {
+            options.import_path = argv[++i];
+        } else if (strcmp(argv[i], "-query") == 0 && has_value) {
+            options.nbr_queries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-find") == 0 && has_value) {
+            options.find_moves = argv[++i];
+        } else if (strcmp(argv[i], "-variant") == 0 && has_value) {
+            if (!variant_from_name(argv[++i], &options.variant)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-length") == 0 && has_value) {
+            options.max_game_length = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-threads") == 0 && has_value) {
+            options.nbr_threads = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-memory") == 0 && has_value) {
+            options.memory_megabytes = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && has_value) {
+            options.random_seed = strtoull(argv[++i], NULL, 10) | 1;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (options.path == NULL) {
+        print_usage();
+        return 1;
+    }
+
+    if (options.nbr_generate > 0 && !generate_games(&options)) {
+        return 1;
+    }
+    if (options.import_path != NULL && !import_games(&options)) {
+        return 1;
+    }
+    if (options.index) {
+        long long nbr_entries;
+        double start_time = seconds_now();
+        if (!build_game_database_index(options.path, options.nbr_threads, options.memory_megabytes << 20, &nbr_entries)) {
+            return 1;
+        }
+        double seconds = seconds_now() - start_time;
+        printf("index: %lli positions on %li threads in %.2f s, %.0f positions/s, %.1f MB\n", nbr_entries,
+               options.nbr_threads, seconds, nbr_entries / seconds, nbr_entries * sizeof(struct GameDatabaseEntry) / 1e6);
+    }
+    if (options.nbr_queries > 0 && !query_positions(&options)) {
+        return 1;
+    }
+    if (options.find_moves != NULL && !find_position(&options)) {
+        return 1;
+    }
+    return 0;
+}
+
+// Random games, ended at a win like in play_game. Both sides promote to queen
+static bool generate_games(struct Options *options) {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    FILE *file = open_game_database_for_append(options->path);
+    if (file == NULL) {
+        return false;
+    }
+    struct GameRecordWriter writer;
+    initialize_game_record_writer(&writer, NULL);
+    unsigned long long random_state = options->random_seed;
+    double start_time = seconds_now();
+    for (long long game = 0; game < options->nbr_generate; ++game) {
+        if (!begin_game_record(&writer, options->variant)) {
+            fclose(file);
+            return false;
+        }
+        enum PieceColor winner = NULL_PIECE_COLOR;
+        for (int move_number = 0; move_number < options->max_game_length && winner == NULL_PIECE_COLOR; ++move_number) {
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &writer.game_state, &writer.rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+            write_game_record_move(&writer, move, QUEEN);
+            winner = get_winner(move, &writer.game_state, &writer.rules);
+        }
+        end_game_record(&writer, winner);
+        if (!append_game_to_database(file, &writer)) {
+            printf("Tragedy: can't append to %s\n", options->path);
+            fclose(file);
+            return false;
+        }
+    }
+    double seconds = seconds_now() - start_time;
+    printf("generated %lli games, %lli moves in %.2f s, %.2f bytes/move\n", options->nbr_generate, writer.nbr_moves, seconds,
+           (double)writer.bytes_written / writer.nbr_moves);
+    terminate_game_record_writer(&writer);
+    return fclose(file) == 0;
+}
+
+// The games are replayed and written again, so only games that replay end up in the database
+static bool import_games(struct Options *options) {
+    FILE *record_file = fopen(options->import_path, "rb");
+    if (record_file == NULL) {
+        printf("Tragedy: can't read %s\n", options->import_path);
+        return false;
+    }
+    FILE *file = open_game_database_for_append(options->path);
+    struct GameRecordReader reader;
+    if (file == NULL || !initialize_game_record_reader(&reader, record_file)) {
+        fclose(record_file);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+    struct GameRecordWriter writer;
+    initialize_game_record_writer(&writer, NULL);
+    bool ok = true;
+    while (ok && next_game_record(&reader)) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        ok = begin_game_record(&writer, reader.variant);
+        while (ok && read_game_record_move(&reader, &move, &promotion_piece_type)) {
+            ok = write_game_record_move(&writer, move, promotion_piece_type);
+        }
+        ok = ok && !reader.error;
+        end_game_record(&writer, reader.winner);
+        ok = ok && append_game_to_database(file, &writer);
+    }
+    printf("imported %lli games, %lli moves\n", reader.nbr_games, reader.nbr_moves);
+    terminate_game_record_reader(&reader);
+    terminate_game_record_writer(&writer);
+    fclose(record_file);
+    return fclose(file) == 0 && ok;
+}
+
+// Positions of random games of the database, replayed from the mapping. Every lookup has to find the game it came from.
+// Only the lookups are timed
+static bool query_positions(struct Options *options) {
+    struct GameDatabase database;
+    if (!open_game_database(&database, options->path)) {
+        return false;
+    }
+    if (database.nbr_entries == 0) {
+        printf("Fiasco: %s has no index, build it with -index\n", options->path);
+        close_game_database(&database);
+        return false;
+    }
+
+    // Zero-copy iteration over the games
+    long long nbr_games = 0, capacity = 1024;
+    long long *game_offsets = malloc(sizeof(*game_offsets) * capacity);
+    const unsigned char *game;
+    size_t length;
+    long long next_offset;
+    double start_time = seconds_now();
+    for (long long offset = GAME_DATABASE_FIRST_GAME; offset < database.indexed_length &&
+            database_game(&database, offset, &game, &length, &next_offset); offset = next_offset) {
+        if (nbr_games == capacity) {
+            capacity *= 2;
+            game_offsets = realloc(game_offsets, sizeof(*game_offsets) * capacity);
+        }
+        if (game_offsets == NULL) {
+            printf("Catastrophe: out of memory\n");
+            close_game_database(&database);
+            return false;
+        }
+        game_offsets[nbr_games++] = offset;
+    }
+    printf("%lli games, %.1f MB, iterated in %.3f s\n", nbr_games, database.length / 1e6, seconds_now() - start_time);
+
+    double *latencies = malloc(sizeof(*latencies) * options->nbr_queries);
+    double *miss_latencies = malloc(sizeof(*miss_latencies) * options->nbr_queries);
+    if (nbr_games == 0 || latencies == NULL || miss_latencies == NULL) {
+        free(game_offsets);
+        free(latencies);
+        free(miss_latencies);
+        close_game_database(&database);
+        return nbr_games == 0;
+    }
+    struct GameRecordReader reader;
+    initialize_game_record_reader_from_memory(&reader, NULL, 0);
+    unsigned long long random_state = options->random_seed;
+    long long total_hits = 0;
+    bool all_found = true;
+    for (int query = 0; query < options->nbr_queries; ++query) {
+        long long offset = game_offsets[next_random(&random_state) % (unsigned long long)nbr_games];
+        database_game(&database, offset, &game, &length, &next_offset);
+        set_game_record_reader_memory(&reader, game, length);
+        if (!next_game_record(&reader)) {
+            all_found = false;
+            break;
+        }
+        unsigned long long hash = position_hash(&reader.game_state, &reader.rules, reader.variant);
+        int ply = 0, last_ply = next_random(&random_state) % 101;
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        while (ply < last_ply && read_game_record_move(&reader, &move, &promotion_piece_type)) {
+            hash = update_position_hash(hash, &reader.undo, &reader.game_state);
+            ++ply;
+        }
+
+        const struct GameDatabaseEntry *entries;
+        double query_start_time = seconds_now();
+        long long nbr_hits = find_database_position(&database, hash, &entries);
+        latencies[query] = seconds_now() - query_start_time;
+        total_hits += nbr_hits;
+        bool found = false;
+        for (long long i = 0; i < nbr_hits && !found; ++i) {
+            found = entries[i].location == ((unsigned long long)offset << GAME_DATABASE_PLY_BITS | ply);
+        }
+        all_found = all_found && found;
+
+        unsigned long long missing_hash = next_random(&random_state);
+        query_start_time = seconds_now();
+        find_database_position(&database, missing_hash, &entries);
+        miss_latencies[query] = seconds_now() - query_start_time;
+    }
+    terminate_game_record_reader(&reader);
+
+    qsort(latencies, options->nbr_queries, sizeof(*latencies), compare_doubles);
+    qsort(miss_latencies, options->nbr_queries, sizeof(*miss_latencies), compare_doubles);
+    int n = options->nbr_queries;
+    printf("%i lookups over %lli positions: p50 %.2f us, p99 %.2f us, max %.2f us, %.1f games per position\n", n,
+           database.nbr_entries, 1e6 * latencies[n / 2], 1e6 * latencies[n * 99 / 100], 1e6 * latencies[n - 1],
+           (double)total_hits / n);
+    printf("%i lookups of positions in no game: p50 %.2f us, p99 %.2f us\n", n, 1e6 * miss_latencies[n / 2],
+           1e6 * miss_latencies[n * 99 / 100]);
+    if (!all_found) {
+        printf("bug, a position wasn't found in the game it came from\n");
+    }
+    free(game_offsets);
+    free(latencies);
+    free(miss_latencies);
+    close_game_database(&database);
+    return all_found;
+}
+
+static bool find_position(struct Options *options) {
+    struct GameDatabase database;
+    struct Rules rules;
+    struct GameState game_state;
+    static struct MoveUndo undo;
+    if (!open_game_database(&database, options->path)) {
+        return false;
+    }
+    if (!initialize_rules_and_game_state(&rules, &game_state, options->variant)) {
+        close_game_database(&database);
+        return false;
+    }
+    unsigned long long hash = position_hash(&game_state, &rules, options->variant);
+    char *moves = strdup(options->find_moves);
+    bool ok = moves != NULL;
+    for (char *token = ok ? strtok(moves, " ") : NULL; token != NULL && ok; token = strtok(NULL, " ")) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        ok = text_to_move(token, &move, &promotion_piece_type, &game_state, &rules);
+        if (!ok) {
+            printf("Calamity: illegal move %s\n", token);
+            break;
+        }
+        make_move_with_undo(move, promotion_piece_type, &game_state, &rules, &undo);
+        hash = update_position_hash(hash, &undo, &game_state);
+    }
+    if (ok) {
+        const struct GameDatabaseEntry *entries;
+        long long nbr_hits = find_database_position(&database, hash, &entries);
+        printf("%lli games reached the position\n", nbr_hits);
+        for (long long i = 0; i < nbr_hits && i < MAX_FOUND_GAMES_PRINTED; ++i) {
+            printf("game at %llu, ply %llu\n", entries[i].location >> GAME_DATABASE_PLY_BITS,
+                   entries[i].location & GAME_DATABASE_MAX_PLY);
+        }
+    }
+    free(moves);
+    terminate_game_state(&game_state);
+    close_game_database(&database);
+    return ok;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double difference = *(const double *)a - *(const double *)b;
+    return (difference > 0) - (difference < 0);
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
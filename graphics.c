@@ -1,117 +1,537 @@
 #include <stdbool.h>
+#include <string.h>
+#include <math.h>
 #include "SDL.h"
 #include <SDL_image.h>
 #include "graphics.h"
 #include "chess.h"
 
-int get_square_index_at_coordinates(int x, int y, struct GraphicsSquare *graphics_board, int graphics_board_length, int square_width) {
-    for (int i = 0; i < graphics_board_length; ++i) {
-        if ((x >= graphics_board[i].x) && (y >= graphics_board[i].y) && (x < graphics_board[i].x + square_width) && (y < graphics_board[i].y + square_width)) {
-            return i;
-        }
+// Square at the pixel of the window, -1 if there is none. Two table lookups
+int get_square_index_at_coordinates(struct GraphicsContext *graphics_context, int window_x, int window_y) {
+    int x = (int)((window_x - graphics_context->pan_x) / graphics_context->zoom);
+    int y = (int)((window_y - graphics_context->pan_y) / graphics_context->zoom);
+    if (    window_x < 0 || window_y < 0 || window_x >= graphics_context->window_width ||
+            window_y >= graphics_context->window_height) {
+        return -1;
+    }
+    int column_part = graphics_context->square_index_part_at_x[x];
+    int row_part = graphics_context->square_index_part_at_y[y];
+    if (column_part == -1 || row_part == -1) {
+        return -1;
     }
-    return -1;
+    return column_part + row_part;
 }
 
+static const enum Texture white_piece_textures[QUEEN + 1] = {
+    [PAWN] = TEXTURE_WHITE_PAWN, [ROOK] = TEXTURE_WHITE_ROOK, [KNIGHT] = TEXTURE_WHITE_KNIGHT,
+    [BISHOP] = TEXTURE_WHITE_BISHOP, [KING] = TEXTURE_WHITE_KING, [QUEEN] = TEXTURE_WHITE_QUEEN,
+};
+static const enum Texture black_piece_textures[QUEEN + 1] = {
+    [PAWN] = TEXTURE_BLACK_PAWN, [ROOK] = TEXTURE_BLACK_ROOK, [KNIGHT] = TEXTURE_BLACK_KNIGHT,
+    [BISHOP] = TEXTURE_BLACK_BISHOP, [KING] = TEXTURE_BLACK_KING, [QUEEN] = TEXTURE_BLACK_QUEEN,
+};
+
+static const SDL_Color highlight_colors[] = {
+    [HIGHLIGHT_HOVERED]            = {170, 190, 200, 0xFF},     // grey blue
+    [HIGHLIGHT_SELECTED]           = {50, 205, 205, 0xFF},      // turquoise
+    [HIGHLIGHT_DIAGONAL_PAWN_MOVE] = {130, 160, 222, 0xFF},     // lighter blue
+    [HIGHLIGHT_MOVE]               = {50, 100, 205, 0xFF},      // blue
+};
+static const SDL_Color light_squares_color = {LIGHT_SQUARES_RGB, 0xFF};
+static const SDL_Color dark_squares_color = {DARK_SQUARES_RGB, 0xFF};
+static const SDL_Color background_color = {BACKGROUND_RGB, 0xFF};
+static const SDL_Color no_tint = {0xFF, 0xFF, 0xFF, 0xFF};
+static const SDL_Color white_dot_color = {0xFF, 0xFF, 0xFF, 0xFF};
+static const SDL_Color black_dot_color = {0, 0, 0, 0xFF};
+static const SDL_Color analysis_white_color = {0xF0, 0xF0, 0xF0, 0xFF};
+static const SDL_Color analysis_black_color = {0x20, 0x20, 0x20, 0xFF};
+static const SDL_Color analysis_arrow_color = {0xF0, 0x8C, 0x00, 0xB4};
+static const SDL_Color threat_white_color = {0x28, 0x6E, 0xFF, 0xB4};    // alpha with THREAT_MAX_ATTACKERS attackers
+static const SDL_Color threat_black_color = {0xEB, 0x28, 0x1E, 0xB4};
+#ifdef PERFORMANCE_HUD
+#define HUD_PIXEL 2                     // window pixels per font pixel
+#define HUD_MARGIN 8
+#define HUD_BAR_WIDTH 4
+#define HUD_HISTOGRAM_HEIGHT 48
+static const SDL_Color hud_panel_color = {0, 0, 0, 0xB4};
+static const SDL_Color hud_text_color = {0xFF, 0xFF, 0xFF, 0xFF};
+static const SDL_Color hud_bar_color = {0x50, 0xD2, 0x50, 0xFF};
+
+// 3x5 pixel glyphs, one row per byte with the leftmost pixel in bit 2
+struct HudGlyph {
+    char character;
+    unsigned char rows[5];
+};
+static const struct HudGlyph hud_glyphs[] = {
+    {'0', {7, 5, 5, 5, 7}}, {'1', {2, 6, 2, 2, 7}}, {'2', {7, 1, 7, 4, 7}}, {'3', {7, 1, 7, 1, 7}},
+    {'4', {5, 5, 7, 1, 1}}, {'5', {7, 4, 7, 1, 7}}, {'6', {7, 4, 7, 5, 7}}, {'7', {7, 1, 1, 1, 1}},
+    {'8', {7, 5, 7, 5, 7}}, {'9', {7, 5, 7, 1, 7}}, {'.', {0, 0, 0, 0, 2}}, {'F', {7, 4, 6, 4, 4}},
+    {'D', {6, 5, 5, 5, 6}}, {'M', {5, 7, 7, 5, 5}}, {'W', {5, 5, 7, 7, 5}}, {'C', {7, 4, 4, 4, 7}},
+};
+
+static void draw_hud(struct GraphicsContext *graphics_context);
+static void add_hud_rect(struct PerformanceHud *hud, float x, float y, float width, float height, SDL_Color color);
+static void add_hud_text(struct PerformanceHud *hud, float x, float y, const char *text);
+#endif
+
+static void highlight_square(struct GraphicsContext *graphics_context, int square_index, enum Highlight highlight);
+static void add_square(struct GraphicsContext *graphics_context, struct GameState *game_state, int square_index,
+                       bool with_background);
+static void add_piece(struct GraphicsContext *graphics_context, struct GeometryBatch *batch, SDL_FRect rect,
+                      struct Piece piece);
+static void add_quad(struct GeometryBatch *batch, SDL_FRect rect, SDL_Color color, SDL_FRect texture_rect);
+static SDL_Color threat_color(int white_attackers, int black_attackers);
+static void draw_analysis(struct GraphicsContext *graphics_context);
+static void add_polygon(SDL_Vertex vertices[], int *nbr_vertices, int indices[], int *nbr_indices, SDL_FPoint points[],
+                        int nbr_points, SDL_Color color);
+static int  visible_square_index_parts(int *square_index_part_at, float pan, int window_length, float zoom, int parts[]);
+static void draw_batch(struct GraphicsContext *graphics_context, struct GeometryBatch *batch, SDL_Texture *texture);
+static bool draw_background(struct GraphicsContext *graphics_context);
+
+// The square is drawn again on the next draw_board, e.g. after a move changed it
+void mark_square_dirty(struct GraphicsContext *graphics_context, int square_index) {
+    if (!graphics_context->dirty_squares[square_index]) {
+        graphics_context->dirty_squares[square_index] = true;
+        graphics_context->dirty_square_list[graphics_context->nbr_dirty_squares++] = square_index;
+    }
+}
+
+// Everything is drawn again on the next draw_board, e.g. after the window lost its textures
+void mark_board_dirty(struct GraphicsContext *graphics_context) {
+    graphics_context->frame_dirty = true;
+    graphics_context->background_dirty = true;
+}
+
+// Draws the squares that changed since the last call into the frame and shows it. Squares that change because of a
+// move have to be marked dirty by the caller, the highlights are compared to the last call here.
+// Squares are copied from the background texture, highlights and pieces go in one SDL_RenderGeometry call each
 bool draw_board(struct GraphicsContext *graphics_context, struct GameState *game_state, int selected_square, struct Move moves[], 
                 struct Move diagonal_pawn_moves[]) {
     SDL_Renderer *renderer = graphics_context->renderer;
+    graphics_context->draw_calls = 0;
+    if (graphics_context->background_dirty && !draw_background(graphics_context)) {
+        return false;
+    }
 
-    SDL_SetRenderDrawColor(graphics_context->renderer, 33, 37, 41, 0xFF);    // background color
-    SDL_RenderClear(graphics_context->renderer);    // fills the screen with color set by SDL_SetRenderDrawColor
+    // New highlights in next_highlights, in the order the later ones win
+    int nbr_old_highlighted_squares = graphics_context->nbr_highlighted_squares;
+    if (graphics_context->hovered_square != -1) {
+        highlight_square(graphics_context, graphics_context->hovered_square, HIGHLIGHT_HOVERED);
+    }
+    if (selected_square != -1) {
+        highlight_square(graphics_context, selected_square, HIGHLIGHT_SELECTED);
+    }
+    for (int i = 0; diagonal_pawn_moves[i].destination_square != -1; ++i) {
+        highlight_square(graphics_context, diagonal_pawn_moves[i].destination_square, HIGHLIGHT_DIAGONAL_PAWN_MOVE);
+    }
+    for (int i = 0; moves[i].destination_square != -1; ++i) {
+        highlight_square(graphics_context, moves[i].destination_square, HIGHLIGHT_MOVE);
+    }
+    // highlighted_squares has the old squares first and the new ones after them, a square can be in both
+    int nbr_highlighted_squares = 0;
+    for (int i = 0; i < graphics_context->nbr_highlighted_squares; ++i) {
+        int square_index = graphics_context->highlighted_squares[i];
+        enum Highlight highlight = graphics_context->next_highlights[square_index];
+        if (graphics_context->highlights[square_index] != highlight) {
+            graphics_context->highlights[square_index] = highlight;
+            mark_square_dirty(graphics_context, square_index);
+        }
+        if (i >= nbr_old_highlighted_squares && highlight != HIGHLIGHT_NONE) {
+            graphics_context->next_highlights[square_index] = HIGHLIGHT_NONE;
+            graphics_context->highlighted_squares[nbr_highlighted_squares++] = square_index;
+        }
+    }
+    graphics_context->nbr_highlighted_squares = nbr_highlighted_squares;
 
-    // draw the board
-    for (int square_index = 0; square_index < graphics_context->graphics_board_length; ++square_index) {
-        bool light_squares = graphics_context->graphics_board[square_index].light_squares;
-        if (light_squares) {
-            SDL_SetRenderDrawColor(graphics_context->renderer, 237, 214, 176, 0xFF);    // light squares color
-        } else {
-            SDL_SetRenderDrawColor(graphics_context->renderer, 184, 134, 98, 0xFF);     // standard dark squares color
+    graphics_context->background_batch.nbr_quads = 0;
+    graphics_context->highlight_batch.nbr_quads = 0;
+    graphics_context->threat_batch.nbr_quads = 0;
+    graphics_context->piece_batch.nbr_quads = 0;
+    SDL_SetRenderTarget(renderer, graphics_context->frame);
+    if (graphics_context->frame_dirty) {
+        // The background scaled by the camera, then only the squares in view
+        SDL_FRect background_rect = {graphics_context->pan_x, graphics_context->pan_y,
+                                     graphics_context->zoom * graphics_context->window_width,
+                                     graphics_context->zoom * graphics_context->window_height};
+        SDL_RenderCopyF(renderer, graphics_context->background, NULL, &background_rect);
+        ++graphics_context->draw_calls;
+        int nbr_columns = visible_square_index_parts(graphics_context->square_index_part_at_x, graphics_context->pan_x,
+                                                     graphics_context->window_width, graphics_context->zoom,
+                                                     graphics_context->visible_column_parts);
+        int nbr_rows = visible_square_index_parts(graphics_context->square_index_part_at_y, graphics_context->pan_y,
+                                                  graphics_context->window_height, graphics_context->zoom,
+                                                  graphics_context->visible_row_parts);
+        for (int row = 0; row < nbr_rows; ++row) {
+            for (int column = 0; column < nbr_columns; ++column) {
+                int square_index = graphics_context->visible_row_parts[row] + graphics_context->visible_column_parts[column];
+                add_square(graphics_context, game_state, square_index, false);
+            }
         }
-        SDL_Rect rect = {graphics_context->graphics_board[square_index].x, graphics_context->graphics_board[square_index].y, 
-                         graphics_context->square_width, graphics_context->square_width};
-        SDL_RenderFillRect(renderer, &rect);
+    } else {
+        for (int i = 0; i < graphics_context->nbr_dirty_squares; ++i) {
+            add_square(graphics_context, game_state, graphics_context->dirty_square_list[i], true);
+        }
+    }
+    // Below GRAPHICS_LOD_SQUARE_WIDTH pieces are dots of their color instead of images
+    bool piece_images = graphics_context->zoom * graphics_context->square_width >= GRAPHICS_LOD_SQUARE_WIDTH;
+    draw_batch(graphics_context, &graphics_context->background_batch, graphics_context->background);
+    draw_batch(graphics_context, &graphics_context->highlight_batch, NULL);
+    draw_batch(graphics_context, &graphics_context->threat_batch, NULL);
+    draw_batch(graphics_context, &graphics_context->piece_batch, piece_images ? graphics_context->atlas : NULL);
+    for (int i = 0; i < graphics_context->nbr_dirty_squares; ++i) {
+        graphics_context->dirty_squares[graphics_context->dirty_square_list[i]] = false;
     }
+    graphics_context->nbr_dirty_squares = 0;
+    graphics_context->frame_dirty = false;
 
-    // draw highlighted squares
-    // TODO: draw something to show the last move
-    if (selected_square != -1) {
-        SDL_SetRenderDrawColor(graphics_context->renderer, 50, 205, 205, 0xFF);    // turquoise
-        SDL_Rect rect = {graphics_context->graphics_board[selected_square].x, graphics_context->graphics_board[selected_square].y, 
-                         graphics_context->square_width, graphics_context->square_width};
-        SDL_RenderFillRect(renderer, &rect);
+    // Update window, the analysis goes over the frame so that it can change without drawing squares again
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_RenderCopy(renderer, graphics_context->frame, NULL, NULL);
+    ++graphics_context->draw_calls;
+    if (graphics_context->show_analysis) {
+        draw_analysis(graphics_context);
+    }
+#ifdef PERFORMANCE_HUD
+    graphics_context->hud.draw_calls = graphics_context->draw_calls;
+    if (graphics_context->hud.shown) {
+        draw_hud(graphics_context);
     }
+#endif
+    SDL_RenderPresent(renderer);
+    return true;
+}
 
-    SDL_SetRenderDrawColor(graphics_context->renderer, 130, 160, 222, 0xFF);    // lighter blue. This before blue
-    for (int i = 0; diagonal_pawn_moves[i].destination_square != -1; ++i) {
-        SDL_Rect rect = {graphics_context->graphics_board[diagonal_pawn_moves[i].destination_square].x,
-                         graphics_context->graphics_board[diagonal_pawn_moves[i].destination_square].y, 
-                         graphics_context->square_width, graphics_context->square_width};
-        SDL_RenderFillRect(renderer, &rect);
+#ifdef PERFORMANCE_HUD
+// Ends a timer started with HUD_TIMER_START, frames also go into the histogram
+void record_hud_time(struct PerformanceHud *hud, enum HudTimer timer, Uint64 start) {
+    double milliseconds = 1000.0 * (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    hud->milliseconds[timer] = milliseconds;
+    if (timer == HUD_TIMER_FRAME) {
+        hud->frame_milliseconds[hud->nbr_frames++ % HUD_FRAMES] = (float)milliseconds;
     }
+}
 
-    SDL_SetRenderDrawColor(graphics_context->renderer, 50, 100, 205, 0xFF);    // blue
-    for (int i = 0; moves[i].destination_square != -1; ++i) {
-        SDL_Rect rect = {graphics_context->graphics_board[moves[i].destination_square].x, 
-                         graphics_context->graphics_board[moves[i].destination_square].y, 
-                         graphics_context->square_width, graphics_context->square_width};
-        SDL_RenderFillRect(renderer, &rect);
+// Histogram of the latest frame times and the latest milliseconds of every timer and draw calls, in the top right
+// corner: F frame, D draw_board, M getting the moves of a click, W evaluate_win_conditions, C draw calls
+static void draw_hud(struct GraphicsContext *graphics_context) {
+    struct PerformanceHud *hud = &graphics_context->hud;
+    hud->nbr_vertices = 0;
+    hud->nbr_indices = 0;
+    const char labels[HUD_TIMERS_COUNT] = {'F', 'D', 'M', 'W'};
+    int line_height = 7 * HUD_PIXEL;
+    float width = HUD_HISTOGRAM_BUCKETS * HUD_BAR_WIDTH + 2 * HUD_MARGIN;
+    float height = (HUD_TIMERS_COUNT + 1) * line_height + HUD_HISTOGRAM_HEIGHT + 3 * HUD_MARGIN;
+    float left = graphics_context->window_width - width - HUD_MARGIN, top = HUD_MARGIN;
+    add_hud_rect(hud, left, top, width, height, hud_panel_color);
+
+    char text[32];
+    float y = top + HUD_MARGIN;
+    for (int timer = 0; timer < HUD_TIMERS_COUNT; ++timer) {
+        snprintf(text, sizeof(text), "%c %.2f", labels[timer], hud->milliseconds[timer]);
+        add_hud_text(hud, left + HUD_MARGIN, y, text);
+        y += line_height;
     }
-    
-    // draw pieces
-    for (int square_index = 0; square_index < graphics_context->graphics_board_length; ++square_index) {
-        SDL_Rect rect = {graphics_context->graphics_board[square_index].x, graphics_context->graphics_board[square_index].y, 
-                         graphics_context->square_width, graphics_context->square_width};
-        enum PieceColor piece_color = game_state->board[square_index].piece.piece_color;
-        switch (game_state->board[square_index].piece.piece_type) {
-            case NULL_PIECE_TYPE:
-                break;
-            case PAWN: 
-                if (piece_color == PIECE_COLOR_WHITE) {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_WHITE_PAWN], NULL, &rect);
-                } else {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_BLACK_PAWN], NULL, &rect);
-                }
-                break;
-            case ROOK: 
-                if (piece_color == PIECE_COLOR_WHITE) {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_WHITE_ROOK], NULL, &rect);
-                } else {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_BLACK_ROOK], NULL, &rect);
-                }
-                break;
-            case KNIGHT:
-                if (piece_color == PIECE_COLOR_WHITE) {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_WHITE_KNIGHT], NULL, &rect);
-                } else {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_BLACK_KNIGHT], NULL, &rect);
-                }
-                break;
-            case BISHOP:
-                if (piece_color == PIECE_COLOR_WHITE) {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_WHITE_BISHOP], NULL, &rect);
-                } else {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_BLACK_BISHOP], NULL, &rect);
-                }
-                break;
-            case KING:
-                if (piece_color == PIECE_COLOR_WHITE) {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_WHITE_KING], NULL, &rect);
-                } else {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_BLACK_KING], NULL, &rect);
+    snprintf(text, sizeof(text), "C %i", hud->draw_calls);
+    add_hud_text(hud, left + HUD_MARGIN, y, text);
+    y += line_height + HUD_MARGIN;
+
+    int bucket_counts[HUD_HISTOGRAM_BUCKETS] = {0};
+    int nbr_frames = hud->nbr_frames < HUD_FRAMES ? hud->nbr_frames : HUD_FRAMES;
+    int max_count = 1;
+    for (int i = 0; i < nbr_frames; ++i) {
+        int bucket = (int)hud->frame_milliseconds[i];
+        bucket = bucket < HUD_HISTOGRAM_BUCKETS ? bucket : HUD_HISTOGRAM_BUCKETS - 1;
+        max_count = ++bucket_counts[bucket] > max_count ? bucket_counts[bucket] : max_count;
+    }
+    for (int bucket = 0; bucket < HUD_HISTOGRAM_BUCKETS; ++bucket) {
+        float bar_height = (float)HUD_HISTOGRAM_HEIGHT * bucket_counts[bucket] / max_count;
+        add_hud_rect(hud, left + HUD_MARGIN + bucket * HUD_BAR_WIDTH, y + HUD_HISTOGRAM_HEIGHT - bar_height,
+                     HUD_BAR_WIDTH - 1, bar_height, hud_bar_color);
+    }
+    SDL_RenderGeometry(graphics_context->renderer, NULL, hud->vertices, hud->nbr_vertices, hud->indices, hud->nbr_indices);
+}
+
+static void add_hud_rect(struct PerformanceHud *hud, float x, float y, float width, float height, SDL_Color color) {
+    if (hud->nbr_vertices + 4 <= 4 * HUD_MAX_QUADS) {
+        SDL_FPoint points[4] = {{x, y}, {x + width, y}, {x + width, y + height}, {x, y + height}};
+        add_polygon(hud->vertices, &hud->nbr_vertices, hud->indices, &hud->nbr_indices, points, 4, color);
+    }
+}
+
+// A quad per lit font pixel, characters without a glyph are spaces
+static void add_hud_text(struct PerformanceHud *hud, float x, float y, const char *text) {
+    for (; *text != '\0'; ++text, x += 4 * HUD_PIXEL) {
+        for (unsigned int i = 0; i < sizeof(hud_glyphs) / sizeof(hud_glyphs[0]); ++i) {
+            if (hud_glyphs[i].character != *text) {
+                continue;
+            }
+            for (int row = 0; row < 5; ++row) {
+                for (int column = 0; column < 3; ++column) {
+                    if (hud_glyphs[i].rows[row] & (4 >> column)) {
+                        add_hud_rect(hud, x + column * HUD_PIXEL, y + row * HUD_PIXEL, HUD_PIXEL, HUD_PIXEL,
+                                     hud_text_color);
+                    }
                 }
-                break;
-            case QUEEN:
-                if (piece_color == PIECE_COLOR_WHITE) {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_WHITE_QUEEN], NULL, &rect);
-                } else {
-                    SDL_RenderCopy(graphics_context->renderer, graphics_context->textures[TEXTURE_BLACK_QUEEN], NULL, &rect);
+            }
+        }
+    }
+}
+#endif
+
+// Latest engine analysis for draw_board, white_score in centipawns from white's point of view. No arrow if best_move
+// has destination_square -1
+void set_graphics_analysis(struct GraphicsContext *graphics_context, struct Move best_move, int white_score) {
+    graphics_context->analysis_best_move = best_move;
+    graphics_context->analysis_white_score = white_score;
+}
+
+// Attackers of every square by color for draw_board, e.g. from count_attacks, NULL to hide them. Only the squares whose
+// counts changed are drawn again, so call it with the counts of every new position
+void set_graphics_threats(struct GraphicsContext *graphics_context, int *attack_counts[PIECE_COLOR_COUNT]) {
+    if (attack_counts == NULL) {
+        graphics_context->frame_dirty = graphics_context->frame_dirty || graphics_context->show_threats;
+        graphics_context->show_threats = false;
+        return;
+    }
+    bool was_shown = graphics_context->show_threats;
+    graphics_context->show_threats = true;
+    graphics_context->frame_dirty = graphics_context->frame_dirty || !was_shown;
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        int *threat_counts = graphics_context->threat_counts[piece_color];
+        for (int square_index = 0; square_index < graphics_context->graphics_board_length; ++square_index) {
+            if (threat_counts[square_index] != attack_counts[piece_color][square_index]) {
+                threat_counts[square_index] = attack_counts[piece_color][square_index];
+                if (was_shown) {
+                    mark_square_dirty(graphics_context, square_index);
                 }
-                break;
+            }
+        }
+    }
+}
+
+// Blue for white, red for black, mixed by how many attackers each has and more opaque the more there are together
+static SDL_Color threat_color(int white_attackers, int black_attackers) {
+    white_attackers = white_attackers < THREAT_MAX_ATTACKERS ? white_attackers : THREAT_MAX_ATTACKERS;
+    black_attackers = black_attackers < THREAT_MAX_ATTACKERS ? black_attackers : THREAT_MAX_ATTACKERS;
+    int attackers = white_attackers + black_attackers;
+    int shown_attackers = attackers < THREAT_MAX_ATTACKERS ? attackers : THREAT_MAX_ATTACKERS;
+    return (SDL_Color){
+        (threat_white_color.r * white_attackers + threat_black_color.r * black_attackers) / attackers,
+        (threat_white_color.g * white_attackers + threat_black_color.g * black_attackers) / attackers,
+        (threat_white_color.b * white_attackers + threat_black_color.b * black_attackers) / attackers,
+        threat_white_color.a * shown_attackers / THREAT_MAX_ATTACKERS,
+    };
+}
+
+// Evaluation bar along the left edge of the window and an arrow for the best move, in one SDL_RenderGeometry call
+static void draw_analysis(struct GraphicsContext *graphics_context) {
+    SDL_Vertex vertices[4 + 4 + 4 + 3];
+    int indices[6 + 6 + 6 + 3];
+    int nbr_vertices = 0, nbr_indices = 0;
+
+    // White from the bottom up to its share of the evaluation, black above
+    float score = (float)graphics_context->analysis_white_score;
+    float white_share = 0.5f + 0.5f * score / (fabsf(score) + ANALYSIS_BAR_HALF_SCORE);
+    float bar_width = ANALYSIS_BAR_WIDTH, height = graphics_context->window_height;
+    float split = height * (1 - white_share);
+    SDL_FPoint black_bar[4] = {{0, 0}, {bar_width, 0}, {bar_width, split}, {0, split}};
+    SDL_FPoint white_bar[4] = {{0, split}, {bar_width, split}, {bar_width, height}, {0, height}};
+    add_polygon(vertices, &nbr_vertices, indices, &nbr_indices, black_bar, 4, analysis_black_color);
+    add_polygon(vertices, &nbr_vertices, indices, &nbr_indices, white_bar, 4, analysis_white_color);
+
+    // Shaft from the middle of the origin square, head ending in the middle of the destination square
+    struct Move move = graphics_context->analysis_best_move;
+    if (move.destination_square != -1) {
+        float zoom = graphics_context->zoom;
+        float half_square = 0.5f * graphics_context->square_width;
+        struct GraphicsSquare *origin = &graphics_context->graphics_board[move.origin_square];
+        struct GraphicsSquare *destination = &graphics_context->graphics_board[move.destination_square];
+        float x0 = (origin->x + half_square) * zoom + graphics_context->pan_x;
+        float y0 = (origin->y + half_square) * zoom + graphics_context->pan_y;
+        float x1 = (destination->x + half_square) * zoom + graphics_context->pan_x;
+        float y1 = (destination->y + half_square) * zoom + graphics_context->pan_y;
+        float length = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+        float width = fmaxf(2, graphics_context->square_width * zoom / 6);
+        float head_length = fminf(3 * width, length);
+        if (length > 0) {
+            float dx = (x1 - x0) / length, dy = (y1 - y0) / length;
+            float head_x = x1 - dx * head_length, head_y = y1 - dy * head_length;
+            SDL_FPoint shaft[4] = {{x0 - dy * width / 2, y0 + dx * width / 2}, {x0 + dy * width / 2, y0 - dx * width / 2},
+                                   {head_x + dy * width / 2, head_y - dx * width / 2},
+                                   {head_x - dy * width / 2, head_y + dx * width / 2}};
+            SDL_FPoint head[3] = {{head_x - dy * width * 2, head_y + dx * width * 2},
+                                  {head_x + dy * width * 2, head_y - dx * width * 2}, {x1, y1}};
+            add_polygon(vertices, &nbr_vertices, indices, &nbr_indices, shaft, 4, analysis_arrow_color);
+            add_polygon(vertices, &nbr_vertices, indices, &nbr_indices, head, 3, analysis_arrow_color);
         }
     }
-    // Update window
-    SDL_RenderPresent(graphics_context->renderer);
+    SDL_RenderGeometry(graphics_context->renderer, NULL, vertices, nbr_vertices, indices, nbr_indices);
+    ++graphics_context->draw_calls;
+}
+
+// Convex polygon as a fan of triangles
+static void add_polygon(SDL_Vertex vertices[], int *nbr_vertices, int indices[], int *nbr_indices, SDL_FPoint points[],
+                        int nbr_points, SDL_Color color) {
+    int first = *nbr_vertices;
+    for (int i = 0; i < nbr_points; ++i) {
+        vertices[(*nbr_vertices)++] = (SDL_Vertex){points[i], color, {0, 0}};
+    }
+    for (int i = 1; i + 1 < nbr_points; ++i) {
+        indices[(*nbr_indices)++] = first;
+        indices[(*nbr_indices)++] = first + i;
+        indices[(*nbr_indices)++] = first + i + 1;
+    }
+}
+
+// Sets the highlight in next_highlights, the square is added to highlighted_squares after the old ones
+static void highlight_square(struct GraphicsContext *graphics_context, int square_index, enum Highlight highlight) {
+    if (graphics_context->next_highlights[square_index] == HIGHLIGHT_NONE) {
+        graphics_context->highlighted_squares[graphics_context->nbr_highlighted_squares++] = square_index;
+    }
+    graphics_context->next_highlights[square_index] = highlight;
+}
+
+// Adds the square to the batches. Without background the square is already in the frame as it is in the background.
+// Squares out of view are left out
+static void add_square(struct GraphicsContext *graphics_context, struct GameState *game_state, int square_index,
+                       bool with_background) {
+    struct GraphicsSquare *graphics_square = &graphics_context->graphics_board[square_index];
+    float zoom = graphics_context->zoom;
+    SDL_FRect rect = {graphics_square->x * zoom + graphics_context->pan_x, graphics_square->y * zoom + graphics_context->pan_y,
+                      graphics_context->square_width * zoom, graphics_context->square_width * zoom};
+    if (    rect.x + rect.w <= 0 || rect.y + rect.h <= 0 || rect.x >= graphics_context->window_width ||
+            rect.y >= graphics_context->window_height) {
+        return;
+    }
+    enum Highlight highlight = graphics_context->highlights[square_index];
+    if (highlight != HIGHLIGHT_NONE) {
+        add_quad(&graphics_context->highlight_batch, rect, highlight_colors[highlight], (SDL_FRect){0, 0, 0, 0});
+    } else if (with_background) {
+        SDL_FRect texture_rect = {(float)graphics_square->x / graphics_context->window_width,
+                                  (float)graphics_square->y / graphics_context->window_height,
+                                  (float)graphics_context->square_width / graphics_context->window_width,
+                                  (float)graphics_context->square_width / graphics_context->window_height};
+        add_quad(&graphics_context->background_batch, rect, no_tint, texture_rect);
+    }
+    if (graphics_context->show_threats) {
+        int white_attackers = graphics_context->threat_counts[PIECE_COLOR_WHITE][square_index];
+        int black_attackers = graphics_context->threat_counts[PIECE_COLOR_BLACK][square_index];
+        if (white_attackers + black_attackers > 0 && game_state->board[square_index].part_of_board) {
+            add_quad(&graphics_context->threat_batch, rect, threat_color(white_attackers, black_attackers),
+                     (SDL_FRect){0, 0, 0, 0});
+        }
+    }
+
+    struct Piece piece = game_state->board[square_index].piece;
+    if (game_state->board[square_index].part_of_board && piece.piece_type != NULL_PIECE_TYPE) {
+        add_piece(graphics_context, &graphics_context->piece_batch, rect, piece);
+    }
+}
+
+// The piece image over rect, or a dot of its color below GRAPHICS_LOD_SQUARE_WIDTH
+static void add_piece(struct GraphicsContext *graphics_context, struct GeometryBatch *batch, SDL_FRect rect,
+                      struct Piece piece) {
+    if (rect.w < GRAPHICS_LOD_SQUARE_WIDTH) {
+        SDL_FRect dot = {rect.x + rect.w / 4, rect.y + rect.h / 4, rect.w / 2, rect.h / 2};
+        add_quad(batch, dot, piece.piece_color == PIECE_COLOR_WHITE ? white_dot_color : black_dot_color,
+                 (SDL_FRect){0, 0, 0, 0});
+        return;
+    }
+    enum Texture texture = piece.piece_color == PIECE_COLOR_WHITE ? white_piece_textures[piece.piece_type] :
+                                                                    black_piece_textures[piece.piece_type];
+    SDL_Rect atlas_rect = graphics_context->atlas_rects[texture];
+    SDL_FRect texture_rect = {(float)atlas_rect.x / graphics_context->atlas_width,
+                              (float)atlas_rect.y / graphics_context->atlas_height,
+                              (float)atlas_rect.w / graphics_context->atlas_width,
+                              (float)atlas_rect.h / graphics_context->atlas_height};
+    add_quad(batch, rect, no_tint, texture_rect);
+}
+
+// The different square index parts in the window along one axis, from a table in board coordinates. Runs of pixels with
+// the same part are skipped, so this is linear in the window size and not in the number of squares
+static int visible_square_index_parts(int *square_index_part_at, float pan, int window_length, float zoom, int parts[]) {
+    int first = (int)(-pan / zoom);
+    int last = (int)((window_length - pan) / zoom);
+    first = first < 0 ? 0 : first;
+    last = last >= window_length ? window_length - 1 : last;
+    int nbr_parts = 0;
+    int previous_part = -1;
+    for (int i = first; i <= last; ++i) {
+        int part = square_index_part_at[i];
+        if (part != -1 && part != previous_part) {
+            parts[nbr_parts++] = part;
+        }
+        previous_part = part;
+    }
+    return nbr_parts;
+}
+
+// Zooms by factor around the pixel, which stays over the same spot of the board. The board always fills the window
+void zoom_camera(struct GraphicsContext *graphics_context, float factor, int x, int y) {
+    float zoom = graphics_context->zoom * factor;
+    zoom = zoom < 1 ? 1 : zoom > GRAPHICS_MAX_ZOOM ? GRAPHICS_MAX_ZOOM : zoom;
+    float board_x = (x - graphics_context->pan_x) / graphics_context->zoom;
+    float board_y = (y - graphics_context->pan_y) / graphics_context->zoom;
+    graphics_context->zoom = zoom;
+    pan_camera(graphics_context, x - board_x * zoom - graphics_context->pan_x, y - board_y * zoom - graphics_context->pan_y);
+}
+
+void pan_camera(struct GraphicsContext *graphics_context, float dx, float dy) {
+    float min_pan_x = graphics_context->window_width * (1 - graphics_context->zoom);
+    float min_pan_y = graphics_context->window_height * (1 - graphics_context->zoom);
+    float pan_x = graphics_context->pan_x + dx, pan_y = graphics_context->pan_y + dy;
+    graphics_context->pan_x = pan_x > 0 ? 0 : pan_x < min_pan_x ? min_pan_x : pan_x;
+    graphics_context->pan_y = pan_y > 0 ? 0 : pan_y < min_pan_y ? min_pan_y : pan_y;
+    graphics_context->frame_dirty = true;
+}
+
+void reset_camera(struct GraphicsContext *graphics_context) {
+    graphics_context->zoom = 1;
+    graphics_context->pan_x = 0;
+    graphics_context->pan_y = 0;
+    graphics_context->frame_dirty = true;
+}
+
+// Two triangles, texture_rect in texture coordinates from 0 to 1
+static void add_quad(struct GeometryBatch *batch, SDL_FRect rect, SDL_Color color, SDL_FRect texture_rect) {
+    SDL_Vertex *vertices = &batch->vertices[4 * batch->nbr_quads++];
+    float left = rect.x, right = rect.x + rect.w, top = rect.y, bottom = rect.y + rect.h;
+    float texture_left = texture_rect.x, texture_right = texture_rect.x + texture_rect.w;
+    float texture_top = texture_rect.y, texture_bottom = texture_rect.y + texture_rect.h;
+    vertices[0] = (SDL_Vertex){{left, top}, color, {texture_left, texture_top}};
+    vertices[1] = (SDL_Vertex){{right, top}, color, {texture_right, texture_top}};
+    vertices[2] = (SDL_Vertex){{left, bottom}, color, {texture_left, texture_bottom}};
+    vertices[3] = (SDL_Vertex){{right, bottom}, color, {texture_right, texture_bottom}};
+}
+
+static void draw_batch(struct GraphicsContext *graphics_context, struct GeometryBatch *batch, SDL_Texture *texture) {
+    if (batch->nbr_quads > 0) {
+        SDL_RenderGeometry(graphics_context->renderer, texture, batch->vertices, 4 * batch->nbr_quads,
+                           graphics_context->quad_indices, 6 * batch->nbr_quads);
+        ++graphics_context->draw_calls;
+    }
+}
+
+// The squares without highlights and pieces, drawn once into the background texture that frames are copied from
+static bool draw_background(struct GraphicsContext *graphics_context) {
+    SDL_Renderer *renderer = graphics_context->renderer;
+    if (SDL_SetRenderTarget(renderer, graphics_context->background) != 0) {
+        printf("Disarray: can't draw the background! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetRenderDrawColor(renderer, background_color.r, background_color.g, background_color.b, background_color.a);
+    SDL_RenderClear(renderer);
+    struct GeometryBatch *batch = &graphics_context->highlight_batch;
+    batch->nbr_quads = 0;
+    for (int square_index = 0; square_index < graphics_context->graphics_board_length; ++square_index) {
+        struct GraphicsSquare *graphics_square = &graphics_context->graphics_board[square_index];
+        SDL_FRect rect = {graphics_square->x, graphics_square->y, graphics_context->square_width, graphics_context->square_width};
+        add_quad(batch, rect, graphics_square->light_squares ? light_squares_color : dark_squares_color,
+                 (SDL_FRect){0, 0, 0, 0});
+    }
+    draw_batch(graphics_context, batch, NULL);
+    graphics_context->background_dirty = false;
+    graphics_context->frame_dirty = true;
     return true;
 }
 
@@ -142,108 +562,132 @@ bool initialize_graphics(struct GraphicsContext *graphics_context, int dimension
     }
 
     //graphics_context->window_surface = SDL_GetWindowSurface(graphics_context->window);
-    graphics_context->renderer = SDL_CreateRenderer(graphics_context->window, -1, SDL_RENDERER_ACCELERATED);
+    graphics_context->renderer = SDL_CreateRenderer(graphics_context->window, -1,
+                                                    SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
     if (graphics_context->renderer == NULL) {
         printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
         return false;
     }
 
-    // Set how the alpha channel is used
-    //SDL_SetRenderDrawBlendMode(graphics_context->renderer, SDL_BLENDMODE_BLEND);
+    // Set how the alpha channel is used, the threat tint and the analysis are see-through
+    SDL_SetRenderDrawBlendMode(graphics_context->renderer, SDL_BLENDMODE_BLEND);
 
-    // Compute square_width for board to fill as much of screen as possible
-    float separation_width_for_dim[MAX_DIMENSIONS] = {0.0, 0.0, 0.5, 0.5, 1.0, 1.0, 1.5, 1.5, 2.0, 2.0, 2.5, 2.5, 3.0, 3.0};    // change this hardcoding if MAX_DIMENSIONS changes
-    float board_width_in_squares = 1.0;
-    float board_height_in_squares = 1.0;
-    for (int dim = 0; dim < dimensions; ++dim) {
-        float this_dim = 0.0;
-        if (dim % 2 == 0) {
-            for (int i = 0; i < board_shape[dim]; ++i) {
-                this_dim += board_width_in_squares;
-                this_dim += separation_width_for_dim[dim];
-            }
-            board_width_in_squares = this_dim - separation_width_for_dim[dim];
-        } else {
-            for (int i = 0; i < board_shape[dim]; ++i) {
-                this_dim += board_height_in_squares;
-                this_dim += separation_width_for_dim[dim];
-            }
-            board_height_in_squares = this_dim - separation_width_for_dim[dim];
-        }
+    // Square size and where every square goes
+    int length = board_layout_length(dimensions, board_shape);
+    struct GraphicsSquare *graphics_board = malloc(sizeof(*graphics_board) * length);       // 1D array representing nD board. Can be large -> malloc
+    if (graphics_board == NULL) {
+        printf("Disarray: no memory for the board\n");
+        return false;
     }
+    struct BoardLayout layout;
+    compute_board_layout(&layout, graphics_board, window_width, window_height, dimensions, board_shape);
+    graphics_context->square_width = layout.square_width;
+    graphics_context->board_total_width = layout.board_total_width;
+    graphics_context->board_total_height = layout.board_total_height;
+    int square_width = layout.square_width;
+    int square[MAX_DIMENSIONS];
+    graphics_context->graphics_board = graphics_board;
+    graphics_context->graphics_board_length = length;
 
-    int width_ratio = (int)(window_width / board_width_in_squares);
-    int height_ratio = (int)(window_height / board_height_in_squares);
-    int square_width = width_ratio < height_ratio ? width_ratio : height_ratio;
-    graphics_context->square_width = square_width;
-
-    for (int i = 2; i < MAX_DIMENSIONS; ++i) {
-        separation_width_for_dim[i] *= square_width;
-    }
-
-    // Computing coordinates for all the dimensions by themselves
-    // 0, 0 is bottom left  (or top left)
-    int x_coord = square_width;
-    int y_coord = square_width;
-    int coordinates_for_dim[MAX_DIMENSIONS][MAX_SIDE_LENGTH];
-    for (int dim = 0; dim < dimensions; ++dim) {
-        int dim_coord = 0;
-        coordinates_for_dim[dim][0] = dim_coord;
-        if (dim % 2 == 0) {
-            x_coord += separation_width_for_dim[dim];
-            for (int i = 1; i < board_shape[dim] + 1; ++i) {
-                dim_coord += x_coord;
-                coordinates_for_dim[dim][i] = dim_coord;
-            }
-            x_coord = dim_coord - separation_width_for_dim[dim];
-        } else {
-            y_coord += separation_width_for_dim[dim];
-            for (int i = 1; i < board_shape[dim] + 1; ++i) {
-                dim_coord += y_coord;
-                coordinates_for_dim[dim][i] = dim_coord;
-            }
-            y_coord = dim_coord - separation_width_for_dim[dim];
-        }
+    // Inverse of the layout for get_square_index_at_coordinates
+    graphics_context->square_index_part_at_x = malloc(sizeof(int) * window_width);
+    graphics_context->square_index_part_at_y = malloc(sizeof(int) * window_height);
+    graphics_context->hovered_square = -1;
+    graphics_context->show_analysis = false;
+    graphics_context->analysis_best_move.destination_square = -1;
+    graphics_context->analysis_white_score = 0;
+    graphics_context->show_threats = false;
+#ifdef PERFORMANCE_HUD
+    memset(&graphics_context->hud, 0, sizeof(graphics_context->hud));     // hidden, no frames timed yet
+#endif
+    graphics_context->visible_column_parts = malloc(sizeof(int) * window_width);
+    graphics_context->visible_row_parts = malloc(sizeof(int) * window_height);
+    reset_camera(graphics_context);
+    if (    graphics_context->square_index_part_at_x == NULL || graphics_context->square_index_part_at_y == NULL ||
+            graphics_context->visible_column_parts == NULL || graphics_context->visible_row_parts == NULL) {
+        printf("Disarray: no memory for the board\n");
+        return false;
     }
-    int board_total_width = x_coord;
-    int board_total_height = y_coord;
-
-    graphics_context->board_total_width = board_total_width;
-    graphics_context->board_total_height = board_total_height;
-
-    // Computing exact coordinates for all squares
-    // coordinates 0, 0 is top left of window
-    // no rotation: 0 right, 1000 down
-    // 90° rotation: 1000 down, 0 right
-    int x_offset = (graphics_context->window_width - graphics_context->board_total_width) / 2;
-    int y_offset = (graphics_context->window_height - graphics_context->board_total_height) / 2;
-    int length = 1;
-    for (int dim = 0; dim < dimensions; ++dim) {
-        length *= board_shape[dim];
+    for (int x = 0; x < window_width; ++x) {
+        graphics_context->square_index_part_at_x[x] = -1;
+    }
+    for (int y = 0; y < window_height; ++y) {
+        graphics_context->square_index_part_at_y[y] = -1;
     }
-    struct GraphicsSquare *graphics_board = malloc(sizeof(*graphics_board) * length);       // 1D array representing nD board. Can be large -> malloc
-    int square[dimensions];
     for (int index = 0; index < length; ++index) {
         square_index_to_square(index, square, dimensions, board_shape);
-        //printf("%d %d\n", square[0], square[1]);
-        int x = 0;
-        int y = board_total_height - square_width;  // top left corner of bottom left square
-        int light_square_dark_square = 0;
-        for (int dim = dimensions-1; dim >= 0; --dim) {
-            light_square_dark_square += square[dim];
+        int column_part = 0, row_part = 0, factor = 1;
+        for (int dim = 0; dim < dimensions; ++dim) {
             if (dim % 2 == 0) {
-                x += coordinates_for_dim[dim][square[dim]];
+                column_part += square[dim] * factor;
             } else {
-                y -= coordinates_for_dim[dim][square[dim]];
+                row_part += square[dim] * factor;
+            }
+            factor *= board_shape[dim];
+        }
+        // Each column and row is written once, by the first square in it
+        if (row_part == 0) {
+            for (int x = graphics_board[index].x; x < graphics_board[index].x + square_width && x < window_width; ++x) {
+                graphics_context->square_index_part_at_x[x] = column_part;
+            }
+        }
+        if (column_part == 0) {
+            for (int y = graphics_board[index].y; y < graphics_board[index].y + square_width && y < window_height; ++y) {
+                graphics_context->square_index_part_at_y[y] = row_part;
             }
         }
-        //printf("%d\n", x);
-        graphics_board[index].x = x + x_offset;
-        graphics_board[index].y = y + y_offset;
-        graphics_board[index].light_squares = (light_square_dark_square % 2 == 1);
     }
-    graphics_context->graphics_board = graphics_board;
-    graphics_context->graphics_board_length = length;
+
+    graphics_context->frame = SDL_CreateTexture(graphics_context->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                                window_width, window_height);
+    if (graphics_context->frame == NULL) {
+        printf("Disarray: frame texture could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    graphics_context->frame_dirty = true;
+    graphics_context->dirty_squares = calloc(length, sizeof(bool));
+    graphics_context->dirty_square_list = malloc(sizeof(int) * length);
+    graphics_context->nbr_dirty_squares = 0;
+    graphics_context->highlights = calloc(length, sizeof(enum Highlight));          // HIGHLIGHT_NONE is 0
+    graphics_context->next_highlights = calloc(length, sizeof(enum Highlight));
+    graphics_context->highlighted_squares = malloc(sizeof(int) * 2 * length);        // old and new highlights
+    graphics_context->nbr_highlighted_squares = 0;
+
+    graphics_context->background = SDL_CreateTexture(graphics_context->renderer, SDL_PIXELFORMAT_ARGB8888,
+                                                     SDL_TEXTUREACCESS_TARGET, window_width, window_height);
+    if (graphics_context->background == NULL) {
+        printf("Disarray: background texture could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    graphics_context->background_dirty = true;
+    graphics_context->background_batch.vertices = malloc(sizeof(SDL_Vertex) * 4 * length);
+    graphics_context->highlight_batch.vertices = malloc(sizeof(SDL_Vertex) * 4 * length);
+    graphics_context->piece_batch.vertices = malloc(sizeof(SDL_Vertex) * 4 * length);
+    graphics_context->threat_batch.vertices = malloc(sizeof(SDL_Vertex) * 4 * length);
+    graphics_context->threat_counts[PIECE_COLOR_WHITE] = calloc(length, sizeof(int));
+    graphics_context->threat_counts[PIECE_COLOR_BLACK] = calloc(length, sizeof(int));
+    graphics_context->quad_indices = malloc(sizeof(int) * 6 * length);
+    if (graphics_context->quad_indices != NULL) {
+        for (int quad = 0; quad < length; ++quad) {
+            int first = 4 * quad;
+            int *indices = &graphics_context->quad_indices[6 * quad];
+            indices[0] = first;
+            indices[1] = first + 1;
+            indices[2] = first + 2;
+            indices[3] = first + 2;
+            indices[4] = first + 1;
+            indices[5] = first + 3;
+        }
+    }
+    if (    graphics_board == NULL || graphics_context->dirty_squares == NULL || graphics_context->dirty_square_list == NULL ||
+            graphics_context->highlights == NULL || graphics_context->next_highlights == NULL ||
+            graphics_context->highlighted_squares == NULL || graphics_context->background_batch.vertices == NULL ||
+            graphics_context->highlight_batch.vertices == NULL || graphics_context->piece_batch.vertices == NULL ||
+            graphics_context->threat_batch.vertices == NULL || graphics_context->threat_counts[PIECE_COLOR_WHITE] == NULL ||
+            graphics_context->threat_counts[PIECE_COLOR_BLACK] == NULL || graphics_context->quad_indices == NULL) {
+        printf("Disarray: no memory for the board\n");
+        return false;
+    }
 
     //SDL_PixelFormat *sdl_pixel_format = graphics_context->window_surface->format;
     //graphics_context->sdl_colors[LIGHT_SQUARES_COLOR] = SDL_MapRGB(sdl_pixel_format, 237, 214, 176);
@@ -253,77 +697,96 @@ bool initialize_graphics(struct GraphicsContext *graphics_context, int dimension
     return true;
 }
 
-static SDL_Texture *load_png_image(char path[], SDL_Renderer *renderer) {
-    SDL_Texture *texture = IMG_LoadTexture(renderer, path);
-    if (texture == NULL) {
+static const char *piece_image_paths[TEXTURES_COUNT] = {
+    [TEXTURE_WHITE_PAWN] = "images/w_pawn.png",     [TEXTURE_BLACK_PAWN] = "images/b_pawn.png",
+    [TEXTURE_WHITE_ROOK] = "images/w_rook.png",     [TEXTURE_BLACK_ROOK] = "images/b_rook.png",
+    [TEXTURE_WHITE_KNIGHT] = "images/w_knight.png", [TEXTURE_BLACK_KNIGHT] = "images/b_knight.png",
+    [TEXTURE_WHITE_BISHOP] = "images/w_bishop.png", [TEXTURE_BLACK_BISHOP] = "images/b_bishop.png",
+    [TEXTURE_WHITE_KING] = "images/w_king.png",     [TEXTURE_BLACK_KING] = "images/b_king.png",
+    [TEXTURE_WHITE_QUEEN] = "images/w_queen.png",   [TEXTURE_BLACK_QUEEN] = "images/b_queen.png",
+};
+
+static SDL_Surface *load_png_image(const char path[]) {
+    SDL_Surface *surface = IMG_Load(path);
+    if (surface == NULL) {
         printf("Unable to load image %s! SDL_image Error: %s\n", path, IMG_GetError());
         return NULL;
     }
-    return texture;
-}
-
-//static SDL_Surface *load_png_image(char path[], SDL_PixelFormat *sdl_pixel_format) {
-//    SDL_Surface *surface = IMG_Load(path);  // use load_texture instead, and use renderer thing
-//    if (surface == NULL) {
-//        printf("Unable to load image %s! SDL_image Error: %s\n", path, IMG_GetError());
-//        return NULL;
-//    }
-//
-//    SDL_Surface *optimized_surface = SDL_ConvertSurface(surface, sdl_pixel_format, 0);
-//    if (optimized_surface == NULL) {
-//        printf("Unable to optimize image %s! SDL Error: %s\n", path, SDL_GetError());
-//        return NULL;
-//    }
-//    SDL_FreeSurface(surface);
-//    return optimized_surface;
-//}
-
-bool load_graphics_media(SDL_Texture *textures[], SDL_Renderer *renderer) {
-    if((textures[TEXTURE_WHITE_PAWN] = load_png_image("images/w_pawn.png", renderer)) == NULL) {
-        return false;
-    }
-    if((textures[TEXTURE_WHITE_ROOK] = load_png_image("images/w_rook.png", renderer)) == NULL) {
-        return false;
-    }
-    if((textures[TEXTURE_WHITE_KNIGHT] = load_png_image("images/w_knight.png", renderer)) == NULL) {
-        return false;
-    }
-    if((textures[TEXTURE_WHITE_BISHOP] = load_png_image("images/w_bishop.png", renderer)) == NULL) {
-        return false;
-    }
-    if((textures[TEXTURE_WHITE_KING] = load_png_image("images/w_king.png", renderer)) == NULL) {
-        return false;
-    }
-    if((textures[TEXTURE_WHITE_QUEEN] = load_png_image("images/w_queen.png", renderer)) == NULL) {
-        return false;
+    SDL_Surface *rgba_surface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(surface);
+    if (rgba_surface == NULL) {
+        printf("Unable to convert image %s! SDL Error: %s\n", path, SDL_GetError());
     }
+    return rgba_surface;
+}
 
-    if((textures[TEXTURE_BLACK_PAWN] = load_png_image("images/b_pawn.png", renderer)) == NULL) {
-        return false;
+// Packs the piece images next to each other into one texture, so that all pieces are drawn in one call
+bool load_graphics_media(struct GraphicsContext *graphics_context) {
+    SDL_Surface *surfaces[TEXTURES_COUNT] = {NULL};
+    SDL_Surface *atlas_surface = NULL;
+    bool ok = true;
+    int atlas_width = 0, atlas_height = 0;
+    for (int i = 0; i < TEXTURES_COUNT && ok; ++i) {
+        surfaces[i] = load_png_image(piece_image_paths[i]);
+        ok = surfaces[i] != NULL;
+        if (ok) {
+            graphics_context->atlas_rects[i] = (SDL_Rect){atlas_width, 0, surfaces[i]->w, surfaces[i]->h};
+            atlas_width += surfaces[i]->w;
+            atlas_height = surfaces[i]->h > atlas_height ? surfaces[i]->h : atlas_height;
+        }
     }
-    if((textures[TEXTURE_BLACK_ROOK] = load_png_image("images/b_rook.png", renderer)) == NULL) {
-        return false;
+    if (ok) {
+        atlas_surface = SDL_CreateRGBSurfaceWithFormat(0, atlas_width, atlas_height, 32, SDL_PIXELFORMAT_RGBA32);
+        ok = atlas_surface != NULL;
     }
-    if((textures[TEXTURE_BLACK_KNIGHT] = load_png_image("images/b_knight.png", renderer)) == NULL) {
-        return false;
+    for (int i = 0; i < TEXTURES_COUNT && ok; ++i) {
+        // Copied as they are, alpha included
+        SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+        ok = SDL_BlitSurface(surfaces[i], NULL, atlas_surface, &graphics_context->atlas_rects[i]) == 0;
     }
-    if((textures[TEXTURE_BLACK_BISHOP] = load_png_image("images/b_bishop.png", renderer)) == NULL) {
-        return false;
+    if (ok) {
+        graphics_context->atlas = SDL_CreateTextureFromSurface(graphics_context->renderer, atlas_surface);
+        ok = graphics_context->atlas != NULL;
     }
-    if((textures[TEXTURE_BLACK_KING] = load_png_image("images/b_king.png", renderer)) == NULL) {
-        return false;
+    if (ok) {
+        SDL_SetTextureBlendMode(graphics_context->atlas, SDL_BLENDMODE_BLEND);
+        graphics_context->atlas_width = atlas_width;
+        graphics_context->atlas_height = atlas_height;
+    } else {
+        printf("Unable to make the piece atlas! SDL Error: %s\n", SDL_GetError());
     }
-    if((textures[TEXTURE_BLACK_QUEEN] = load_png_image("images/b_queen.png", renderer)) == NULL) {
-        return false;
+    for (int i = 0; i < TEXTURES_COUNT; ++i) {
+        SDL_FreeSurface(surfaces[i]);
     }
-    return true;
+    SDL_FreeSurface(atlas_surface);
+    return ok;
 }
 
 void terminate_graphics(struct GraphicsContext *graphics_context) {
-    for (int i = 0; i < TEXTURES_COUNT; ++i) {
-        SDL_DestroyTexture(graphics_context->textures[i]);
-        graphics_context->textures[i] = NULL;
-    }
+    free(graphics_context->graphics_board);
+    free(graphics_context->square_index_part_at_x);
+    free(graphics_context->square_index_part_at_y);
+    free(graphics_context->visible_column_parts);
+    free(graphics_context->visible_row_parts);
+    free(graphics_context->dirty_squares);
+    free(graphics_context->dirty_square_list);
+    free(graphics_context->highlights);
+    free(graphics_context->next_highlights);
+    free(graphics_context->highlighted_squares);
+    SDL_DestroyTexture(graphics_context->frame);
+    graphics_context->frame = NULL;
+
+    free(graphics_context->background_batch.vertices);
+    free(graphics_context->highlight_batch.vertices);
+    free(graphics_context->piece_batch.vertices);
+    free(graphics_context->threat_batch.vertices);
+    free(graphics_context->threat_counts[PIECE_COLOR_WHITE]);
+    free(graphics_context->threat_counts[PIECE_COLOR_BLACK]);
+    free(graphics_context->quad_indices);
+    SDL_DestroyTexture(graphics_context->background);
+    graphics_context->background = NULL;
+    SDL_DestroyTexture(graphics_context->atlas);
+    graphics_context->atlas = NULL;
 
     SDL_DestroyRenderer(graphics_context->renderer);
     graphics_context->renderer = NULL;
@@ -334,3 +797,167 @@ void terminate_graphics(struct GraphicsContext *graphics_context) {
     IMG_Quit();
     SDL_Quit();
 }
+
+// Lays out nbr_games games of the board in a grid over the window of graphics_context, in as many columns as give the
+// largest squares. Every game gets a texture of its own. The window, renderer and piece atlas are those of
+// graphics_context, which has to stay alive until terminate_spectator_grid
+bool initialize_spectator_grid(struct SpectatorGrid *grid, struct GraphicsContext *graphics_context, int nbr_games,
+                               int dimensions, int board_shape[]) {
+    memset(grid, 0, sizeof(*grid));
+    grid->graphics_context = graphics_context;
+    grid->nbr_games = nbr_games;
+    grid->board_length = board_layout_length(dimensions, board_shape);
+    grid->graphics_board = malloc(sizeof(*grid->graphics_board) * grid->board_length);
+    grid->game_textures = calloc(nbr_games, sizeof(SDL_Texture *));
+    grid->dirty_games = calloc(nbr_games, sizeof(bool));
+    grid->dirty_game_list = malloc(sizeof(int) * nbr_games);
+    if (    grid->graphics_board == NULL || grid->game_textures == NULL || grid->dirty_games == NULL ||
+            grid->dirty_game_list == NULL) {
+        printf("Disarray: no memory for the spectator grid\n");
+        terminate_spectator_grid(grid);
+        return false;
+    }
+    for (int nbr_columns = 1; nbr_columns <= nbr_games; ++nbr_columns) {
+        int nbr_rows = (nbr_games + nbr_columns - 1) / nbr_columns;
+        struct BoardLayout layout;
+        compute_board_layout(&layout, grid->graphics_board, graphics_context->window_width / nbr_columns,
+                             graphics_context->window_height / nbr_rows, dimensions, board_shape);
+        if (layout.square_width > grid->layout.square_width || grid->nbr_columns == 0) {
+            grid->layout = layout;
+            grid->nbr_columns = nbr_columns;
+            grid->nbr_rows = nbr_rows;
+        }
+    }
+    compute_board_layout(&grid->layout, grid->graphics_board, graphics_context->window_width / grid->nbr_columns,
+                         graphics_context->window_height / grid->nbr_rows, dimensions, board_shape);
+
+    SDL_Renderer *renderer = graphics_context->renderer;
+    grid->board = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, grid->layout.width,
+                                    grid->layout.height);
+    grid->frame = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                    graphics_context->window_width, graphics_context->window_height);
+    bool ok = grid->board != NULL && grid->frame != NULL;
+    for (int game = 0; game < nbr_games && ok; ++game) {
+        grid->game_textures[game] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                                      grid->layout.width, grid->layout.height);
+        ok = grid->game_textures[game] != NULL;
+    }
+    if (!ok) {
+        printf("Disarray: spectator textures could not be created! SDL Error: %s\n", SDL_GetError());
+        terminate_spectator_grid(grid);
+        return false;
+    }
+    mark_spectator_grid_dirty(grid);
+    return true;
+}
+
+// The game is drawn again on the next draw_spectator_grid, e.g. after it got a move
+void mark_spectator_game_dirty(struct SpectatorGrid *grid, int game) {
+    if (!grid->dirty_games[game]) {
+        grid->dirty_games[game] = true;
+        grid->dirty_game_list[grid->nbr_dirty_games++] = game;
+    }
+}
+
+// Every game is drawn again on the next draw_spectator_grid, e.g. after the window lost its textures
+void mark_spectator_grid_dirty(struct SpectatorGrid *grid) {
+    grid->board_dirty = true;
+    grid->frame_dirty = true;
+}
+
+// Draws the games marked dirty into their textures and those into the frame, then shows it. Games that didn't change
+// cost nothing, a changed game is a copy of the empty board, its pieces in one SDL_RenderGeometry call and a copy into
+// the frame
+bool draw_spectator_grid(struct SpectatorGrid *grid, struct GameState game_states[]) {
+    struct GraphicsContext *graphics_context = grid->graphics_context;
+    SDL_Renderer *renderer = graphics_context->renderer;
+    graphics_context->draw_calls = 0;
+    if (grid->frame_dirty) {
+        for (int game = 0; game < grid->nbr_games; ++game) {
+            mark_spectator_game_dirty(grid, game);
+        }
+    }
+
+    // The squares without pieces, drawn once like the background of draw_board
+    if (grid->board_dirty) {
+        if (SDL_SetRenderTarget(renderer, grid->board) != 0) {
+            printf("Disarray: can't draw the spectator board! SDL Error: %s\n", SDL_GetError());
+            return false;
+        }
+        SDL_SetRenderDrawColor(renderer, background_color.r, background_color.g, background_color.b, background_color.a);
+        SDL_RenderClear(renderer);
+        struct GeometryBatch *batch = &graphics_context->highlight_batch;
+        batch->nbr_quads = 0;
+        for (int square_index = 0; square_index < grid->board_length; ++square_index) {
+            struct GraphicsSquare *graphics_square = &grid->graphics_board[square_index];
+            SDL_FRect rect = {graphics_square->x, graphics_square->y, grid->layout.square_width, grid->layout.square_width};
+            add_quad(batch, rect, graphics_square->light_squares ? light_squares_color : dark_squares_color,
+                     (SDL_FRect){0, 0, 0, 0});
+        }
+        draw_batch(graphics_context, batch, NULL);
+        grid->board_dirty = false;
+    }
+
+    bool piece_images = grid->layout.square_width >= GRAPHICS_LOD_SQUARE_WIDTH;
+    struct GeometryBatch *batch = &graphics_context->piece_batch;
+    for (int i = 0; i < grid->nbr_dirty_games; ++i) {
+        int game = grid->dirty_game_list[i];
+        struct GameState *game_state = &game_states[game];
+        SDL_SetRenderTarget(renderer, grid->game_textures[game]);
+        SDL_RenderCopy(renderer, grid->board, NULL, NULL);
+        ++graphics_context->draw_calls;
+        batch->nbr_quads = 0;
+        for (int square_index = 0; square_index < grid->board_length; ++square_index) {
+            struct Piece piece = game_state->board[square_index].piece;
+            if (game_state->board[square_index].part_of_board && piece.piece_type != NULL_PIECE_TYPE) {
+                struct GraphicsSquare *graphics_square = &grid->graphics_board[square_index];
+                SDL_FRect rect = {graphics_square->x, graphics_square->y, grid->layout.square_width,
+                                  grid->layout.square_width};
+                add_piece(graphics_context, batch, rect, piece);
+            }
+        }
+        draw_batch(graphics_context, batch, piece_images ? graphics_context->atlas : NULL);
+    }
+
+    SDL_SetRenderTarget(renderer, grid->frame);
+    if (grid->frame_dirty) {
+        SDL_SetRenderDrawColor(renderer, background_color.r, background_color.g, background_color.b, background_color.a);
+        SDL_RenderClear(renderer);
+    }
+    for (int i = 0; i < grid->nbr_dirty_games; ++i) {
+        int game = grid->dirty_game_list[i];
+        SDL_Rect cell = {(game % grid->nbr_columns) * grid->layout.width, (game / grid->nbr_columns) * grid->layout.height,
+                         grid->layout.width, grid->layout.height};
+        SDL_RenderCopy(renderer, grid->game_textures[game], NULL, &cell);
+        ++graphics_context->draw_calls;
+        grid->dirty_games[game] = false;
+    }
+    grid->games_drawn = grid->nbr_dirty_games;
+    grid->nbr_dirty_games = 0;
+    grid->frame_dirty = false;
+
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_RenderCopy(renderer, grid->frame, NULL, NULL);
+    ++graphics_context->draw_calls;
+    SDL_RenderPresent(renderer);
+    return true;
+}
+
+void terminate_spectator_grid(struct SpectatorGrid *grid) {
+    for (int game = 0; grid->game_textures != NULL && game < grid->nbr_games; ++game) {
+        if (grid->game_textures[game] != NULL) {
+            SDL_DestroyTexture(grid->game_textures[game]);
+        }
+    }
+    if (grid->board != NULL) {
+        SDL_DestroyTexture(grid->board);
+    }
+    if (grid->frame != NULL) {
+        SDL_DestroyTexture(grid->frame);
+    }
+    free(grid->graphics_board);
+    free(grid->game_textures);
+    free(grid->dirty_games);
+    free(grid->dirty_game_list);
+    memset(grid, 0, sizeof(*grid));
+}
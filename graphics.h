@@ -3,6 +3,16 @@
 
 #include "chess.h"
 #include "SDL.h"
+#include "board_layout.h"
+
+#define GRAPHICS_MAX_ZOOM 32.0f
+#define GRAPHICS_LOD_SQUARE_WIDTH 12    // pixels. Narrower squares get dots instead of piece images
+#define ANALYSIS_BAR_WIDTH 8            // pixels
+#define ANALYSIS_BAR_HALF_SCORE 400     // centipawns at which the evaluation bar is three quarters one color
+#define THREAT_MAX_ATTACKERS 4          // attackers of a square at which its threat tint is strongest
+#define HUD_FRAMES 240                  // latest frame times in the histogram of the performance HUD
+#define HUD_HISTOGRAM_BUCKETS 32        // one per millisecond, the last one for everything slower
+#define HUD_MAX_QUADS 1024
 
 enum Texture {
     TEXTURE_WHITE_PAWN,
@@ -41,16 +51,65 @@ enum GraphicsColor {
     GRAPHICS_COLOR_COUNT
 };
 
-struct GraphicsSquare {
-    int x;
-    int y;
-    bool light_squares;
+// What a square is highlighted with. A later one wins when a square has several
+enum Highlight {
+    HIGHLIGHT_NONE,
+    HIGHLIGHT_HOVERED,
+    HIGHLIGHT_SELECTED,
+    HIGHLIGHT_DIAGONAL_PAWN_MOVE,
+    HIGHLIGHT_MOVE,
+};
+
+// Quads for one SDL_RenderGeometry call, four vertices each
+struct GeometryBatch {
+    SDL_Vertex *vertices;
+    int nbr_quads;
 };
 
+enum HudTimer {
+    HUD_TIMER_FRAME,                    // from the first event handled to the frame shown
+    HUD_TIMER_DRAW_BOARD,
+    HUD_TIMER_GET_MOVES,                // of the last click
+    HUD_TIMER_WIN_CONDITIONS,           // of the last move
+    HUD_TIMERS_COUNT
+};
+
+// Where the time of the window goes, shown over the frame with F3. Only there with PERFORMANCE_HUD defined (make HUD=1),
+// see the HUD_TIMER macros
+struct PerformanceHud {
+    bool shown;
+    double milliseconds[HUD_TIMERS_COUNT];  // latest of each timer
+    float frame_milliseconds[HUD_FRAMES];   // ring of the latest frames
+    int  nbr_frames;                        // ever recorded
+    int  draw_calls;                        // of the latest frame, without the HUD
+    SDL_Vertex vertices[4 * HUD_MAX_QUADS];
+    int  indices[6 * HUD_MAX_QUADS];
+    int  nbr_vertices;
+    int  nbr_indices;
+};
+
+// Timers around the call sites the HUD shows, e.g.
+//   HUD_TIMER_START(start);
+//   draw_board(...);
+//   HUD_TIMER_STOP(graphics_context, HUD_TIMER_DRAW_BOARD, start);
+// HUD_TIMER_RESTART starts a timer declared by HUD_TIMER_START again. Without PERFORMANCE_HUD nothing is left of them
+#ifdef PERFORMANCE_HUD
+#define HUD_TIMER_START(start) Uint64 start = SDL_GetPerformanceCounter()
+#define HUD_TIMER_RESTART(start) start = SDL_GetPerformanceCounter()
+#define HUD_TIMER_STOP(graphics_context, timer, start) record_hud_time(&(graphics_context)->hud, timer, start)
+#else
+#define HUD_TIMER_START(start) ((void)0)
+#define HUD_TIMER_RESTART(start) ((void)0)
+#define HUD_TIMER_STOP(graphics_context, timer, start) ((void)0)
+#endif
+
 struct GraphicsContext {
     SDL_Window *window;
     SDL_Renderer *renderer;
-    SDL_Texture *textures[TEXTURES_COUNT];
+    SDL_Texture *atlas;                 // all piece images in one texture
+    SDL_Rect atlas_rects[TEXTURES_COUNT];
+    int atlas_width;
+    int atlas_height;
     //SDL_Surface *window_surface;
     //SDL_Surface *surfaces[SURFACES_COUNT];    // TODO change from surface to texture and use renderer
     int square_width;
@@ -60,19 +119,96 @@ struct GraphicsContext {
     int board_total_width;
     struct GraphicsSquare *graphics_board;       // 1D array representing nD board. Can be large -> malloc
     int graphics_board_length;
+    // Squares are laid out with the even dimensions along x and the odd ones along y, so the square at a pixel is the
+    // part of the square index from its column plus the part from its row. -1 between squares
+    int *square_index_part_at_x;        // [window_width]
+    int *square_index_part_at_y;        // [window_height]
+    int hovered_square;                 // -1 if none
+    // Camera, a board pixel is drawn at board * zoom + pan in the window. zoom 1 shows the whole board
+    float zoom;
+    float pan_x;
+    float pan_y;
+    int *visible_column_parts;          // scratch for draw_board, [window_width]
+    int *visible_row_parts;             // [window_height]
     struct RgbaColor rgba_colors[GRAPHICS_COLOR_COUNT];     // not used?
+    // The window content is kept in frame and only the squares that changed are drawn into it again
+    SDL_Texture *frame;
+    bool frame_dirty;                   // draw all of frame again
+    bool *dirty_squares;                // per square, to draw again on the next draw_board
+    int  *dirty_square_list;
+    int  nbr_dirty_squares;
+    enum Highlight *highlights;         // per square, as drawn in frame
+    enum Highlight *next_highlights;    // per square, HIGHLIGHT_NONE except while draw_board works out new highlights
+    int  *highlighted_squares;          // squares with a highlight in frame
+    int  nbr_highlighted_squares;
+    // Squares without highlights or pieces, drawn once
+    SDL_Texture *background;
+    bool background_dirty;
+    struct GeometryBatch background_batch;  // squares copied from background
+    struct GeometryBatch highlight_batch;
+    struct GeometryBatch piece_batch;       // from atlas
+    int  *quad_indices;                     // two triangles per quad, the same for every batch
+    int  draw_calls;                        // by the last draw_board
+    // Engine analysis drawn over the frame, see set_graphics_analysis
+    bool show_analysis;
+    struct Move analysis_best_move;         // destination_square -1 for no arrow
+    int  analysis_white_score;              // centipawns, from white's point of view
+#ifdef PERFORMANCE_HUD
+    struct PerformanceHud hud;
+#endif
+    // Attackers of every square tinted over it, see set_graphics_threats
+    bool show_threats;
+    int  *threat_counts[PIECE_COLOR_COUNT]; // per square, as drawn in frame
+    struct GeometryBatch threat_batch;
     //int separation_width_for_dim[MAX_DIMENSIONS];   // remove this
     //int coordinates_for_dim[MAX_DIMENSIONS][MAX_SIDE_LENGTH];   // remove this
 };
 
+// Many games of one variant in one window, e.g. to watch a tournament. Every game is kept in a texture of its own that
+// is only drawn again when the game changed, the window is put together from those. See draw_spectator_grid
+struct SpectatorGrid {
+    struct GraphicsContext *graphics_context;   // window, renderer, piece atlas and batches
+    int  nbr_games;
+    int  nbr_columns;
+    int  nbr_rows;
+    struct BoardLayout layout;                  // of one game in its cell, the same for every game
+    struct GraphicsSquare *graphics_board;      // [board_length]
+    int  board_length;
+    SDL_Texture *board;                         // the squares without pieces, cell sized
+    bool board_dirty;
+    SDL_Texture **game_textures;                // [nbr_games], cell sized
+    bool *dirty_games;                          // per game, to draw again on the next draw_spectator_grid
+    int  *dirty_game_list;
+    int  nbr_dirty_games;
+    SDL_Texture *frame;                         // the window content
+    bool frame_dirty;
+    int  games_drawn;                           // by the last draw_spectator_grid
+};
+
 bool initialize_graphics(struct GraphicsContext *graphics_context, int dimensions, int board_shape[]);
-bool load_graphics_media(SDL_Texture *textures[TEXTURES_COUNT], SDL_Renderer *renderer);
+bool load_graphics_media(struct GraphicsContext *graphics_context);
 bool draw_board(struct GraphicsContext *graphics_context, struct GameState *game_state, int selected_square, struct Move moves[], 
                 struct Move diagonal_pawn_moves[]);
-int  get_square_index_at_coordinates(int x, int y, struct GraphicsSquare *graphics_board, int graphics_board_length, 
-                                     int square_width);
+void mark_square_dirty(struct GraphicsContext *graphics_context, int square_index);
+void mark_board_dirty(struct GraphicsContext *graphics_context);
+void set_graphics_analysis(struct GraphicsContext *graphics_context, struct Move best_move, int white_score);
+void set_graphics_threats(struct GraphicsContext *graphics_context, int *attack_counts[PIECE_COLOR_COUNT]);
+#ifdef PERFORMANCE_HUD
+void record_hud_time(struct PerformanceHud *hud, enum HudTimer timer, Uint64 start);
+#endif
+void zoom_camera(struct GraphicsContext *graphics_context, float factor, int x, int y);
+void pan_camera(struct GraphicsContext *graphics_context, float dx, float dy);
+void reset_camera(struct GraphicsContext *graphics_context);
+int  get_square_index_at_coordinates(struct GraphicsContext *graphics_context, int x, int y);
 void terminate_graphics(struct GraphicsContext *graphics_context);
 
+bool initialize_spectator_grid(struct SpectatorGrid *grid, struct GraphicsContext *graphics_context, int nbr_games,
+                               int dimensions, int board_shape[]);
+void mark_spectator_game_dirty(struct SpectatorGrid *grid, int game);
+void mark_spectator_grid_dirty(struct SpectatorGrid *grid);
+bool draw_spectator_grid(struct SpectatorGrid *grid, struct GameState game_states[]);
+void terminate_spectator_grid(struct SpectatorGrid *grid);
+
 // returns n by 3 array with coordinates of where it drew the promotion options and which PieceType
 // [[x, y, PieceType], ... ]
 void draw_promotion_options(int square, enum PieceType promotion_options[], struct GraphicsContext *graphics_context,
@@ -0,0 +1,302 @@
+#define _POSIX_C_SOURCE 200809L     // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "chess4d.h"
+
+// Load for game_server: opens idle games that wait for an opponent, then plays random games on a few more connections
+// and measures the round trip of every move. Prints the latency percentiles and the validation time the server measured,
+// e.g.
+//   ./game_server & ./load_generator -idle 10000 -games 50 -moves 100
+
+#define DEFAULT_PORT 7474
+#define MAX_LINE_LENGTH 256
+
+struct Client {
+    int fd;
+    char input[MAX_LINE_LENGTH];
+    int input_length;
+};
+
+struct ActiveGame {
+    struct Client players[PIECE_COLOR_COUNT];
+    struct Rules rules;
+    struct GameState game_state;
+    int nbr_moves;
+    bool over;
+};
+
+static bool connect_client(struct Client *client, int port, const char *unix_path);
+static bool send_text(struct Client *client, const char *text);
+static bool read_line(struct Client *client, char line[MAX_LINE_LENGTH], const char *prefix);
+static bool play_random_move(struct ActiveGame *game, unsigned long long *random_state, double *latency);
+static int  compare_doubles(const void *a, const void *b);
+static double seconds_now(void);
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    const char *unix_path = NULL;
+    int nbr_idle_games = 10000;
+    int nbr_active_games = 50;
+    int max_moves = 100;
+    enum Variant variant = STANDARD_CHESS;
+    unsigned long long random_state = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-port") == 0) {
+            port = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "-unix") == 0) {
+            unix_path = argv[i+1];
+        } else if (strcmp(argv[i], "-idle") == 0) {
+            nbr_idle_games = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "-games") == 0) {
+            nbr_active_games = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "-moves") == 0) {
+            max_moves = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "-variant") == 0) {
+            if (!variant_from_name(argv[i+1], &variant)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-seed") == 0) {
+            random_state = strtoull(argv[i+1], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-positions") == 0) {
+            if (!load_starting_position_cache(argv[i+1])) {
+                return 1;
+            }
+        } else {
+            argc = 0;
+        }
+    }
+    if (argc % 2 == 0 || nbr_idle_games < 0 || nbr_active_games < 1) {
+        printf("usage: load_generator [-port n] [-unix path] [-idle n] [-games n] [-moves n] [-variant name] [-seed n]\n"
+               "                      [-positions file]\n");
+        return 1;
+    }
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Idle games, one player each waiting for an opponent
+    struct Client *idle_clients = malloc(sizeof(*idle_clients) * (nbr_idle_games + 1));
+    struct ActiveGame *games = malloc(sizeof(*games) * nbr_active_games);
+    double *latencies = malloc(sizeof(*latencies) * ((size_t)nbr_active_games * max_moves + 1));
+    if (idle_clients == NULL || games == NULL || latencies == NULL) {
+        printf("Catastrophe: out of memory\n");
+        return 1;
+    }
+    char line[MAX_LINE_LENGTH];
+    char command[MAX_LINE_LENGTH];
+    snprintf(command, sizeof(command), "new %s\n", variant_name(variant));
+    double start_time = seconds_now();
+    int nbr_idle_clients = 0;
+    for (; nbr_idle_clients < nbr_idle_games; ++nbr_idle_clients) {
+        struct Client *client = &idle_clients[nbr_idle_clients];
+        if (!connect_client(client, port, unix_path) || !send_text(client, command) || !read_line(client, line, "game ")) {
+            printf("Havoc: only %i idle games, %s\n", nbr_idle_clients, strerror(errno));
+            break;
+        }
+    }
+    printf("%i idle games opened in %.2f s\n", nbr_idle_clients, seconds_now() - start_time);
+
+    // Active games, both players on their own connection
+    int nbr_games = 0;
+    for (; nbr_games < nbr_active_games; ++nbr_games) {
+        struct ActiveGame *game = &games[nbr_games];
+        struct Client *white = &game->players[PIECE_COLOR_WHITE];
+        struct Client *black = &game->players[PIECE_COLOR_BLACK];
+        if (!connect_client(white, port, unix_path) || !send_text(white, command) || !read_line(white, line, "game ") ||
+                !connect_client(black, port, unix_path)) {
+            printf("Havoc: only %i active games\n", nbr_games);
+            break;
+        }
+        char join[MAX_LINE_LENGTH];
+        snprintf(join, sizeof(join), "join %i\n", atoi(line + strlen("game ")));
+        if (!send_text(black, join) || !read_line(black, line, "start") || !read_line(white, line, "start") ||
+                !start_game(&game->rules, &game->game_state, variant)) {
+            printf("Havoc: can't join game\n");
+            break;
+        }
+        game->nbr_moves = 0;
+        game->over = false;
+    }
+
+    // One move per game per round, so that all games are in progress at the same time
+    int nbr_latencies = 0;
+    start_time = seconds_now();
+    bool any_playing = true;
+    while (any_playing) {
+        any_playing = false;
+        for (int i = 0; i < nbr_games; ++i) {
+            struct ActiveGame *game = &games[i];
+            if (game->over) {
+                continue;
+            }
+            if (!play_random_move(game, &random_state, &latencies[nbr_latencies])) {
+                game->over = true;
+                continue;
+            }
+            ++nbr_latencies;
+            game->over = game->over || ++game->nbr_moves >= max_moves;
+            any_playing = true;
+        }
+    }
+    double seconds = seconds_now() - start_time;
+
+    qsort(latencies, nbr_latencies, sizeof(*latencies), compare_doubles);
+    printf("%i moves in %i games in %.2f s, %.0f moves/s\n", nbr_latencies, nbr_games, seconds,
+           seconds > 0 ? nbr_latencies / seconds : 0.0);
+    if (nbr_latencies > 0) {
+        printf("move round trip: p50 %.1f us, p99 %.1f us, max %.1f us\n", 1e6 * latencies[nbr_latencies / 2],
+               1e6 * latencies[nbr_latencies * 99 / 100], 1e6 * latencies[nbr_latencies - 1]);
+    }
+    if (nbr_games > 0 && send_text(&games[0].players[PIECE_COLOR_WHITE], "stats\n") &&
+            read_line(&games[0].players[PIECE_COLOR_WHITE], line, "stats ")) {
+        printf("server %s\n", line);
+    }
+
+    for (int i = 0; i < nbr_games; ++i) {
+        close(games[i].players[PIECE_COLOR_WHITE].fd);
+        close(games[i].players[PIECE_COLOR_BLACK].fd);
+        terminate_game_state(&games[i].game_state);
+    }
+    for (int i = 0; i < nbr_idle_clients; ++i) {
+        close(idle_clients[i].fd);
+    }
+    free(idle_clients);
+    free(games);
+    free(latencies);
+    return 0;
+}
+
+// Sends a random legal move for the side to move and waits for the server to confirm it to both players. false when the
+// game is over
+static bool play_random_move(struct ActiveGame *game, unsigned long long *random_state, double *latency) {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game->game_state, &game->rules);
+    if (nbr_moves == 0) {
+        return false;
+    }
+    struct Move move = moves[next_random(random_state) % (unsigned long long)nbr_moves];
+    enum PieceType promotion_piece_type = NULL_PIECE_TYPE;
+    if (evaluate_promotion(move.origin_square, move.destination_square, &game->game_state, &game->rules)) {
+        promotion_piece_type = QUEEN;
+    }
+    char command[MAX_MOVE_TEXT_LENGTH + 8] = "move ";
+    move_to_text(move, promotion_piece_type, command + strlen(command), &game->rules);
+    strcat(command, "\n");
+
+    struct Client *mover = &game->players[game->game_state.whos_turn];
+    struct Client *opponent = &game->players[1 - game->game_state.whos_turn];
+    char line[MAX_LINE_LENGTH];
+    double start_time = seconds_now();
+    if (!send_text(mover, command) || !read_line(mover, line, "moved ")) {
+        printf("Havoc: %s", command);
+        return false;
+    }
+    *latency = seconds_now() - start_time;
+    read_line(opponent, line, "moved ");
+
+    make_move(move, promotion_piece_type, &game->game_state, &game->rules);
+    if (get_winner(move, &game->game_state, &game->rules) != NULL_PIECE_COLOR) {
+        read_line(mover, line, "winner ");
+        read_line(opponent, line, "winner ");
+        game->over = true;
+    }
+    return true;
+}
+
+static bool connect_client(struct Client *client, int port, const char *unix_path) {
+    client->input_length = 0;
+    if (unix_path != NULL) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", unix_path);
+        client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (client->fd == -1 || connect(client->fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+            return false;
+        }
+        return true;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client->fd == -1 || connect(client->fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        return false;
+    }
+    int no_delay = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    return true;
+}
+
+static bool send_text(struct Client *client, const char *text) {
+    size_t length = strlen(text);
+    size_t sent = 0;
+    while (sent < length) {
+        ssize_t nbr_written = send(client->fd, text + sent, length - sent, MSG_NOSIGNAL);
+        if (nbr_written == -1 && errno != EINTR) {
+            return false;
+        }
+        sent += nbr_written > 0 ? nbr_written : 0;
+    }
+    return true;
+}
+
+// Reads lines until one starts with prefix. false on errors from the server or a closed connection
+static bool read_line(struct Client *client, char line[MAX_LINE_LENGTH], const char *prefix) {
+    while (true) {
+        char *newline = memchr(client->input, '\n', client->input_length);
+        if (newline != NULL) {
+            int length = newline - client->input;
+            memcpy(line, client->input, length);
+            line[length] = '\0';
+            client->input_length -= length + 1;
+            memmove(client->input, newline + 1, client->input_length);
+            if (strncmp(line, prefix, strlen(prefix)) == 0) {
+                return true;
+            }
+            if (strncmp(line, "error", strlen("error")) == 0) {
+                printf("%s\n", line);
+                return false;
+            }
+            continue;
+        }
+        if (client->input_length == MAX_LINE_LENGTH) {
+            client->input_length = 0;   // longer than any line it waits for
+        }
+        ssize_t nbr_read = read(client->fd, client->input + client->input_length, MAX_LINE_LENGTH - client->input_length);
+        if (nbr_read <= 0) {
+            if (nbr_read == -1 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        client->input_length += nbr_read;
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double difference = *(const double *)a - *(const double *)b;
+    return (difference > 0) - (difference < 0);
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
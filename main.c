@@ -1,10 +1,24 @@
 #include <stdio.h>
-#include "chess.h"
+#include <stdlib.h>
+#include "chess4d.h"
 #include "graphics.h"
 //#include <SDL.h>
 #include "SDL.h"
 #include <stdbool.h>
 
+#define IDLE_WAIT_MS 1000   // longest sleep without events, nothing is drawn when it runs out
+#define ZOOM_STEP 1.25f     // per wheel notch or key press
+#define PAN_STEP 64         // pixels per arrow key press
+#define ANALYSIS_SECONDS 30 // per position, the analysis thread sleeps after that
+
+// Called on the analysis thread, the event wakes the loop below to poll the result
+static void push_analysis_event(void *argument) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = *(Uint32 *)argument;
+    SDL_PushEvent(&event);
+}
+
 int main() {
     //enum Variant variant = STANDARD_10X10_CHESS;          //
     //enum Variant variant = LONG_RANGE_CHESS;              //
@@ -48,52 +62,162 @@ int main() {
         printf("initialize_graphics failed\n");
         return -1;
     }
-    if(!load_graphics_media(graphics_context.textures, graphics_context.renderer)) {
+    if(!load_graphics_media(&graphics_context)) {
         printf("load_graphics_media failed\n");
         return -1;
     }
 
+    // Moves of the side to move are generated in the background, so selecting a piece only looks them up
+    unsigned long long hash = position_hash(&game_state, &rules, variant);
+    struct MoveCache move_cache;
+    if (!initialize_move_cache(&move_cache, &game_state, &rules, hash)) {
+        printf("initialize_move_cache failed\n");
+        return -1;
+    }
+
+    // The engine analyzes every position in the background, 'a' shows its evaluation and best move
+    static Uint32 analysis_event_type;
+    analysis_event_type = SDL_RegisterEvents(1);
+    struct SearchOptions analysis_options;
+    default_search_options(&analysis_options);
+    analysis_options.max_seconds = ANALYSIS_SECONDS;
+    static struct Analysis analysis;
+    if (    analysis_event_type == (Uint32)-1 ||
+            !initialize_analysis(&analysis, &rules, &analysis_options, push_analysis_event, &analysis_event_type)) {
+        printf("initialize_analysis failed\n");
+        return -1;
+    }
+    analyze_position(&analysis, &game_state, hash);
+    struct AnalysisResult analysis_result;
+
+    // 'h' tints every square by how many pieces of each color attack it, counted once per position
+    int board_length = 1;
+    for (int dim = 0; dim < rules.dimensions; ++dim) {
+        board_length *= rules.board_shape[dim];
+    }
+    int *attack_counts[PIECE_COLOR_COUNT] = {malloc(sizeof(int) * board_length), malloc(sizeof(int) * board_length)};
+    if (attack_counts[PIECE_COLOR_WHITE] == NULL || attack_counts[PIECE_COLOR_BLACK] == NULL) {
+        printf("Tragedy: no memory for attack counts\n");
+        return -1;
+    }
+    bool show_threats = false;
+    bool threats_counted = false;
+    unsigned long long threats_hash = 0;
+
     int selected_square_index = -1;
     struct Move moves[MAX_MOVES_SINGLE_PIECE];
     moves[0].destination_square = -1;
     struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
     diagonal_pawn_moves[0].destination_square = -1;
+    static struct MoveUndo undo;
     SDL_Event event;
-    int frameDelay = 16;    // 16*60=960
 
+    // Nothing is drawn until something changes, the loop sleeps in SDL_WaitEventTimeout in between
     bool quit = false;
     bool promotion_choice_flag = false;
+    bool redraw = true;
+    HUD_TIMER_START(frame_start);
     while (!quit) {
-        int frameStart = SDL_GetTicks();
-        while (SDL_PollEvent(&event) != 0) {
+        if (redraw) {
+            if (show_threats && (!threats_counted || threats_hash != hash)) {
+                count_attacks(attack_counts, &game_state, &rules);
+                threats_counted = true;
+                threats_hash = hash;
+            }
+            set_graphics_threats(&graphics_context, show_threats ? attack_counts : NULL);
+            HUD_TIMER_START(draw_start);
+            draw_board(&graphics_context, &game_state, selected_square_index, moves, diagonal_pawn_moves);
+            HUD_TIMER_STOP(&graphics_context, HUD_TIMER_DRAW_BOARD, draw_start);
+            HUD_TIMER_STOP(&graphics_context, HUD_TIMER_FRAME, frame_start);
+            redraw = false;
+        }
+        if (!SDL_WaitEventTimeout(&event, IDLE_WAIT_MS)) {
+            continue;
+        }
+        HUD_TIMER_RESTART(frame_start);
+        do {
             switch (event.type) {
                 case SDL_QUIT: 
                     quit = true;
                     break;
-                case SDL_KEYDOWN:
-                    if (event.key.keysym.sym == SDLK_DOWN) {
-                        ;
+                case SDL_WINDOWEVENT:
+                    // The frame is still there, it only has to be shown again
+                    if (event.window.event == SDL_WINDOWEVENT_EXPOSED || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                        redraw = true;
+                    } else if (event.window.event == SDL_WINDOWEVENT_LEAVE && graphics_context.hovered_square != -1) {
+                        graphics_context.hovered_square = -1;
+                        redraw = true;
+                    }
+                    break;
+                case SDL_RENDER_TARGETS_RESET:
+                case SDL_RENDER_DEVICE_RESET:
+                    mark_board_dirty(&graphics_context);
+                    redraw = true;
+                    break;
+                case SDL_MOUSEMOTION: {
+                    // Dragging with the right or middle button pans the camera
+                    if (event.motion.state & (SDL_BUTTON_RMASK | SDL_BUTTON_MMASK)) {
+                        pan_camera(&graphics_context, event.motion.xrel, event.motion.yrel);
+                        redraw = true;
+                    }
+                    int hovered_square = get_square_index_at_coordinates(&graphics_context, event.motion.x, event.motion.y);
+                    if (hovered_square != graphics_context.hovered_square) {
+                        graphics_context.hovered_square = hovered_square;
+                        redraw = true;
                     }
                     break;
+                }
+                case SDL_MOUSEWHEEL: {
+                    int x, y;
+                    SDL_GetMouseState(&x, &y);
+                    zoom_camera(&graphics_context, event.wheel.y > 0 ? ZOOM_STEP : 1 / ZOOM_STEP, x, y);
+                    redraw = true;
+                    break;
+                }
+                case SDL_KEYDOWN: {
+                    // Arrow keys pan, + and - zoom around the middle of the window, 0 shows the whole board again
+                    int middle_x = graphics_context.window_width / 2, middle_y = graphics_context.window_height / 2;
+                    redraw = true;
+                    switch (event.key.keysym.sym) {
+                        case SDLK_LEFT:   pan_camera(&graphics_context, PAN_STEP, 0); break;
+                        case SDLK_RIGHT:  pan_camera(&graphics_context, -PAN_STEP, 0); break;
+                        case SDLK_UP:     pan_camera(&graphics_context, 0, PAN_STEP); break;
+                        case SDLK_DOWN:   pan_camera(&graphics_context, 0, -PAN_STEP); break;
+                        case SDLK_PLUS:
+                        case SDLK_EQUALS:
+                        case SDLK_KP_PLUS:  zoom_camera(&graphics_context, ZOOM_STEP, middle_x, middle_y); break;
+                        case SDLK_MINUS:
+                        case SDLK_KP_MINUS: zoom_camera(&graphics_context, 1 / ZOOM_STEP, middle_x, middle_y); break;
+                        case SDLK_0:      reset_camera(&graphics_context); break;
+                        case SDLK_a:      graphics_context.show_analysis = !graphics_context.show_analysis; break;
+                        case SDLK_h:      show_threats = !show_threats; break;
+#ifdef PERFORMANCE_HUD
+                        case SDLK_F3:     graphics_context.hud.shown = !graphics_context.hud.shown; break;
+#endif
+                        default:          redraw = false; break;
+                    }
+                    break;
+                }
                 case SDL_MOUSEBUTTONDOWN:
                     if (event.button.button != SDL_BUTTON_LEFT) { break; }
                     if (promotion_choice_flag) {
                         // they just clicked on one of the choices, or outside it
                         continue;
                     }
+                    redraw = true;
 
-                    int square_index = get_square_index_at_coordinates(event.button.x, event.button.y, 
-                                                        graphics_context.graphics_board, graphics_context.graphics_board_length, 
-                                                        graphics_context.square_width);
+                    int square_index = get_square_index_at_coordinates(&graphics_context, event.button.x, event.button.y);
                     if (square_index == -1 || square_index == selected_square_index) {  // outside board -> reset highlighted squares
                         selected_square_index = -1;
                         moves[0].destination_square = -1;
                         diagonal_pawn_moves[0].destination_square = -1;
                     } else if (selected_square_index == -1) {   // on board -> highlight squares
                         selected_square_index = square_index;
-                        get_moves(moves, diagonal_pawn_moves, square_index, &game_state, &rules);
+                        HUD_TIMER_START(get_moves_start);
+                        get_cached_moves(&move_cache, moves, diagonal_pawn_moves, square_index, &game_state, hash);
+                        HUD_TIMER_STOP(&graphics_context, HUD_TIMER_GET_MOVES, get_moves_start);
                     } else {                                    // on board and squares already highlighted -> make move or highlight new square
-                        get_moves(moves, diagonal_pawn_moves, selected_square_index, &game_state, &rules);
+                        // moves are still those of the selected square
                         struct Move move = validate_selected_move(selected_square_index, square_index, moves, &game_state, &rules);
                         if (move.destination_square != -1) {
                             enum PieceType promote_to_piece_type;
@@ -104,29 +228,50 @@ int main() {
                                 promote_to_piece_type = NULL_PIECE_TYPE;
                             }
 
-                            make_move(move, promote_to_piece_type, &game_state, &rules);
+                            // Only the squares the move changed are drawn again
+                            make_move_with_undo(move, promote_to_piece_type, &game_state, &rules, &undo);
+                            for (int i = 0; i < undo.nbr_square_changes; ++i) {
+                                mark_square_dirty(&graphics_context, undo.square_changes[i].square_index);
+                            }
+                            hash = update_position_hash(hash, &undo, &game_state);
+                            set_move_cache_position(&move_cache, &game_state, hash);
+                            analyze_position(&analysis, &game_state, hash);
+                            struct Move no_move = {.destination_square = -1};
+                            set_graphics_analysis(&graphics_context, no_move, graphics_context.analysis_white_score);
                             selected_square_index = -1;
                             moves[0].destination_square = -1;
                             diagonal_pawn_moves[0].destination_square = -1;
-                            if (evaluate_win_conditions(move, &game_state, &rules)) {
+                            HUD_TIMER_START(win_conditions_start);
+                            bool game_over = evaluate_win_conditions(move, &game_state, &rules);
+                            HUD_TIMER_STOP(&graphics_context, HUD_TIMER_WIN_CONDITIONS, win_conditions_start);
+                            if (game_over) {
                                 quit = true;
                             }
                         } else {
                             selected_square_index = square_index;
-                            get_moves(moves, diagonal_pawn_moves, selected_square_index, &game_state, &rules);
+                            HUD_TIMER_START(get_moves_start);
+                            get_cached_moves(&move_cache, moves, diagonal_pawn_moves, square_index, &game_state, hash);
+                            HUD_TIMER_STOP(&graphics_context, HUD_TIMER_GET_MOVES, get_moves_start);
                         }
                     }
                     break;
+                default:
+                    if (event.type == analysis_event_type && poll_analysis(&analysis, &analysis_result) &&
+                            analysis_result.hash == hash) {
+                        int white_score = analysis_result.side_to_move == PIECE_COLOR_WHITE ? analysis_result.score :
+                                                                                              -analysis_result.score;
+                        set_graphics_analysis(&graphics_context, analysis_result.best_move, white_score);
+                        redraw = redraw || graphics_context.show_analysis;
+                    }
+                    break;
             }
-        }
-        draw_board(&graphics_context, &game_state, selected_square_index, moves, diagonal_pawn_moves);
-
-        int frameTime = SDL_GetTicks() - frameStart;
-        if(frameDelay > frameTime) {
-            SDL_Delay(frameDelay - frameTime);
-        }
+        } while (!quit && SDL_PollEvent(&event));
     }
 
+    free(attack_counts[PIECE_COLOR_WHITE]);
+    free(attack_counts[PIECE_COLOR_BLACK]);
+    terminate_analysis(&analysis);
+    terminate_move_cache(&move_cache);
     terminate_graphics(&graphics_context);
     terminate_game_state(&game_state);
     return 0;
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+
+// Moves of the pieces in the position the UI shows, keyed by position hash and square, so that selecting a piece and
+// clicking its destination don't generate moves. After every move a background thread generates the moves of all
+// pieces of the side to move, a square that isn't done yet is generated by the caller and kept as well.
+// The moves of one position are packed one after another in pool. An entry is valid while its generation is the
+// generation of the cache, so handing over a new position drops every entry without touching them
+
+static void *move_cache_thread(void *argument);
+static void store_moves(struct MoveCache *cache, unsigned int generation, int square_index, struct Move moves[],
+                        struct Move diagonal_pawn_moves[]);
+static int  count_moves(struct Move moves[]);
+
+// Starts the background thread on the position. false if there's no memory or no thread
+bool initialize_move_cache(struct MoveCache *cache, struct GameState *game_state, struct Rules *rules,
+                           unsigned long long hash) {
+    memset(cache, 0, sizeof(*cache));
+    cache->rules = *rules;
+    cache->board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        cache->board_length *= rules->board_shape[dim];
+    }
+    cache->position.board = malloc(sizeof(struct Square) * cache->board_length);
+    cache->entries = calloc(cache->board_length, sizeof(struct MoveCacheEntry));
+    cache->pool = malloc(sizeof(struct Move) * MOVE_CACHE_POOL_LENGTH);
+    if (cache->position.board == NULL || cache->entries == NULL || cache->pool == NULL) {
+        printf("Tragedy: no memory for the move cache\n");
+        terminate_move_cache(cache);
+        return false;
+    }
+    pthread_mutex_init(&cache->mutex, NULL);
+    pthread_cond_init(&cache->condition, NULL);
+    cache->synchronization_initialized = true;
+    set_move_cache_position(cache, game_state, hash);
+    if (pthread_create(&cache->thread, NULL, move_cache_thread, cache) != 0) {
+        printf("Havoc: can't start the move cache thread\n");
+        terminate_move_cache(cache);
+        return false;
+    }
+    cache->thread_started = true;
+    return true;
+}
+
+void terminate_move_cache(struct MoveCache *cache) {
+    if (cache->thread_started) {
+        pthread_mutex_lock(&cache->mutex);
+        cache->quit = true;
+        pthread_cond_signal(&cache->condition);
+        pthread_mutex_unlock(&cache->mutex);
+        pthread_join(cache->thread, NULL);
+        cache->thread_started = false;
+    }
+    if (cache->synchronization_initialized) {
+        pthread_mutex_destroy(&cache->mutex);
+        pthread_cond_destroy(&cache->condition);
+        cache->synchronization_initialized = false;
+    }
+    free(cache->position.board);
+    free(cache->entries);
+    free(cache->pool);
+    cache->position.board = NULL;
+    cache->entries = NULL;
+    cache->pool = NULL;
+}
+
+// Call after every move with the new position and its hash. Work on the previous position is dropped
+void set_move_cache_position(struct MoveCache *cache, struct GameState *game_state, unsigned long long hash) {
+    pthread_mutex_lock(&cache->mutex);
+    struct Square *board = cache->position.board;
+    cache->position = *game_state;
+    cache->position.board = board;
+    memcpy(board, game_state->board, sizeof(struct Square) * cache->board_length);
+    cache->hash = hash;
+    ++cache->generation;
+    cache->pool_length = 0;
+    pthread_cond_signal(&cache->condition);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// Same as get_moves. From the cache if the square of the position is in it, else generated and kept for next time
+void get_cached_moves(struct MoveCache *cache, struct Move moves[MAX_MOVES_SINGLE_PIECE],
+                      struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE], int square_index,
+                      struct GameState *game_state, unsigned long long hash) {
+    pthread_mutex_lock(&cache->mutex);
+    struct MoveCacheEntry entry = cache->entries[square_index];
+    if (hash == cache->hash && entry.generation == cache->generation) {
+        memcpy(moves, &cache->pool[entry.first_move], sizeof(struct Move) * entry.nbr_moves);
+        memcpy(diagonal_pawn_moves, &cache->pool[entry.first_move + entry.nbr_moves],
+               sizeof(struct Move) * entry.nbr_diagonal_pawn_moves);
+        moves[entry.nbr_moves].destination_square = -1;
+        diagonal_pawn_moves[entry.nbr_diagonal_pawn_moves].destination_square = -1;
+        ++cache->hits;
+        pthread_mutex_unlock(&cache->mutex);
+        return;
+    }
+    ++cache->misses;
+    unsigned int generation = hash == cache->hash ? cache->generation : 0;
+    pthread_mutex_unlock(&cache->mutex);
+
+    get_moves(moves, diagonal_pawn_moves, square_index, game_state, &cache->rules);
+    if (generation != 0) {
+        store_moves(cache, generation, square_index, moves, diagonal_pawn_moves);
+    }
+}
+
+// true once the background thread has generated the moves of every piece of the side to move in the latest position
+bool move_cache_complete(struct MoveCache *cache) {
+    pthread_mutex_lock(&cache->mutex);
+    bool complete = cache->completed_generation == cache->generation;
+    pthread_mutex_unlock(&cache->mutex);
+    return complete;
+}
+
+// Generates on its own copy of the position, the lock is only held to look at and fill the cache
+static void *move_cache_thread(void *argument) {
+    struct MoveCache *cache = argument;
+    struct GameState game_state;
+    game_state.board = malloc(sizeof(struct Square) * cache->board_length);
+    if (game_state.board == NULL) {
+        printf("Tragedy: no memory for the move cache thread\n");
+        return NULL;
+    }
+    struct Move moves[MAX_MOVES_SINGLE_PIECE];
+    struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+
+    pthread_mutex_lock(&cache->mutex);
+    while (!cache->quit) {
+        if (cache->completed_generation == cache->generation) {
+            pthread_cond_wait(&cache->condition, &cache->mutex);
+            continue;
+        }
+        unsigned int generation = cache->generation;
+        struct Square *board = game_state.board;
+        game_state = cache->position;
+        game_state.board = board;
+        memcpy(board, cache->position.board, sizeof(struct Square) * cache->board_length);
+        pthread_mutex_unlock(&cache->mutex);
+
+        bool dropped = false;
+        for (int square_index = 0; square_index < cache->board_length && !dropped; ++square_index) {
+            struct Square square = game_state.board[square_index];
+            if (    !square.part_of_board || square.piece.piece_type == NULL_PIECE_TYPE ||
+                    square.piece.piece_color != game_state.whos_turn) {
+                continue;
+            }
+            pthread_mutex_lock(&cache->mutex);
+            dropped = cache->quit || cache->generation != generation;
+            bool done = cache->entries[square_index].generation == generation;
+            pthread_mutex_unlock(&cache->mutex);
+            if (!dropped && !done) {
+                get_moves(moves, diagonal_pawn_moves, square_index, &game_state, &cache->rules);
+                store_moves(cache, generation, square_index, moves, diagonal_pawn_moves);
+            }
+        }
+
+        pthread_mutex_lock(&cache->mutex);
+        if (!dropped) {
+            cache->completed_generation = generation;
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    free(game_state.board);
+    return NULL;
+}
+
+// Keeps the moves unless the position changed meanwhile, the square is already there or the pool is full
+static void store_moves(struct MoveCache *cache, unsigned int generation, int square_index, struct Move moves[],
+                        struct Move diagonal_pawn_moves[]) {
+    int nbr_moves = count_moves(moves);
+    int nbr_diagonal_pawn_moves = count_moves(diagonal_pawn_moves);
+    pthread_mutex_lock(&cache->mutex);
+    struct MoveCacheEntry *entry = &cache->entries[square_index];
+    if (    generation == cache->generation && entry->generation != generation &&
+            cache->pool_length + nbr_moves + nbr_diagonal_pawn_moves <= MOVE_CACHE_POOL_LENGTH) {
+        memcpy(&cache->pool[cache->pool_length], moves, sizeof(struct Move) * nbr_moves);
+        memcpy(&cache->pool[cache->pool_length + nbr_moves], diagonal_pawn_moves,
+               sizeof(struct Move) * nbr_diagonal_pawn_moves);
+        entry->generation = generation;
+        entry->first_move = cache->pool_length;
+        entry->nbr_moves = nbr_moves;
+        entry->nbr_diagonal_pawn_moves = nbr_diagonal_pawn_moves;
+        cache->pool_length += nbr_moves + nbr_diagonal_pawn_moves;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+static int count_moves(struct Move moves[]) {
+    int nbr_moves = 0;
+    while (moves[nbr_moves].destination_square != -1) {
+        ++nbr_moves;
+    }
+    return nbr_moves;
+}
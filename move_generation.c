@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include "chess.h"
+#include "engine.h"
+
+static bool generate_next_piece(struct MoveGenerator *move_generator);
+
+// captures_only: the quiet moves stage is skipped, for quiescence search
+void initialize_move_generator(struct MoveGenerator *move_generator, bool captures_only, struct GameState *game_state,
+                               struct Rules *rules) {
+    int board_length = 1;
+    for (int i = 0; i < rules->dimensions; ++i) {
+        board_length *= rules->board_shape[i];
+    }
+    move_generator->game_state = game_state;
+    move_generator->rules = rules;
+    move_generator->stage = GENERATION_STAGE_CAPTURES;
+    move_generator->captures_only = captures_only;
+    move_generator->board_length = board_length;
+    move_generator->next_square_index = 0;
+    move_generator->piece_moves[0].destination_square = -1;
+    move_generator->piece_move_index = 0;
+}
+
+// Returns false when there are no moves left. The board must not change between calls
+bool next_move(struct MoveGenerator *move_generator, struct Move *move) {
+    while (move_generator->stage != GENERATION_STAGE_DONE) {
+        struct Move *piece_move = &move_generator->piece_moves[move_generator->piece_move_index];
+        if (piece_move->destination_square != -1) {
+            *move = *piece_move;
+            ++move_generator->piece_move_index;
+            return true;
+        }
+        if (generate_next_piece(move_generator)) {
+            continue;
+        }
+
+        // No pieces left in this stage
+        if (move_generator->stage == GENERATION_STAGE_CAPTURES && !move_generator->captures_only) {
+            move_generator->stage = GENERATION_STAGE_QUIETS;
+            move_generator->next_square_index = 0;
+        } else {
+            move_generator->stage = GENERATION_STAGE_DONE;
+        }
+    }
+    return false;
+}
+
+// All remaining moves of the current stage, at most max_moves. Call again for the next stage. Returns number of moves
+int generate_stage_moves(struct MoveGenerator *move_generator, struct Move moves[], int max_moves) {
+    enum GenerationStage stage = move_generator->stage;
+    int counter = 0;
+    while (counter < max_moves && move_generator->stage == stage) {
+        struct Move *piece_move = &move_generator->piece_moves[move_generator->piece_move_index];
+        if (piece_move->destination_square != -1) {
+            moves[counter++] = *piece_move;
+            ++move_generator->piece_move_index;
+        } else if (!generate_next_piece(move_generator)) {
+            if (stage == GENERATION_STAGE_CAPTURES && !move_generator->captures_only) {
+                move_generator->stage = GENERATION_STAGE_QUIETS;
+                move_generator->next_square_index = 0;
+            } else {
+                move_generator->stage = GENERATION_STAGE_DONE;
+            }
+        }
+    }
+    return counter;
+}
+
+// All moves for the side to move, captures first. Terminated with -1 if there is room. Returns number of moves
+int generate_moves(struct Move moves[], int max_moves, bool captures_only, struct GameState *game_state, struct Rules *rules) {
+    struct MoveGenerator move_generator;
+    initialize_move_generator(&move_generator, captures_only, game_state, rules);
+    int counter = 0;
+    while (counter < max_moves && next_move(&move_generator, &moves[counter])) {
+        ++counter;
+    }
+    if (counter < max_moves) {
+        moves[counter].destination_square = -1;
+    }
+    return counter;
+}
+
+// Same conditions as validate_selected_move, except the move itself
+bool piece_can_move_this_turn(int square_index, struct GameState *game_state, struct Rules *rules) {
+    struct Square *square = &game_state->board[square_index];
+    if (!square->part_of_board || square->piece.piece_type == NULL_PIECE_TYPE) {
+        return false;
+    }
+    enum PieceColor piece_color = square->piece.piece_color;
+    if (piece_color != game_state->whos_turn) {
+        return false;
+    }
+    if (!rules->same_piece_can_move_twice && rules->moves_per_turn_by_color[piece_color] > 1) {
+        for (int i = 0; i < game_state->moves_made_this_turn; ++i) {
+            if (game_state->last_moves_by_piece_color[piece_color][i].destination_square == square_index) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Fills piece_moves with the moves of the next piece that can move in the current stage. False if there is none
+static bool generate_next_piece(struct MoveGenerator *move_generator) {
+    struct GameState *game_state = move_generator->game_state;
+    struct Rules *rules = move_generator->rules;
+    struct Move *piece_moves = move_generator->piece_moves;
+
+    while (move_generator->next_square_index < move_generator->board_length) {
+        int square_index = move_generator->next_square_index++;
+        if (!piece_can_move_this_turn(square_index, game_state, rules)) {
+            continue;
+        }
+
+        move_generator->piece_move_index = 0;
+        if (move_generator->stage == GENERATION_STAGE_CAPTURES) {
+            get_capture_moves(piece_moves, square_index, game_state, rules);
+        } else {
+            // Quiet moves: everything get_moves returns except the captures already handed out
+            struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+            get_moves(piece_moves, diagonal_pawn_moves, square_index, game_state, rules);
+            int counter = 0;
+            for (int i = 0; piece_moves[i].destination_square != -1; ++i) {
+                if (!move_is_capture(piece_moves[i], game_state)) {
+                    piece_moves[counter++] = piece_moves[i];
+                }
+            }
+            piece_moves[counter].destination_square = -1;
+        }
+        if (piece_moves[0].destination_square != -1) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess.h"
+#include "engine.h"
+
+// Scores are bucketed so that a move from a better bucket is always tried before any move from a worse bucket
+#define CAPTURE_SCORE       (1 << 22)
+#define FIRST_KILLER_SCORE  (1 << 21)
+#define SECOND_KILLER_SCORE ((1 << 21) - 1)
+#define COUNTERMOVE_SCORE   ((1 << 21) - 2)
+
+// Centipawns. The king is worth more than everything else combined since losing it usually loses the game
+const int piece_values[NBR_OF_PIECE_TYPES] = {
+    [NULL_PIECE_TYPE] = 0, [PAWN] = 100, [ROOK] = 500, [KNIGHT] = 300, [BISHOP] = 325, [KING] = 20000, [QUEEN] = 900,
+};
+
+// Most valuable victim - least valuable attacker. Ranks rather than values to keep the king from dominating
+static const int mvv_lva_rank[NBR_OF_PIECE_TYPES] = {
+    [NULL_PIECE_TYPE] = 0, [PAWN] = 1, [KNIGHT] = 2, [BISHOP] = 3, [ROOK] = 4, [QUEEN] = 5, [KING] = 6,
+};
+
+static int  piece_table_index(struct Piece piece, int square_index, int board_length);
+static bool same_move(struct Move move1, struct Move move2);
+
+bool initialize_move_ordering(struct MoveOrdering *move_ordering, struct Rules *rules) {
+    int board_length = 1;
+    for (int i = 0; i < rules->dimensions; ++i) {
+        board_length *= rules->board_shape[i];
+    }
+    move_ordering->board_length = board_length;
+
+    int table_length = PIECE_COLOR_COUNT * NBR_OF_PIECE_TYPES * board_length;
+    move_ordering->history = malloc(sizeof(*move_ordering->history) * table_length);
+    move_ordering->countermoves = malloc(sizeof(*move_ordering->countermoves) * table_length);
+    if (move_ordering->history == NULL || move_ordering->countermoves == NULL) {
+        printf("Mayhem: failed to allocate move ordering tables\n");
+        terminate_move_ordering(move_ordering);
+        return false;
+    }
+    memset(move_ordering->history, 0, sizeof(*move_ordering->history) * table_length);
+    for (int i = 0; i < table_length; ++i) {
+        move_ordering->countermoves[i].destination_square = -1;
+    }
+    clear_move_ordering(move_ordering);
+    move_ordering->cutoffs = 0;
+    move_ordering->first_move_cutoffs = 0;
+    return true;
+}
+
+void terminate_move_ordering(struct MoveOrdering *move_ordering) {
+    free(move_ordering->history);
+    free(move_ordering->countermoves);
+    move_ordering->history = NULL;
+    move_ordering->countermoves = NULL;
+}
+
+// Called before every new search. Killers only make sense for the position they were found in, history is kept but aged
+void clear_move_ordering(struct MoveOrdering *move_ordering) {
+    for (int ply = 0; ply < MAX_SEARCH_PLY; ++ply) {
+        for (int i = 0; i < NBR_OF_KILLER_MOVES; ++i) {
+            move_ordering->killers[ply][i].destination_square = -1;
+        }
+    }
+    int table_length = PIECE_COLOR_COUNT * NBR_OF_PIECE_TYPES * move_ordering->board_length;
+    for (int i = 0; i < table_length; ++i) {
+        move_ordering->history[i] /= 2;
+    }
+}
+
+// previous_move has already been made on the board, destination_square -1 if there is none
+void score_moves(int scores[], struct Move moves[], int nbr_moves, int ply, struct Move previous_move,
+                 struct GameState *game_state, struct MoveOrdering *move_ordering) {
+    struct Square *board = game_state->board;
+    int board_length = move_ordering->board_length;
+
+    struct Move countermove;
+    countermove.destination_square = -1;
+    if (previous_move.destination_square != -1) {
+        struct Piece previous_piece = board[previous_move.destination_square].piece;
+        if (previous_piece.piece_type != NULL_PIECE_TYPE) {
+            countermove = move_ordering->countermoves[piece_table_index(previous_piece, previous_move.destination_square,
+                                                                         board_length)];
+        }
+    }
+
+    for (int i = 0; i < nbr_moves; ++i) {
+        struct Piece piece = board[moves[i].origin_square].piece;
+        if (move_is_capture(moves[i], game_state)) {
+            enum PieceType victim = board[moves[i].destination_square].piece.piece_type;
+            if (victim == NULL_PIECE_TYPE) {
+                victim = PAWN;      // en passant
+            }
+            scores[i] = CAPTURE_SCORE + 8 * mvv_lva_rank[victim] - mvv_lva_rank[piece.piece_type];
+        } else if (ply < MAX_SEARCH_PLY && same_move(moves[i], move_ordering->killers[ply][0])) {
+            scores[i] = FIRST_KILLER_SCORE;
+        } else if (ply < MAX_SEARCH_PLY && same_move(moves[i], move_ordering->killers[ply][1])) {
+            scores[i] = SECOND_KILLER_SCORE;
+        } else if (same_move(moves[i], countermove)) {
+            scores[i] = COUNTERMOVE_SCORE;
+        } else {
+            scores[i] = move_ordering->history[piece_table_index(piece, moves[i].destination_square, board_length)];
+        }
+    }
+}
+
+// Selection sort one step at a time. Moves after a cutoff are never sorted
+void pick_next_move(struct Move moves[], int scores[], int nbr_moves, int index) {
+    int best_index = index;
+    for (int i = index + 1; i < nbr_moves; ++i) {
+        if (scores[i] > scores[best_index]) {
+            best_index = i;
+        }
+    }
+    if (best_index != index) {
+        struct Move move = moves[index];
+        moves[index] = moves[best_index];
+        moves[best_index] = move;
+        int score = scores[index];
+        scores[index] = scores[best_index];
+        scores[best_index] = score;
+    }
+}
+
+// Call with the board as it was before move was made. move_number is 0 if the cutoff came from the first move tried.
+// quiets_tried are the quiet moves searched before move at this node, they are penalized
+void update_move_ordering_on_cutoff(struct Move move, int move_number, struct Move quiets_tried[], int nbr_quiets_tried,
+                                    struct Move previous_move, int ply, int depth, struct GameState *game_state,
+                                    struct MoveOrdering *move_ordering) {
+    struct Square *board = game_state->board;
+    int board_length = move_ordering->board_length;
+
+    ++move_ordering->cutoffs;
+    if (move_number == 0) {
+        ++move_ordering->first_move_cutoffs;
+    }
+
+    if (move_is_capture(move, game_state)) {
+        return;     // captures are ordered by MVV-LVA already
+    }
+
+    // Killers
+    if (ply < MAX_SEARCH_PLY && !same_move(move, move_ordering->killers[ply][0])) {
+        move_ordering->killers[ply][1] = move_ordering->killers[ply][0];
+        move_ordering->killers[ply][0] = move;
+    }
+
+    // History. Gravity formula keeps the values bounded without periodic rescaling
+    int bonus = depth * depth > HISTORY_MAX ? HISTORY_MAX : depth * depth;
+    int *entry = &move_ordering->history[piece_table_index(board[move.origin_square].piece, move.destination_square, board_length)];
+    *entry += bonus - *entry * bonus / HISTORY_MAX;
+    for (int i = 0; i < nbr_quiets_tried; ++i) {
+        entry = &move_ordering->history[piece_table_index(board[quiets_tried[i].origin_square].piece,
+                                                          quiets_tried[i].destination_square, board_length)];
+        *entry += -bonus - *entry * bonus / HISTORY_MAX;
+    }
+
+    // Countermove
+    if (previous_move.destination_square != -1) {
+        struct Piece previous_piece = board[previous_move.destination_square].piece;
+        if (previous_piece.piece_type != NULL_PIECE_TYPE) {
+            move_ordering->countermoves[piece_table_index(previous_piece, previous_move.destination_square, board_length)] = move;
+        }
+    }
+}
+
+double first_move_cutoff_rate(struct MoveOrdering *move_ordering) {
+    if (move_ordering->cutoffs == 0) {
+        return 0.0;
+    }
+    return (double)move_ordering->first_move_cutoffs / (double)move_ordering->cutoffs;
+}
+
+static int piece_table_index(struct Piece piece, int square_index, int board_length) {
+    int piece_index = piece.piece_color * NBR_OF_PIECE_TYPES + piece.piece_type;
+    return piece_index * board_length + square_index;
+}
+
+static bool same_move(struct Move move1, struct Move move2) {
+    return move1.destination_square != -1 && move1.destination_square == move2.destination_square &&
+           move1.origin_square == move2.origin_square;
+}
@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+
+// Squares are written as their coordinates separated by dots, first dimension first and counting from 0, so e2 on the
+// standard board is "4.1". A move is origin-destination with an optional promotion letter, "4.6-4.7q"
+//
+// A position is one line of six fields separated by spaces, like FEN:
+//   shape         side lengths joined by x, w after a dimension that wraps: "8x8", "5x5x5", "8x8w"
+//   board         squares in square index order, first dimension fastest. A / after every row of the first dimension,
+//                 // after every plane of the first two and so on. Within a row:
+//                   PRNBKQ white pieces, prnbkq black pieces, ~ before the letter for neutral pieces
+//                   after a piece + if it has moved, v > < for a pawn facing backwards, right, left
+//                   n empty squares, . one empty square, x a square that isn't part of the board, nx n of them.
+//                   Empty squares just before a hole end in a . instead, "2.x" and not "3x" which is three holes
+//                   ! and ? after a piece or . for a white and a black flag on the square
+//   side to move  w or b
+//   moves made    moves made this turn by the side to move
+//   last moves    of white and of black, the moves of their last turn that en passant and moving twice look at:
+//                 origin-destination/passed square, the passed square only after a pawn moved two squares. Moves of a
+//                 turn are separated by commas, - for none
+// The standard starting position is
+//   8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 - -
+// The shape has to match the rules the position is read with, the notation doesn't change the rules
+
+static const char promotion_letters[NBR_OF_PIECE_TYPES] = {
+    [NULL_PIECE_TYPE] = '\0', [PAWN] = 'p', [ROOK] = 'r', [KNIGHT] = 'n', [BISHOP] = 'b', [KING] = 'k', [QUEEN] = 'q',
+};
+
+static const char direction_letters[] = {[FORWARDS] = '\0', [BACKWARDS] = 'v', [RIGHT] = '>', [LEFT] = '<'};
+
+// Piece type of a letter of either case, NULL_PIECE_TYPE if it isn't one, indexed by unsigned char
+static enum PieceType letter_piece_types[256] = {
+    ['P'] = PAWN, ['R'] = ROOK, ['N'] = KNIGHT, ['B'] = BISHOP, ['K'] = KING, ['Q'] = QUEEN,
+    ['p'] = PAWN, ['r'] = ROOK, ['n'] = KNIGHT, ['b'] = BISHOP, ['k'] = KING, ['q'] = QUEEN,
+};
+
+static int  write_number(char *text, int number);
+static bool read_number(const char **text, int *number);
+static int  write_last_moves(char *text, struct Move last_moves[MAX_MOVES_PER_TURN], struct Rules *rules);
+static bool read_last_moves(const char **text, struct Move last_moves[MAX_MOVES_PER_TURN], struct Rules *rules);
+
+void square_to_text(int square_index, char text[MAX_SQUARE_TEXT_LENGTH], struct Rules *rules) {
+    int square[MAX_DIMENSIONS];
+    square_index_to_square(square_index, square, rules->dimensions, rules->board_shape);
+    int length = 0;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        if (dim > 0) {
+            text[length++] = '.';
+        }
+        length += write_number(text + length, square[dim]);
+    }
+    text[length] = '\0';
+}
+
+// Reads a square from the start of text. end is set to the first character after it. -1 if there is no square on the board
+int text_to_square(const char *text, const char **end, struct Rules *rules) {
+    int square[MAX_DIMENSIONS];
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        if (dim > 0) {
+            if (*text != '.') {
+                return -1;
+            }
+            ++text;
+        }
+        char *number_end;
+        long coordinate = strtol(text, &number_end, 10);
+        if (number_end == text || coordinate < 0 || coordinate >= rules->board_shape[dim]) {
+            return -1;
+        }
+        square[dim] = (int)coordinate;
+        text = number_end;
+    }
+    *end = text;
+    return square_to_square_index(square, rules->dimensions, rules->board_shape);
+}
+
+void move_to_text(struct Move move, enum PieceType promotion_piece_type, char text[MAX_MOVE_TEXT_LENGTH], struct Rules *rules) {
+    square_to_text(move.origin_square, text, rules);
+    size_t length = strlen(text);
+    text[length++] = '-';
+    square_to_text(move.destination_square, text + length, rules);
+    length = strlen(text);
+    if (promotion_piece_type != NULL_PIECE_TYPE) {
+        text[length++] = promotion_letters[promotion_piece_type];
+        text[length] = '\0';
+    }
+}
+
+// Finds the move among the moves of the side to move. A promoting move without a letter promotes to queen. false if the
+// text isn't a move or the move isn't allowed in this position
+bool text_to_move(const char *text, struct Move *move, enum PieceType *promotion_piece_type, struct GameState *game_state,
+                  struct Rules *rules) {
+    const char *end;
+    int origin_square = text_to_square(text, &end, rules);
+    if (origin_square == -1 || *end != '-') {
+        return false;
+    }
+    int destination_square = text_to_square(end + 1, &end, rules);
+    if (destination_square == -1 || !piece_can_move_this_turn(origin_square, game_state, rules)) {
+        return false;
+    }
+
+    struct Move moves[MAX_MOVES_SINGLE_PIECE];
+    struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    get_moves(moves, diagonal_pawn_moves, origin_square, game_state, rules);
+    *move = validate_selected_move(origin_square, destination_square, moves, game_state, rules);
+    if (move->destination_square == -1) {
+        return false;
+    }
+
+    *promotion_piece_type = NULL_PIECE_TYPE;
+    bool promotion = evaluate_promotion(origin_square, destination_square, game_state, rules);
+    if (promotion) {
+        *promotion_piece_type = QUEEN;
+    }
+    if (*end != '\0') {
+        for (int piece_type = PAWN; piece_type < NBR_OF_PIECE_TYPES; ++piece_type) {
+            if (*end == promotion_letters[piece_type] && piece_type != PAWN && piece_type != KING) {
+                *promotion_piece_type = piece_type;
+                ++end;
+                break;
+            }
+        }
+        if (!promotion || *end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Longest text position_to_text can write for the board, terminator included
+int position_text_max_length(struct Rules *rules) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        board_length *= rules->board_shape[dim];
+    }
+    int last_moves_length = PIECE_COLOR_COUNT * MAX_MOVES_PER_TURN * (3 * MAX_SQUARE_TEXT_LENGTH + 3);
+    // a square is at most ~Q+v!? and the slashes after it, fewer than dimensions when it ends a row
+    return 4 * MAX_DIMENSIONS + board_length * (6 + rules->dimensions) + last_moves_length + 32;
+}
+
+// Writes the position as one line into text, which has room for position_text_max_length. Returns the length
+int position_to_text(struct GameState *game_state, struct Rules *rules, char text[]) {
+    int length = 0;
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        if (dim > 0) {
+            text[length++] = 'x';
+        }
+        length += write_number(text + length, rules->board_shape[dim]);
+        if (rules->dimension_wrapping[dim]) {
+            text[length++] = 'w';
+        }
+        board_length *= rules->board_shape[dim];
+    }
+    text[length++] = ' ';
+
+    int row_length = rules->board_shape[0];
+    for (int row_start = 0; row_start < board_length; row_start += row_length) {
+        if (row_start > 0) {
+            // A slash for every dimension the previous row ended
+            int slice_length = row_length;
+            for (int dim = 1; dim < rules->dimensions && row_start % slice_length == 0; ++dim) {
+                text[length++] = '/';
+                slice_length *= rules->board_shape[dim];
+            }
+        }
+        int empty_squares = 0, holes = 0;
+        for (struct Square *square = &game_state->board[row_start]; square < &game_state->board[row_start + row_length];
+                ++square) {
+            bool flagged = square->white_flag || square->black_flag;
+            bool empty = square->part_of_board && square->piece.piece_type == NULL_PIECE_TYPE && !flagged;
+            bool hole = !square->part_of_board;
+            if (!empty && empty_squares > 0) {
+                // Before a hole the last empty square is a . so that the count isn't read as holes
+                if (hole) {
+                    length += empty_squares > 1 ? write_number(text + length, empty_squares - 1) : 0;
+                    text[length++] = '.';
+                } else {
+                    length += write_number(text + length, empty_squares);
+                }
+                empty_squares = 0;
+            }
+            if (!hole && holes > 0) {
+                length += holes > 1 ? write_number(text + length, holes) : 0;
+                text[length++] = 'x';
+                holes = 0;
+            }
+            if (empty) {
+                ++empty_squares;
+                continue;
+            }
+            if (hole) {
+                ++holes;
+                continue;
+            }
+            struct Piece *piece = &square->piece;
+            if (piece->piece_type == NULL_PIECE_TYPE) {
+                text[length++] = '.';
+            } else {
+                if (piece->piece_color == PIECE_COLOR_NEUTRAL) {
+                    text[length++] = '~';
+                }
+                char letter = promotion_letters[piece->piece_type];
+                text[length++] = piece->piece_color == PIECE_COLOR_BLACK ? letter : letter - 'a' + 'A';
+                if (piece->has_moved) {
+                    text[length++] = '+';
+                }
+                if (piece->direction != FORWARDS) {
+                    text[length++] = direction_letters[piece->direction];
+                }
+            }
+            if (square->white_flag) {
+                text[length++] = '!';
+            }
+            if (square->black_flag) {
+                text[length++] = '?';
+            }
+        }
+        if (empty_squares > 0) {
+            length += write_number(text + length, empty_squares);
+        }
+        if (holes > 0) {
+            length += holes > 1 ? write_number(text + length, holes) : 0;
+            text[length++] = 'x';
+        }
+    }
+
+    text[length++] = ' ';
+    text[length++] = game_state->whos_turn == PIECE_COLOR_BLACK ? 'b' : 'w';
+    text[length++] = ' ';
+    length += write_number(text + length, game_state->moves_made_this_turn);
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        text[length++] = ' ';
+        length += write_last_moves(text + length, game_state->last_moves_by_piece_color[piece_color], rules);
+    }
+    text[length] = '\0';
+    return length;
+}
+
+// Reads a position written by position_to_text into game_state, whose board has the size of the rules. false if the text
+// isn't a position for the rules, the game state is left half read then. Holes may differ from the ones the rules were
+// set up with, rules->topology follows the board read
+bool text_to_position(const char *text, struct GameState *game_state, struct Rules *rules) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        int side_length;
+        if ((dim > 0 && *text++ != 'x') || !read_number(&text, &side_length) || side_length != rules->board_shape[dim]) {
+            return false;
+        }
+        bool wrapping = *text == 'w';
+        text += wrapping;
+        if (wrapping != rules->dimension_wrapping[dim]) {
+            return false;
+        }
+        board_length *= side_length;
+    }
+    if (*text++ != ' ') {
+        return false;
+    }
+
+    int square_index = 0;
+    int row_end = rules->board_shape[0];
+    while (square_index < board_length) {
+        if (square_index == row_end) {
+            // As many slashes as dimensions the previous square ended
+            int row_length = rules->board_shape[0];
+            for (int dim = 1; dim < rules->dimensions && square_index % row_length == 0; ++dim) {
+                if (*text++ != '/') {
+                    return false;
+                }
+                row_length *= rules->board_shape[dim];
+            }
+            row_end += rules->board_shape[0];
+        }
+
+        char c = *text;
+        if (c >= '1' && c <= '9') {
+            int count;
+            read_number(&text, &count);
+            bool holes = *text == 'x';
+            text += holes;
+            if (square_index + count > row_end) {
+                return false;
+            }
+            for (int i = 0; i < count; ++i, ++square_index) {
+                struct Square *square = &game_state->board[square_index];
+                square->part_of_board = !holes;
+                square->piece.piece_type = NULL_PIECE_TYPE;
+                square->piece.piece_color = NULL_PIECE_COLOR;
+                square->piece.direction = FORWARDS;
+                square->piece.has_moved = false;
+                square->white_flag = false;
+                square->black_flag = false;
+            }
+            continue;
+        }
+
+        struct Square *square = &game_state->board[square_index++];
+        square->part_of_board = c != 'x';
+        square->piece.piece_type = NULL_PIECE_TYPE;
+        square->piece.piece_color = NULL_PIECE_COLOR;
+        square->piece.direction = FORWARDS;
+        square->piece.has_moved = false;
+        square->white_flag = false;
+        square->black_flag = false;
+        ++text;
+        if (c == 'x') {
+            continue;
+        }
+        if (c != '.') {
+            bool neutral = c == '~';
+            if (neutral) {
+                c = *text++;
+            }
+            enum PieceType piece_type = letter_piece_types[(unsigned char)c];
+            if (piece_type == NULL_PIECE_TYPE) {
+                return false;
+            }
+            square->piece.piece_type = piece_type;
+            square->piece.piece_color = neutral ? PIECE_COLOR_NEUTRAL : c >= 'a' ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+            if (*text == '+') {
+                square->piece.has_moved = true;
+                ++text;
+            }
+            for (int direction = BACKWARDS; direction <= LEFT; ++direction) {
+                if (*text == direction_letters[direction]) {
+                    square->piece.direction = direction;
+                    ++text;
+                    break;
+                }
+            }
+        }
+        if (*text == '!') {
+            square->white_flag = true;
+            ++text;
+        }
+        if (*text == '?') {
+            square->black_flag = true;
+            ++text;
+        }
+    }
+
+    if (text[0] != ' ' || (text[1] != 'w' && text[1] != 'b') || text[2] != ' ') {
+        return false;
+    }
+    game_state->whos_turn = text[1] == 'w' ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK;
+    text += 3;
+    if (    !read_number(&text, &game_state->moves_made_this_turn) ||
+            game_state->moves_made_this_turn >= rules->moves_per_turn_by_color[game_state->whos_turn]) {
+        return false;
+    }
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        if (*text++ != ' ' || !read_last_moves(&text, game_state->last_moves_by_piece_color[piece_color], rules)) {
+            return false;
+        }
+    }
+    if (*text != '\0' && *text != '\n') {
+        return false;
+    }
+    return update_board_topology(rules, game_state->board);
+}
+
+static int write_number(char *text, int number) {
+    char digits[12];
+    int nbr_digits = 0;
+    do {
+        digits[nbr_digits++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    for (int i = 0; i < nbr_digits; ++i) {
+        text[i] = digits[nbr_digits - 1 - i];
+    }
+    return nbr_digits;
+}
+
+static bool read_number(const char **text, int *number) {
+    const char *start = *text;
+    *number = 0;
+    while (**text >= '0' && **text <= '9' && *text - start < 9) {
+        *number = 10 * *number + (**text - '0');
+        ++*text;
+    }
+    return *text != start;
+}
+
+// Moves up to the last one that was made, empty between commas if a move in between wasn't
+static int write_last_moves(char *text, struct Move last_moves[MAX_MOVES_PER_TURN], struct Rules *rules) {
+    int nbr_moves = MAX_MOVES_PER_TURN;
+    while (nbr_moves > 0 && last_moves[nbr_moves - 1].destination_square == -1) {
+        --nbr_moves;
+    }
+    if (nbr_moves == 0) {
+        text[0] = '-';
+        return 1;
+    }
+    int length = 0;
+    for (int i = 0; i < nbr_moves; ++i) {
+        if (i > 0) {
+            text[length++] = ',';
+        }
+        if (last_moves[i].destination_square == -1) {
+            continue;
+        }
+        move_to_text(last_moves[i], NULL_PIECE_TYPE, text + length, rules);
+        length += strlen(text + length);
+        if (last_moves[i].pawn_moved_past_square != -1) {
+            text[length++] = '/';
+            square_to_text(last_moves[i].pawn_moved_past_square, text + length, rules);
+            length += strlen(text + length);
+        }
+    }
+    return length;
+}
+
+static bool read_last_moves(const char **text, struct Move last_moves[MAX_MOVES_PER_TURN], struct Rules *rules) {
+    for (int i = 0; i < MAX_MOVES_PER_TURN; ++i) {
+        last_moves[i].origin_square = -1;
+        last_moves[i].destination_square = -1;
+        last_moves[i].pawn_moved_past_square = -1;
+        last_moves[i].en_passant_capture = false;
+        last_moves[i].castling_with_rook_on_square = -1;
+        last_moves[i].castling_rook_destination_square = -1;
+    }
+    if (**text == '-') {
+        ++*text;
+        return true;
+    }
+    for (int i = 0; i < MAX_MOVES_PER_TURN; ++i) {
+        if (**text != ',' && **text != ' ' && **text != '\0') {
+            struct Move *move = &last_moves[i];
+            move->origin_square = text_to_square(*text, text, rules);
+            if (move->origin_square == -1 || **text != '-') {
+                return false;
+            }
+            move->destination_square = text_to_square(*text + 1, text, rules);
+            if (move->destination_square == -1) {
+                return false;
+            }
+            if (**text == '/') {
+                move->pawn_moved_past_square = text_to_square(*text + 1, text, rules);
+                if (move->pawn_moved_past_square == -1) {
+                    return false;
+                }
+            }
+        }
+        if (**text != ',') {
+            return true;
+        }
+        ++*text;
+    }
+    return false;
+}
@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 199309L     // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chess4d.h"
+
+// Positions per second written as text and read back. Positions of random games are collected first, then all written,
+// then all read into a second game state and written again, which has to give the same text
+
+#define NOTATION_BENCH_GAMES 20
+#define NOTATION_BENCH_MAX_MOVES 200
+#define NOTATION_BENCH_REPEATS 5
+
+struct NotationBenchVariant {
+    enum Variant variant;
+    const char *name;
+};
+
+static const struct NotationBenchVariant notation_bench_variants[] = {
+    {STANDARD_CHESS,            "standard"},
+    {GRAVITY_CHESS,             "gravity"},
+    {STANDARD_24X24_CHESS,      "standard 24x24"},
+    {THREE_D_5X5X5_CHESS,       "3D 5x5x5"},
+    {FOUR_D_4X4X4X4_V1_CHESS,   "4D 4x4x4x4 v1"},
+    {SIX_D_3X3X3X3X3X3_CHESS,   "6D 3x3x3x3x3x3"},
+};
+
+#define NBR_OF_NOTATION_BENCH_VARIANTS (int)(sizeof(notation_bench_variants) / sizeof(notation_bench_variants[0]))
+#define NOTATION_BENCH_MAX_POSITIONS (NOTATION_BENCH_GAMES * NOTATION_BENCH_MAX_MOVES)
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+int main() {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    unsigned long long random_state = 1;
+    bool all_equal = true;
+
+    printf("%-16s %7s %9s %9s %13s %13s\n", "variant", "squares", "positions", "text B", "write pos/s", "read pos/s");
+    for (int v = 0; v < NBR_OF_NOTATION_BENCH_VARIANTS; ++v) {
+        struct Rules rules;
+        struct GameState game_state, read_game_state;
+        if (!initialize_rules_and_game_state(&rules, &read_game_state, notation_bench_variants[v].variant)) {
+            return 1;
+        }
+        int board_length = 1;
+        for (int dim = 0; dim < rules.dimensions; ++dim) {
+            board_length *= rules.board_shape[dim];
+        }
+        int max_length = position_text_max_length(&rules);
+        char *text = malloc(max_length);
+        struct GameState *positions = malloc(NOTATION_BENCH_MAX_POSITIONS * sizeof(struct GameState));
+        struct Square *boards = malloc((size_t)NOTATION_BENCH_MAX_POSITIONS * board_length * sizeof(struct Square));
+        if (text == NULL || positions == NULL || boards == NULL) {
+            return 1;
+        }
+
+        int nbr_positions = 0;
+        for (int game = 0; game < NOTATION_BENCH_GAMES; ++game) {
+            if (!initialize_rules_and_game_state(&rules, &game_state, notation_bench_variants[v].variant)) {
+                return 1;
+            }
+            for (int move_number = 0; move_number < NOTATION_BENCH_MAX_MOVES; ++move_number) {
+                int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+                if (nbr_moves == 0) {
+                    break;
+                }
+                struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+                bool promotion = evaluate_promotion(move.origin_square, move.destination_square, &game_state, &rules);
+                make_move(move, promotion ? QUEEN : NULL_PIECE_TYPE, &game_state, &rules);
+                positions[nbr_positions] = game_state;
+                positions[nbr_positions].board = boards + (size_t)nbr_positions * board_length;
+                memcpy(positions[nbr_positions].board, game_state.board, board_length * sizeof(struct Square));
+                ++nbr_positions;
+            }
+            terminate_game_state(&game_state);
+        }
+
+        long long text_bytes = 0;
+        double start_time = seconds_now();
+        for (int repeat = 0; repeat < NOTATION_BENCH_REPEATS; ++repeat) {
+            for (int i = 0; i < nbr_positions; ++i) {
+                text_bytes += position_to_text(&positions[i], &rules, text);
+            }
+        }
+        double write_seconds = seconds_now() - start_time;
+
+        // Texts are written outside the timing, one at a time so that they don't all have to be kept
+        double read_seconds = 0;
+        char *read_text = malloc(max_length);
+        for (int i = 0; i < nbr_positions && read_text != NULL; ++i) {
+            position_to_text(&positions[i], &rules, text);
+            start_time = seconds_now();
+            for (int repeat = 0; repeat < NOTATION_BENCH_REPEATS; ++repeat) {
+                all_equal = text_to_position(text, &read_game_state, &rules) && all_equal;
+            }
+            read_seconds += seconds_now() - start_time;
+            position_to_text(&read_game_state, &rules, read_text);
+            all_equal = all_equal && strcmp(text, read_text) == 0;
+        }
+
+        long long nbr_conversions = (long long)nbr_positions * NOTATION_BENCH_REPEATS;
+        printf("%-16s %7i %9i %9.1f %13.0f %13.0f\n", notation_bench_variants[v].name, board_length, nbr_positions,
+               (double)text_bytes / nbr_conversions, nbr_conversions / write_seconds, nbr_conversions / read_seconds);
+        free(read_text);
+        free(text);
+        free(positions);
+        free(boards);
+        terminate_game_state(&read_game_state);
+    }
+    printf("\n%i random games of up to %i moves per variant, every position written and read %i times\n",
+           NOTATION_BENCH_GAMES, NOTATION_BENCH_MAX_MOVES, NOTATION_BENCH_REPEATS);
+    if (!all_equal) {
+        printf("bug, position read back from text differs\n");
+        return 1;
+    }
+    return 0;
+}
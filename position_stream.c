@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+
+// Binary stream of position updates, so that clients following a game don't need the whole board after every move.
+// Every message starts with
+//   byte    POSITION_UPDATE_KEYFRAME or POSITION_UPDATE_DELTA
+//   varint  sequence number, one more than the previous message
+//   byte    whos_turn, byte moves_made_this_turn
+// A keyframe is the whole position, decodable without any earlier message:
+//   varint  board length
+//   runs of (square, varint run length) until the board is covered, empty space compresses to a few bytes
+//   last_moves_by_piece_color, (origin, destination, pawn_moved_past_square) per entry
+// A delta is one move, the squares it changed with what is on them now:
+//   byte    piece color that moved, byte index of the move in its turn, then the move as in a keyframe
+//   varint  number of changed squares, then per square the gap from the previous changed square and the square
+// Varints are unsigned LEB128, square indices are stored +1 so that -1 fits. A square is one byte,
+// part_of_board | has_moved | color | piece type, and a second one for pawn direction and flags when they are set
+
+#define MAX_VARINT_BYTES 5
+#define SQUARE_EXTENDED 0x80
+#define SQUARE_PART_OF_BOARD 0x40
+#define SQUARE_HAS_MOVED 0x20
+#define SQUARE_WHITE_FLAG 0x04
+#define SQUARE_BLACK_FLAG 0x08
+
+static int  write_varint        (unsigned char buffer[], unsigned int value);
+static bool read_varint         (const unsigned char **position, const unsigned char *end, unsigned int *value);
+static int  write_square        (unsigned char buffer[], struct Square square);
+static bool read_square         (const unsigned char **position, const unsigned char *end, struct Square *square);
+static bool squares_equal       (struct Square square1, struct Square square2);
+static int  write_last_move     (unsigned char buffer[], struct Move move);
+static bool read_last_move      (const unsigned char **position, const unsigned char *end, struct Move *move,
+                                 int board_length);
+static bool read_byte           (const unsigned char **position, const unsigned char *end, int *value);
+
+static int board_length_of(struct Rules *rules) {
+    int board_length = 1;
+    for (int dim = 0; dim < rules->dimensions; ++dim) {
+        board_length *= rules->board_shape[dim];
+    }
+    return board_length;
+}
+
+void initialize_position_encoder(struct PositionStreamEncoder *encoder, int keyframe_interval, struct Rules *rules) {
+    encoder->board_length = board_length_of(rules);
+    encoder->sequence = 0;
+    encoder->keyframe_interval = keyframe_interval;
+    encoder->updates_since_keyframe = 0;
+}
+
+void initialize_position_decoder(struct PositionStreamDecoder *decoder, struct Rules *rules) {
+    decoder->rules = rules;
+    decoder->board_length = board_length_of(rules);
+    decoder->next_sequence = 0;
+    decoder->synchronized = false;
+}
+
+// Largest message for the board, keyframe or delta
+int position_update_max_bytes(struct Rules *rules) {
+    int header_bytes = 3 + MAX_VARINT_BYTES;
+    int last_move_bytes = 3 * MAX_VARINT_BYTES;
+    int keyframe_bytes = MAX_VARINT_BYTES + board_length_of(rules) * (2 + MAX_VARINT_BYTES) +
+                         PIECE_COLOR_COUNT * MAX_MOVES_PER_TURN * last_move_bytes;
+    int delta_bytes = 2 + last_move_bytes + MAX_VARINT_BYTES + MAX_SQUARES_CHANGED_BY_MOVE * (2 + MAX_VARINT_BYTES);
+    return header_bytes + (keyframe_bytes > delta_bytes ? keyframe_bytes : delta_bytes);
+}
+
+// Whole position. buffer must hold position_update_max_bytes. Returns the number of bytes written
+int encode_position_keyframe(struct PositionStreamEncoder *encoder, struct GameState *game_state, unsigned char buffer[]) {
+    int length = 0;
+    buffer[length++] = POSITION_UPDATE_KEYFRAME;
+    length += write_varint(buffer + length, encoder->sequence++);
+    buffer[length++] = (unsigned char)game_state->whos_turn;
+    buffer[length++] = (unsigned char)game_state->moves_made_this_turn;
+    length += write_varint(buffer + length, encoder->board_length);
+    for (int square_index = 0; square_index < encoder->board_length; ) {
+        int run_length = 1;
+        while (square_index + run_length < encoder->board_length &&
+               squares_equal(game_state->board[square_index + run_length], game_state->board[square_index])) {
+            ++run_length;
+        }
+        length += write_square(buffer + length, game_state->board[square_index]);
+        length += write_varint(buffer + length, run_length);
+        square_index += run_length;
+    }
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        for (int i = 0; i < MAX_MOVES_PER_TURN; ++i) {
+            length += write_last_move(buffer + length, game_state->last_moves_by_piece_color[piece_color][i]);
+        }
+    }
+    encoder->updates_since_keyframe = 0;
+    return length;
+}
+
+// The move just made with make_move_with_undo, from the squares recorded in undo. Every keyframe_interval updates a
+// keyframe is sent instead so that clients that missed something catch up. Returns the number of bytes written
+int encode_position_update(struct PositionStreamEncoder *encoder, struct MoveUndo *undo, struct GameState *game_state,
+                           unsigned char buffer[]) {
+    if (encoder->sequence == 0 || ++encoder->updates_since_keyframe >= encoder->keyframe_interval) {
+        return encode_position_keyframe(encoder, game_state, buffer);
+    }
+
+    // Changed squares in increasing order, each once. Moves change a handful so insertion sort it is
+    int changed_squares[MAX_SQUARES_CHANGED_BY_MOVE];
+    int nbr_changed_squares = 0;
+    for (int i = 0; i < undo->nbr_square_changes; ++i) {
+        int square_index = undo->square_changes[i].square_index;
+        int j = nbr_changed_squares;
+        while (j > 0 && changed_squares[j-1] > square_index) {
+            --j;
+        }
+        if (j > 0 && changed_squares[j-1] == square_index) {
+            continue;
+        }
+        memmove(&changed_squares[j+1], &changed_squares[j], sizeof(changed_squares[0]) * (nbr_changed_squares - j));
+        changed_squares[j] = square_index;
+        ++nbr_changed_squares;
+    }
+
+    int length = 0;
+    buffer[length++] = POSITION_UPDATE_DELTA;
+    length += write_varint(buffer + length, encoder->sequence++);
+    buffer[length++] = (unsigned char)game_state->whos_turn;
+    buffer[length++] = (unsigned char)game_state->moves_made_this_turn;
+    buffer[length++] = (unsigned char)undo->whos_turn;
+    buffer[length++] = (unsigned char)undo->moves_made_this_turn;
+    length += write_last_move(buffer + length, game_state->last_moves_by_piece_color[undo->whos_turn][undo->moves_made_this_turn]);
+    length += write_varint(buffer + length, nbr_changed_squares);
+    int previous_square_index = -1;
+    for (int i = 0; i < nbr_changed_squares; ++i) {
+        length += write_varint(buffer + length, changed_squares[i] - previous_square_index - 1);
+        length += write_square(buffer + length, game_state->board[changed_squares[i]]);
+        previous_square_index = changed_squares[i];
+    }
+    return length;
+}
+
+// Applies a message to game_state, whose board must have the decoders board length. Deltas are only applied in sequence
+// after a keyframe, false if the message was not applied. After a missed message nothing is applied until the next
+// keyframe. The topology of the decoders rules follows the holes of the board
+bool decode_position_update(struct PositionStreamDecoder *decoder, const unsigned char buffer[], int length,
+                            struct GameState *game_state) {
+    const unsigned char *position = buffer;
+    const unsigned char *end = buffer + length;
+    int type, whos_turn, moves_made_this_turn;
+    unsigned int sequence;
+    if (    !read_byte(&position, end, &type) || !read_varint(&position, end, &sequence) ||
+            !read_byte(&position, end, &whos_turn) || !read_byte(&position, end, &moves_made_this_turn) ||
+            whos_turn >= PIECE_COLOR_COUNT || moves_made_this_turn >= MAX_MOVES_PER_TURN) {
+        printf("Mayhem: malformed position update\n");
+        return false;
+    }
+
+    if (type == POSITION_UPDATE_KEYFRAME) {
+        unsigned int board_length;
+        if (!read_varint(&position, end, &board_length) || (int)board_length != decoder->board_length) {
+            printf("Mayhem: keyframe for another board\n");
+            return false;
+        }
+        // Decoded into a copy first so that a broken keyframe leaves game_state alone
+        struct Square *board = malloc(sizeof(*board) * board_length);
+        if (board == NULL) {
+            printf("Havoc: failed to allocate board\n");
+            return false;
+        }
+        struct Move last_moves[PIECE_COLOR_COUNT][MAX_MOVES_PER_TURN];
+        bool valid = true;
+        for (unsigned int square_index = 0; square_index < board_length && valid; ) {
+            struct Square square;
+            unsigned int run_length;
+            valid = read_square(&position, end, &square) && read_varint(&position, end, &run_length) &&
+                    run_length > 0 && run_length <= board_length - square_index;
+            for (unsigned int i = 0; valid && i < run_length; ++i) {
+                board[square_index++] = square;
+            }
+        }
+        for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT && valid; ++piece_color) {
+            for (int i = 0; i < MAX_MOVES_PER_TURN && valid; ++i) {
+                valid = read_last_move(&position, end, &last_moves[piece_color][i], board_length);
+            }
+        }
+        if (!valid || position != end) {
+            free(board);
+            printf("Mayhem: malformed keyframe\n");
+            return false;
+        }
+        if (!update_board_topology(decoder->rules, board)) {
+            free(board);
+            return false;
+        }
+        memcpy(game_state->board, board, sizeof(*board) * board_length);
+        memcpy(game_state->last_moves_by_piece_color, last_moves, sizeof(last_moves));
+        free(board);
+    } else if (type == POSITION_UPDATE_DELTA) {
+        if (!decoder->synchronized || sequence != decoder->next_sequence) {
+            decoder->synchronized = false;      // missed something, wait for a keyframe
+            return false;
+        }
+        // Checked completely before anything is changed
+        int moved_piece_color, move_index;
+        struct Move last_move;
+        unsigned int nbr_changed_squares;
+        if (    !read_byte(&position, end, &moved_piece_color) || !read_byte(&position, end, &move_index) ||
+                moved_piece_color >= PIECE_COLOR_COUNT || move_index >= MAX_MOVES_PER_TURN ||
+                !read_last_move(&position, end, &last_move, decoder->board_length) ||
+                !read_varint(&position, end, &nbr_changed_squares) || nbr_changed_squares > MAX_SQUARES_CHANGED_BY_MOVE) {
+            printf("Mayhem: malformed delta\n");
+            return false;
+        }
+        const unsigned char *changes = position;
+        int square_index = -1;
+        for (unsigned int i = 0; i < nbr_changed_squares; ++i) {
+            unsigned int gap;
+            struct Square square;
+            if (    !read_varint(&position, end, &gap) || gap >= (unsigned int)(decoder->board_length - square_index - 1) ||
+                    !read_square(&position, end, &square)) {
+                printf("Mayhem: malformed delta\n");
+                return false;
+            }
+            square_index += gap + 1;
+        }
+        if (position != end) {
+            printf("Mayhem: malformed delta\n");
+            return false;
+        }
+        position = changes;
+        square_index = -1;
+        bool holes_changed = false;
+        for (unsigned int i = 0; i < nbr_changed_squares; ++i) {
+            unsigned int gap;
+            read_varint(&position, end, &gap);
+            square_index += gap + 1;
+            bool part_of_board = game_state->board[square_index].part_of_board;
+            read_square(&position, end, &game_state->board[square_index]);
+            holes_changed = holes_changed || game_state->board[square_index].part_of_board != part_of_board;
+        }
+        game_state->last_moves_by_piece_color[moved_piece_color][move_index] = last_move;
+        if (holes_changed && !update_board_topology(decoder->rules, game_state->board)) {
+            decoder->synchronized = false;
+            return false;
+        }
+    } else {
+        printf("Mayhem: unknown position update %i\n", type);
+        return false;
+    }
+
+    game_state->whos_turn = whos_turn;
+    game_state->moves_made_this_turn = moves_made_this_turn;
+    decoder->next_sequence = sequence + 1;
+    decoder->synchronized = true;
+    return true;
+}
+
+static int write_varint(unsigned char buffer[], unsigned int value) {
+    int length = 0;
+    while (value >= 0x80) {
+        buffer[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (unsigned char)value;
+    return length;
+}
+
+static bool read_varint(const unsigned char **position, const unsigned char *end, unsigned int *value) {
+    *value = 0;
+    for (int i = 0; i < MAX_VARINT_BYTES; ++i) {
+        if (*position >= end) {
+            return false;
+        }
+        unsigned char byte = *(*position)++;
+        *value |= (unsigned int)(byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_byte(const unsigned char **position, const unsigned char *end, int *value) {
+    if (*position >= end) {
+        return false;
+    }
+    *value = *(*position)++;
+    return true;
+}
+
+// Two bits of color, NULL_PIECE_COLOR 0, white 1, black 2, neutral 3
+static int write_square(unsigned char buffer[], struct Square square) {
+    unsigned char extension = (unsigned char)square.piece.direction | (square.white_flag ? SQUARE_WHITE_FLAG : 0) |
+                              (square.black_flag ? SQUARE_BLACK_FLAG : 0);
+    unsigned char piece_color = square.piece.piece_color == PIECE_COLOR_NEUTRAL ? 3 :
+                                square.piece.piece_color == NULL_PIECE_COLOR ? 0 : (unsigned char)square.piece.piece_color + 1;
+    buffer[0] = (unsigned char)square.piece.piece_type | (unsigned char)(piece_color << 3) |
+                (square.piece.has_moved ? SQUARE_HAS_MOVED : 0) | (square.part_of_board ? SQUARE_PART_OF_BOARD : 0);
+    if (extension == 0) {
+        return 1;
+    }
+    buffer[0] |= SQUARE_EXTENDED;
+    buffer[1] = extension;
+    return 2;
+}
+
+static bool read_square(const unsigned char **position, const unsigned char *end, struct Square *square) {
+    int byte, extension = 0;
+    if (!read_byte(position, end, &byte) || (byte & 0x07) >= NBR_OF_PIECE_TYPES ||
+            ((byte & SQUARE_EXTENDED) && !read_byte(position, end, &extension))) {
+        return false;
+    }
+    square->part_of_board = byte & SQUARE_PART_OF_BOARD;
+    square->piece.piece_type = byte & 0x07;
+    int piece_color = (byte >> 3) & 0x03;
+    square->piece.piece_color = piece_color == 3 ? PIECE_COLOR_NEUTRAL : piece_color - 1;
+    square->piece.has_moved = byte & SQUARE_HAS_MOVED;
+    square->piece.direction = extension & 0x03;
+    square->white_flag = extension & SQUARE_WHITE_FLAG;
+    square->black_flag = extension & SQUARE_BLACK_FLAG;
+    return true;
+}
+
+// Everything write_square keeps
+static bool squares_equal(struct Square square1, struct Square square2) {
+    unsigned char buffer1[2], buffer2[2];
+    int length = write_square(buffer1, square1);
+    return length == write_square(buffer2, square2) && memcmp(buffer1, buffer2, length) == 0;
+}
+
+// Only the fields en passant and the moved-twice check read. Not yet made moves have garbage, stored as -1
+static int write_last_move(unsigned char buffer[], struct Move move) {
+    int length = 0;
+    length += write_varint(buffer + length, move.destination_square >= 0 ? move.origin_square + 1 : 0);
+    length += write_varint(buffer + length, move.destination_square >= 0 ? move.destination_square + 1 : 0);
+    length += write_varint(buffer + length, move.destination_square >= 0 && move.pawn_moved_past_square >= 0 ?
+                                            move.pawn_moved_past_square + 1 : 0);
+    return length;
+}
+
+static bool read_last_move(const unsigned char **position, const unsigned char *end, struct Move *move,
+                           int board_length) {
+    unsigned int origin_square, destination_square, pawn_moved_past_square;
+    if (    !read_varint(position, end, &origin_square) || !read_varint(position, end, &destination_square) ||
+            !read_varint(position, end, &pawn_moved_past_square) || origin_square > (unsigned int)board_length ||
+            destination_square > (unsigned int)board_length || pawn_moved_past_square > (unsigned int)board_length) {
+        return false;
+    }
+    move->origin_square = (int)origin_square - 1;
+    move->destination_square = (int)destination_square - 1;
+    move->pawn_moved_past_square = (int)pawn_moved_past_square - 1;
+    move->en_passant_capture = false;
+    move->castling_with_rook_on_square = -1;
+    move->castling_rook_destination_square = -1;
+    return true;
+}
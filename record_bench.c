@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 199309L     // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chess4d.h"
+
+// Bytes per move of game records against storing struct Move, and how fast they decode. Random games are written to a
+// temporary file, read back and then verified. With -verify the verifier runs on a record file instead, e.g.
+//   ./selfplay -games 100 -record games.c4dr && ./record_bench -verify games.c4dr
+
+#define RECORD_BENCH_GAMES 200
+#define RECORD_BENCH_MAX_MOVES 200
+
+struct RecordBenchVariant {
+    enum Variant variant;
+    const char *name;
+};
+
+static const struct RecordBenchVariant record_bench_variants[] = {
+    {STANDARD_CHESS,            "standard"},
+    {GRAVITY_CHESS,             "gravity"},
+    {STANDARD_24X24_CHESS,      "standard 24x24"},
+    {THREE_D_5X5X5_CHESS,       "3D 5x5x5"},
+    {FOUR_D_4X4X4X4_V1_CHESS,   "4D 4x4x4x4 v1"},
+    {SIX_D_3X3X3X3X3X3_CHESS,   "6D 3x3x3x3x3x3"},
+};
+
+#define NBR_OF_RECORD_BENCH_VARIANTS (int)(sizeof(record_bench_variants) / sizeof(record_bench_variants[0]))
+
+static bool write_random_games(struct GameRecordWriter *writer, enum Variant variant, unsigned long long *random_state);
+static int  verify_file(const char *path);
+static double seconds_now(void);
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "-verify") == 0) {
+        return verify_file(argv[2]);
+    }
+    if (argc != 1) {
+        printf("usage: record_bench [-verify file]\n");
+        return 1;
+    }
+    unsigned long long random_state = 1;
+    printf("%-16s %9s %10s %11s %9s %13s %13s\n", "variant", "moves", "record B", "B/move", "vs Move",
+           "decode mv/s", "verify mv/s");
+    for (int v = 0; v < NBR_OF_RECORD_BENCH_VARIANTS; ++v) {
+        FILE *file = tmpfile();
+        if (file == NULL) {
+            printf("Tragedy: no temporary file\n");
+            return 1;
+        }
+        struct GameRecordWriter writer;
+        initialize_game_record_writer(&writer, file);
+        if (!write_random_games(&writer, record_bench_variants[v].variant, &random_state)) {
+            return 1;
+        }
+        terminate_game_record_writer(&writer);
+
+        // Decode only, the moves are made on the reader's board but nobody checks them
+        struct GameRecordReader reader;
+        rewind(file);
+        if (!initialize_game_record_reader(&reader, file)) {
+            return 1;
+        }
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        double start_time = seconds_now();
+        while (next_game_record(&reader)) {
+            while (read_game_record_move(&reader, &move, &promotion_piece_type)) {
+            }
+            if (reader.error) {
+                return 1;
+            }
+        }
+        double decode_seconds = seconds_now() - start_time;
+        terminate_game_record_reader(&reader);
+
+        rewind(file);
+        start_time = seconds_now();
+        if (!initialize_game_record_reader(&reader, file) || !verify_game_records(&reader)) {
+            printf("bug, record of %s doesn't verify\n", record_bench_variants[v].name);
+            return 1;
+        }
+        double verify_seconds = seconds_now() - start_time;
+        fclose(file);
+
+        double bytes_per_move = (double)writer.bytes_written / writer.nbr_moves;
+        printf("%-16s %9lli %10lli %11.2f %8.1fx %13.0f %13.0f\n", record_bench_variants[v].name, writer.nbr_moves,
+               writer.bytes_written, bytes_per_move, sizeof(struct Move) / bytes_per_move,
+               reader.nbr_moves / decode_seconds, reader.nbr_moves / verify_seconds);
+    }
+    printf("\n%i random games of up to %i moves per variant. vs Move: against %i bytes of struct Move per move\n",
+           RECORD_BENCH_GAMES, RECORD_BENCH_MAX_MOVES, (int)sizeof(struct Move));
+    return 0;
+}
+
+// Both sides promote to queen, games end at a win like in play_game
+static bool write_random_games(struct GameRecordWriter *writer, enum Variant variant, unsigned long long *random_state) {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    for (int game = 0; game < RECORD_BENCH_GAMES; ++game) {
+        if (!begin_game_record(writer, variant)) {
+            return false;
+        }
+        struct GameState *game_state = &writer->game_state;
+        enum PieceColor winner = NULL_PIECE_COLOR;
+        for (int move_number = 0; move_number < RECORD_BENCH_MAX_MOVES && winner == NULL_PIECE_COLOR; ++move_number) {
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, game_state, &writer->rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            struct Move move = moves[next_random(random_state) % (unsigned long long)nbr_moves];
+            if (!write_game_record_move(writer, move, QUEEN)) {
+                return false;
+            }
+            winner = get_winner(move, game_state, &writer->rules);
+        }
+        end_game_record(writer, winner);
+    }
+    return true;
+}
+
+static int verify_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Tragedy: can't read %s\n", path);
+        return 1;
+    }
+    struct GameRecordReader reader;
+    double start_time = seconds_now();
+    bool verified = initialize_game_record_reader(&reader, file) && verify_game_records(&reader);
+    double seconds = seconds_now() - start_time;
+    long bytes = ftell(file);
+    fclose(file);
+    printf("%s: %lli games, %lli moves, %.2f bytes/move, %.0f moves/s, %s\n", path, reader.nbr_games, reader.nbr_moves,
+           reader.nbr_moves > 0 ? (double)bytes / reader.nbr_moves : 0.0, seconds > 0 ? reader.nbr_moves / seconds : 0.0,
+           verified ? "verified" : "broken");
+    return verified ? 0 : 1;
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
@@ -0,0 +1,279 @@
+#define _POSIX_C_SOURCE 200809L     // sysconf, clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "chess4d.h"
+#include "software_renderer.h"
+
+// Images of the positions of a game record without SDL, see software_renderer.c. Every -every-th position of every
+// game is drawn, on -threads threads that each replay all games and draw their share. Without a record, -games random
+// games of -variant are played first. e.g.
+//   ./render_positions -records games.c4dr -every 10 -size 512x512 -o thumbnails
+// Without -o the PNGs are made and thrown away, with -raw not even made, to see how fast drawing alone is
+
+#define DEFAULT_IMAGE_SIZE 256
+#define DEFAULT_RANDOM_GAMES 8
+#define RANDOM_GAME_MAX_MOVES 200
+
+struct Options {
+    const char *records_path;
+    enum Variant variant;
+    int  nbr_random_games;
+    int  every;
+    int  width;
+    int  height;
+    long nbr_threads;
+    const char *output_directory;       // NULL to not write files
+    bool raw;                           // no PNGs
+    const char *images_path;
+};
+
+struct RenderJob {
+    struct Options *options;
+    const unsigned char *records;
+    size_t records_length;
+    int  thread_index;
+    long long nbr_images;
+    long long png_bytes;
+    double seconds;                     // on this thread
+    bool ok;
+};
+
+static void *render_thread(void *argument);
+static bool render_one(struct RenderJob *job, struct SoftwareRenderer *renderer, struct PngEncoder *encoder,
+                       struct GameState *game_state, unsigned char image[], long long game_number, int ply);
+static bool play_random_games(struct Options *options, unsigned char **records, size_t *records_length);
+static bool read_file(const char *path, unsigned char **data, size_t *length);
+static double seconds_now(void);
+
+static void print_usage(void) {
+    printf("usage: render_positions [-records file | -variant name -games n] [-every n] [-size WxH] [-threads n] "
+           "[-o directory] [-raw] [-images directory]\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct Options options = {
+        .variant = FOUR_D_8X8X8X8_V2_CHESS, .nbr_random_games = DEFAULT_RANDOM_GAMES, .every = 1,
+        .width = DEFAULT_IMAGE_SIZE, .height = DEFAULT_IMAGE_SIZE, .nbr_threads = sysconf(_SC_NPROCESSORS_ONLN),
+        .images_path = "images",
+    };
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-records") == 0 && has_value) {
+            options.records_path = argv[++i];
+        } else if (strcmp(argv[i], "-variant") == 0 && has_value) {
+            if (!variant_from_name(argv[++i], &options.variant)) {
+                printf("Calamity: no variant %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-games") == 0 && has_value) {
+            options.nbr_random_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-every") == 0 && has_value) {
+            options.every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-size") == 0 && has_value) {
+            if (sscanf(argv[++i], "%ix%i", &options.width, &options.height) != 2) {
+                print_usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-threads") == 0 && has_value) {
+            options.nbr_threads = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && has_value) {
+            options.output_directory = argv[++i];
+        } else if (strcmp(argv[i], "-raw") == 0) {
+            options.raw = true;
+        } else if (strcmp(argv[i], "-images") == 0 && has_value) {
+            options.images_path = argv[++i];
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (options.every < 1 || options.width < 1 || options.height < 1 || options.nbr_threads < 1) {
+        print_usage();
+        return 1;
+    }
+
+    unsigned char *records;
+    size_t records_length;
+    if (options.records_path != NULL ? !read_file(options.records_path, &records, &records_length) :
+                                       !play_random_games(&options, &records, &records_length)) {
+        return 1;
+    }
+
+    struct RenderJob *jobs = calloc(options.nbr_threads, sizeof(*jobs));
+    pthread_t *threads = malloc(sizeof(*threads) * options.nbr_threads);
+    if (jobs == NULL || threads == NULL) {
+        printf("Tragedy: no memory for %li threads\n", options.nbr_threads);
+        return 1;
+    }
+    double start_time = seconds_now();
+    for (long i = 0; i < options.nbr_threads; ++i) {
+        jobs[i] = (struct RenderJob){.options = &options, .records = records, .records_length = records_length,
+                                     .thread_index = i};
+        if (pthread_create(&threads[i], NULL, render_thread, &jobs[i]) != 0) {
+            printf("Havoc: can't start thread %li\n", i);
+            return 1;
+        }
+    }
+    long long nbr_images = 0, png_bytes = 0;
+    double thread_seconds = 0;
+    bool ok = true;
+    for (long i = 0; i < options.nbr_threads; ++i) {
+        pthread_join(threads[i], NULL);
+        nbr_images += jobs[i].nbr_images;
+        png_bytes += jobs[i].png_bytes;
+        thread_seconds += jobs[i].seconds;
+        ok = ok && jobs[i].ok;
+    }
+    double seconds = seconds_now() - start_time;
+    printf("%lli images of %ix%i in %.2f s on %li threads: %.0f images/s, %.0f images/s per thread", nbr_images,
+           options.width, options.height, seconds, options.nbr_threads, nbr_images / seconds, nbr_images / thread_seconds);
+    if (!options.raw) {
+        printf(", %.1f kB per PNG", nbr_images > 0 ? png_bytes / 1000.0 / nbr_images : 0.0);
+    }
+    printf("\n");
+    free(jobs);
+    free(threads);
+    free(records);
+    return ok ? 0 : 1;
+}
+
+// Replays every game and draws the positions of this thread, game by game the variant can change
+static void *render_thread(void *argument) {
+    struct RenderJob *job = argument;
+    struct Options *options = job->options;
+    double start_time = seconds_now();
+    struct GameRecordReader reader;
+    initialize_game_record_reader_from_memory(&reader, job->records, job->records_length);
+    struct SoftwareRenderer renderer;
+    bool renderer_ready = false;
+    enum Variant renderer_variant = 0;
+    unsigned char *image = malloc(4 * (size_t)options->width * options->height);
+    struct PngEncoder encoder;
+    job->ok = image != NULL && initialize_png_encoder(&encoder, options->width, options->height);
+    long long position_number = 0;
+
+    for (long long game_number = 0; job->ok && next_game_record(&reader); ++game_number) {
+        if (!renderer_ready || renderer_variant != reader.variant) {
+            if (renderer_ready) {
+                terminate_software_renderer(&renderer);
+            }
+            renderer_ready = initialize_software_renderer(&renderer, options->width, options->height,
+                                                          reader.rules.dimensions, reader.rules.board_shape,
+                                                          options->images_path);
+            renderer_variant = reader.variant;
+            job->ok = renderer_ready;
+        }
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        for (int ply = 0; job->ok; ++ply) {
+            if (    ply % options->every == 0 &&
+                    position_number++ % options->nbr_threads == job->thread_index) {
+                job->ok = render_one(job, &renderer, &encoder, &reader.game_state, image, game_number, ply);
+            }
+            if (!read_game_record_move(&reader, &move, &promotion_piece_type)) {
+                break;
+            }
+        }
+        job->ok = job->ok && !reader.error;
+    }
+    job->ok = job->ok && !reader.error;
+    if (renderer_ready) {
+        terminate_software_renderer(&renderer);
+    }
+    terminate_game_record_reader(&reader);
+    terminate_png_encoder(&encoder);
+    free(image);
+    job->seconds = seconds_now() - start_time;
+    return NULL;
+}
+
+static bool render_one(struct RenderJob *job, struct SoftwareRenderer *renderer, struct PngEncoder *encoder,
+                       struct GameState *game_state, unsigned char image[], long long game_number, int ply) {
+    struct Options *options = job->options;
+    render_position(renderer, game_state, image);
+    ++job->nbr_images;
+    if (options->raw) {
+        return true;
+    }
+    size_t length = encode_png(encoder, image);
+    job->png_bytes += length;
+    if (length == 0) {
+        return false;
+    } else if (options->output_directory == NULL) {
+        return true;
+    }
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof(path), "%s/game%06lli_ply%04i.png", options->output_directory, game_number, ply);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Tragedy: can't write %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(encoder->png, 1, length, file) == length;
+    if (fclose(file) != 0 || !ok) {
+        printf("Havoc: failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+static bool play_random_games(struct Options *options, unsigned char **records, size_t *records_length) {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    unsigned long long random_state = 1;
+    struct GameRecordWriter writer;
+    initialize_game_record_writer(&writer, NULL);
+    for (int game = 0; game < options->nbr_random_games; ++game) {
+        if (!begin_game_record(&writer, options->variant)) {
+            return false;
+        }
+        enum PieceColor winner = NULL_PIECE_COLOR;
+        for (int move_number = 0; move_number < RANDOM_GAME_MAX_MOVES && winner == NULL_PIECE_COLOR; ++move_number) {
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &writer.game_state, &writer.rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+            if (!write_game_record_move(&writer, move, QUEEN)) {
+                return false;
+            }
+            winner = get_winner(move, &writer.game_state, &writer.rules);
+        }
+        end_game_record(&writer, winner);
+    }
+    // The buffer is handed over instead of freed
+    *records = writer.buffer;
+    *records_length = writer.buffer_length;
+    writer.buffer = NULL;
+    terminate_game_record_writer(&writer);
+    return true;
+}
+
+static bool read_file(const char *path, unsigned char **data, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0) {
+        printf("Tragedy: can't read %s\n", path);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+    *length = ftell(file);
+    rewind(file);
+    *data = malloc(*length > 0 ? *length : 1);
+    bool ok = *data != NULL && fread(*data, 1, *length, file) == *length;
+    fclose(file);
+    if (!ok) {
+        printf("Tragedy: can't read %s\n", path);
+    }
+    return ok;
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
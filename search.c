@@ -0,0 +1,539 @@
+#define _POSIX_C_SOURCE 199309L     // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "chess.h"
+#include "engine.h"
+
+#define DELTA_PRUNING_MARGIN 200    // captures that can't raise the score to alpha even with this margin are skipped
+#define QUIESCENCE_FULL_PLIES 4     // deeper than this only recaptures are searched, crowded boards have endless captures
+#define RAZORING_MAX_DEPTH 2
+#define RAZORING_MARGIN 300         // per ply of depth left
+#define FUTILITY_MAX_DEPTH 3
+#define FUTILITY_MARGIN 150         // per ply of depth left
+#define NULL_MOVE_MIN_DEPTH 3
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES_SEARCHED 3    // the first moves are searched at full depth
+#define TIME_CHECK_INTERVAL 1024    // nodes between clock reads
+
+static int  quiescence         (struct SearchContext *search_context, int alpha, int beta, int ply, int quiescence_ply,
+                                int last_destination_square);
+static int  alpha_beta         (struct SearchContext *search_context, int alpha, int beta, int depth, int ply,
+                                struct Move previous_move, bool null_move_allowed);
+static int  search_child       (struct SearchContext *search_context, bool turn_passed, int alpha, int beta, int depth, int ply,
+                                struct Move move);
+static bool null_move_allowed_by_rules(struct Rules *rules);
+static bool search_limit_reached(struct SearchContext *search_context);
+static double seconds_now      (void);
+static bool search_make_move   (struct SearchContext *search_context, struct Move move, int ply);
+static void search_unmake_move (struct SearchContext *search_context, int ply);
+static bool move_wins_game     (struct Move move, struct GameState *game_state, struct Rules *rules);
+static int  captured_piece_value(struct Move move, struct GameState *game_state);
+
+bool initialize_search_context(struct SearchContext *search_context, struct GameState *game_state, struct Rules *rules) {
+    search_context->game_state = game_state;
+    search_context->rules = rules;
+    search_context->move_stack = malloc(sizeof(*search_context->move_stack) * MAX_SEARCH_PLY * MAX_MOVES_IN_POSITION);
+    search_context->score_stack = malloc(sizeof(*search_context->score_stack) * MAX_SEARCH_PLY * MAX_MOVES_IN_POSITION);
+    search_context->plies = malloc(sizeof(*search_context->plies) * MAX_SEARCH_PLY);
+    if (    search_context->move_stack == NULL || search_context->score_stack == NULL || search_context->plies == NULL ||
+            !initialize_move_ordering(&search_context->move_ordering, rules)) {
+        printf("Havoc: failed to allocate search context\n");
+        free(search_context->move_stack);
+        free(search_context->score_stack);
+        free(search_context->plies);
+        return false;
+    }
+    default_search_options(&search_context->options);
+    search_context->start_time = seconds_now();
+    search_context->stopped = false;
+    search_context->stop_requested = false;
+    search_context->pondering = false;
+    search_context->limits_started = false;
+    search_context->limits_start_time = search_context->start_time;
+    search_context->limits_start_nodes = 0;
+    search_context->root_best_move.destination_square = -1;
+    search_context->previous_root_best_move.destination_square = -1;
+    search_context->iteration_done = NULL;
+    search_context->iteration_done_argument = NULL;
+    search_context->nodes = 0;
+    search_context->quiescence_nodes = 0;
+    search_context->see_pruned_captures = 0;
+    search_context->null_move_cutoffs = 0;
+    search_context->reduced_moves = 0;
+    search_context->futility_pruned_moves = 0;
+    search_context->razored_nodes = 0;
+    reset_search_material(search_context);
+    return true;
+}
+
+void terminate_search_context(struct SearchContext *search_context) {
+    terminate_move_ordering(&search_context->move_ordering);
+    free(search_context->move_stack);
+    free(search_context->score_stack);
+    free(search_context->plies);
+    search_context->move_stack = NULL;
+    search_context->score_stack = NULL;
+    search_context->plies = NULL;
+}
+
+// Counts the material on the board. Call whenever the game state was changed outside of search
+void reset_search_material(struct SearchContext *search_context) {
+    struct Square *board = search_context->game_state->board;
+    int board_length = search_context->move_ordering.board_length;
+    search_context->material[PIECE_COLOR_WHITE] = 0;
+    search_context->material[PIECE_COLOR_BLACK] = 0;
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        struct Piece piece = board[square_index].piece;
+        if (!board[square_index].part_of_board || piece.piece_type == NULL_PIECE_TYPE) {
+            continue;
+        }
+        if (piece.piece_color == PIECE_COLOR_WHITE || piece.piece_color == PIECE_COLOR_BLACK) {
+            search_context->material[piece.piece_color] += piece_values[piece.piece_type];
+        }
+    }
+}
+
+// Score from the point of view of the side to move
+int evaluate_position(struct SearchContext *search_context) {
+    int score = search_context->material[PIECE_COLOR_WHITE] - search_context->material[PIECE_COLOR_BLACK];
+    return search_context->game_state->whos_turn == PIECE_COLOR_WHITE ? score : -score;
+}
+
+void default_search_options(struct SearchOptions *options) {
+    options->max_depth = MAX_SEARCH_PLY / 2;
+    options->max_nodes = 0;
+    options->max_seconds = 0;
+    options->null_move_pruning = true;
+    options->late_move_reductions = true;
+    options->futility_pruning = true;
+    options->razoring = true;
+}
+
+// Iterative deepening from the current game state. The game state is unchanged afterwards
+struct SearchResult search_position(struct SearchContext *search_context, struct SearchOptions *options) {
+    struct SearchResult result;
+    result.best_move.destination_square = -1;
+    result.score = 0;
+    result.depth_reached = 0;
+
+    search_context->options = *options;
+    search_context->stopped = false;
+    search_context->start_time = seconds_now();
+    search_context->limits_started = false;
+    search_context->previous_root_best_move.destination_square = -1;
+    search_context->nodes = 0;
+    search_context->quiescence_nodes = 0;
+    search_context->see_pruned_captures = 0;
+    search_context->null_move_cutoffs = 0;
+    search_context->reduced_moves = 0;
+    search_context->futility_pruned_moves = 0;
+    search_context->razored_nodes = 0;
+    clear_move_ordering(&search_context->move_ordering);
+    reset_search_material(search_context);
+
+    struct Move no_previous_move;
+    no_previous_move.destination_square = -1;
+    int max_depth = options->max_depth < MAX_SEARCH_PLY - 1 ? options->max_depth : MAX_SEARCH_PLY - 1;
+    for (int depth = 1; depth <= max_depth; ++depth) {
+        search_context->root_best_move.destination_square = -1;
+        int score = alpha_beta(search_context, -INFINITE_SCORE, INFINITE_SCORE, depth, 0, no_previous_move, false);
+        if (search_context->stopped) {
+            // An unfinished iteration is only used if there is nothing better
+            if (result.best_move.destination_square == -1) {
+                result.best_move = search_context->root_best_move;
+            }
+            break;
+        }
+        result.best_move = search_context->root_best_move;
+        result.score = score;
+        result.depth_reached = depth;
+        search_context->previous_root_best_move = search_context->root_best_move;
+        if (search_context->iteration_done != NULL) {
+            result.nodes = search_context->nodes;
+            result.seconds = seconds_now() - search_context->start_time;
+            search_context->iteration_done(&result, search_context->iteration_done_argument);
+        }
+        if (score >= MATE_SCORE - MAX_SEARCH_PLY || score <= -MATE_SCORE + MAX_SEARCH_PLY) {
+            break;
+        }
+    }
+    if (result.best_move.destination_square == -1 && search_context->stopped &&
+            generate_moves(search_context->move_stack, 1, false, search_context->game_state,
+                           search_context->rules) > 0) {
+        result.best_move = search_context->move_stack[0];     // stopped before the first move was searched
+    }
+    result.nodes = search_context->nodes;
+    result.seconds = seconds_now() - search_context->start_time;
+    return result;
+}
+
+// Material won or lost by the side making the capture if both sides keep recapturing on the destination square with their
+// least valuable attacker, and either side can stop when continuing would lose material. Board is unchanged afterwards
+int static_exchange_evaluation(struct Move move, struct GameState *game_state, struct Rules *rules) {
+    struct Square *board = game_state->board;
+    int target = move.destination_square;
+    int attackers[MAX_ATTACKERS];
+    int captured_values[MAX_ATTACKERS + 1];     // value of the piece taken by each capture in the sequence
+    int nbr_captures = 0;
+
+    // Pieces moved during the exchange, put back at the end
+    int removed_squares[MAX_ATTACKERS + 1];
+    struct Piece removed_pieces[MAX_ATTACKERS + 1];
+    struct Piece target_piece = board[target].piece;
+
+    captured_values[nbr_captures] = captured_piece_value(move, game_state);
+    removed_squares[nbr_captures] = move.origin_square;
+    removed_pieces[nbr_captures++] = board[move.origin_square].piece;
+    board[target].piece = board[move.origin_square].piece;
+    board[move.origin_square].piece.piece_type = NULL_PIECE_TYPE;
+
+    enum PieceColor side = board[target].piece.piece_color;
+    while (nbr_captures <= MAX_ATTACKERS) {
+        side = (side == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+        if (rules->king_invincible && board[target].piece.piece_type == KING) {
+            break;
+        }
+        // Recomputed after every capture so that sliders behind the pieces that already captured join in
+        if (get_attackers(attackers, MAX_ATTACKERS, target, side, game_state, rules) == 0) {
+            break;
+        }
+        captured_values[nbr_captures] = piece_values[board[target].piece.piece_type];
+        removed_squares[nbr_captures] = attackers[0];
+        removed_pieces[nbr_captures++] = board[attackers[0]].piece;
+        board[target].piece = board[attackers[0]].piece;
+        board[attackers[0]].piece.piece_type = NULL_PIECE_TYPE;
+    }
+
+    for (int i = nbr_captures - 1; i >= 0; --i) {
+        board[removed_squares[i]].piece = removed_pieces[i];
+    }
+    board[target].piece = target_piece;
+
+    // Backwards from the last capture. Every recapture is optional, so a side only takes if it doesn't lose by it
+    int recapture_gain = 0;
+    for (int i = nbr_captures - 1; i > 0; --i) {
+        recapture_gain = captured_values[i] - recapture_gain > 0 ? captured_values[i] - recapture_gain : 0;
+    }
+    return captured_values[0] - recapture_gain;
+}
+
+// Captures only, until the position is quiet. Losing captures according to static exchange evaluation are not searched
+int quiescence_search(struct SearchContext *search_context, int alpha, int beta, int ply) {
+    return quiescence(search_context, alpha, beta, ply, 0, -1);
+}
+
+static int quiescence(struct SearchContext *search_context, int alpha, int beta, int ply, int quiescence_ply,
+                      int last_destination_square) {
+    struct GameState *game_state = search_context->game_state;
+    struct Rules *rules = search_context->rules;
+    ++search_context->nodes;
+    ++search_context->quiescence_nodes;
+    if (search_limit_reached(search_context)) {
+        return 0;
+    }
+
+    int stand_pat = evaluate_position(search_context);
+    if (ply >= MAX_SEARCH_PLY - 1 || stand_pat >= beta) {
+        return stand_pat;
+    }
+    if (stand_pat > alpha) {
+        alpha = stand_pat;
+    }
+
+    struct Move *moves = search_context->move_stack + ply * MAX_MOVES_IN_POSITION;
+    int *scores = search_context->score_stack + ply * MAX_MOVES_IN_POSITION;
+    int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, true, game_state, rules);
+    struct Move no_previous_move;
+    no_previous_move.destination_square = -1;
+    score_moves(scores, moves, nbr_moves, ply, no_previous_move, game_state, &search_context->move_ordering);
+
+    int best_score = stand_pat;
+    for (int i = 0; i < nbr_moves; ++i) {
+        pick_next_move(moves, scores, nbr_moves, i);
+        struct Move move = moves[i];
+        if (move_wins_game(move, game_state, rules)) {
+            return MATE_SCORE - ply;
+        }
+        if (stand_pat + captured_piece_value(move, game_state) + DELTA_PRUNING_MARGIN < alpha) {
+            continue;
+        }
+        if (quiescence_ply >= QUIESCENCE_FULL_PLIES && move.destination_square != last_destination_square) {
+            continue;
+        }
+        if (static_exchange_evaluation(move, game_state, rules) < 0) {
+            ++search_context->see_pruned_captures;
+            continue;
+        }
+
+        int score;
+        if (search_make_move(search_context, move, ply)) {
+            score = -quiescence(search_context, -beta, -alpha, ply + 1, quiescence_ply + 1, move.destination_square);
+        } else {
+            // same side moves again this turn
+            score = quiescence(search_context, alpha, beta, ply + 1, quiescence_ply + 1, move.destination_square);
+        }
+        search_unmake_move(search_context, ply);
+        if (search_context->stopped) {
+            return 0;
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (score >= beta) {
+                break;
+            }
+        }
+    }
+    return best_score;
+}
+
+// Fail-soft alpha-beta with principal variation search. Null windows everywhere but on the principal variation allow
+// the selective parts: razoring and null move before generating moves, futility pruning and late move reductions per move
+static int alpha_beta(struct SearchContext *search_context, int alpha, int beta, int depth, int ply, struct Move previous_move,
+                      bool null_move_allowed) {
+    struct GameState *game_state = search_context->game_state;
+    struct Rules *rules = search_context->rules;
+    struct SearchOptions *options = &search_context->options;
+    if (depth <= 0) {
+        return quiescence_search(search_context, alpha, beta, ply);
+    }
+    ++search_context->nodes;
+    if (search_limit_reached(search_context)) {
+        return 0;
+    }
+    if (ply >= MAX_SEARCH_PLY - 1) {
+        return evaluate_position(search_context);
+    }
+
+    bool principal_variation = beta - alpha > 1;
+    int static_evaluation = evaluate_position(search_context);
+
+    // Razoring: far below alpha close to the leaves, only captures can save the position
+    if (    options->razoring && !principal_variation && depth <= RAZORING_MAX_DEPTH &&
+            static_evaluation + RAZORING_MARGIN * depth <= alpha) {
+        int score = quiescence_search(search_context, alpha, alpha + 1, ply);
+        if (score <= alpha) {
+            ++search_context->razored_nodes;
+            return score;
+        }
+    }
+
+    // Null move: if passing still fails high, a real move would too
+    if (    options->null_move_pruning && null_move_allowed && !principal_variation && depth >= NULL_MOVE_MIN_DEPTH &&
+            static_evaluation >= beta && null_move_allowed_by_rules(rules)) {
+        int reduction = depth > 6 ? 3 : 2;
+        struct SearchPly *search_ply = &search_context->plies[ply];
+        make_null_move(game_state, &search_ply->undo);
+        struct Move null_move;
+        null_move.destination_square = -1;
+        int score = -alpha_beta(search_context, -beta, -beta + 1, depth - 1 - reduction, ply + 1, null_move, false);
+        unmake_move(&search_ply->undo, game_state);
+        if (search_context->stopped) {
+            return 0;
+        }
+        if (score >= beta) {
+            ++search_context->null_move_cutoffs;
+            return score >= MATE_SCORE - MAX_SEARCH_PLY ? beta : score;   // don't trust a mate found by passing
+        }
+    }
+
+    // Futility: quiet moves can't make up the difference near the leaves
+    bool futile = options->futility_pruning && !principal_variation && depth <= FUTILITY_MAX_DEPTH &&
+                  static_evaluation + FUTILITY_MARGIN * depth <= alpha;
+
+    struct Move *moves = search_context->move_stack + ply * MAX_MOVES_IN_POSITION;
+    int *scores = search_context->score_stack + ply * MAX_MOVES_IN_POSITION;
+    int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, game_state, rules);
+    if (nbr_moves == 0) {
+        return 0;
+    }
+    score_moves(scores, moves, nbr_moves, ply, previous_move, game_state, &search_context->move_ordering);
+    if (ply == 0 && search_context->previous_root_best_move.destination_square != -1) {
+        for (int i = 0; i < nbr_moves; ++i) {
+            if (    moves[i].origin_square == search_context->previous_root_best_move.origin_square &&
+                    moves[i].destination_square == search_context->previous_root_best_move.destination_square) {
+                scores[i] = INFINITE_SCORE;
+            }
+        }
+    }
+
+    int best_score = -INFINITE_SCORE;
+    int moves_searched = 0;
+    int nbr_quiets_tried = 0;   // tried quiet moves are kept in moves[0..nbr_quiets_tried), those slots are done with
+    for (int i = 0; i < nbr_moves; ++i) {
+        pick_next_move(moves, scores, nbr_moves, i);
+        struct Move move = moves[i];
+        if (move_wins_game(move, game_state, rules)) {
+            if (ply == 0) {
+                search_context->root_best_move = move;
+            }
+            return MATE_SCORE - ply;
+        }
+        bool quiet = !move_is_capture(move, game_state);
+        // Pawn moves may promote, they are never futile
+        if (    futile && quiet && moves_searched > 0 && 
+                game_state->board[move.origin_square].piece.piece_type != PAWN) {
+            ++search_context->futility_pruned_moves;
+            continue;
+        }
+
+        bool turn_passed = search_make_move(search_context, move, ply);
+        int score;
+        if (moves_searched == 0) {
+            score = search_child(search_context, turn_passed, alpha, beta, depth - 1, ply, move);
+        } else {
+            int reduction = 0;
+            if (    options->late_move_reductions && quiet && depth >= LMR_MIN_DEPTH && 
+                    moves_searched >= LMR_MIN_MOVES_SEARCHED) {
+                reduction = (depth >= 6 && moves_searched >= 3 * LMR_MIN_MOVES_SEARCHED) ? 2 : 1;
+                ++search_context->reduced_moves;
+            }
+            score = search_child(search_context, turn_passed, alpha, alpha + 1, depth - 1 - reduction, ply, move);
+            if (score > alpha && reduction > 0) {
+                score = search_child(search_context, turn_passed, alpha, alpha + 1, depth - 1, ply, move);
+            }
+            if (score > alpha && score < beta) {
+                score = search_child(search_context, turn_passed, alpha, beta, depth - 1, ply, move);
+            }
+        }
+        search_unmake_move(search_context, ply);
+        if (search_context->stopped) {
+            return 0;
+        }
+        ++moves_searched;
+
+        if (score > best_score) {
+            best_score = score;
+            if (ply == 0) {
+                search_context->root_best_move = move;
+            }
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (score >= beta) {
+                update_move_ordering_on_cutoff(move, moves_searched - 1, moves, nbr_quiets_tried, previous_move, ply, depth,
+                                               game_state, &search_context->move_ordering);
+                break;
+            }
+        }
+        if (quiet) {
+            moves[nbr_quiets_tried++] = move;
+        }
+    }
+    return best_score;
+}
+
+// Searches the position after move from the point of view of whoever moved. With several moves per turn the same side
+// can be to move again, then the window is not flipped
+static int search_child(struct SearchContext *search_context, bool turn_passed, int alpha, int beta, int depth, int ply,
+                        struct Move move) {
+    if (turn_passed) {
+        return -alpha_beta(search_context, -beta, -alpha, depth, ply + 1, move, true);
+    }
+    return alpha_beta(search_context, alpha, beta, depth, ply + 1, move, true);
+}
+
+// Passing is never good in the middle of a turn, and with gravity zugzwang is too common for the null move assumption
+static bool null_move_allowed_by_rules(struct Rules *rules) {
+    return rules->moves_per_turn_by_color[PIECE_COLOR_WHITE] == 1 && rules->moves_per_turn_by_color[PIECE_COLOR_BLACK] == 1 &&
+           rules->gravity_dimension == -1;
+}
+
+// Called every node. A stop request is seen on the next node, which is well within a millisecond
+static bool search_limit_reached(struct SearchContext *search_context) {
+    if (search_context->stopped) {
+        return true;
+    }
+    if (search_context->stop_requested) {
+        search_context->stopped = true;
+        return true;
+    }
+    if (search_context->pondering) {
+        return false;
+    }
+    if (!search_context->limits_started) {
+        search_context->limits_started = true;
+        search_context->limits_start_time = search_context->nodes <= 1 ? search_context->start_time : seconds_now();
+        search_context->limits_start_nodes = search_context->nodes - 1;
+    }
+    struct SearchOptions *options = &search_context->options;
+    long long nodes = search_context->nodes - search_context->limits_start_nodes;
+    if (options->max_nodes > 0 && nodes >= options->max_nodes) {
+        search_context->stopped = true;
+    } else if (options->max_seconds > 0 && nodes % TIME_CHECK_INTERVAL == 0 &&
+               seconds_now() - search_context->limits_start_time >= options->max_seconds) {
+        search_context->stopped = true;
+    }
+    return search_context->stopped;
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+// Returns true if the other side is to move after the move. Promotes to queen
+static bool search_make_move(struct SearchContext *search_context, struct Move move, int ply) {
+    struct GameState *game_state = search_context->game_state;
+    struct Rules *rules = search_context->rules;
+    struct SearchPly *search_ply = &search_context->plies[ply];
+    enum PieceColor piece_color = game_state->whos_turn;
+    enum PieceColor opponent_piece_color = (piece_color == PIECE_COLOR_WHITE) ? PIECE_COLOR_BLACK : PIECE_COLOR_WHITE;
+
+    search_ply->material[PIECE_COLOR_WHITE] = search_context->material[PIECE_COLOR_WHITE];
+    search_ply->material[PIECE_COLOR_BLACK] = search_context->material[PIECE_COLOR_BLACK];
+    search_context->material[opponent_piece_color] -= captured_piece_value(move, game_state);
+
+    enum PieceType promotion_piece_type = NULL_PIECE_TYPE;
+    if (evaluate_promotion(move.origin_square, move.destination_square, game_state, rules)) {
+        promotion_piece_type = QUEEN;
+        enum PieceType piece_type = game_state->board[move.origin_square].piece.piece_type;
+        search_context->material[piece_color] += piece_values[QUEEN] - piece_values[piece_type];
+    }
+
+    make_move_with_undo(move, promotion_piece_type, game_state, rules, &search_ply->undo);
+    return game_state->whos_turn != piece_color;
+}
+
+static void search_unmake_move(struct SearchContext *search_context, int ply) {
+    struct SearchPly *search_ply = &search_context->plies[ply];
+    unmake_move(&search_ply->undo, search_context->game_state);
+    search_context->material[PIECE_COLOR_WHITE] = search_ply->material[PIECE_COLOR_WHITE];
+    search_context->material[PIECE_COLOR_BLACK] = search_ply->material[PIECE_COLOR_BLACK];
+}
+
+// Capturing the king ends the game for every win condition where the king can be captured. KING_ARRIVED wins on arrival
+static bool move_wins_game(struct Move move, struct GameState *game_state, struct Rules *rules) {
+    struct Square *board = game_state->board;
+    struct Piece victim = board[move.destination_square].piece;
+    struct Piece piece = board[move.origin_square].piece;
+    if (victim.piece_type == KING && victim.piece_color != piece.piece_color && !rules->king_invincible) {
+        return true;
+    }
+    if (piece.piece_type == KING && move.destination_square == rules->goal_square_by_piece_color[piece.piece_color]) {
+        for (int i = 0; i < MAX_NBR_OF_WIN_CONDITIONS; ++i) {
+            if (rules->win_conditions[i] == KING_ARRIVED) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int captured_piece_value(struct Move move, struct GameState *game_state) {
+    struct Square *board = game_state->board;
+    struct Piece piece = board[move.origin_square].piece;
+    struct Piece victim = board[move.destination_square].piece;
+    if (victim.piece_type != NULL_PIECE_TYPE && victim.piece_color != piece.piece_color) {
+        return piece_values[victim.piece_type];
+    }
+    if (piece.piece_type == PAWN && move.en_passant_capture) {
+        return piece_values[PAWN];
+    }
+    return 0;
+}
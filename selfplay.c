@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+
+// Headless engine-vs-engine games from the command line, e.g.
+//   ./selfplay -variant three_d_5x5x5 -games 10 -depth 3
+// -record writes all games to a new game record file, see game_record.c
+
+static void print_usage(void) {
+    printf("usage: selfplay [-variant name] [-games n] [-depth n] [-nodes n] [-seconds x] [-length n] [-random n] [-seed n]\n"
+           "                [-record file] [-verbose] [-list]\n");
+}
+
+int main(int argc, char *argv[]) {
+    enum Variant variant = STANDARD_CHESS;
+    int nbr_games = 1;
+    struct GameSettings settings;
+    default_game_settings(&settings, variant);
+    struct SearchOptions options = settings.move_choosers[PIECE_COLOR_WHITE].search_options;
+    const char *record_path = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-list") == 0) {
+            for (int v = 0; v < NBR_OF_VARIANTS; ++v) {
+                printf("%s\n", variant_name(v));
+            }
+            return 0;
+        } else if (strcmp(argv[i], "-verbose") == 0) {
+            settings.verbose = true;
+        } else if (strcmp(argv[i], "-variant") == 0 && has_value) {
+            if (!variant_from_name(argv[++i], &variant)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-games") == 0 && has_value) {
+            nbr_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-depth") == 0 && has_value) {
+            options.max_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-nodes") == 0 && has_value) {
+            options.max_nodes = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-seconds") == 0 && has_value) {
+            options.max_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-length") == 0 && has_value) {
+            settings.max_game_length = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-random") == 0 && has_value) {
+            settings.random_opening_moves = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && has_value) {
+            settings.random_seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-record") == 0 && has_value) {
+            record_path = argv[++i];
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    settings.variant = variant;
+    settings.move_choosers[PIECE_COLOR_WHITE].search_options = options;
+    settings.move_choosers[PIECE_COLOR_BLACK].search_options = options;
+    struct GameRecordWriter record;
+    FILE *record_file = NULL;
+    if (record_path != NULL) {
+        record_file = fopen(record_path, "wb");
+        if (record_file == NULL) {
+            printf("Tragedy: can't write %s\n", record_path);
+            return 1;
+        }
+        initialize_game_record_writer(&record, record_file);
+        settings.record = &record;
+    }
+    unsigned long long first_seed = settings.random_seed;
+    int wins[PIECE_COLOR_COUNT] = {0};
+    int draws = 0;
+    double total_seconds = 0;
+    long long total_nodes = 0;
+    for (int game = 1; game <= nbr_games; ++game) {
+        struct GameResult result;
+        settings.random_seed = first_seed + game - 1;
+        if (!play_game(&result, &settings)) {
+            return 1;
+        }
+        const char *outcome = "draw";
+        if (result.winner == PIECE_COLOR_WHITE) {
+            outcome = "white won";
+            ++wins[PIECE_COLOR_WHITE];
+        } else if (result.winner == PIECE_COLOR_BLACK) {
+            outcome = "black won";
+            ++wins[PIECE_COLOR_BLACK];
+        } else {
+            ++draws;
+        }
+        total_seconds += result.seconds;
+        total_nodes += result.nodes;
+        printf("game %i: %s after %i moves, %lli nodes, %.2f s\n", game, outcome, result.nbr_moves, result.nodes, result.seconds);
+    }
+
+    printf("%s: white %i, black %i, draws %i", variant_name(variant), wins[PIECE_COLOR_WHITE], wins[PIECE_COLOR_BLACK], draws);
+    if (total_seconds > 0) {
+        printf(", %.1f games/minute, %.0f nodes/s", 60.0 * nbr_games / total_seconds, (double)total_nodes / total_seconds);
+    }
+    printf("\n");
+    if (record_file != NULL) {
+        terminate_game_record_writer(&record);
+        printf("%lli moves recorded in %lli bytes\n", record.nbr_moves, record.bytes_written);
+        fclose(record_file);
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include "software_renderer.h"
+
+// The board without pieces is drawn once into background. A position is a copy of background with a sprite blended
+// in per piece, the sprites are decoded and scaled to the square width once. Images are RGBA, 4 bytes per pixel,
+// top row first. PNGs are put together here around zlib, as RGB with fast settings since the images are mostly flat
+// color. libpng only decodes the sprites
+
+static const unsigned char light_squares_color[3] = {LIGHT_SQUARES_RGB};
+static const unsigned char dark_squares_color[3] = {DARK_SQUARES_RGB};
+static const unsigned char background_color[3] = {BACKGROUND_RGB};
+
+static const char *sprite_names[QUEEN + 1] = {
+    [PAWN] = "pawn", [ROOK] = "rook", [KNIGHT] = "knight", [BISHOP] = "bishop", [KING] = "king", [QUEEN] = "queen",
+};
+
+static unsigned char *load_sprite(const char *path, int square_width);
+static size_t write_chunk(unsigned char out[], const char type[4], const unsigned char data[], int length);
+static void write_big_endian(unsigned char out[4], unsigned long value);
+static void fill_rect(unsigned char image[], int image_width, int x, int y, int width, int height,
+                      const unsigned char color[3]);
+
+// Layout for width x height images and the piece sprites from images_path, e.g. "images". false if a sprite can't be
+// read or the board doesn't fit
+bool initialize_software_renderer(struct SoftwareRenderer *renderer, int width, int height, int dimensions,
+                                  int board_shape[], const char *images_path) {
+    memset(renderer, 0, sizeof(*renderer));
+    renderer->board_length = board_layout_length(dimensions, board_shape);
+    renderer->graphics_board = malloc(sizeof(*renderer->graphics_board) * renderer->board_length);
+    renderer->background = malloc(4 * (size_t)width * height);
+    if (renderer->graphics_board == NULL || renderer->background == NULL) {
+        printf("Disarray: no memory for the software renderer\n");
+        terminate_software_renderer(renderer);
+        return false;
+    }
+    compute_board_layout(&renderer->layout, renderer->graphics_board, width, height, dimensions, board_shape);
+    int square_width = renderer->layout.square_width;
+    if (square_width < 1) {
+        printf("Disarray: the board doesn't fit in %ix%i\n", width, height);
+        terminate_software_renderer(renderer);
+        return false;
+    }
+
+    fill_rect(renderer->background, width, 0, 0, width, height, background_color);
+    for (int square_index = 0; square_index < renderer->board_length; ++square_index) {
+        struct GraphicsSquare *graphics_square = &renderer->graphics_board[square_index];
+        fill_rect(renderer->background, width, graphics_square->x, graphics_square->y, square_width, square_width,
+                  graphics_square->light_squares ? light_squares_color : dark_squares_color);
+    }
+
+    for (int piece_type = PAWN; piece_type <= QUEEN; ++piece_type) {
+        for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+            char path[FILENAME_MAX];
+            snprintf(path, sizeof(path), "%s/%c_%s.png", images_path, piece_color == PIECE_COLOR_WHITE ? 'w' : 'b',
+                     sprite_names[piece_type]);
+            renderer->sprites[piece_color][piece_type] = load_sprite(path, square_width);
+            if (renderer->sprites[piece_color][piece_type] == NULL) {
+                terminate_software_renderer(renderer);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void terminate_software_renderer(struct SoftwareRenderer *renderer) {
+    free(renderer->graphics_board);
+    free(renderer->background);
+    for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+        for (int piece_type = 0; piece_type <= QUEEN; ++piece_type) {
+            free(renderer->sprites[piece_color][piece_type]);
+            renderer->sprites[piece_color][piece_type] = NULL;
+        }
+    }
+    renderer->graphics_board = NULL;
+    renderer->background = NULL;
+}
+
+// Draws the position into image, 4 * width * height bytes
+void render_position(struct SoftwareRenderer *renderer, struct GameState *game_state, unsigned char image[]) {
+    int width = renderer->layout.width;
+    int square_width = renderer->layout.square_width;
+    memcpy(image, renderer->background, 4 * (size_t)width * renderer->layout.height);
+    for (int square_index = 0; square_index < renderer->board_length; ++square_index) {
+        struct Square *square = &game_state->board[square_index];
+        if (    !square->part_of_board || square->piece.piece_type == NULL_PIECE_TYPE ||
+                square->piece.piece_color < 0 || square->piece.piece_color >= PIECE_COLOR_COUNT) {
+            continue;
+        }
+        const unsigned char *sprite = renderer->sprites[square->piece.piece_color][square->piece.piece_type];
+        struct GraphicsSquare *graphics_square = &renderer->graphics_board[square_index];
+        for (int y = 0; y < square_width; ++y) {
+            unsigned char *pixel = &image[4 * ((size_t)(graphics_square->y + y) * width + graphics_square->x)];
+            const unsigned char *sprite_pixel = &sprite[4 * y * square_width];
+            for (int x = 0; x < square_width; ++x, pixel += 4, sprite_pixel += 4) {
+                int alpha = sprite_pixel[3];
+                if (alpha == 0xFF) {
+                    memcpy(pixel, sprite_pixel, 4);
+                } else if (alpha != 0) {
+                    for (int channel = 0; channel < 3; ++channel) {
+                        pixel[channel] = sprite_pixel[channel] + (pixel[channel] * (0xFF - alpha) + 0x7F) / 0xFF;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Deflate state and buffers for the PNGs of one thread, reused from image to image
+bool initialize_png_encoder(struct PngEncoder *encoder, int width, int height) {
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->width = width;
+    encoder->height = height;
+    encoder->filtered_length = (size_t)height * (1 + 3 * (size_t)width);
+    encoder->filtered = malloc(encoder->filtered_length);
+    if (    encoder->filtered == NULL ||
+            deflateInit2(&encoder->stream, 1, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        printf("Disarray: no memory for the PNG encoder\n");
+        free(encoder->filtered);
+        encoder->filtered = NULL;
+        return false;
+    }
+    encoder->stream_initialized = true;
+    encoder->capacity = PNG_OVERHEAD + deflateBound(&encoder->stream, encoder->filtered_length);
+    encoder->png = malloc(encoder->capacity);
+    if (encoder->png == NULL) {
+        printf("Disarray: no memory for the PNG encoder\n");
+        terminate_png_encoder(encoder);
+        return false;
+    }
+    return true;
+}
+
+void terminate_png_encoder(struct PngEncoder *encoder) {
+    if (encoder->stream_initialized) {
+        deflateEnd(&encoder->stream);
+        encoder->stream_initialized = false;
+    }
+    free(encoder->filtered);
+    free(encoder->png);
+    encoder->filtered = NULL;
+    encoder->png = NULL;
+}
+
+// PNG file of an image from render_position in encoder->png, RGB without alpha. Returns its length, 0 on errors.
+// Every row is filtered with the left pixel subtracted, which turns flat color into zeros that run length encoding
+// packs well and fast
+size_t encode_png(struct PngEncoder *encoder, const unsigned char image[]) {
+    int width = encoder->width;
+    unsigned char *filtered = encoder->filtered;
+    for (int y = 0; y < encoder->height; ++y) {
+        const unsigned char *pixel = &image[4 * (size_t)y * width];
+        const unsigned char *above = pixel - 4 * (size_t)width;
+        *filtered++ = y > 0 ? 2 : 0;
+        for (int x = 0; x < width; ++x, filtered += 3, pixel += 4, above += 4) {
+            if (y > 0) {
+                filtered[0] = pixel[0] - above[0];
+                filtered[1] = pixel[1] - above[1];
+                filtered[2] = pixel[2] - above[2];
+            } else {
+                filtered[0] = pixel[0];
+                filtered[1] = pixel[1];
+                filtered[2] = pixel[2];
+            }
+        }
+    }
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned char *png = encoder->png;
+    memcpy(png, signature, sizeof(signature));
+    unsigned char header[13];
+    write_big_endian(&header[0], width);
+    write_big_endian(&header[4], encoder->height);
+    header[8] = 8;              // bits per channel
+    header[9] = 2;              // RGB
+    header[10] = 0;             // deflate
+    header[11] = 0;             // adaptive filtering
+    header[12] = 0;             // no interlacing
+    size_t length = sizeof(signature);
+    length += write_chunk(&png[length], "IHDR", header, sizeof(header));
+
+    // IDAT is compressed in place, its length and CRC are filled in afterwards
+    unsigned char *idat = &png[length];
+    z_stream *stream = &encoder->stream;
+    deflateReset(stream);
+    stream->next_in = encoder->filtered;
+    stream->avail_in = encoder->filtered_length;
+    stream->next_out = &idat[8];
+    stream->avail_out = encoder->capacity - length - 8 - 4 - 12;
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+        printf("Havoc: PNG didn't fit in %zu bytes\n", encoder->capacity);
+        return 0;
+    }
+    int idat_length = stream->total_out;
+    write_big_endian(&idat[0], idat_length);
+    memcpy(&idat[4], "IDAT", 4);
+    write_big_endian(&idat[8 + idat_length], crc32(crc32(0, NULL, 0), &idat[4], 4 + idat_length));
+    length += 8 + idat_length + 4;
+    length += write_chunk(&png[length], "IEND", NULL, 0);
+    return length;
+}
+
+// Length, type, data and CRC. Returns the bytes written
+static size_t write_chunk(unsigned char out[], const char type[4], const unsigned char data[], int length) {
+    write_big_endian(&out[0], length);
+    memcpy(&out[4], type, 4);
+    if (length > 0) {
+        memcpy(&out[8], data, length);
+    }
+    write_big_endian(&out[8 + length], crc32(crc32(0, NULL, 0), &out[4], 4 + length));
+    return 8 + length + 4;
+}
+
+static void write_big_endian(unsigned char out[4], unsigned long value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+// Decodes the PNG and scales it to square_width x square_width, each pixel the average of the pixels it covers
+static unsigned char *load_sprite(const char *path, int square_width) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path)) {
+        printf("Tragedy: can't read %s: %s\n", path, png.message);
+        return NULL;
+    }
+    png.format = PNG_FORMAT_RGBA;
+    unsigned char *pixels = malloc(PNG_IMAGE_SIZE(png));
+    unsigned char *sprite = malloc(4 * (size_t)square_width * square_width);
+    if (pixels == NULL || sprite == NULL || !png_image_finish_read(&png, NULL, pixels, 0, NULL)) {
+        printf("Tragedy: can't decode %s\n", path);
+        png_image_free(&png);
+        free(pixels);
+        free(sprite);
+        return NULL;
+    }
+    int source_width = png.width, source_height = png.height;
+    for (int y = 0; y < square_width; ++y) {
+        int y0 = y * source_height / square_width, y1 = (y + 1) * source_height / square_width;
+        y1 = y1 > y0 ? y1 : y0 + 1;
+        for (int x = 0; x < square_width; ++x) {
+            int x0 = x * source_width / square_width, x1 = (x + 1) * source_width / square_width;
+            x1 = x1 > x0 ? x1 : x0 + 1;
+            long sums[4] = {0, 0, 0, 0};
+            for (int source_y = y0; source_y < y1; ++source_y) {
+                for (int source_x = x0; source_x < x1; ++source_x) {
+                    const unsigned char *pixel = &pixels[4 * (source_y * source_width + source_x)];
+                    for (int channel = 0; channel < 3; ++channel) {
+                        sums[channel] += pixel[channel] * pixel[3];
+                    }
+                    sums[3] += pixel[3];
+                }
+            }
+            long count = (long)(y1 - y0) * (x1 - x0);
+            unsigned char *sprite_pixel = &sprite[4 * (y * square_width + x)];
+            for (int channel = 0; channel < 3; ++channel) {
+                sprite_pixel[channel] = (unsigned char)((sums[channel] + 0xFF * count / 2) / (0xFF * count));
+            }
+            sprite_pixel[3] = (unsigned char)((sums[3] + count / 2) / count);
+        }
+    }
+    free(pixels);
+    return sprite;
+}
+
+static void fill_rect(unsigned char image[], int image_width, int x, int y, int width, int height,
+                      const unsigned char color[3]) {
+    for (int row = y; row < y + height; ++row) {
+        unsigned char *pixel = &image[4 * ((size_t)row * image_width + x)];
+        for (int column = 0; column < width; ++column, pixel += 4) {
+            pixel[0] = color[0];
+            pixel[1] = color[1];
+            pixel[2] = color[2];
+            pixel[3] = 0xFF;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "chess.h"
+#include <zlib.h>
+#include "board_layout.h"
+
+#define PNG_OVERHEAD 57                 // signature, IHDR, IDAT length, type and CRC, IEND
+
+// Draws positions into RGBA images in memory without SDL or a window, the same layout as the SDL window. Read only
+// once initialized, so threads can share one renderer and draw into images of their own
+
+struct SoftwareRenderer {
+    struct BoardLayout layout;
+    struct GraphicsSquare *graphics_board;
+    int board_length;
+    unsigned char *background;          // RGBA, the board without pieces, width * height
+    unsigned char *sprites[PIECE_COLOR_COUNT][QUEEN + 1];   // RGBA premultiplied by alpha, square_width * square_width
+};
+
+// Makes PNGs of the images of one renderer, one encoder per thread
+struct PngEncoder {
+    int width;
+    int height;
+    z_stream stream;
+    bool stream_initialized;
+    unsigned char *filtered;            // rows of the image ready for deflate
+    size_t filtered_length;
+    unsigned char *png;                 // the last PNG
+    size_t capacity;
+};
+
+bool initialize_software_renderer(struct SoftwareRenderer *renderer, int width, int height, int dimensions,
+                                  int board_shape[], const char *images_path);
+void terminate_software_renderer(struct SoftwareRenderer *renderer);
+void render_position(struct SoftwareRenderer *renderer, struct GameState *game_state, unsigned char image[]);
+bool initialize_png_encoder(struct PngEncoder *encoder, int width, int height);
+void terminate_png_encoder(struct PngEncoder *encoder);
+size_t encode_png(struct PngEncoder *encoder, const unsigned char image[]);
+
+#endif // SOFTWARE_RENDERER_H
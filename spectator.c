@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess4d.h"
+#include "graphics.h"
+#include "SDL.h"
+
+// Watches many games of one variant at once in one window. The games are played on a thread of their own, one move per
+// game every -interval milliseconds, and every move is handed to the window, which only draws the games that got a move
+// again, see draw_spectator_grid. Finished games start over after a pause. e.g.
+//   ./spectator -variant four_d_4x4x4x4_v1 -games 36 -depth 2 -interval 500
+// Without -depth the moves are random
+
+#define DEFAULT_SPECTATED_GAMES 16
+#define DEFAULT_MOVE_INTERVAL_MS 1000
+#define GAME_OVER_PAUSE_MS 3000         // the final position stays up this long before the game starts over
+#define IDLE_WAIT_MS 1000               // longest sleep without events
+#define PLAYER_SLEEP_MS 50              // longest sleep of the player thread, it looks at quit in between
+
+struct PlayedMove {
+    int  game;
+    bool new_game;                      // the game starts over from the starting position, move is unused
+    struct Move move;
+    enum PieceType promotion_piece_type;
+};
+
+struct LiveGames {
+    // settings, read only once the player thread runs
+    struct Rules rules;
+    struct GameState starting_position;
+    int  board_length;
+    int  nbr_games;
+    struct MoveChooser move_chooser;
+    int  move_interval_ms;
+    int  max_game_length;
+    Uint32 event_type;                  // pushed when moves were handed over and the window hasn't taken any yet
+
+    // the player thread's own copies of the games
+    struct GameState *game_states;
+    int  *nbr_moves_played;
+    bool *game_over;
+    Uint32 *next_move_times;
+    struct SearchContext search_context;
+
+    // shared with the window, guarded by mutex
+    pthread_mutex_t mutex;
+    struct PlayedMove *played_moves;
+    int  nbr_played_moves;
+    int  played_moves_capacity;
+    bool quit;
+    pthread_t thread;
+};
+
+static bool initialize_game_states(struct GameState **game_states, struct GameState *starting_position, int nbr_games,
+                                   int board_length);
+static void restart_game(struct GameState *game_state, struct GameState *starting_position, int board_length);
+static void *player_thread(void *argument);
+static bool hand_over_move(struct LiveGames *live_games, struct PlayedMove *played_move);
+static struct Move choose_live_move(struct LiveGames *live_games, int game, unsigned long long *random_state);
+
+static void print_usage(void) {
+    printf("usage: spectator [-variant name] [-games n] [-depth n] [-interval ms] [-length n]\n");
+}
+
+int main(int argc, char *argv[]) {
+    static struct LiveGames live_games;
+    enum Variant variant = STANDARD_CHESS;
+    live_games.nbr_games = DEFAULT_SPECTATED_GAMES;
+    live_games.move_chooser.type = MOVE_CHOOSER_RANDOM;
+    default_search_options(&live_games.move_chooser.search_options);
+    live_games.move_interval_ms = DEFAULT_MOVE_INTERVAL_MS;
+    live_games.max_game_length = DEFAULT_MAX_GAME_LENGTH;
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-variant") == 0 && has_value) {
+            if (!variant_from_name(argv[++i], &variant)) {
+                printf("Calamity: no variant %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-games") == 0 && has_value) {
+            live_games.nbr_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-depth") == 0 && has_value) {
+            live_games.move_chooser.type = MOVE_CHOOSER_SEARCH;
+            live_games.move_chooser.search_options.max_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-interval") == 0 && has_value) {
+            live_games.move_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-length") == 0 && has_value) {
+            live_games.max_game_length = atoi(argv[++i]);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (live_games.nbr_games < 1 || live_games.move_interval_ms < 0) {
+        print_usage();
+        return 1;
+    }
+
+    if (!start_game(&live_games.rules, &live_games.starting_position, variant)) {
+        return 1;
+    }
+    struct Rules *rules = &live_games.rules;
+    live_games.board_length = board_layout_length(rules->dimensions, rules->board_shape);
+    int nbr_games = live_games.nbr_games;
+    struct GraphicsContext graphics_context;
+    struct SpectatorGrid grid;
+    if (    !initialize_graphics(&graphics_context, rules->dimensions, rules->board_shape) ||
+            !load_graphics_media(&graphics_context) ||
+            !initialize_spectator_grid(&grid, &graphics_context, nbr_games, rules->dimensions, rules->board_shape)) {
+        printf("Fiasco: can't open the spectator window\n");
+        return 1;
+    }
+
+    // The window and the player thread each have their own copy of every game, the moves keep them the same
+    struct GameState *game_states;
+    live_games.nbr_moves_played = calloc(nbr_games, sizeof(int));
+    live_games.game_over = calloc(nbr_games, sizeof(bool));
+    live_games.next_move_times = malloc(sizeof(Uint32) * nbr_games);
+    if (    live_games.nbr_moves_played == NULL || live_games.game_over == NULL || live_games.next_move_times == NULL ||
+            !initialize_game_states(&game_states, &live_games.starting_position, nbr_games, live_games.board_length) ||
+            !initialize_game_states(&live_games.game_states, &live_games.starting_position, nbr_games,
+                                    live_games.board_length) ||
+            !initialize_search_context(&live_games.search_context, &live_games.game_states[0], rules)) {
+        printf("Tragedy: no memory for %i games\n", nbr_games);
+        return 1;
+    }
+    // Spread over the interval, so that the games don't all get their moves in the same frame
+    Uint32 now = SDL_GetTicks();
+    for (int game = 0; game < nbr_games; ++game) {
+        live_games.next_move_times[game] = now + (Uint32)((long long)live_games.move_interval_ms * (game + 1) / nbr_games);
+    }
+    live_games.event_type = SDL_RegisterEvents(1);
+    pthread_mutex_init(&live_games.mutex, NULL);
+    if (    live_games.event_type == (Uint32)-1 ||
+            pthread_create(&live_games.thread, NULL, player_thread, &live_games) != 0) {
+        printf("Havoc: can't start the player thread\n");
+        return 1;
+    }
+
+    // Taken from the player thread by swapping arrays, so that it never waits for the window
+    struct PlayedMove *played_moves = NULL;
+    int played_moves_capacity = 0;
+    long long nbr_frames = 0, nbr_games_drawn = 0;
+    SDL_Event event;
+    bool quit = false;
+    bool redraw = true;
+    while (!quit) {
+        if (redraw || grid.nbr_dirty_games > 0) {
+            draw_spectator_grid(&grid, game_states);
+            ++nbr_frames;
+            nbr_games_drawn += grid.games_drawn;
+            redraw = false;
+        }
+        if (!SDL_WaitEventTimeout(&event, IDLE_WAIT_MS)) {
+            continue;
+        }
+        do {
+            switch (event.type) {
+                case SDL_QUIT:
+                    quit = true;
+                    break;
+                case SDL_WINDOWEVENT:
+                    redraw = redraw || event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                             event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED;
+                    break;
+                case SDL_RENDER_TARGETS_RESET:
+                case SDL_RENDER_DEVICE_RESET:
+                    mark_spectator_grid_dirty(&grid);
+                    redraw = true;
+                    break;
+                case SDL_KEYDOWN:
+                    quit = event.key.keysym.sym == SDLK_ESCAPE;
+                    break;
+                default:
+                    if (event.type == live_games.event_type) {
+                        pthread_mutex_lock(&live_games.mutex);
+                        struct PlayedMove *swap = live_games.played_moves;
+                        int nbr_played_moves = live_games.nbr_played_moves;
+                        live_games.played_moves = played_moves;
+                        live_games.nbr_played_moves = 0;
+                        played_moves = swap;
+                        int capacity = live_games.played_moves_capacity;
+                        live_games.played_moves_capacity = played_moves_capacity;
+                        played_moves_capacity = capacity;
+                        pthread_mutex_unlock(&live_games.mutex);
+
+                        for (int i = 0; i < nbr_played_moves; ++i) {
+                            struct PlayedMove *played_move = &played_moves[i];
+                            struct GameState *game_state = &game_states[played_move->game];
+                            if (played_move->new_game) {
+                                restart_game(game_state, &live_games.starting_position, live_games.board_length);
+                            } else {
+                                make_move(played_move->move, played_move->promotion_piece_type, game_state, rules);
+                            }
+                            mark_spectator_game_dirty(&grid, played_move->game);
+                        }
+                    }
+                    break;
+            }
+        } while (!quit && SDL_PollEvent(&event));
+    }
+
+    pthread_mutex_lock(&live_games.mutex);
+    live_games.quit = true;
+    live_games.search_context.stop_requested = true;
+    pthread_mutex_unlock(&live_games.mutex);
+    pthread_join(live_games.thread, NULL);
+    pthread_mutex_destroy(&live_games.mutex);
+    printf("%lli frames, %.1f of %i games drawn per frame\n", nbr_frames,
+           nbr_frames > 0 ? (double)nbr_games_drawn / nbr_frames : 0.0, nbr_games);
+
+    terminate_search_context(&live_games.search_context);
+    for (int game = 0; game < nbr_games; ++game) {
+        free(game_states[game].board);
+        free(live_games.game_states[game].board);
+    }
+    free(game_states);
+    free(live_games.game_states);
+    free(live_games.nbr_moves_played);
+    free(live_games.game_over);
+    free(live_games.next_move_times);
+    free(live_games.played_moves);
+    free(played_moves);
+    terminate_game_state(&live_games.starting_position);
+    terminate_spectator_grid(&grid);
+    terminate_graphics(&graphics_context);
+    return 0;
+}
+
+static bool initialize_game_states(struct GameState **game_states, struct GameState *starting_position, int nbr_games,
+                                   int board_length) {
+    *game_states = calloc(nbr_games, sizeof(struct GameState));
+    if (*game_states == NULL) {
+        return false;
+    }
+    for (int game = 0; game < nbr_games; ++game) {
+        (*game_states)[game].board = malloc(sizeof(struct Square) * board_length);
+        if ((*game_states)[game].board == NULL) {
+            return false;
+        }
+        restart_game(&(*game_states)[game], starting_position, board_length);
+    }
+    return true;
+}
+
+static void restart_game(struct GameState *game_state, struct GameState *starting_position, int board_length) {
+    struct Square *board = game_state->board;
+    *game_state = *starting_position;
+    game_state->board = board;
+    memcpy(board, starting_position->board, sizeof(struct Square) * board_length);
+}
+
+// Makes the move of whichever game is due next, all games take turns on this one thread
+static void *player_thread(void *argument) {
+    struct LiveGames *live_games = argument;
+    unsigned long long random_state = 1;
+    while (true) {
+        int game = 0;
+        for (int i = 1; i < live_games->nbr_games; ++i) {
+            if ((Sint32)(live_games->next_move_times[i] - live_games->next_move_times[game]) < 0) {
+                game = i;
+            }
+        }
+        Sint32 wait_ms;
+        while ((wait_ms = (Sint32)(live_games->next_move_times[game] - SDL_GetTicks())) > 0) {
+            pthread_mutex_lock(&live_games->mutex);
+            bool quit = live_games->quit;
+            pthread_mutex_unlock(&live_games->mutex);
+            if (quit) {
+                return NULL;
+            }
+            SDL_Delay(wait_ms < PLAYER_SLEEP_MS ? wait_ms : PLAYER_SLEEP_MS);
+        }
+
+        struct GameState *game_state = &live_games->game_states[game];
+        struct PlayedMove played_move = {.game = game, .new_game = live_games->game_over[game]};
+        Uint32 pause_ms = live_games->move_interval_ms;
+        if (played_move.new_game) {
+            restart_game(game_state, &live_games->starting_position, live_games->board_length);
+            live_games->nbr_moves_played[game] = 0;
+            live_games->game_over[game] = false;
+        } else {
+            played_move.move = choose_live_move(live_games, game, &random_state);
+            if (played_move.move.destination_square == -1) {
+                live_games->game_over[game] = true;
+                live_games->next_move_times[game] = SDL_GetTicks() + GAME_OVER_PAUSE_MS;
+                continue;
+            }
+            played_move.promotion_piece_type = NULL_PIECE_TYPE;
+            if (evaluate_promotion(played_move.move.origin_square, played_move.move.destination_square, game_state,
+                                   &live_games->rules)) {
+                played_move.promotion_piece_type = QUEEN;
+            }
+            make_move(played_move.move, played_move.promotion_piece_type, game_state, &live_games->rules);
+            live_games->game_over[game] = ++live_games->nbr_moves_played[game] >= live_games->max_game_length ||
+                                          get_winner(played_move.move, game_state, &live_games->rules) != NULL_PIECE_COLOR;
+            pause_ms = live_games->game_over[game] ? GAME_OVER_PAUSE_MS : pause_ms;
+        }
+        live_games->next_move_times[game] = SDL_GetTicks() + pause_ms;
+        if (!hand_over_move(live_games, &played_move)) {
+            return NULL;
+        }
+    }
+}
+
+// Appends the move for the window and wakes it if it has nothing to take yet. false on quit or without memory
+static bool hand_over_move(struct LiveGames *live_games, struct PlayedMove *played_move) {
+    pthread_mutex_lock(&live_games->mutex);
+    if (live_games->nbr_played_moves == live_games->played_moves_capacity) {
+        int capacity = live_games->played_moves_capacity > 0 ? 2 * live_games->played_moves_capacity : 64;
+        struct PlayedMove *played_moves = realloc(live_games->played_moves, sizeof(struct PlayedMove) * capacity);
+        if (played_moves == NULL) {
+            printf("Tragedy: no memory for played moves\n");
+            pthread_mutex_unlock(&live_games->mutex);
+            return false;
+        }
+        live_games->played_moves = played_moves;
+        live_games->played_moves_capacity = capacity;
+    }
+    bool wake = live_games->nbr_played_moves == 0;
+    live_games->played_moves[live_games->nbr_played_moves++] = *played_move;
+    bool quit = live_games->quit;
+    pthread_mutex_unlock(&live_games->mutex);
+    if (wake) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = live_games->event_type;
+        SDL_PushEvent(&event);
+    }
+    return !quit;
+}
+
+// destination_square -1 if the side to move has no moves
+static struct Move choose_live_move(struct LiveGames *live_games, int game, unsigned long long *random_state) {
+    struct SearchContext *search_context = &live_games->search_context;
+    search_context->game_state = &live_games->game_states[game];
+    if (live_games->move_chooser.type == MOVE_CHOOSER_SEARCH) {
+        return search_position(search_context, &live_games->move_chooser.search_options).best_move;
+    }
+    // The search move stack is free between searches
+    struct Move move = {.destination_square = -1};
+    int nbr_moves = generate_moves(search_context->move_stack, MAX_MOVES_IN_POSITION, false, search_context->game_state,
+                                   search_context->rules);
+    if (nbr_moves > 0) {
+        move = search_context->move_stack[next_random(random_state) % (unsigned long long)nbr_moves];
+    }
+    return move;
+}
@@ -0,0 +1,479 @@
+#define _POSIX_C_SOURCE 200809L     // fork, pipes, getline
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "chess4d.h"
+
+// Sequential probability ratio test between a baseline and a candidate engine. Both are separate processes speaking the
+// engine_server protocol over pipes, several game pairs are played at once. Every opening is played twice with colors
+// swapped. Testing stops when the log likelihood ratio of "candidate is elo1 stronger" against "candidate is elo0
+// stronger" crosses a bound, e.g.
+//   ./sprt -baseline "./engine_server -no-lmr" -candidate ./engine_server -variants standard,three_d_5x5x5 -nodes 5000
+
+#define MAX_ENGINE_ARGUMENTS 32
+#define MAX_SPRT_VARIANTS NBR_OF_VARIANTS
+#define NBR_OF_ENGINES 2
+#define BASELINE 0
+#define CANDIDATE 1
+
+struct EngineProcess {
+    pid_t pid;
+    FILE *to_engine;
+    FILE *from_engine;
+};
+
+// Random plies from the starting position of a variant, played by both engines with both colors
+struct Opening {
+    enum Variant variant;
+    char *moves;            // move texts separated by spaces
+};
+
+struct Sprt {
+    // settings, read only while games are played
+    const char *engine_commands[NBR_OF_ENGINES];
+    enum Variant variants[MAX_SPRT_VARIANTS];
+    int  nbr_variants;
+    struct Opening *openings;
+    int  nbr_openings;
+    char go_command[100];
+    int  max_game_length;
+    int  max_games;
+    double elo0, elo1;
+    double lower_bound, upper_bound;    // on the log likelihood ratio, from alpha and beta
+
+    // shared between worker threads, guarded by mutex
+    pthread_mutex_t mutex;
+    int  next_pair;
+    int  results[3];                    // candidate wins, draws, losses
+    double llr;
+    bool done;
+};
+
+#define WIN 0
+#define DRAW 1
+#define LOSS 2
+
+static void *worker_thread(void *argument);
+static int  play_sprt_game(struct EngineProcess engines[NBR_OF_ENGINES], int white_engine, struct Opening *opening,
+                           struct Sprt *sprt);
+static bool start_engine(struct EngineProcess *engine, const char *command);
+static void stop_engine(struct EngineProcess *engine);
+static bool read_engine_line(struct EngineProcess *engine, char **line, size_t *line_capacity, const char *prefix);
+static bool create_openings(struct Sprt *sprt, int openings_per_variant, int opening_plies, unsigned long long seed);
+static double sprt_log_likelihood_ratio(int results[3], double elo0, double elo1);
+static void print_sprt_status(struct Sprt *sprt);
+static double elo_to_score(double elo);
+
+static void print_usage(void) {
+    printf("usage: sprt -baseline command -candidate command [-variants name,name,..] [-elo0 x] [-elo1 x] [-alpha x]\n"
+           "            [-beta x] [-games n] [-concurrency n] [-depth n] [-nodes n] [-movetime ms] [-openings n]\n"
+           "            [-plies n] [-length n] [-seed n]\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct Sprt sprt;
+    memset(&sprt, 0, sizeof(sprt));
+    sprt.variants[0] = STANDARD_CHESS;
+    sprt.nbr_variants = 1;
+    sprt.elo0 = 0;
+    sprt.elo1 = 10;
+    sprt.max_games = 20000;
+    sprt.max_game_length = DEFAULT_MAX_GAME_LENGTH;
+    double alpha = 0.05;
+    double beta = 0.05;
+    long concurrency = sysconf(_SC_NPROCESSORS_ONLN) / NBR_OF_ENGINES;
+    int openings_per_variant = 100;
+    int opening_plies = 6;
+    unsigned long long seed = 1;
+    char limit[60] = "depth 3";
+    char variant_names[1000] = "";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *option = argv[i];
+        char *value = argv[i+1];
+        if (strcmp(option, "-baseline") == 0) {
+            sprt.engine_commands[BASELINE] = value;
+        } else if (strcmp(option, "-candidate") == 0) {
+            sprt.engine_commands[CANDIDATE] = value;
+        } else if (strcmp(option, "-variants") == 0) {
+            snprintf(variant_names, sizeof(variant_names), "%s", value);
+        } else if (strcmp(option, "-elo0") == 0) {
+            sprt.elo0 = atof(value);
+        } else if (strcmp(option, "-elo1") == 0) {
+            sprt.elo1 = atof(value);
+        } else if (strcmp(option, "-alpha") == 0) {
+            alpha = atof(value);
+        } else if (strcmp(option, "-beta") == 0) {
+            beta = atof(value);
+        } else if (strcmp(option, "-games") == 0) {
+            sprt.max_games = atoi(value);
+        } else if (strcmp(option, "-concurrency") == 0) {
+            concurrency = atol(value);
+        } else if (strcmp(option, "-depth") == 0 || strcmp(option, "-nodes") == 0 || strcmp(option, "-movetime") == 0) {
+            snprintf(limit, sizeof(limit), "%s %s", option + 1, value);
+        } else if (strcmp(option, "-openings") == 0) {
+            openings_per_variant = atoi(value);
+        } else if (strcmp(option, "-plies") == 0) {
+            opening_plies = atoi(value);
+        } else if (strcmp(option, "-length") == 0) {
+            sprt.max_game_length = atoi(value);
+        } else if (strcmp(option, "-seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || sprt.engine_commands[BASELINE] == NULL || sprt.engine_commands[CANDIDATE] == NULL) {
+        print_usage();
+        return 1;
+    }
+    if (variant_names[0] != '\0') {
+        sprt.nbr_variants = 0;
+        for (char *name = strtok(variant_names, ","); name != NULL; name = strtok(NULL, ",")) {
+            if (sprt.nbr_variants >= MAX_SPRT_VARIANTS || !variant_from_name(name, &sprt.variants[sprt.nbr_variants])) {
+                return 1;
+            }
+            ++sprt.nbr_variants;
+        }
+    }
+    if (concurrency < 1) {
+        concurrency = 1;
+    }
+    snprintf(sprt.go_command, sizeof(sprt.go_command), "go %s", limit);
+    sprt.lower_bound = log(beta / (1 - alpha));
+    sprt.upper_bound = log((1 - beta) / alpha);
+    if (!create_openings(&sprt, openings_per_variant, opening_plies, seed)) {
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);   // a dead engine shows up as a failed read instead
+    pthread_mutex_init(&sprt.mutex, NULL);
+    pthread_t *threads = malloc(sizeof(*threads) * concurrency);
+    if (threads == NULL) {
+        printf("Catastrophe: failed to allocate threads\n");
+        return 1;
+    }
+    long nbr_started = 0;
+    for (; nbr_started < concurrency; ++nbr_started) {
+        if (pthread_create(&threads[nbr_started], NULL, worker_thread, &sprt) != 0) {
+            break;
+        }
+    }
+    for (long i = 0; i < nbr_started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&sprt.mutex);
+
+    printf("\n");
+    print_sprt_status(&sprt);
+    if (sprt.llr >= sprt.upper_bound) {
+        printf("H1 accepted: candidate is at least %.1f elo stronger\n", sprt.elo1);
+    } else if (sprt.llr <= sprt.lower_bound) {
+        printf("H0 accepted: candidate is not %.1f elo stronger\n", sprt.elo1);
+    } else {
+        printf("no decision after %i games\n", sprt.results[WIN] + sprt.results[DRAW] + sprt.results[LOSS]);
+    }
+    for (int i = 0; i < sprt.nbr_openings; ++i) {
+        free(sprt.openings[i].moves);
+    }
+    free(sprt.openings);
+    return 0;
+}
+
+// Plays game pairs with its own two engine processes until the test is decided or out of games
+static void *worker_thread(void *argument) {
+    struct Sprt *sprt = argument;
+    struct EngineProcess engines[NBR_OF_ENGINES];
+
+    // Engines are started one at a time so that no other thread forks while pipes are not yet close-on-exec
+    pthread_mutex_lock(&sprt->mutex);
+    bool started = start_engine(&engines[BASELINE], sprt->engine_commands[BASELINE]);
+    if (started && !start_engine(&engines[CANDIDATE], sprt->engine_commands[CANDIDATE])) {
+        stop_engine(&engines[BASELINE]);
+        started = false;
+    }
+    pthread_mutex_unlock(&sprt->mutex);
+    if (!started) {
+        return NULL;
+    }
+
+    while (true) {
+        pthread_mutex_lock(&sprt->mutex);
+        int pair = sprt->next_pair++;
+        bool done = sprt->done || 2 * pair >= sprt->max_games;
+        pthread_mutex_unlock(&sprt->mutex);
+        if (done) {
+            break;
+        }
+
+        struct Opening *opening = &sprt->openings[pair % sprt->nbr_openings];
+        for (int white_engine = 0; white_engine < NBR_OF_ENGINES; ++white_engine) {
+            int result = play_sprt_game(engines, white_engine, opening, sprt);
+            pthread_mutex_lock(&sprt->mutex);
+            if (!sprt->done) {
+                ++sprt->results[result];
+                sprt->llr = sprt_log_likelihood_ratio(sprt->results, sprt->elo0, sprt->elo1);
+                sprt->done = sprt->llr >= sprt->upper_bound || sprt->llr <= sprt->lower_bound;
+                printf("\r");
+                print_sprt_status(sprt);
+                fflush(stdout);
+            }
+            pthread_mutex_unlock(&sprt->mutex);
+        }
+    }
+    stop_engine(&engines[BASELINE]);
+    stop_engine(&engines[CANDIDATE]);
+    return NULL;
+}
+
+// Result from the point of view of the candidate. The harness keeps the game and checks every move, an engine that sends
+// an illegal move or dies loses
+static int play_sprt_game(struct EngineProcess engines[NBR_OF_ENGINES], int white_engine, struct Opening *opening,
+                          struct Sprt *sprt) {
+    struct Rules rules;
+    struct GameState game_state;
+    if (!initialize_rules_and_game_state(&rules, &game_state, opening->variant)) {
+        return DRAW;
+    }
+    size_t moves_capacity = strlen(opening->moves) + 1000;
+    char *moves = malloc(moves_capacity);
+    if (moves == NULL) {
+        terminate_game_state(&game_state);
+        return DRAW;
+    }
+    strcpy(moves, opening->moves);
+    size_t moves_length = strlen(moves);
+
+    // Replay the opening
+    int nbr_moves = 0;
+    char *opening_moves = strdup(opening->moves);
+    for (char *token = strtok(opening_moves, " "); token != NULL; token = strtok(NULL, " ")) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        if (text_to_move(token, &move, &promotion_piece_type, &game_state, &rules)) {
+            make_move(move, promotion_piece_type, &game_state, &rules);
+            ++nbr_moves;
+        }
+    }
+    free(opening_moves);
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    int engine_to_move_winner = -1;
+    for (; nbr_moves < sprt->max_game_length; ++nbr_moves) {
+        int engine_to_move = (game_state.whos_turn == PIECE_COLOR_WHITE) ? white_engine : 1 - white_engine;
+        struct EngineProcess *engine = &engines[engine_to_move];
+        fprintf(engine->to_engine, "position %s moves %s\n%s\n", variant_name(opening->variant), moves, sprt->go_command);
+        fflush(engine->to_engine);
+
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        if (!read_engine_line(engine, &line, &line_capacity, "bestmove ")) {
+            engine_to_move_winner = 1 - engine_to_move;
+            break;
+        }
+        const char *move_text = line + strlen("bestmove ");
+        if (strcmp(move_text, "none") == 0) {
+            break;
+        }
+        if (!text_to_move(move_text, &move, &promotion_piece_type, &game_state, &rules)) {
+            engine_to_move_winner = 1 - engine_to_move;
+            break;
+        }
+        make_move(move, promotion_piece_type, &game_state, &rules);
+
+        size_t move_text_length = strlen(move_text);
+        if (moves_length + move_text_length + 2 > moves_capacity) {
+            moves_capacity = 2 * moves_capacity + move_text_length;
+            char *bigger_moves = realloc(moves, moves_capacity);
+            if (bigger_moves == NULL) {
+                break;
+            }
+            moves = bigger_moves;
+        }
+        if (moves_length > 0) {
+            moves[moves_length++] = ' ';
+        }
+        strcpy(moves + moves_length, move_text);
+        moves_length += move_text_length;
+
+        if (get_winner(move, &game_state, &rules) != NULL_PIECE_COLOR) {
+            engine_to_move_winner = engine_to_move;
+            break;
+        }
+    }
+    free(line);
+    free(moves);
+    terminate_game_state(&game_state);
+
+    if (engine_to_move_winner == -1) {
+        return DRAW;
+    }
+    return engine_to_move_winner == CANDIDATE ? WIN : LOSS;
+}
+
+// Splits command on spaces, starts it with its stdin and stdout connected to pipes and waits for the handshake
+static bool start_engine(struct EngineProcess *engine, const char *command) {
+    char command_copy[1000];
+    snprintf(command_copy, sizeof(command_copy), "%s", command);
+    char *arguments[MAX_ENGINE_ARGUMENTS + 1];
+    int nbr_arguments = 0;
+    for (char *token = strtok(command_copy, " "); token != NULL && nbr_arguments < MAX_ENGINE_ARGUMENTS;
+            token = strtok(NULL, " ")) {
+        arguments[nbr_arguments++] = token;
+    }
+    arguments[nbr_arguments] = NULL;
+
+    int to_engine[2];
+    int from_engine[2];
+    if (nbr_arguments == 0 || pipe(to_engine) != 0) {
+        return false;
+    }
+    if (pipe(from_engine) != 0) {
+        close(to_engine[0]);
+        close(to_engine[1]);
+        return false;
+    }
+    fcntl(to_engine[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_engine[0], F_SETFD, FD_CLOEXEC);
+
+    engine->pid = fork();
+    if (engine->pid == 0) {
+        dup2(to_engine[0], STDIN_FILENO);
+        dup2(from_engine[1], STDOUT_FILENO);
+        close(to_engine[0]);
+        close(from_engine[1]);
+        execvp(arguments[0], arguments);
+        _exit(127);
+    }
+    close(to_engine[0]);
+    close(from_engine[1]);
+    if (engine->pid < 0) {
+        close(to_engine[1]);
+        close(from_engine[0]);
+        return false;
+    }
+    engine->to_engine = fdopen(to_engine[1], "w");
+    engine->from_engine = fdopen(from_engine[0], "r");
+
+    fprintf(engine->to_engine, "chess4d\n");
+    fflush(engine->to_engine);
+    char *line = NULL;
+    size_t line_capacity = 0;
+    bool handshake = read_engine_line(engine, &line, &line_capacity, "chess4dok");
+    free(line);
+    if (!handshake) {
+        printf("Catastrophe: %s doesn't speak the protocol\n", command);
+        stop_engine(engine);
+    }
+    return handshake;
+}
+
+static void stop_engine(struct EngineProcess *engine) {
+    fprintf(engine->to_engine, "quit\n");
+    fclose(engine->to_engine);
+    fclose(engine->from_engine);
+    waitpid(engine->pid, NULL, 0);
+}
+
+// Reads lines until one starts with prefix, info lines and the like are skipped. false if the engine is gone
+static bool read_engine_line(struct EngineProcess *engine, char **line, size_t *line_capacity, const char *prefix) {
+    while (getline(line, line_capacity, engine->from_engine) != -1) {
+        (*line)[strcspn(*line, "\r\n")] = '\0';
+        if (strncmp(*line, prefix, strlen(prefix)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Openings are sampled by playing random moves from the starting positions in starting_positions/. Openings where a
+// side has already won are skipped
+static bool create_openings(struct Sprt *sprt, int openings_per_variant, int opening_plies, unsigned long long seed) {
+    sprt->nbr_openings = 0;
+    sprt->openings = malloc(sizeof(*sprt->openings) * sprt->nbr_variants * openings_per_variant);
+    if (sprt->openings == NULL || openings_per_variant < 1) {
+        printf("Catastrophe: no openings\n");
+        return false;
+    }
+    unsigned long long random_state = seed != 0 ? seed : 1;
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    for (int i = 0; i < openings_per_variant; ++i) {
+        for (int v = 0; v < sprt->nbr_variants; ++v) {
+            struct Rules rules;
+            struct GameState game_state;
+            if (!initialize_rules_and_game_state(&rules, &game_state, sprt->variants[v])) {
+                return false;
+            }
+            struct Opening *opening = &sprt->openings[sprt->nbr_openings];
+            opening->variant = sprt->variants[v];
+            opening->moves = malloc(opening_plies * MAX_MOVE_TEXT_LENGTH + 1);
+            if (opening->moves == NULL) {
+                terminate_game_state(&game_state);
+                return false;
+            }
+            opening->moves[0] = '\0';
+            bool game_over = false;
+            for (int ply = 0; ply < opening_plies && !game_over; ++ply) {
+                int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+                if (nbr_moves == 0) {
+                    break;
+                }
+                struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+                enum PieceType promotion_piece_type = NULL_PIECE_TYPE;
+                if (evaluate_promotion(move.origin_square, move.destination_square, &game_state, &rules)) {
+                    promotion_piece_type = QUEEN;
+                }
+                char move_text[MAX_MOVE_TEXT_LENGTH];
+                move_to_text(move, promotion_piece_type, move_text, &rules);
+                make_move(move, promotion_piece_type, &game_state, &rules);
+                game_over = get_winner(move, &game_state, &rules) != NULL_PIECE_COLOR;
+                if (ply > 0) {
+                    strcat(opening->moves, " ");
+                }
+                strcat(opening->moves, move_text);
+            }
+            terminate_game_state(&game_state);
+            if (game_over) {
+                free(opening->moves);
+            } else {
+                ++sprt->nbr_openings;
+            }
+        }
+    }
+    return sprt->nbr_openings > 0;
+}
+
+// Normal approximation of the trinomial log likelihood ratio, the same one as most engine testing frameworks use
+static double sprt_log_likelihood_ratio(int results[3], double elo0, double elo1) {
+    double nbr_games = results[WIN] + results[DRAW] + results[LOSS];
+    if (results[WIN] == 0 || results[LOSS] == 0) {
+        return 0;   // variance estimate is useless until both sides won a game
+    }
+    double score = (results[WIN] + 0.5 * results[DRAW]) / nbr_games;
+    double variance = (results[WIN] + 0.25 * results[DRAW]) / nbr_games - score * score;
+    double score0 = elo_to_score(elo0);
+    double score1 = elo_to_score(elo1);
+    return nbr_games * (score1 - score0) * (2 * score - score0 - score1) / (2 * variance);
+}
+
+static double elo_to_score(double elo) {
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+static void print_sprt_status(struct Sprt *sprt) {
+    int nbr_games = sprt->results[WIN] + sprt->results[DRAW] + sprt->results[LOSS];
+    double score = nbr_games > 0 ? (sprt->results[WIN] + 0.5 * sprt->results[DRAW]) / nbr_games : 0.5;
+    double elo = (score > 0 && score < 1) ? -400 * log10(1 / score - 1) : 0;
+    printf("games %i +%i =%i -%i, elo %.1f, llr %.2f [%.2f, %.2f]   ", nbr_games, sprt->results[WIN], sprt->results[DRAW],
+           sprt->results[LOSS], elo, sprt->llr, sprt->lower_bound, sprt->upper_bound);
+}
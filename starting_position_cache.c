@@ -0,0 +1,197 @@
+#define _POSIX_C_SOURCE 200809L     // mmap
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "chess4d.h"
+
+// Starting positions compiled into one binary file, so that starting a game is a memcpy instead of opening and parsing
+// a text file in starting_positions/. The file is
+//   struct StartingPositionCacheHeader
+//   offset of every variant, 0 for variants that aren't in the file, as long long
+//   per variant struct Rules, struct GameState with a NULL board, int board length, then the squares
+// Structs are stored the way the compiler lays them out, the header has their sizes and a file written by a build with
+// other structs is refused. compile_positions writes the file again whenever a text file changes.
+// The file is mapped once for the whole process, load it before starting threads
+
+#define STARTING_POSITION_CACHE_MAGIC "C4SP"
+#define STARTING_POSITION_CACHE_VERSION 2
+
+struct StartingPositionCacheHeader {
+    char magic[4];
+    unsigned int version;
+    unsigned int nbr_variants;
+    unsigned int rules_size;
+    unsigned int game_state_size;
+    unsigned int square_size;
+};
+
+static const unsigned char *cache_data = NULL;
+static size_t cache_length = 0;
+static const long long *cache_offsets = NULL;
+static const struct BoardTopology *cache_topologies[NBR_OF_VARIANTS];    // the pointers in the file are from its writer
+
+static bool cached_variant(enum Variant variant, struct Rules *rules, struct GameState *game_state, int *board_length,
+                           const struct Square **board);
+
+// Writes the starting position of every variant that initialize_rules_and_game_state sets up. false on write errors
+bool write_starting_position_cache(const char *path, int *nbr_variants) {
+    *nbr_variants = 0;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Tragedy: can't write %s\n", path);
+        return false;
+    }
+    struct StartingPositionCacheHeader header = {
+        .magic = STARTING_POSITION_CACHE_MAGIC, .version = STARTING_POSITION_CACHE_VERSION,
+        .nbr_variants = NBR_OF_VARIANTS, .rules_size = sizeof(struct Rules),
+        .game_state_size = sizeof(struct GameState), .square_size = sizeof(struct Square),
+    };
+    long long offsets[NBR_OF_VARIANTS] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(offsets, sizeof(offsets), 1, file) == 1;
+
+    for (int variant = 0; variant < NBR_OF_VARIANTS && ok; ++variant) {
+        struct Rules rules;
+        struct GameState game_state;
+        memset(&rules, 0, sizeof(rules));
+        memset(&game_state, 0, sizeof(game_state));
+        if (!initialize_rules_and_game_state(&rules, &game_state, variant)) {
+            continue;
+        }
+        int board_length = 1;
+        for (int dim = 0; dim < rules.dimensions; ++dim) {
+            board_length *= rules.board_shape[dim];
+        }
+        struct Square *board = game_state.board;
+        game_state.board = NULL;
+        offsets[variant] = ftell(file);
+        ok = fwrite(&rules, sizeof(rules), 1, file) == 1 && fwrite(&game_state, sizeof(game_state), 1, file) == 1 &&
+             fwrite(&board_length, sizeof(board_length), 1, file) == 1 &&
+             fwrite(board, sizeof(*board), board_length, file) == (size_t)board_length;
+        free(board);
+        ++*nbr_variants;
+    }
+
+    ok = ok && fseek(file, sizeof(header), SEEK_SET) == 0 && fwrite(offsets, sizeof(offsets), 1, file) == 1;
+    if (fclose(file) != 0 || !ok) {
+        printf("Havoc: failed to write %s\n", path);
+        remove(path);
+        return false;
+    }
+    return true;
+}
+
+// Maps the file, from now on start_game takes the starting positions from it. false and no cache if the file is missing
+// or was written by another build
+bool load_starting_position_cache(const char *path) {
+    unload_starting_position_cache();
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd == -1 || fstat(fd, &status) == -1) {
+        printf("Tragedy: can't open %s\n", path);
+        if (fd != -1) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t length = status.st_size;
+    void *mapping = length > 0 ? mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("Tragedy: can't map %s\n", path);
+        return false;
+    }
+
+    struct StartingPositionCacheHeader header;
+    size_t offsets_end = sizeof(header) + NBR_OF_VARIANTS * sizeof(long long);
+    if (length >= sizeof(header)) {
+        memcpy(&header, mapping, sizeof(header));
+    }
+    if (    length < offsets_end || memcmp(header.magic, STARTING_POSITION_CACHE_MAGIC, 4) != 0 ||
+            header.version != STARTING_POSITION_CACHE_VERSION || header.nbr_variants != NBR_OF_VARIANTS ||
+            header.rules_size != sizeof(struct Rules) || header.game_state_size != sizeof(struct GameState) ||
+            header.square_size != sizeof(struct Square)) {
+        printf("Fiasco: %s is from another build, compile the starting positions again\n", path);
+        munmap(mapping, length);
+        return false;
+    }
+    cache_data = mapping;
+    cache_length = length;
+    cache_offsets = (const long long *)(cache_data + sizeof(header));
+
+    // Every variant is checked once here so that start_game can trust the offsets, and its board topology compiled
+    for (int variant = 0; variant < NBR_OF_VARIANTS; ++variant) {
+        struct Rules rules;
+        struct GameState game_state;
+        int board_length;
+        const struct Square *board;
+        if (cache_offsets[variant] == 0) {
+            continue;
+        }
+        if (!cached_variant(variant, &rules, &game_state, &board_length, &board)) {
+            printf("Fiasco: %s is broken, compile the starting positions again\n", path);
+            unload_starting_position_cache();
+            return false;
+        }
+        cache_topologies[variant] = compile_board_topology(&rules, board);
+        if (cache_topologies[variant] == NULL) {
+            printf("Tragedy: no memory for the board topology\n");
+            unload_starting_position_cache();
+            return false;
+        }
+    }
+    return true;
+}
+
+void unload_starting_position_cache(void) {
+    if (cache_data != NULL) {
+        munmap((void *)cache_data, cache_length);
+    }
+    cache_data = NULL;
+    cache_length = 0;
+    cache_offsets = NULL;
+}
+
+// Like initialize_rules_and_game_state, but with the board copied from the loaded cache if the variant is in it.
+// Finish with terminate_game_state as usual
+bool start_game(struct Rules *rules, struct GameState *game_state, enum Variant variant) {
+    int board_length;
+    const struct Square *board;
+    if (cache_data == NULL || variant < 0 || variant >= NBR_OF_VARIANTS || cache_offsets[variant] == 0) {
+        return initialize_rules_and_game_state(rules, game_state, variant);
+    }
+    cached_variant(variant, rules, game_state, &board_length, &board);
+    game_state->board = malloc(sizeof(*game_state->board) * board_length);
+    if (game_state->board == NULL) {
+        printf("Tragedy: no memory for the board\n");
+        return false;
+    }
+    memcpy(game_state->board, board, sizeof(*game_state->board) * board_length);
+    rules->topology = cache_topologies[variant];
+    return true;
+}
+
+// Rules and game state of the variant and where its squares are in the mapping. false if they don't fit in the file
+static bool cached_variant(enum Variant variant, struct Rules *rules, struct GameState *game_state, int *board_length,
+                           const struct Square **board) {
+    long long offset = cache_offsets[variant];
+    size_t squares_offset = offset + sizeof(*rules) + sizeof(*game_state) + sizeof(*board_length);
+    if (offset < 0 || squares_offset > cache_length) {
+        return false;
+    }
+    memcpy(rules, cache_data + offset, sizeof(*rules));
+    memcpy(game_state, cache_data + offset + sizeof(*rules), sizeof(*game_state));
+    memcpy(board_length, cache_data + offset + sizeof(*rules) + sizeof(*game_state), sizeof(*board_length));
+    *board = (const struct Square *)(cache_data + squares_offset);
+
+    int expected_length = 1;
+    for (int dim = 0; dim < rules->dimensions && rules->dimensions <= MAX_DIMENSIONS; ++dim) {
+        expected_length *= rules->board_shape[dim];
+    }
+    return rules->dimensions >= 1 && rules->dimensions <= MAX_DIMENSIONS && *board_length == expected_length &&
+           *board_length <= MAX_TOTAL_NBR_OF_SQUARES &&
+           squares_offset + sizeof(**board) * *board_length <= cache_length;
+}
@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 199309L     // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include "chess4d.h"
+
+// Bytes per move of the position stream against sending the whole board after every move. Random games, played on
+// after a win since the stream doesn't care, every message is decoded into a second game state that has to stay equal to
+// the game
+
+#define STREAM_BENCH_GAMES 20
+#define STREAM_BENCH_MAX_MOVES 200
+
+struct StreamBenchVariant {
+    enum Variant variant;
+    const char *name;
+};
+
+static const struct StreamBenchVariant stream_bench_variants[] = {
+    {STANDARD_CHESS,            "standard"},
+    {GRAVITY_CHESS,             "gravity"},
+    {STANDARD_24X24_CHESS,      "standard 24x24"},
+    {THREE_D_5X5X5_CHESS,       "3D 5x5x5"},
+    {FOUR_D_4X4X4X4_V1_CHESS,   "4D 4x4x4x4 v1"},
+    {FOUR_D_8X8X8X8_V2_CHESS,   "4D 8x8x8x8 v2"},
+    {SIX_D_3X3X3X3X3X3_CHESS,   "6D 3x3x3x3x3x3"},
+};
+
+#define NBR_OF_STREAM_BENCH_VARIANTS (int)(sizeof(stream_bench_variants) / sizeof(stream_bench_variants[0]))
+
+static bool boards_equal(struct GameState *game_state1, struct GameState *game_state2, int board_length) {
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        struct Square square1 = game_state1->board[square_index];
+        struct Square square2 = game_state2->board[square_index];
+        if (    square1.part_of_board != square2.part_of_board || square1.piece.piece_type != square2.piece.piece_type ||
+                (square1.piece.piece_type != NULL_PIECE_TYPE && (square1.piece.piece_color != square2.piece.piece_color ||
+                 square1.piece.has_moved != square2.piece.has_moved || square1.piece.direction != square2.piece.direction))) {
+            return false;
+        }
+    }
+    return game_state1->whos_turn == game_state2->whos_turn &&
+           game_state1->moves_made_this_turn == game_state2->moves_made_this_turn;
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+int main() {
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    static struct MoveUndo undo;
+    unsigned long long random_state = 1;
+    bool all_equal = true;
+
+    printf("%-16s %7s %11s %11s %11s %11s %9s %9s\n", "variant", "squares", "delta B", "keyframe B", "stream B/mv",
+           "raw board B", "vs keyfr", "vs raw");
+    for (int v = 0; v < NBR_OF_STREAM_BENCH_VARIANTS; ++v) {
+        long long delta_bytes = 0, nbr_deltas = 0;
+        long long keyframe_bytes = 0, nbr_keyframes = 0;
+        long long snapshot_bytes = 0;
+        double coding_seconds = 0;
+        int board_length = 0;
+        for (int game = 0; game < STREAM_BENCH_GAMES; ++game) {
+            struct Rules rules;
+            struct GameState game_state, client_game_state;
+            if (    !initialize_rules_and_game_state(&rules, &game_state, stream_bench_variants[v].variant) ||
+                    !initialize_rules_and_game_state(&rules, &client_game_state, stream_bench_variants[v].variant)) {
+                return 1;
+            }
+            struct PositionStreamEncoder encoder;
+            struct PositionStreamDecoder decoder;
+            initialize_position_encoder(&encoder, POSITION_STREAM_KEYFRAME_INTERVAL, &rules);
+            initialize_position_decoder(&decoder, &rules);
+            board_length = encoder.board_length;
+            unsigned char *buffer = malloc(position_update_max_bytes(&rules));
+            unsigned char *snapshot = malloc(position_update_max_bytes(&rules));
+            struct PositionStreamEncoder snapshot_encoder = encoder;
+            if (buffer == NULL || snapshot == NULL) {
+                return 1;
+            }
+
+            for (int move_number = 0; move_number < STREAM_BENCH_MAX_MOVES; ++move_number) {
+                int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+                if (nbr_moves == 0) {
+                    break;
+                }
+                struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+                make_move_with_undo(move, QUEEN, &game_state, &rules, &undo);
+
+                double start_time = seconds_now();
+                int length = encode_position_update(&encoder, &undo, &game_state, buffer);
+                all_equal = all_equal && decode_position_update(&decoder, buffer, length, &client_game_state) &&
+                            boards_equal(&game_state, &client_game_state, board_length);
+                coding_seconds += seconds_now() - start_time;
+                if (buffer[0] == POSITION_UPDATE_KEYFRAME) {
+                    keyframe_bytes += length;
+                    ++nbr_keyframes;
+                } else {
+                    delta_bytes += length;
+                    ++nbr_deltas;
+                }
+                snapshot_bytes += encode_position_keyframe(&snapshot_encoder, &game_state, snapshot);
+            }
+            free(buffer);
+            free(snapshot);
+            terminate_game_state(&game_state);
+            terminate_game_state(&client_game_state);
+        }
+        long long nbr_messages = nbr_deltas + nbr_keyframes;
+        double stream_bytes_per_move = (double)(delta_bytes + keyframe_bytes) / nbr_messages;
+        double raw_board_bytes = (double)board_length * sizeof(struct Square);
+        printf("%-16s %7i %11.1f %11.1f %11.1f %11.0f %8.1fx %8.1fx   %.0f ns/move\n", stream_bench_variants[v].name,
+               board_length, nbr_deltas > 0 ? (double)delta_bytes / nbr_deltas : 0.0,
+               (double)keyframe_bytes / nbr_keyframes, stream_bytes_per_move, raw_board_bytes,
+               (double)snapshot_bytes / nbr_messages / stream_bytes_per_move, raw_board_bytes / stream_bytes_per_move,
+               1e9 * coding_seconds / nbr_messages);
+    }
+    printf("\nkeyframe every %i moves. vs keyfr: sending a keyframe after every move, vs raw: sending the board array\n",
+           POSITION_STREAM_KEYFRAME_INTERVAL);
+    if (!all_equal) {
+        printf("bug, decoded position differs from the game\n");
+        return 1;
+    }
+    return 0;
+}
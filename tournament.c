@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L     // sysconf, clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "chess4d.h"
+
+// Round-robin tournament between two players over a list of variants, games played concurrently on a pool of threads.
+// Game i is played in variant i % nbr_variants, and player 1 has white in the first round over the variants, black in
+// the next and so on. Every finished game is appended to the results file right away, e.g.
+//   ./tournament -variants standard,three_d_5x5x5 -games 200 -player2 random -depth1 3 -results results.csv
+
+#define MAX_TOURNAMENT_VARIANTS NBR_OF_VARIANTS
+#define NBR_OF_PLAYERS 2
+
+struct Tournament {
+    // settings, read only while games are played
+    enum Variant variants[MAX_TOURNAMENT_VARIANTS];
+    int  nbr_variants;
+    struct MoveChooser players[NBR_OF_PLAYERS];
+    int  nbr_games;
+    int  max_game_length;
+    int  random_opening_moves;
+    unsigned long long random_seed;
+    FILE *results_file;
+    double start_time;
+
+    // shared between worker threads, guarded by mutex
+    pthread_mutex_t mutex;
+    int  next_game;
+    int  games_finished;
+    int  points_by_player[NBR_OF_PLAYERS];                          // half points, a win is 2
+    int  wins_by_variant_and_color[MAX_TOURNAMENT_VARIANTS][PIECE_COLOR_COUNT];
+    int  draws_by_variant[MAX_TOURNAMENT_VARIANTS];
+    long long nodes;
+};
+
+static void *worker_thread(void *argument);
+static bool parse_player(const char *name, struct MoveChooser *move_chooser);
+static bool parse_variants(char *names, struct Tournament *tournament);
+static double seconds_now(void);
+
+static void print_usage(void) {
+    printf("usage: tournament [-variants all|name,name,..] [-games n] [-threads n] [-player1 search|random]\n"
+           "                  [-player2 search|random] [-depth1 n] [-depth2 n] [-nodes n] [-seconds x] [-length n]\n"
+           "                  [-random n] [-seed n] [-results file] [-positions file]\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct Tournament tournament;
+    memset(&tournament, 0, sizeof(tournament));
+    tournament.variants[0] = STANDARD_CHESS;
+    tournament.nbr_variants = 1;
+    tournament.nbr_games = 100;
+    tournament.max_game_length = DEFAULT_MAX_GAME_LENGTH;
+    tournament.random_opening_moves = 4;
+    tournament.random_seed = 1;
+    for (int player = 0; player < NBR_OF_PLAYERS; ++player) {
+        tournament.players[player].type = MOVE_CHOOSER_SEARCH;
+        default_search_options(&tournament.players[player].search_options);
+        tournament.players[player].search_options.max_depth = 2;
+    }
+    long nbr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *results_path = "tournament_results.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!has_value) {
+            print_usage();
+            return 1;
+        }
+        char *value = argv[++i];
+        if (strcmp(argv[i-1], "-variants") == 0) {
+            if (!parse_variants(value, &tournament)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i-1], "-games") == 0) {
+            tournament.nbr_games = atoi(value);
+        } else if (strcmp(argv[i-1], "-threads") == 0) {
+            nbr_threads = atol(value);
+        } else if (strcmp(argv[i-1], "-player1") == 0 || strcmp(argv[i-1], "-player2") == 0) {
+            if (!parse_player(value, &tournament.players[argv[i-1][7] - '1'])) {
+                return 1;
+            }
+        } else if (strcmp(argv[i-1], "-depth1") == 0 || strcmp(argv[i-1], "-depth2") == 0) {
+            tournament.players[argv[i-1][6] - '1'].search_options.max_depth = atoi(value);
+        } else if (strcmp(argv[i-1], "-nodes") == 0) {
+            for (int player = 0; player < NBR_OF_PLAYERS; ++player) {
+                tournament.players[player].search_options.max_nodes = atoll(value);
+            }
+        } else if (strcmp(argv[i-1], "-seconds") == 0) {
+            for (int player = 0; player < NBR_OF_PLAYERS; ++player) {
+                tournament.players[player].search_options.max_seconds = atof(value);
+            }
+        } else if (strcmp(argv[i-1], "-length") == 0) {
+            tournament.max_game_length = atoi(value);
+        } else if (strcmp(argv[i-1], "-random") == 0) {
+            tournament.random_opening_moves = atoi(value);
+        } else if (strcmp(argv[i-1], "-seed") == 0) {
+            tournament.random_seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-results") == 0) {
+            results_path = value;
+        } else if (strcmp(argv[i-1], "-positions") == 0) {
+            if (!load_starting_position_cache(value)) {
+                return 1;
+            }
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (nbr_threads < 1) {
+        nbr_threads = 1;
+    }
+
+    tournament.results_file = fopen(results_path, "w");
+    if (tournament.results_file == NULL) {
+        printf("Fiasco: could not open %s\n", results_path);
+        return 1;
+    }
+    fprintf(tournament.results_file, "game,variant,white,black,result,moves,nodes,search_seconds\n");
+    fflush(tournament.results_file);
+
+    pthread_mutex_init(&tournament.mutex, NULL);
+    tournament.start_time = seconds_now();
+    pthread_t *threads = malloc(sizeof(*threads) * nbr_threads);
+    if (threads == NULL) {
+        printf("Fiasco: failed to allocate threads\n");
+        return 1;
+    }
+    long nbr_started = 0;
+    for (; nbr_started < nbr_threads; ++nbr_started) {
+        if (pthread_create(&threads[nbr_started], NULL, worker_thread, &tournament) != 0) {
+            printf("Fiasco: could only start %li threads\n", nbr_started);
+            break;
+        }
+    }
+    for (long i = 0; i < nbr_started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&tournament.mutex);
+    fclose(tournament.results_file);
+
+    double seconds = seconds_now() - tournament.start_time;
+    printf("\n%i games on %li threads in %.1f s, %.0f games/hour, %.0f nodes/s\n", tournament.games_finished, nbr_started,
+           seconds, 3600.0 * tournament.games_finished / seconds, (double)tournament.nodes / seconds);
+    printf("player 1 %.1f - %.1f player 2\n", tournament.points_by_player[0] / 2.0, tournament.points_by_player[1] / 2.0);
+    printf("%-40s %8s %8s %8s\n", "variant", "white", "black", "draws");
+    for (int v = 0; v < tournament.nbr_variants; ++v) {
+        printf("%-40s %8i %8i %8i\n", variant_name(tournament.variants[v]),
+               tournament.wins_by_variant_and_color[v][PIECE_COLOR_WHITE],
+               tournament.wins_by_variant_and_color[v][PIECE_COLOR_BLACK], tournament.draws_by_variant[v]);
+    }
+    return 0;
+}
+
+// Takes the next unplayed game until there are none left. Each game owns its GameState, only results are shared
+static void *worker_thread(void *argument) {
+    struct Tournament *tournament = argument;
+    while (true) {
+        pthread_mutex_lock(&tournament->mutex);
+        int game = tournament->next_game++;
+        pthread_mutex_unlock(&tournament->mutex);
+        if (game >= tournament->nbr_games) {
+            return NULL;
+        }
+
+        int variant_index = game % tournament->nbr_variants;
+        int white_player = (game / tournament->nbr_variants) % NBR_OF_PLAYERS;
+        struct GameSettings settings;
+        default_game_settings(&settings, tournament->variants[variant_index]);
+        settings.move_choosers[PIECE_COLOR_WHITE] = tournament->players[white_player];
+        settings.move_choosers[PIECE_COLOR_BLACK] = tournament->players[1 - white_player];
+        settings.max_game_length = tournament->max_game_length;
+        settings.random_opening_moves = tournament->random_opening_moves;
+        settings.random_seed = tournament->random_seed + (unsigned long long)game * 0x9E3779B97F4A7C15ULL;
+
+        struct GameResult result;
+        if (!play_game(&result, &settings)) {
+            printf("Fiasco: game %i in %s could not be played\n", game, variant_name(settings.variant));
+            continue;
+        }
+
+        const char *outcome = "1/2-1/2";
+        pthread_mutex_lock(&tournament->mutex);
+        if (result.winner == NULL_PIECE_COLOR) {
+            ++tournament->points_by_player[0];
+            ++tournament->points_by_player[1];
+            ++tournament->draws_by_variant[variant_index];
+        } else {
+            int winning_player = (result.winner == PIECE_COLOR_WHITE) ? white_player : 1 - white_player;
+            tournament->points_by_player[winning_player] += 2;
+            ++tournament->wins_by_variant_and_color[variant_index][result.winner];
+            outcome = (result.winner == PIECE_COLOR_WHITE) ? "1-0" : "0-1";
+        }
+        ++tournament->games_finished;
+        tournament->nodes += result.nodes;
+        fprintf(tournament->results_file, "%i,%s,player%i,player%i,%s,%i,%lli,%.3f\n", game, variant_name(settings.variant),
+                white_player + 1, 2 - white_player, outcome, result.nbr_moves, result.nodes, result.seconds);
+        fflush(tournament->results_file);
+        double seconds = seconds_now() - tournament->start_time;
+        printf("\r%i/%i games, %.0f games/hour", tournament->games_finished, tournament->nbr_games,
+               3600.0 * tournament->games_finished / seconds);
+        fflush(stdout);
+        pthread_mutex_unlock(&tournament->mutex);
+    }
+}
+
+static bool parse_player(const char *name, struct MoveChooser *move_chooser) {
+    if (strcmp(name, "search") == 0) {
+        move_chooser->type = MOVE_CHOOSER_SEARCH;
+    } else if (strcmp(name, "random") == 0) {
+        move_chooser->type = MOVE_CHOOSER_RANDOM;
+    } else {
+        printf("Fiasco: no player called %s, use search or random\n", name);
+        return false;
+    }
+    return true;
+}
+
+// Comma separated variant names, or all for every variant that can be set up
+static bool parse_variants(char *names, struct Tournament *tournament) {
+    tournament->nbr_variants = 0;
+    if (strcmp(names, "all") == 0) {
+        for (int v = 0; v < NBR_OF_VARIANTS; ++v) {
+            struct Rules rules;
+            struct GameState game_state;
+            if (initialize_rules_and_game_state(&rules, &game_state, v)) {
+                terminate_game_state(&game_state);
+                tournament->variants[tournament->nbr_variants++] = v;
+            }
+        }
+        return tournament->nbr_variants > 0;
+    }
+    for (char *name = strtok(names, ","); name != NULL; name = strtok(NULL, ",")) {
+        if (tournament->nbr_variants >= MAX_TOURNAMENT_VARIANTS ||
+                !variant_from_name(name, &tournament->variants[tournament->nbr_variants])) {
+            return false;
+        }
+        ++tournament->nbr_variants;
+    }
+    return tournament->nbr_variants > 0;
+}
+
+static double seconds_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
@@ -333,6 +333,38 @@ void test_player_is_checkmated() {
     game_state.board[square_index].piece.piece_color = PIECE_COLOR_WHITE;
     TEST_TRUTH(!player_is_checkmated(PIECE_COLOR_WHITE, &game_state, &rules));
     TEST_TRUTH(player_is_checkmated(PIECE_COLOR_BLACK, &game_state, &rules));
+
+    // check on the e-file. The king can't escape but the check can be blocked
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    square[0] = 4;
+    square[1] = 1;
+    square_index = square_to_square_index(square, rules.dimensions, rules.board_shape);
+    game_state.board[square_index].piece.piece_type = NULL_PIECE_TYPE;
+    square[1] = 3;
+    square_index = square_to_square_index(square, rules.dimensions, rules.board_shape);
+    game_state.board[square_index].piece.piece_type = QUEEN;
+    game_state.board[square_index].piece.piece_color = PIECE_COLOR_BLACK;
+    TEST_TRUTH(!player_is_checkmated(PIECE_COLOR_WHITE, &game_state, &rules));
+
+    // check on the e-file, d- and f-file covered. Castling would get the king away but isn't allowed out of check
+    terminate_game_state(&game_state);
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    for (int i = 0; i < 64; ++i) {
+        game_state.board[i].piece.piece_type = NULL_PIECE_TYPE;
+    }
+    int pieces[6][4] = {    // x, y, piece type, piece color
+        {4, 0, KING, PIECE_COLOR_WHITE}, {7, 0, ROOK, PIECE_COLOR_WHITE}, {0, 7, KING, PIECE_COLOR_BLACK},
+        {3, 7, ROOK, PIECE_COLOR_BLACK}, {4, 7, ROOK, PIECE_COLOR_BLACK}, {5, 7, ROOK, PIECE_COLOR_BLACK},
+    };
+    for (int i = 0; i < 6; ++i) {
+        square[0] = pieces[i][0];
+        square[1] = pieces[i][1];
+        square_index = square_to_square_index(square, rules.dimensions, rules.board_shape);
+        game_state.board[square_index].piece.piece_type = pieces[i][2];
+        game_state.board[square_index].piece.piece_color = pieces[i][3];
+    }
+    TEST_TRUTH(player_is_checkmated(PIECE_COLOR_WHITE, &game_state, &rules));
+    terminate_game_state(&game_state);
 }
 
 int main() {
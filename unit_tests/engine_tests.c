@@ -0,0 +1,1278 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../chess4d.h"
+
+/// TESTING FRAMEWORK ///
+#define TEST_TRUTH(X)    test_truth(__FILE__, __LINE__, __func__, X, "")
+void test_truth(const char* test_file, const int test_line_number, const char* test_function, bool result, const char* message) {
+    if (result) {
+        printf(".");
+    } else {
+        printf("\n");
+        fprintf(stderr, "TEST FAILED: %s, file: %s, line: %i - %s\n", test_function, test_file, test_line_number, message);
+    }
+}
+/// TESTING FRAMEWORK ///
+
+
+static int square_index_2d(int x, int y, struct Rules *rules) {
+    int square[2] = {x, y};
+    return square_to_square_index(square, rules->dimensions, rules->board_shape);
+}
+
+static void put_piece(int square_index, enum PieceType piece_type, enum PieceColor piece_color, struct GameState *game_state) {
+    game_state->board[square_index].piece.piece_type = piece_type;
+    game_state->board[square_index].piece.piece_color = piece_color;
+    game_state->board[square_index].piece.direction = FORWARDS;
+    game_state->board[square_index].piece.has_moved = true;
+}
+
+static struct Move quiet_move(int origin_square, int destination_square) {
+    struct Move move;
+    move.origin_square = origin_square;
+    move.destination_square = destination_square;
+    move.pawn_moved_past_square = -1;
+    move.en_passant_capture = false;
+    move.castling_with_rook_on_square = -1;
+    return move;
+}
+
+void test_move_ordering_mvv_lva() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    struct MoveOrdering move_ordering;
+    TEST_TRUTH(initialize_move_ordering(&move_ordering, &rules));
+
+    // white queen and pawn can both take the black queen on d5, the queen can also take a pawn on a6
+    put_piece(square_index_2d(3, 4, &rules), QUEEN, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(0, 5, &rules), PAWN, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(3, 2, &rules), QUEEN, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(2, 3, &rules), PAWN, PIECE_COLOR_WHITE, &game_state);
+
+    struct Move moves[4];
+    moves[0] = quiet_move(square_index_2d(6, 0, &rules), square_index_2d(5, 2, &rules));    // quiet knight move
+    moves[1] = quiet_move(square_index_2d(3, 2, &rules), square_index_2d(0, 5, &rules));    // QxP
+    moves[2] = quiet_move(square_index_2d(3, 2, &rules), square_index_2d(3, 4, &rules));    // QxQ
+    moves[3] = quiet_move(square_index_2d(2, 3, &rules), square_index_2d(3, 4, &rules));    // PxQ
+
+    struct Move no_previous_move;
+    no_previous_move.destination_square = -1;
+    int scores[4];
+    score_moves(scores, moves, 4, 0, no_previous_move, &game_state, &move_ordering);
+    for (int i = 0; i < 4; ++i) {
+        pick_next_move(moves, scores, 4, i);
+    }
+    TEST_TRUTH(moves[0].origin_square == square_index_2d(2, 3, &rules));        // PxQ
+    TEST_TRUTH(moves[1].origin_square == square_index_2d(3, 2, &rules) && moves[1].destination_square == square_index_2d(3, 4, &rules));
+    TEST_TRUTH(moves[2].destination_square == square_index_2d(0, 5, &rules));   // QxP
+    TEST_TRUTH(moves[3].origin_square == square_index_2d(6, 0, &rules));        // quiet move last
+
+    terminate_move_ordering(&move_ordering);
+    terminate_game_state(&game_state);
+}
+
+void test_move_ordering_killers_and_history() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    struct MoveOrdering move_ordering;
+    TEST_TRUTH(initialize_move_ordering(&move_ordering, &rules));
+
+    struct Move no_previous_move;
+    no_previous_move.destination_square = -1;
+    struct Move knight_move = quiet_move(square_index_2d(6, 0, &rules), square_index_2d(5, 2, &rules));
+    struct Move pawn_move = quiet_move(square_index_2d(4, 1, &rules), square_index_2d(4, 3, &rules));
+    struct Move other_pawn_move = quiet_move(square_index_2d(0, 1, &rules), square_index_2d(0, 2, &rules));
+
+    // pawn move tried first and failed, knight move produced the cutoff
+    update_move_ordering_on_cutoff(knight_move, 1, &pawn_move, 1, no_previous_move, 3, 4, &game_state, &move_ordering);
+    TEST_TRUTH(move_ordering.cutoffs == 1 && move_ordering.first_move_cutoffs == 0);
+    update_move_ordering_on_cutoff(knight_move, 0, NULL, 0, no_previous_move, 2, 4, &game_state, &move_ordering);
+    TEST_TRUTH(first_move_cutoff_rate(&move_ordering) == 0.5);
+
+    struct Move moves[3] = {pawn_move, other_pawn_move, knight_move};
+    int scores[3];
+    // killer at ply 3
+    score_moves(scores, moves, 3, 3, no_previous_move, &game_state, &move_ordering);
+    pick_next_move(moves, scores, 3, 0);
+    TEST_TRUTH(moves[0].destination_square == knight_move.destination_square);
+    // no killers at ply 5, history still prefers the knight move and punishes the pawn move
+    score_moves(scores, moves, 3, 5, no_previous_move, &game_state, &move_ordering);
+    for (int i = 0; i < 3; ++i) {
+        pick_next_move(moves, scores, 3, i);
+    }
+    TEST_TRUTH(moves[0].destination_square == knight_move.destination_square);
+    TEST_TRUTH(moves[2].destination_square == pawn_move.destination_square);
+
+    // new search clears the killers
+    clear_move_ordering(&move_ordering);
+    TEST_TRUTH(move_ordering.killers[3][0].destination_square == -1);
+
+    terminate_move_ordering(&move_ordering);
+    terminate_game_state(&game_state);
+}
+
+// Staged generator must hand out exactly what get_moves returns for every piece that can move, captures first
+static bool staged_generation_matches_get_moves(struct GameState *game_state, struct Rules *rules) {
+    static struct Move staged_moves[MAX_MOVES_IN_POSITION];
+    int nbr_staged_moves = generate_moves(staged_moves, MAX_MOVES_IN_POSITION, false, game_state, rules);
+
+    bool quiet_move_seen = false;
+    for (int i = 0; i < nbr_staged_moves; ++i) {
+        bool capture = move_is_capture(staged_moves[i], game_state);
+        if (capture && quiet_move_seen) {
+            return false;
+        }
+        quiet_move_seen = quiet_move_seen || !capture;
+    }
+
+    int board_length = 1;
+    for (int i = 0; i < rules->dimensions; ++i) {
+        board_length *= rules->board_shape[i];
+    }
+    int nbr_moves = 0;
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        if (!piece_can_move_this_turn(square_index, game_state, rules)) {
+            continue;
+        }
+        struct Move moves[MAX_MOVES_SINGLE_PIECE];
+        struct Move diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+        get_moves(moves, diagonal_pawn_moves, square_index, game_state, rules);
+        for (int i = 0; moves[i].destination_square != -1; ++i, ++nbr_moves) {
+            bool found = false;
+            for (int j = 0; j < nbr_staged_moves && !found; ++j) {
+                found = staged_moves[j].origin_square == moves[i].origin_square && 
+                        staged_moves[j].destination_square == moves[i].destination_square;
+            }
+            if (!found) {
+                return false;
+            }
+        }
+    }
+    return nbr_moves == nbr_staged_moves;
+}
+
+void test_staged_move_generation() {
+    printf("\n---%s---\n", __func__);
+    enum Variant variants[] = {STANDARD_CHESS, TEN_MOVES_CHESS, KING_MARCH_CHESS, MOVE_TO_ANY_SQUARE_CHESS, WRAPPING_10X10_CHESS, 
+                               THREE_D_5X5X5_CHESS, FOUR_D_3X3X3X3_V2_CHESS, SIX_D_3X3X3X3X3X3_CHESS};
+    for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        struct Rules rules;
+        struct GameState game_state;
+        initialize_rules_and_game_state(&rules, &game_state, variants[v]);
+
+        // play into a middle game, preferring captures so both stages get exercised
+        bool all_matched = true;
+        for (int ply = 0; ply < 30 && all_matched; ++ply) {
+            all_matched = staged_generation_matches_get_moves(&game_state, &rules);
+            struct Move moves[MAX_MOVES_IN_POSITION];
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            make_move(moves[(ply * 7) % nbr_moves], NULL_PIECE_TYPE, &game_state, &rules);
+        }
+        TEST_TRUTH(all_matched);
+        terminate_game_state(&game_state);
+    }
+}
+
+void test_lazy_generation_stops_early() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+
+    // no captures in the starting position, first move is a quiet move of the first piece and nothing else is generated
+    struct MoveGenerator move_generator;
+    initialize_move_generator(&move_generator, false, &game_state, &rules);
+    struct Move move;
+    TEST_TRUTH(next_move(&move_generator, &move));
+    TEST_TRUTH(move_generator.stage == GENERATION_STAGE_QUIETS);
+    TEST_TRUTH(move.origin_square == 1);    // knight on b1, the rook on a1 can't move
+    TEST_TRUTH(move_generator.next_square_index == 2);
+
+    initialize_move_generator(&move_generator, true, &game_state, &rules);
+    TEST_TRUTH(!next_move(&move_generator, &move));
+    terminate_game_state(&game_state);
+}
+
+static bool boards_equal(struct GameState *game_state1, struct GameState *game_state2, int board_length) {
+    for (int i = 0; i < board_length; ++i) {
+        struct Square square1 = game_state1->board[i];
+        struct Square square2 = game_state2->board[i];
+        if (square1.part_of_board != square2.part_of_board) {
+            return false;
+        }
+        if (square1.part_of_board && (square1.piece.piece_type != square2.piece.piece_type ||
+                (square1.piece.piece_type != NULL_PIECE_TYPE && (square1.piece.piece_color != square2.piece.piece_color ||
+                 square1.piece.has_moved != square2.piece.has_moved || square1.piece.direction != square2.piece.direction)))) {
+            return false;
+        }
+    }
+    return game_state1->whos_turn == game_state2->whos_turn && 
+           game_state1->moves_made_this_turn == game_state2->moves_made_this_turn;
+}
+
+void test_make_and_unmake_move() {
+    printf("\n---%s---\n", __func__);
+    enum Variant variants[] = {STANDARD_CHESS, TEN_MOVES_CHESS, GRAVITY_CHESS, WRAPPING_10X10_CHESS, THREE_D_5X5X5_CHESS};
+    for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        struct Rules rules;
+        struct GameState game_state;
+        struct GameState copy;
+        initialize_rules_and_game_state(&rules, &game_state, variants[v]);
+        initialize_rules_and_game_state(&rules, &copy, variants[v]);
+        int board_length = 1;
+        for (int i = 0; i < rules.dimensions; ++i) {
+            board_length *= rules.board_shape[i];
+        }
+
+        // every move of every position along a game line is made and unmade
+        bool all_restored = true;
+        for (int ply = 0; ply < 20 && all_restored; ++ply) {
+            struct Move moves[MAX_MOVES_IN_POSITION];
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            for (int i = 0; i < nbr_moves && all_restored; ++i) {
+                struct MoveUndo undo;
+                make_move_with_undo(moves[i], QUEEN, &game_state, &rules, &undo);
+                unmake_move(&undo, &game_state);
+                all_restored = boards_equal(&game_state, &copy, board_length);
+            }
+            make_move(moves[(ply * 5) % nbr_moves], QUEEN, &game_state, &rules);
+            make_move(moves[(ply * 5) % nbr_moves], QUEEN, &copy, &rules);
+        }
+        TEST_TRUTH(all_restored);
+        terminate_game_state(&game_state);
+        terminate_game_state(&copy);
+    }
+
+    // a knight move doesn't leave a square open for en passant, whatever its undefined pawn_moved_past_square says
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    struct Move knight_move = quiet_move(square_index_2d(1, 0, &rules), square_index_2d(2, 2, &rules));
+    knight_move.pawn_moved_past_square = square_index_2d(2, 2, &rules);
+    make_move(knight_move, NULL_PIECE_TYPE, &game_state, &rules);
+    TEST_TRUTH(game_state.last_moves_by_piece_color[PIECE_COLOR_WHITE][0].pawn_moved_past_square == -1);
+    TEST_TRUTH(game_state.last_moves_by_piece_color[PIECE_COLOR_BLACK][0].pawn_moved_past_square == -1);
+    terminate_game_state(&game_state);
+}
+
+void test_get_attackers() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    for (int i = 0; i < 64; ++i) {
+        game_state.board[i].piece.piece_type = NULL_PIECE_TYPE;
+    }
+
+    // d5 attacked by a queen, a rook behind the queen, a knight and a pawn
+    int target = square_index_2d(3, 4, &rules);
+    put_piece(square_index_2d(3, 0, &rules), ROOK, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(3, 1, &rules), QUEEN, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(2, 2, &rules), KNIGHT, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(4, 3, &rules), PAWN, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(3, 6, &rules), BISHOP, PIECE_COLOR_WHITE, &game_state);   // wrong geometry
+    put_piece(square_index_2d(6, 7, &rules), BISHOP, PIECE_COLOR_BLACK, &game_state);   // wrong color
+
+    int attackers[MAX_ATTACKERS];
+    int nbr_attackers = get_attackers(attackers, MAX_ATTACKERS, target, PIECE_COLOR_WHITE, &game_state, &rules);
+    TEST_TRUTH(nbr_attackers == 3);     // rook is hidden behind the queen
+    TEST_TRUTH(attackers[0] == square_index_2d(4, 3, &rules));
+    TEST_TRUTH(attackers[1] == square_index_2d(2, 2, &rules));
+    TEST_TRUTH(attackers[2] == square_index_2d(3, 1, &rules));
+    TEST_TRUTH(get_attackers(attackers, MAX_ATTACKERS, target, PIECE_COLOR_BLACK, &game_state, &rules) == 1);
+    terminate_game_state(&game_state);
+}
+
+void test_count_attacks() {
+    printf("\n---%s---\n", __func__);
+    enum Variant variants[] = {STANDARD_CHESS, WRAPPING_8X14_CHESS, THREE_D_5X5X5_CHESS, FOUR_D_4X4X4X4_V1_CHESS,
+                               FOUR_D_8X8X8X8_V2_CHESS};
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    unsigned long long random_state = 11;
+    bool all_match = true;
+    for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        struct Rules rules;
+        struct GameState game_state;
+        initialize_rules_and_game_state(&rules, &game_state, variants[v]);
+        int board_length = 1;
+        for (int dim = 0; dim < rules.dimensions; ++dim) {
+            board_length *= rules.board_shape[dim];
+        }
+        int *attack_counts[PIECE_COLOR_COUNT] = {malloc(sizeof(int) * board_length), malloc(sizeof(int) * board_length)};
+
+        // counted forwards from the pieces, the same as the attackers found backwards from every square
+        for (int move_number = 0; move_number < 40 && all_match; ++move_number) {
+            count_attacks(attack_counts, &game_state, &rules);
+            for (int square_index = 0; square_index < board_length; ++square_index) {
+                int attackers[MAX_ATTACKERS];
+                for (int piece_color = 0; piece_color < PIECE_COLOR_COUNT; ++piece_color) {
+                    all_match = all_match && attack_counts[piece_color][square_index] ==
+                                get_attackers(attackers, MAX_ATTACKERS, square_index, piece_color, &game_state, &rules);
+                }
+            }
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            make_move(moves[next_random(&random_state) % (unsigned long long)nbr_moves], QUEEN, &game_state, &rules);
+        }
+        free(attack_counts[PIECE_COLOR_WHITE]);
+        free(attack_counts[PIECE_COLOR_BLACK]);
+        terminate_game_state(&game_state);
+    }
+    TEST_TRUTH(all_match);
+}
+
+void test_board_topology() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct Rules rules2;
+    struct GameState game_state;
+    struct GameState game_state2;
+
+    // Compiled once per board and shared
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    initialize_rules_and_game_state(&rules2, &game_state2, STANDARD_CHESS);
+    TEST_TRUTH(rules.topology != NULL && rules.topology == rules2.topology);
+    terminate_game_state(&game_state2);
+    initialize_rules_and_game_state(&rules2, &game_state2, STANDARD_10X10_CHESS);
+    TEST_TRUTH(rules2.topology != NULL && rules2.topology != rules.topology);
+    terminate_game_state(&game_state2);
+
+    // Directions: 2*dim for -1, 2*dim+1 for +1, then diagonals, then knight jumps
+    const struct BoardTopology *topology = rules.topology;
+    int a1 = square_index_2d(0, 0, &rules);
+    TEST_TRUTH(topology->nbr_directions == 4 + 4 + 8);
+    TEST_TRUTH(topology->successors[a1 * topology->nbr_directions + 1] == square_index_2d(1, 0, &rules));
+    TEST_TRUTH(topology->successors[a1 * topology->nbr_directions + 0] == -1);
+    TEST_TRUTH(topology->successors[a1 * topology->nbr_directions + topology->diagonal_directions[0][1]] ==
+               square_index_2d(1, 1, &rules));
+    terminate_game_state(&game_state);
+
+    // The second dimension wraps, the first doesn't
+    initialize_rules_and_game_state(&rules, &game_state, WRAPPING_8X14_CHESS);
+    topology = rules.topology;
+    int top_left = square_index_2d(0, 13, &rules);
+    TEST_TRUTH(topology->successors[top_left * topology->nbr_directions + 3] == square_index_2d(0, 0, &rules));
+    TEST_TRUTH(topology->successors[top_left * topology->nbr_directions + 0] == -1);
+    terminate_game_state(&game_state);
+
+    // The middle square of this board is a hole: no edge leads into it or out of it and no move ends there
+    initialize_rules_and_game_state(&rules, &game_state, FOUR_D_3X3X3X3_V1_CHESS);
+    topology = rules.topology;
+    int hole = 0;
+    for (int square_index = 0; square_index < topology->board_length; ++square_index) {
+        if (!game_state.board[square_index].part_of_board) {
+            hole = square_index;
+        }
+    }
+    TEST_TRUTH(!game_state.board[hole].part_of_board);
+    bool edges_avoid_hole = true;
+    for (int square_index = 0; square_index < topology->board_length; ++square_index) {
+        for (int direction = 0; direction < topology->nbr_directions; ++direction) {
+            int successor = topology->successors[square_index * topology->nbr_directions + direction];
+            edges_avoid_hole = edges_avoid_hole && successor != hole && (square_index != hole || successor == -1);
+        }
+    }
+    TEST_TRUTH(edges_avoid_hole);
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    unsigned long long random_state = 5;
+    bool moves_avoid_hole = true;
+    for (int move_number = 0; move_number < 40; ++move_number) {
+        int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+        for (int i = 0; i < nbr_moves; ++i) {
+            moves_avoid_hole = moves_avoid_hole && moves[i].destination_square != hole;
+        }
+        if (nbr_moves == 0) {
+            break;
+        }
+        make_move(moves[next_random(&random_state) % (unsigned long long)nbr_moves], QUEEN, &game_state, &rules);
+    }
+    TEST_TRUTH(moves_avoid_hole);
+    terminate_game_state(&game_state);
+}
+
+void test_static_exchange_evaluation() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    for (int i = 0; i < 64; ++i) {
+        game_state.board[i].piece.piece_type = NULL_PIECE_TYPE;
+    }
+    int target = square_index_2d(3, 4, &rules);
+
+    // RxP defended by a pawn loses the exchange
+    put_piece(target, PAWN, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(4, 5, &rules), PAWN, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(3, 0, &rules), ROOK, PIECE_COLOR_WHITE, &game_state);
+    struct Move rook_takes = quiet_move(square_index_2d(3, 0, &rules), target);
+    TEST_TRUTH(static_exchange_evaluation(rook_takes, &game_state, &rules) == 100 - 500);
+    TEST_TRUTH(game_state.board[target].piece.piece_type == PAWN && game_state.board[square_index_2d(3, 0, &rules)].piece.piece_type == ROOK);
+
+    // PxN is winning whatever happens next
+    put_piece(target, KNIGHT, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(2, 3, &rules), PAWN, PIECE_COLOR_WHITE, &game_state);
+    struct Move pawn_takes = quiet_move(square_index_2d(2, 3, &rules), target);
+    TEST_TRUTH(static_exchange_evaluation(pawn_takes, &game_state, &rules) == 300);
+
+    // undefended pawn after the defender is gone. Rook behind rook x-rays through
+    put_piece(square_index_2d(4, 5, &rules), NULL_PIECE_TYPE, PIECE_COLOR_BLACK, &game_state);
+    put_piece(target, PAWN, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(3, 7, &rules), ROOK, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(3, 1, &rules), ROOK, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(2, 3, &rules), NULL_PIECE_TYPE, PIECE_COLOR_WHITE, &game_state);
+    rook_takes = quiet_move(square_index_2d(3, 1, &rules), target);
+    TEST_TRUTH(static_exchange_evaluation(rook_takes, &game_state, &rules) == 100);
+    terminate_game_state(&game_state);
+}
+
+void test_quiescence_search() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    struct SearchContext search_context;
+    TEST_TRUTH(initialize_search_context(&search_context, &game_state, &rules));
+
+    // quiet starting position evaluates to equal material and searches a single node
+    TEST_TRUTH(quiescence_search(&search_context, -INFINITE_SCORE, INFINITE_SCORE, 0) == 0);
+    TEST_TRUTH(search_context.nodes == 1);
+
+    // extra black queen on d3 hangs to the pawns on c2 and e2, winning it back evens the material
+    put_piece(square_index_2d(3, 2, &rules), QUEEN, PIECE_COLOR_BLACK, &game_state);
+    reset_search_material(&search_context);
+    int score = quiescence_search(&search_context, -INFINITE_SCORE, INFINITE_SCORE, 0);
+    TEST_TRUTH(score == 0);
+    TEST_TRUTH(game_state.board[square_index_2d(3, 2, &rules)].piece.piece_type == QUEEN);     // board restored
+    TEST_TRUTH(search_context.material[PIECE_COLOR_BLACK] == search_context.material[PIECE_COLOR_WHITE] + 900);
+
+    // capturing the king ends the search
+    put_piece(square_index_2d(3, 2, &rules), KING, PIECE_COLOR_BLACK, &game_state);
+    reset_search_material(&search_context);
+    TEST_TRUTH(quiescence_search(&search_context, -INFINITE_SCORE, INFINITE_SCORE, 0) == MATE_SCORE);
+
+    terminate_search_context(&search_context);
+    terminate_game_state(&game_state);
+}
+
+void test_search_position() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    struct SearchContext search_context;
+    TEST_TRUTH(initialize_search_context(&search_context, &game_state, &rules));
+
+    // extra black queen on d3 is won with every combination of selective search features
+    int queen_square = square_index_2d(3, 2, &rules);
+    put_piece(queen_square, QUEEN, PIECE_COLOR_BLACK, &game_state);
+    bool queen_taken = true;
+    for (int features = 0; features < 16; ++features) {
+        struct SearchOptions options;
+        default_search_options(&options);
+        options.max_depth = 4;
+        options.null_move_pruning = features & 1;
+        options.late_move_reductions = features & 2;
+        options.futility_pruning = features & 4;
+        options.razoring = features & 8;
+        struct SearchResult result = search_position(&search_context, &options);
+        queen_taken = queen_taken && result.best_move.destination_square == queen_square && result.depth_reached == 4;
+    }
+    TEST_TRUTH(queen_taken);
+    TEST_TRUTH(game_state.board[queen_square].piece.piece_type == QUEEN && game_state.whos_turn == PIECE_COLOR_WHITE);
+
+    // node limit stops the search
+    struct SearchOptions options;
+    default_search_options(&options);
+    options.max_nodes = 1000;
+    struct SearchResult result = search_position(&search_context, &options);
+    TEST_TRUTH(result.nodes <= 1000 && result.depth_reached < options.max_depth);
+    TEST_TRUTH(result.best_move.destination_square != -1);
+
+    // stop requested by another thread before the first node still gives a move. Limits don't count while pondering
+    search_context.stop_requested = true;
+    result = search_position(&search_context, &options);
+    TEST_TRUTH(result.nodes == 1 && result.depth_reached == 0 && result.best_move.destination_square != -1);
+    search_context.stop_requested = false;
+    search_context.pondering = true;
+    options.max_nodes = 100;
+    options.max_depth = 3;
+    result = search_position(&search_context, &options);
+    TEST_TRUTH(result.nodes > 100 && result.depth_reached == 3);
+    search_context.pondering = false;
+
+    // king capture is found as a win right away
+    put_piece(queen_square, KING, PIECE_COLOR_BLACK, &game_state);
+    default_search_options(&options);
+    result = search_position(&search_context, &options);
+    TEST_TRUTH(result.score == MATE_SCORE && result.best_move.destination_square == queen_square);
+
+    terminate_search_context(&search_context);
+    terminate_game_state(&game_state);
+}
+
+void test_variant_names() {
+    printf("\n---%s---\n", __func__);
+    bool all_found = true;
+    for (int v = 0; v < NBR_OF_VARIANTS; ++v) {
+        enum Variant variant;
+        all_found = all_found && variant_from_name(variant_name(v), &variant) && variant == (enum Variant)v;
+    }
+    TEST_TRUTH(all_found);
+    enum Variant variant;
+    TEST_TRUTH(variant_from_name("four_d_3x3x3x3_v2", &variant) && variant == FOUR_D_3X3X3X3_V2_CHESS);
+}
+
+void test_play_game() {
+    printf("\n---%s---\n", __func__);
+    struct GameSettings settings;
+    default_game_settings(&settings, TWO_MOVES_CHESS);
+    settings.move_choosers[PIECE_COLOR_WHITE].search_options.max_depth = 2;
+    settings.move_choosers[PIECE_COLOR_BLACK].type = MOVE_CHOOSER_RANDOM;
+    settings.max_game_length = 200;
+
+    // king captured variant, ends with a winner or at the length limit. Search beats random
+    struct GameResult result;
+    TEST_TRUTH(play_game(&result, &settings));
+    TEST_TRUTH(result.nbr_moves > 0 && result.nbr_moves <= 200 && result.nodes > 0);
+    TEST_TRUTH(result.winner == PIECE_COLOR_WHITE);
+
+    // same seed same game, other seed other game
+    default_game_settings(&settings, STANDARD_CHESS);
+    settings.move_choosers[PIECE_COLOR_WHITE].type = MOVE_CHOOSER_RANDOM;
+    settings.move_choosers[PIECE_COLOR_BLACK].type = MOVE_CHOOSER_RANDOM;
+    settings.max_game_length = 300;
+    struct GameResult results[3];
+    settings.random_seed = 7;
+    TEST_TRUTH(play_game(&results[0], &settings) && play_game(&results[1], &settings));
+    settings.random_seed = 8;
+    TEST_TRUTH(play_game(&results[2], &settings));
+    TEST_TRUTH(results[0].nbr_moves == results[1].nbr_moves && results[0].winner == results[1].winner);
+    TEST_TRUTH(results[0].nbr_moves != results[2].nbr_moves || results[0].winner != results[2].winner);
+
+    default_game_settings(&settings, FOUR_D_3X3X3X3_V2_CHESS);
+    settings.max_game_length = 20;
+    TEST_TRUTH(play_game(&result, &settings));
+    TEST_TRUTH(result.nbr_moves > 1);   // no false checkmate on the first move
+}
+
+void test_notation() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+
+    char text[MAX_MOVE_TEXT_LENGTH];
+    square_to_text(square_index_2d(4, 1, &rules), text, &rules);
+    TEST_TRUTH(strcmp(text, "4.1") == 0);
+    const char *end;
+    TEST_TRUTH(text_to_square("4.1-4.3", &end, &rules) == square_index_2d(4, 1, &rules) && *end == '-');
+    TEST_TRUTH(text_to_square("4.8", &end, &rules) == -1);
+
+    // every legal move survives the round trip
+    struct Move moves[MAX_MOVES_IN_POSITION];
+    int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+    bool all_round_trip = nbr_moves == 20;
+    for (int i = 0; i < nbr_moves; ++i) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        move_to_text(moves[i], NULL_PIECE_TYPE, text, &rules);
+        all_round_trip = all_round_trip && text_to_move(text, &move, &promotion_piece_type, &game_state, &rules) &&
+                         move.origin_square == moves[i].origin_square &&
+                         move.destination_square == moves[i].destination_square;
+    }
+    TEST_TRUTH(all_round_trip);
+
+    // illegal moves, wrong side and junk are rejected
+    struct Move move;
+    enum PieceType promotion_piece_type;
+    TEST_TRUTH(!text_to_move("4.1-4.4", &move, &promotion_piece_type, &game_state, &rules));
+    TEST_TRUTH(!text_to_move("4.6-4.5", &move, &promotion_piece_type, &game_state, &rules));
+    TEST_TRUTH(!text_to_move("4.1-4.3q", &move, &promotion_piece_type, &game_state, &rules));
+    TEST_TRUTH(!text_to_move("e2e4", &move, &promotion_piece_type, &game_state, &rules));
+
+    // promotion letter, queen if left out
+    memset(game_state.board, 0, sizeof(struct Square) * 64);
+    for (int i = 0; i < 64; ++i) {
+        game_state.board[i].part_of_board = true;
+    }
+    put_piece(square_index_2d(4, 0, &rules), KING, PIECE_COLOR_WHITE, &game_state);
+    put_piece(square_index_2d(4, 7, &rules), KING, PIECE_COLOR_BLACK, &game_state);
+    put_piece(square_index_2d(0, 6, &rules), PAWN, PIECE_COLOR_WHITE, &game_state);
+    TEST_TRUTH(text_to_move("0.6-0.7n", &move, &promotion_piece_type, &game_state, &rules) && promotion_piece_type == KNIGHT);
+    TEST_TRUTH(text_to_move("0.6-0.7", &move, &promotion_piece_type, &game_state, &rules) && promotion_piece_type == QUEEN);
+    move_to_text(move, KNIGHT, text, &rules);
+    TEST_TRUTH(strcmp(text, "0.6-0.7n") == 0);
+    terminate_game_state(&game_state);
+}
+
+void test_position_notation() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state, read_game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    initialize_rules_and_game_state(&rules, &read_game_state, STANDARD_CHESS);
+    const struct BoardTopology *standard_topology = rules.topology;
+    char *text = malloc(position_text_max_length(&rules));
+    position_to_text(&game_state, &rules, text);
+    TEST_TRUTH(strcmp(text, "8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 - -") == 0);
+
+    // en passant state and moved pieces
+    TEST_TRUTH(text_to_position("8x8 RNBQKBNR/PPPP1PPP/8/4P+3/8/8/pppppppp/rnbqkbnr b 0 4.1-4.3/4.2 -", &read_game_state,
+                                &rules));
+    struct Move last_move = read_game_state.last_moves_by_piece_color[PIECE_COLOR_WHITE][0];
+    TEST_TRUTH(read_game_state.whos_turn == PIECE_COLOR_BLACK && last_move.pawn_moved_past_square == square_index_2d(4, 2, &rules));
+    TEST_TRUTH(read_game_state.board[square_index_2d(4, 3, &rules)].piece.has_moved);
+
+    // flags, holes, neutral pieces and directions write back the way they were read
+    const char *board_text = "8x8 R!NBQKBNR/PPPPPPPP/2x.?~N4/8/8/8/pvp>p<ppppp/rnbqkbnr w 0 - 0.1-0.3/0.2,,2.2-3.3";
+    TEST_TRUTH(text_to_position(board_text, &read_game_state, &rules));
+    TEST_TRUTH(read_game_state.board[0].white_flag && read_game_state.board[square_index_2d(2, 2, &rules)].black_flag);
+    TEST_TRUTH(!read_game_state.board[square_index_2d(1, 2, &rules)].part_of_board);
+    TEST_TRUTH(read_game_state.board[square_index_2d(3, 2, &rules)].piece.piece_color == PIECE_COLOR_NEUTRAL);
+    TEST_TRUTH(read_game_state.board[square_index_2d(1, 6, &rules)].piece.direction == RIGHT);
+    position_to_text(&read_game_state, &rules, text);
+    TEST_TRUTH(strcmp(text, board_text) == 0);
+
+    // shape, side to move, runs across rows and junk are rejected
+    TEST_TRUTH(!text_to_position("8x9 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8w RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8 RNBQKBNR/PPPPPPPP/16/8/8/pppppppp/rnbqkbnr w 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr x 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnz w 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 4.1-4.9 -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 -", &read_game_state, &rules));
+    TEST_TRUTH(!text_to_position("8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp", &read_game_state, &rules));
+
+    // a hole the rules weren't set up with, in front of the a pawn. Moves go around it, the standard board comes back
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    int hole = square_index_2d(0, 2, &rules);
+    TEST_TRUTH(text_to_position("8x8 RNBQKBNR/PPPPPPPP/x7/8/8/8/pppppppp/rnbqkbnr w 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(rules.topology != standard_topology && !rules.topology->part_of_board[hole]);
+    int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &read_game_state, &rules);
+    bool onto_or_past_hole = false;
+    for (int i = 0; i < nbr_moves; ++i) {
+        onto_or_past_hole = onto_or_past_hole || moves[i].destination_square == hole ||
+                            moves[i].destination_square == square_index_2d(0, 3, &rules);
+    }
+    TEST_TRUTH(nbr_moves == 17 && !onto_or_past_hole);
+    TEST_TRUTH(text_to_position("8x8 RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr w 0 - -", &read_game_state, &rules));
+    TEST_TRUTH(rules.topology == standard_topology);
+    free(text);
+    terminate_game_state(&game_state);
+    terminate_game_state(&read_game_state);
+
+    // positions of random games read back to the same position and the same text
+    enum Variant variants[] = {STANDARD_CHESS, GRAVITY_CHESS, TEN_MOVES_CHESS, WRAPPING_10X10_CHESS,
+                               THREE_D_5X5X5_CHESS, FOUR_D_4X4X4X4_V1_CHESS, FOUR_D_3X3X3X3_V1_CHESS,
+                               FOUR_D_3X3X3X3_V3_CHESS};
+    unsigned long long random_state = 7;
+    bool all_round_trip = true;
+    for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        initialize_rules_and_game_state(&rules, &game_state, variants[v]);
+        initialize_rules_and_game_state(&rules, &read_game_state, variants[v]);
+        int board_length = 1;
+        for (int dim = 0; dim < rules.dimensions; ++dim) {
+            board_length *= rules.board_shape[dim];
+        }
+        text = malloc(position_text_max_length(&rules));
+        char *read_text = malloc(position_text_max_length(&rules));
+        for (int move_number = 0; move_number < 60; ++move_number) {
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+            bool promotion = evaluate_promotion(move.origin_square, move.destination_square, &game_state, &rules);
+            make_move(move, promotion ? QUEEN : NULL_PIECE_TYPE, &game_state, &rules);
+            int length = position_to_text(&game_state, &rules, text);
+            all_round_trip = all_round_trip && length < position_text_max_length(&rules) &&
+                             text_to_position(text, &read_game_state, &rules) &&
+                             boards_equal(&game_state, &read_game_state, board_length) &&
+                             position_to_text(&read_game_state, &rules, read_text) == length && strcmp(text, read_text) == 0;
+        }
+        free(text);
+        free(read_text);
+        terminate_game_state(&game_state);
+        terminate_game_state(&read_game_state);
+    }
+    TEST_TRUTH(all_round_trip);
+
+    // holes right after empty squares, the empty squares end in a . so that they aren't read as holes
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    initialize_rules_and_game_state(&rules, &read_game_state, STANDARD_CHESS);
+    text = malloc(position_text_max_length(&rules));
+    char *read_text = malloc(position_text_max_length(&rules));
+    game_state.board[square_index_2d(3, 2, &rules)].part_of_board = false;
+    position_to_text(&game_state, &rules, text);
+    TEST_TRUTH(strcmp(text, "8x8 RNBQKBNR/PPPPPPPP/2.x4/8/8/8/pppppppp/rnbqkbnr w 0 - -") == 0);
+    TEST_TRUTH(text_to_position(text, &read_game_state, &rules) && boards_equal(&game_state, &read_game_state, 64));
+
+    // and random boards of pieces, empty squares and holes
+    all_round_trip = true;
+    for (int board_number = 0; board_number < 200; ++board_number) {
+        for (int square_index = 0; square_index < 64; ++square_index) {
+            struct Square *square = &game_state.board[square_index];
+            unsigned long long random = next_random(&random_state) % 4;
+            square->part_of_board = random != 0;
+            if (random <= 1) {
+                square->piece.piece_type = NULL_PIECE_TYPE;
+                square->piece.piece_color = NULL_PIECE_COLOR;
+            } else if (square->piece.piece_type == NULL_PIECE_TYPE) {
+                square->piece.piece_type = PAWN;
+                square->piece.piece_color = random == 2 ? PIECE_COLOR_WHITE : PIECE_COLOR_BLACK;
+            }
+        }
+        int length = position_to_text(&game_state, &rules, text);
+        all_round_trip = all_round_trip && text_to_position(text, &read_game_state, &rules) &&
+                         boards_equal(&game_state, &read_game_state, 64) &&
+                         position_to_text(&read_game_state, &rules, read_text) == length && strcmp(text, read_text) == 0;
+    }
+    TEST_TRUTH(all_round_trip);
+    free(text);
+    free(read_text);
+    terminate_game_state(&game_state);
+    terminate_game_state(&read_game_state);
+}
+
+void test_position_stream() {
+    printf("\n---%s---\n", __func__);
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    static struct MoveUndo undo;
+    struct Rules rules;
+    struct GameState game_state;
+    struct GameState client_game_state;
+    initialize_rules_and_game_state(&rules, &game_state, GRAVITY_CHESS);
+    initialize_rules_and_game_state(&rules, &client_game_state, GRAVITY_CHESS);
+    struct PositionStreamEncoder encoder;
+    struct PositionStreamDecoder decoder;
+    initialize_position_encoder(&encoder, 16, &rules);
+    initialize_position_decoder(&decoder, &rules);
+    unsigned char buffer[4096];
+    TEST_TRUTH(position_update_max_bytes(&rules) <= (int)sizeof(buffer));
+
+    // client follows the game, gravity moves more than two squares. One message is lost at ply 20, nothing is applied
+    // until the keyframe at ply 32
+    bool all_equal = true;
+    bool applied_while_out_of_sync = false;
+    int total_delta_bytes = 0;
+    for (int ply = 0; ply < 60; ++ply) {
+        int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+        if (nbr_moves == 0) {
+            break;
+        }
+        make_move_with_undo(moves[(ply * 7) % nbr_moves], QUEEN, &game_state, &rules, &undo);
+        int length = encode_position_update(&encoder, &undo, &game_state, buffer);
+        TEST_TRUTH((buffer[0] == POSITION_UPDATE_KEYFRAME) == (ply % 16 == 0));
+        if (buffer[0] == POSITION_UPDATE_DELTA) {
+            total_delta_bytes += length;
+        }
+        if (ply == 20) {
+            continue;
+        }
+        bool applied = decode_position_update(&decoder, buffer, length, &client_game_state);
+        if (ply > 20 && ply < 32) {
+            applied_while_out_of_sync = applied_while_out_of_sync || applied;
+        } else {
+            all_equal = all_equal && applied && boards_equal(&game_state, &client_game_state, 64) &&
+                        game_state.whos_turn == client_game_state.whos_turn;
+        }
+    }
+    TEST_TRUTH(all_equal);
+    TEST_TRUTH(!applied_while_out_of_sync);
+    TEST_TRUTH(total_delta_bytes < 56 * 24);   // a move is a few squares, a board 64
+
+    // truncated messages change nothing
+    int length = encode_position_keyframe(&encoder, &game_state, buffer);
+    TEST_TRUTH(!decode_position_update(&decoder, buffer, length - 1, &client_game_state));
+    TEST_TRUTH(boards_equal(&game_state, &client_game_state, 64));
+
+    // a keyframe with a hole the clients rules weren't set up with compiles their topology for it
+    struct Rules client_rules = rules;
+    initialize_position_decoder(&decoder, &client_rules);
+    int hole = 0;
+    while (!game_state.board[hole].part_of_board || game_state.board[hole].piece.piece_type != NULL_PIECE_TYPE) {
+        ++hole;
+    }
+    game_state.board[hole].part_of_board = false;
+    length = encode_position_keyframe(&encoder, &game_state, buffer);
+    TEST_TRUTH(decode_position_update(&decoder, buffer, length, &client_game_state));
+    TEST_TRUTH(boards_equal(&game_state, &client_game_state, 64));
+    TEST_TRUTH(client_rules.topology != rules.topology && !client_rules.topology->part_of_board[hole]);
+    terminate_game_state(&game_state);
+    terminate_game_state(&client_game_state);
+}
+
+void test_game_record() {
+    printf("\n---%s---\n", __func__);
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    struct Move played[60];
+    FILE *file = tmpfile();
+    struct GameRecordWriter writer;
+    initialize_game_record_writer(&writer, file);
+    TEST_TRUTH(begin_game_record(&writer, STANDARD_CHESS));
+    int nbr_played = 0;
+    enum PieceColor winner = NULL_PIECE_COLOR;
+    while (nbr_played < 60 && winner == NULL_PIECE_COLOR) {
+        int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &writer.game_state, &writer.rules);
+        if (nbr_moves == 0) {
+            break;
+        }
+        played[nbr_played] = moves[(nbr_played * 7) % nbr_moves];
+        TEST_TRUTH(write_game_record_move(&writer, played[nbr_played], QUEEN));
+        winner = get_winner(played[nbr_played++], &writer.game_state, &writer.rules);
+    }
+    struct GameState final_position = writer.game_state;
+    final_position.board = malloc(sizeof(*final_position.board) * 64);
+    memcpy(final_position.board, writer.game_state.board, sizeof(*final_position.board) * 64);
+    end_game_record(&writer, winner);
+
+    // a move that isn't legal is refused and the game goes on
+    struct Move black_move = {.origin_square = square_index_2d(4, 6, &writer.rules),
+                              .destination_square = square_index_2d(4, 4, &writer.rules)};
+    TEST_TRUTH(begin_game_record(&writer, STANDARD_CHESS));
+    TEST_TRUTH(!write_game_record_move(&writer, black_move, NULL_PIECE_TYPE));
+    TEST_TRUTH(write_game_record_move(&writer, quiet_move(square_index_2d(4, 1, &writer.rules),
+                                                          square_index_2d(4, 3, &writer.rules)), NULL_PIECE_TYPE));
+    end_game_record(&writer, NULL_PIECE_COLOR);
+    terminate_game_record_writer(&writer);
+    TEST_TRUTH(writer.nbr_moves == nbr_played + 1);
+    TEST_TRUTH(writer.bytes_written < 5 + 2 * 3 + (nbr_played + 1) * 2);   // a byte or two per move, 24 as struct Move
+
+    // the moves come back in order and end in the same position
+    rewind(file);
+    struct GameRecordReader reader;
+    TEST_TRUTH(initialize_game_record_reader(&reader, file));
+    TEST_TRUTH(next_game_record(&reader) && reader.variant == STANDARD_CHESS);
+    struct Move move;
+    enum PieceType promotion_piece_type;
+    bool same_moves = true;
+    int nbr_read = 0;
+    while (read_game_record_move(&reader, &move, &promotion_piece_type)) {
+        same_moves = same_moves && nbr_read < nbr_played && move.origin_square == played[nbr_read].origin_square &&
+                     move.destination_square == played[nbr_read].destination_square;
+        ++nbr_read;
+    }
+    TEST_TRUTH(same_moves && nbr_read == nbr_played);
+    TEST_TRUTH(!reader.error && reader.winner == winner);
+    TEST_TRUTH(boards_equal(&reader.game_state, &final_position, 64));
+    TEST_TRUTH(next_game_record(&reader) && read_game_record_move(&reader, &move, &promotion_piece_type));
+    TEST_TRUTH(!read_game_record_move(&reader, &move, &promotion_piece_type) && !reader.error);
+    TEST_TRUTH(!next_game_record(&reader));
+    terminate_game_record_reader(&reader);
+    rewind(file);
+    TEST_TRUTH(initialize_game_record_reader(&reader, file) && verify_game_records(&reader));
+    TEST_TRUTH(reader.nbr_games == 2);
+    terminate_game_record_reader(&reader);
+    fclose(file);
+    free(final_position.board);
+
+    // play_game records its games, the verifier finds a result the moves don't give
+    file = tmpfile();
+    initialize_game_record_writer(&writer, file);
+    struct GameSettings settings;
+    default_game_settings(&settings, STANDARD_CHESS);
+    settings.move_choosers[PIECE_COLOR_WHITE].type = MOVE_CHOOSER_RANDOM;
+    settings.move_choosers[PIECE_COLOR_BLACK].type = MOVE_CHOOSER_RANDOM;
+    settings.max_game_length = 300;
+    settings.record = &writer;
+    struct GameResult result;
+    TEST_TRUTH(play_game(&result, &settings));
+    TEST_TRUTH(writer.nbr_moves == result.nbr_moves);
+    rewind(file);
+    TEST_TRUTH(initialize_game_record_reader(&reader, file) && verify_game_records(&reader));
+    terminate_game_record_reader(&reader);
+    begin_game_record(&writer, STANDARD_CHESS);
+    write_game_record_move(&writer, quiet_move(square_index_2d(4, 1, &writer.rules), square_index_2d(4, 3, &writer.rules)),
+                           NULL_PIECE_TYPE);
+    end_game_record(&writer, PIECE_COLOR_WHITE);
+    terminate_game_record_writer(&writer);
+    rewind(file);
+    TEST_TRUTH(initialize_game_record_reader(&reader, file) && !verify_game_records(&reader));
+    terminate_game_record_reader(&reader);
+    fclose(file);
+}
+
+static void write_game_from_text(struct GameRecordWriter *writer, FILE *database_file, enum Variant variant,
+                                 const char *moves[], int nbr_moves) {
+    begin_game_record(writer, variant);
+    for (int i = 0; i < nbr_moves; ++i) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        TEST_TRUTH(text_to_move(moves[i], &move, &promotion_piece_type, &writer->game_state, &writer->rules));
+        write_game_record_move(writer, move, promotion_piece_type);
+    }
+    end_game_record(writer, NULL_PIECE_COLOR);
+    TEST_TRUTH(append_game_to_database(database_file, writer));
+}
+
+void test_game_database() {
+    printf("\n---%s---\n", __func__);
+    static struct Move moves[MAX_MOVES_IN_POSITION];
+    static struct MoveUndo undo;
+
+    // the hash kept up to date move by move is the hash of the position, gravity records squares more than once
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, GRAVITY_CHESS);
+    unsigned long long hash = position_hash(&game_state, &rules, GRAVITY_CHESS);
+    bool hashes_equal = true;
+    for (int ply = 0; ply < 40; ++ply) {
+        int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &game_state, &rules);
+        if (nbr_moves == 0) {
+            break;
+        }
+        make_move_with_undo(moves[(ply * 5) % nbr_moves], QUEEN, &game_state, &rules, &undo);
+        hash = update_position_hash(hash, &undo, &game_state);
+        hashes_equal = hashes_equal && hash == position_hash(&game_state, &rules, GRAVITY_CHESS);
+    }
+    TEST_TRUTH(hashes_equal);
+    TEST_TRUTH(position_hash(&game_state, &rules, GRAVITY_CHESS) != position_hash(&game_state, &rules, STANDARD_CHESS));
+    terminate_game_state(&game_state);
+
+    // two standard games reach the same position with the knights moved in a different order, a gravity game doesn't
+    const char *path = "test_game_database.c4db";
+    remove(path);
+    FILE *file = open_game_database_for_append(path);
+    struct GameRecordWriter writer;
+    initialize_game_record_writer(&writer, NULL);
+    const char *game1[] = {"1.0-2.2", "1.7-2.5", "6.0-5.2", "6.7-5.5"};
+    const char *game2[] = {"6.0-5.2", "1.7-2.5", "1.0-2.2"};
+    const char *game3[] = {"4.1-4.3"};
+    write_game_from_text(&writer, file, STANDARD_CHESS, game1, 4);
+    write_game_from_text(&writer, file, STANDARD_CHESS, game2, 3);
+    write_game_from_text(&writer, file, GRAVITY_CHESS, game3, 1);
+    terminate_game_record_writer(&writer);
+    fclose(file);
+    long long nbr_entries;
+    TEST_TRUTH(build_game_database_index(path, 2, (size_t)1 << 30, &nbr_entries));
+    TEST_TRUTH(nbr_entries == 5 + 4 + 2);
+
+    struct GameDatabase database;
+    TEST_TRUTH(open_game_database(&database, path));
+    TEST_TRUTH(database.nbr_entries == nbr_entries && database.indexed_length == (long long)database.length);
+    long long game_offsets[4];
+    int nbr_games = 0;
+    const unsigned char *game;
+    size_t length;
+    long long next_offset;
+    for (long long offset = GAME_DATABASE_FIRST_GAME; nbr_games < 4 &&
+            database_game(&database, offset, &game, &length, &next_offset); offset = next_offset) {
+        game_offsets[nbr_games++] = offset;
+    }
+    TEST_TRUTH(nbr_games == 3);
+
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    const struct GameDatabaseEntry *entries;
+    TEST_TRUTH(find_database_position(&database, position_hash(&game_state, &rules, STANDARD_CHESS), &entries) == 2);
+    for (int i = 0; i < 3; ++i) {
+        struct Move move;
+        enum PieceType promotion_piece_type;
+        text_to_move(game1[i], &move, &promotion_piece_type, &game_state, &rules);
+        make_move(move, promotion_piece_type, &game_state, &rules);
+    }
+    TEST_TRUTH(find_database_position(&database, position_hash(&game_state, &rules, STANDARD_CHESS), &entries) == 2);
+    TEST_TRUTH(entries[0].location == ((unsigned long long)game_offsets[0] << GAME_DATABASE_PLY_BITS | 3));
+    TEST_TRUTH(entries[1].location == ((unsigned long long)game_offsets[1] << GAME_DATABASE_PLY_BITS | 3));
+    TEST_TRUTH(find_database_position(&database, position_hash(&game_state, &rules, GRAVITY_CHESS), &entries) == 0);
+    terminate_game_state(&game_state);
+
+    // appended after the index was built, not in it until it is built again
+    close_game_database(&database);
+    file = open_game_database_for_append(path);
+    initialize_game_record_writer(&writer, NULL);
+    write_game_from_text(&writer, file, STANDARD_CHESS, game3, 1);
+    terminate_game_record_writer(&writer);
+    fclose(file);
+    TEST_TRUTH(open_game_database(&database, path));
+    TEST_TRUTH(database.indexed_length < (long long)database.length && database.nbr_entries == nbr_entries);
+    close_game_database(&database);
+
+    // more positions than the smallest memory budget holds, the sorted runs are spilled and merged into the same index
+    file = open_game_database_for_append(path);
+    initialize_game_record_writer(&writer, NULL);
+    unsigned long long random_state = 11;
+    for (int game_number = 0; game_number < 300; ++game_number) {
+        begin_game_record(&writer, STANDARD_CHESS);
+        enum PieceColor winner = NULL_PIECE_COLOR;
+        for (int ply = 0; ply < 60 && winner == NULL_PIECE_COLOR; ++ply) {
+            int nbr_moves = generate_moves(moves, MAX_MOVES_IN_POSITION, false, &writer.game_state, &writer.rules);
+            if (nbr_moves == 0) {
+                break;
+            }
+            struct Move move = moves[next_random(&random_state) % (unsigned long long)nbr_moves];
+            write_game_record_move(&writer, move, QUEEN);
+            winner = get_winner(move, &writer.game_state, &writer.rules);
+        }
+        end_game_record(&writer, winner);
+        append_game_to_database(file, &writer);
+    }
+    terminate_game_record_writer(&writer);
+    fclose(file);
+    TEST_TRUTH(build_game_database_index(path, 2, (size_t)1 << 30, &nbr_entries));
+    TEST_TRUTH(nbr_entries > 4 * 4096);
+    TEST_TRUTH(open_game_database(&database, path));
+    struct GameDatabaseEntry *in_memory_entries = malloc(sizeof(*in_memory_entries) * nbr_entries);
+    memcpy(in_memory_entries, database.entries, sizeof(*in_memory_entries) * nbr_entries);
+    close_game_database(&database);
+    long long nbr_spilled_entries;
+    TEST_TRUTH(build_game_database_index(path, 2, 0, &nbr_spilled_entries));
+    TEST_TRUTH(open_game_database(&database, path));
+    TEST_TRUTH(nbr_spilled_entries == nbr_entries && database.nbr_entries == nbr_entries &&
+               memcmp(database.entries, in_memory_entries, sizeof(*in_memory_entries) * nbr_entries) == 0);
+    char index_path[64];
+    snprintf(index_path, sizeof(index_path), "%s.index.spill0", path);
+    FILE *spill_file = fopen(index_path, "rb");
+    TEST_TRUTH(spill_file == NULL);     // removed as soon as it was open
+    if (spill_file != NULL) {
+        fclose(spill_file);
+    }
+    free(in_memory_entries);
+    close_game_database(&database);
+
+    remove(path);
+    snprintf(index_path, sizeof(index_path), "%s.index", path);
+    remove(index_path);
+}
+
+void test_starting_position_cache() {
+    printf("\n---%s---\n", __func__);
+    const char *path = "test_starting_positions.c4sp";
+    int nbr_variants;
+    TEST_TRUTH(write_starting_position_cache(path, &nbr_variants) && nbr_variants > 20);
+    TEST_TRUTH(load_starting_position_cache(path));
+
+    // the same game starts from the file as from the text files
+    enum Variant variants[] = {STANDARD_CHESS, TEN_MOVES_CHESS, SPARSE_CHESS, THREE_D_5X5X5_CHESS, FOUR_D_8X8X8X8_V2_CHESS};
+    bool all_same = true;
+    for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        struct Rules rules, cached_rules;
+        struct GameState game_state, cached_game_state;
+        initialize_rules_and_game_state(&rules, &game_state, variants[v]);
+        TEST_TRUTH(start_game(&cached_rules, &cached_game_state, variants[v]));
+        int board_length = 1;
+        for (int dim = 0; dim < rules.dimensions; ++dim) {
+            board_length *= rules.board_shape[dim];
+        }
+        all_same = all_same && cached_rules.dimensions == rules.dimensions &&
+                   cached_rules.moves_per_turn_by_color[PIECE_COLOR_WHITE] == rules.moves_per_turn_by_color[PIECE_COLOR_WHITE] &&
+                   boards_equal(&game_state, &cached_game_state, board_length);
+        terminate_game_state(&game_state);
+        terminate_game_state(&cached_game_state);
+    }
+    TEST_TRUTH(all_same);
+    unload_starting_position_cache();
+
+    // a cut off file is refused and games start from the text files again
+    FILE *file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    unsigned char *data = malloc(length);
+    rewind(file);
+    TEST_TRUTH(fread(data, 1, length, file) == (size_t)length);
+    fclose(file);
+    file = fopen(path, "wb");
+    fwrite(data, 1, length - 1, file);
+    fclose(file);
+    free(data);
+    TEST_TRUTH(!load_starting_position_cache(path));
+    struct Rules rules;
+    struct GameState game_state;
+    TEST_TRUTH(start_game(&rules, &game_state, STANDARD_CHESS) && game_state.board[0].piece.piece_type == ROOK);
+    terminate_game_state(&game_state);
+    remove(path);
+}
+
+// same moves from the cache as from get_moves, before and after the background thread filled it
+static bool cached_moves_match(struct MoveCache *cache, struct GameState *game_state, struct Rules *rules,
+                               unsigned long long hash, int board_length) {
+    struct Move moves[MAX_MOVES_SINGLE_PIECE], diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    struct Move cached_moves[MAX_MOVES_SINGLE_PIECE], cached_diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        if (!game_state->board[square_index].part_of_board) {
+            continue;
+        }
+        get_moves(moves, diagonal_pawn_moves, square_index, game_state, rules);
+        get_cached_moves(cache, cached_moves, cached_diagonal_pawn_moves, square_index, game_state, hash);
+        for (int i = 0; ; ++i) {
+            if (moves[i].destination_square != cached_moves[i].destination_square) {
+                return false;
+            } else if (moves[i].destination_square == -1) {
+                break;
+            } else if (moves[i].origin_square != cached_moves[i].origin_square) {
+                return false;
+            }
+        }
+        for (int i = 0; ; ++i) {
+            if (diagonal_pawn_moves[i].destination_square != cached_diagonal_pawn_moves[i].destination_square) {
+                return false;
+            } else if (diagonal_pawn_moves[i].destination_square == -1) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void test_move_cache() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    int board_length = rules.board_shape[0] * rules.board_shape[1];
+    unsigned long long hash = position_hash(&game_state, &rules, STANDARD_CHESS);
+    struct MoveCache cache;
+    TEST_TRUTH(initialize_move_cache(&cache, &game_state, &rules, hash));
+    TEST_TRUTH(cached_moves_match(&cache, &game_state, &rules, hash, board_length));
+
+    // after a move the old moves are gone, and once the thread is done every white piece comes from the cache
+    struct Move moves[MAX_MOVES_SINGLE_PIECE], diagonal_pawn_moves[MAX_MOVES_SINGLE_PIECE];
+    int e2 = square_index_2d(4, 1, &rules);
+    get_cached_moves(&cache, moves, diagonal_pawn_moves, e2, &game_state, hash);
+    struct MoveUndo undo;
+    make_move_with_undo(validate_selected_move(e2, square_index_2d(4, 3, &rules), moves, &game_state, &rules),
+                        NULL_PIECE_TYPE, &game_state, &rules, &undo);
+    hash = update_position_hash(hash, &undo, &game_state);
+    set_move_cache_position(&cache, &game_state, hash);
+    TEST_TRUTH(cached_moves_match(&cache, &game_state, &rules, hash, board_length));
+    int d7 = square_index_2d(3, 6, &rules);
+    get_cached_moves(&cache, moves, diagonal_pawn_moves, d7, &game_state, hash);
+    make_move_with_undo(validate_selected_move(d7, square_index_2d(3, 4, &rules), moves, &game_state, &rules),
+                        NULL_PIECE_TYPE, &game_state, &rules, &undo);
+    hash = update_position_hash(hash, &undo, &game_state);
+    set_move_cache_position(&cache, &game_state, hash);
+    while (!move_cache_complete(&cache)) {
+        ;
+    }
+    long long misses = cache.misses;
+    for (int square_index = 0; square_index < board_length; ++square_index) {
+        struct Piece piece = game_state.board[square_index].piece;
+        if (piece.piece_type != NULL_PIECE_TYPE && piece.piece_color == PIECE_COLOR_WHITE) {
+            get_cached_moves(&cache, moves, diagonal_pawn_moves, square_index, &game_state, hash);
+        }
+    }
+    TEST_TRUTH(cache.misses == misses);
+    TEST_TRUTH(cached_moves_match(&cache, &game_state, &rules, hash, board_length));
+    terminate_move_cache(&cache);
+    terminate_game_state(&game_state);
+}
+
+void test_analysis() {
+    printf("\n---%s---\n", __func__);
+    struct Rules rules;
+    struct GameState game_state;
+    initialize_rules_and_game_state(&rules, &game_state, STANDARD_CHESS);
+    struct SearchOptions options;
+    default_search_options(&options);
+    options.max_depth = 3;
+    struct Analysis analysis;
+    TEST_TRUTH(initialize_analysis(&analysis, &rules, &options, NULL, NULL));
+
+    // results come in by depth, the last one at full depth
+    unsigned long long hash = position_hash(&game_state, &rules, STANDARD_CHESS);
+    analyze_position(&analysis, &game_state, hash);
+    struct AnalysisResult result = {.depth = 0};
+    while (result.depth < 3) {
+        poll_analysis(&analysis, &result);
+    }
+    TEST_TRUTH(result.hash == hash && result.side_to_move == PIECE_COLOR_WHITE && result.best_move.destination_square != -1);
+    TEST_TRUTH(!poll_analysis(&analysis, &result));
+
+    // a newer position replaces the one being searched, its results end up last
+    struct Move move = result.best_move;
+    struct MoveUndo undo;
+    make_move_with_undo(move, NULL_PIECE_TYPE, &game_state, &rules, &undo);
+    unsigned long long hash_after_move = update_position_hash(hash, &undo, &game_state);
+    analyze_position(&analysis, &game_state, hash_after_move);
+    result.hash = 0;
+    while (result.hash != hash_after_move || result.depth < 3) {
+        poll_analysis(&analysis, &result);
+    }
+    TEST_TRUTH(result.side_to_move == PIECE_COLOR_BLACK &&
+               game_state.board[result.best_move.origin_square].piece.piece_color == PIECE_COLOR_BLACK);
+
+    terminate_analysis(&analysis);
+
+    // the stop meant for the position before can reach the thread after it took the next one, when the UI is between
+    // the exchange and stop_requested. Requested by hand during the first iterations here, the latest position is still
+    // searched to full depth
+    options.max_depth = 10;         // tens of milliseconds, the first iterations take one
+    TEST_TRUTH(initialize_analysis(&analysis, &rules, &options, NULL, NULL));
+    analyze_position(&analysis, &game_state, hash_after_move);
+    result.hash = 0;
+    while (result.hash != hash_after_move) {
+        poll_analysis(&analysis, &result);
+    }
+    TEST_TRUTH(result.depth < 10);
+    __atomic_store_n(&analysis.search_context.stop_requested, true, __ATOMIC_SEQ_CST);
+    while (result.depth < 10) {
+        poll_analysis(&analysis, &result);
+    }
+    TEST_TRUTH(result.hash == hash_after_move && result.best_move.destination_square != -1);
+    terminate_analysis(&analysis);
+    terminate_game_state(&game_state);
+}
+
+int main() {
+    // move_ordering.c
+    test_move_ordering_mvv_lva();
+    test_move_ordering_killers_and_history();
+
+    // move_generation.c
+    test_staged_move_generation();
+    test_lazy_generation_stops_early();
+
+    // chess_logic.c
+    test_make_and_unmake_move();
+    test_get_attackers();
+    test_count_attacks();
+    test_board_topology();
+
+    // search.c
+    test_static_exchange_evaluation();
+    test_quiescence_search();
+    test_search_position();
+
+    // chess_init.c
+    test_variant_names();
+
+    // game.c
+    test_play_game();
+
+    // notation.c
+    test_notation();
+    test_position_notation();
+
+    // position_stream.c
+    test_position_stream();
+
+    // game_record.c
+    test_game_record();
+
+    // game_database.c
+    test_game_database();
+
+    // starting_position_cache.c
+    test_starting_position_cache();
+
+    // move_cache.c
+    test_move_cache();
+
+    // analysis.c
+    test_analysis();
+
+    printf("\n");
+}